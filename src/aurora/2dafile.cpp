@@ -35,6 +35,7 @@
 #include "src/common/readstream.h"
 #include "src/common/writefile.h"
 #include "src/common/streamtokenizer.h"
+#include "src/common/hash.h"
 
 #include "src/aurora/types.h"
 #include "src/aurora/2dafile.h"
@@ -49,89 +50,107 @@ static const uint32 kVersion2b = MKTAG('V', '2', '.', 'b');
 
 namespace Aurora {
 
-TwoDARow::TwoDARow(TwoDAFile &parent) : _parent(&parent) {
+/** Hash a string, ignoring the case of ASCII characters. */
+static uint64 hashStringIgnoreCase(const Common::UString &str) {
+	uint64 hash = 0xCBF29CE484222325LL;
+
+	for (Common::UString::iterator it = str.begin(); it != str.end(); ++it)
+		hash = Common::hashFNV64(hash, Common::UString::toLower(*it));
+
+	return hash;
 }
 
-TwoDARow::~TwoDARow() {
+/** Could strtol() or strtof() find any number in this string? */
+static bool mayBeNumber(const Common::UString &str) {
+	const uint32 c = *str.begin();
+
+	// Digits, signs and the decimal point, or "inf" and "nan"
+	return Common::UString::isDigit(c) || (c == '-') || (c == '+') || (c == '.') ||
+	       (c == 'i') || (c == 'I') || (c == 'n') || (c == 'N') || Common::UString::isSpace(c);
+}
+
+
+TwoDARow::TwoDARow(const TwoDAFile &parent, size_t row) : _parent(&parent), _row(row) {
 }
 
 const Common::UString &TwoDARow::getString(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	if (_parent->isEmpty(_row, column))
 		return _parent->_defaultString;
 
-	return cell;
+	return _parent->getCell(_row, column);
 }
 
 const Common::UString &TwoDARow::getString(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultString;
-
-	return cell;
+	return getString(_parent->headerToColumn(column));
 }
 
 int32 TwoDARow::getInt(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	if (_parent->isEmpty(_row, column))
 		return _parent->_defaultInt;
 
-	return _parent->parseInt(cell);
+	return _parent->getCellInt(_row, column);
 }
 
 int32 TwoDARow::getInt(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultInt;
-
-	return _parent->parseInt(cell);
+	return getInt(_parent->headerToColumn(column));
 }
 
 float TwoDARow::getFloat(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
+	if (_parent->isEmpty(_row, column))
 		return _parent->_defaultFloat;
 
-	return _parent->parseFloat(cell);
+	return _parent->getCellFloat(_row, column);
 }
 
 float TwoDARow::getFloat(const Common::UString &column) const {
-	const Common::UString &cell = getCell(_parent->headerToColumn(column));
-	if (cell.empty() || (cell == "****"))
-		return _parent->_defaultFloat;
-
-	return _parent->parseFloat(cell);
+	return getFloat(_parent->headerToColumn(column));
 }
 
 bool TwoDARow::empty(size_t column) const {
-	const Common::UString &cell = getCell(column);
-	if (cell.empty() || (cell == "****"))
-		return true;
-
-	return false;
+	return _parent->isEmpty(_row, column);
 }
 
 bool TwoDARow::empty(const Common::UString &column) const {
 	return empty(_parent->headerToColumn(column));
 }
 
-static const Common::UString kEmpty;
-const Common::UString &TwoDARow::getCell(size_t n) const {
-	if (n >= _data.size())
-		return kEmpty;
 
-	return _data[n];
+TwoDAFile::PoolString::PoolString(const Common::UString &str) : string(str),
+	empty(str.empty() || (str == "****")), intValue(0), floatValue(0.0f) {
+
+	if (!empty && mayBeNumber(str)) {
+		intValue   = parseInt(str);
+		floatValue = parseFloat(str);
+	}
+}
+
+
+TwoDAFile::PoolString::PoolString(const Common::UString &str, bool e, int32 i, float f) :
+	string(str), empty(e), intValue(i), floatValue(f) {
+
+}
+
+
+TwoDAFile::Column::Column() : indexed(false) {
 }
 
 
+TwoDAFile::TwoDAFile() :
+	_defaultInt(0), _defaultFloat(0.0f), _headerHashCollision(false), _rowCount(0),
+	_emptyRow(*this, SIZE_MAX) {
+
+}
+
 TwoDAFile::TwoDAFile(Common::SeekableReadStream &twoda) :
-	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this) {
+	_defaultInt(0), _defaultFloat(0.0f), _headerHashCollision(false), _rowCount(0),
+	_emptyRow(*this, SIZE_MAX) {
 
 	load(twoda);
 }
 
 TwoDAFile::TwoDAFile(const GDAFile &gda) :
-	_defaultInt(0), _defaultFloat(0.0f), _emptyRow(*this) {
+	_defaultInt(0), _defaultFloat(0.0f), _headerHashCollision(false), _rowCount(0),
+	_emptyRow(*this, SIZE_MAX) {
 
 	load(gda);
 }
@@ -145,11 +164,14 @@ void TwoDAFile::clear() {
 
 	_headers.clear();
 
-	for (std::vector<TwoDARow *>::iterator row = _rows.begin(); row != _rows.end(); ++row)
-		delete *row;
 	_rows.clear();
+	_columns.clear();
+	_strings.clear();
+	_stringMap.clear();
+	_rowCount = 0;
 
 	_headerMap.clear();
+	_headerHashCollision = false;
 
 	_defaultString.clear();
 	_defaultInt   = 0;
@@ -175,6 +197,8 @@ void TwoDAFile::load(Common::SeekableReadStream &twoda) {
 		else if (_version == kVersion2b)
 			read2b(twoda); // Binary
 
+		finishColumns();
+
 		// Create the map to quickly translate headers to column indices
 		createHeaderMap();
 
@@ -249,25 +273,24 @@ void TwoDAFile::readRows2a(Common::SeekableReadStream &twoda,
 
 	size_t columnCount = _headers.size();
 
-	while (!twoda.eos()) {
-		TwoDARow *row = new TwoDARow(*this);
+	_columns.resize(columnCount);
 
+	std::vector<Common::UString> cells;
+	while (!twoda.eos()) {
 		// Skip the first token, which is the row index. It's implicit in the data anyway
 		tokenize.skipToken(twoda);
 
 		// Read all the cells in the row
-		size_t count = tokenize.getTokens(twoda, row->_data, columnCount, columnCount);
+		size_t count = tokenize.getTokens(twoda, cells, columnCount, columnCount);
 
 		// And move to the next line
 		tokenize.nextChunk(twoda);
 
-		if (count == 0) {
+		if (count == 0)
 			// Ignore empty lines
-			delete row;
 			continue;
-		}
 
-		_rows.push_back(row);
+		addRow(cells);
 	}
 }
 
@@ -296,7 +319,7 @@ void TwoDAFile::skipRowNames2b(Common::SeekableReadStream &twoda) {
 	 */
 
 	const uint32 rowCount = twoda.readUint32LE();
-	_rows.resize(rowCount, 0);
+	_rowCount = rowCount;
 
 	Common::StreamTokenizer tokenize(Common::StreamTokenizer::kRuleHeed);
 
@@ -316,10 +339,11 @@ void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
 	 */
 
 	size_t columnCount = _headers.size();
-	size_t rowCount    = _rows.size();
+	size_t rowCount    = _rowCount;
 	size_t cellCount   = columnCount * rowCount;
 
-	uint32 *offsets = new uint32[cellCount];
+	std::vector<uint16> offsets;
+	offsets.resize(cellCount);
 
 	Common::StreamTokenizer tokenize(Common::StreamTokenizer::kRuleHeed);
 
@@ -332,33 +356,167 @@ void TwoDAFile::readRows2b(Common::SeekableReadStream &twoda) {
 
 	size_t dataOffset = twoda.pos();
 
-	for (size_t i = 0; i < rowCount; i++) {
-		_rows[i] = new TwoDARow(*this);
+	/* Since the cell data is deduplicated, we only read each of the
+	 * distinct data strings once, and then reuse its pool index. */
+	Common::FlatHashMap<uint32> offsetToString;
 
-		_rows[i]->_data.resize(columnCount);
+	_columns.resize(columnCount);
+	for (size_t j = 0; j < columnCount; j++)
+		_columns[j].cells.resize(rowCount);
 
+	for (size_t i = 0; i < rowCount; i++) {
 		for (size_t j = 0; j < columnCount; j++) {
-			size_t offset = dataOffset + offsets[i * columnCount + j];
+			const uint16 offset = offsets[i * columnCount + j];
+
+			uint32 *string = offsetToString.find(offset);
+			if (!string) {
+				twoda.seek(dataOffset + offset);
 
-			try {
-				twoda.seek(offset);
-			} catch (...) {
-				delete[] offsets;
-				throw;
+				Common::UString cell = tokenize.getToken(twoda);
+				if (cell.empty())
+					cell = "****";
+
+				string  = &offsetToString[offset];
+				*string = addString(cell);
 			}
 
-			_rows[i]->_data[j] = tokenize.getToken(twoda);
-			if (_rows[i]->_data[j].empty())
-				_rows[i]->_data[j] = "****";
+			_columns[j].cells[i] = *string;
 		}
 	}
-
-	delete[] offsets;
 }
 
 void TwoDAFile::createHeaderMap() {
+	_headerMap.reserve(_headers.size());
+
 	for (size_t i = 0; i < _headers.size(); i++)
-		_headerMap.insert(std::make_pair(_headers[i], i));
+		mapHeader(hashStringIgnoreCase(_headers[i]), i);
+}
+
+void TwoDAFile::mapHeader(uint64 hash, uint32 column) {
+	const uint32 *mapped = _headerMap.find(hash);
+	if (!mapped) {
+		_headerMap[hash] = column;
+		return;
+	}
+
+	// Of several equal headers, the first one wins. Different headers with the same hash are a problem
+	if (!_headers[*mapped].equalsIgnoreCase(_headers[column]))
+		_headerHashCollision = true;
+}
+
+uint32 TwoDAFile::addString(const Common::UString &str) {
+	const uint64 hash = Common::hashStringFNV64(str);
+
+	const uint32 *string = _stringMap.find(hash);
+	if (string && (_strings[*string].string == str))
+		return *string;
+
+	_strings.push_back(PoolString(str));
+
+	// On a hash collision, the string is simply not deduplicated
+	if (!string)
+		_stringMap[hash] = _strings.size() - 1;
+
+	return _strings.size() - 1;
+}
+
+void TwoDAFile::addRow(const std::vector<Common::UString> &cells) {
+	assert(_columns.size() == _headers.size());
+
+	for (size_t i = 0; i < _columns.size(); i++)
+		_columns[i].cells.push_back(addString((i < cells.size()) ? cells[i] : ""));
+
+	_rowCount++;
+}
+
+void TwoDAFile::finishColumns() {
+	for (std::vector<Column>::iterator c = _columns.begin(); c != _columns.end(); ++c) {
+		assert(c->cells.size() == _rowCount);
+
+		c->empty.resize((_rowCount + 31) / 32, 0);
+
+		bool hasInts = false, hasFloats = false;
+		for (size_t i = 0; i < _rowCount; i++) {
+			const PoolString &string = _strings[c->cells[i]];
+
+			if (string.empty)
+				c->empty[i / 32] |= 1U << (i % 32);
+
+			hasInts   = hasInts   || (string.intValue   != 0);
+			hasFloats = hasFloats || (string.floatValue != 0.0f);
+		}
+
+		// Only columns that contain numbers get arrays of parsed values
+
+		if (hasInts) {
+			c->ints.resize(_rowCount);
+			for (size_t i = 0; i < _rowCount; i++)
+				c->ints[i] = _strings[c->cells[i]].intValue;
+		}
+
+		if (hasFloats) {
+			c->floats.resize(_rowCount);
+			for (size_t i = 0; i < _rowCount; i++)
+				c->floats[i] = _strings[c->cells[i]].floatValue;
+		}
+	}
+
+	createRows();
+
+	// Only needed while loading
+	_stringMap.clear();
+}
+
+void TwoDAFile::createRows() {
+	_rows.clear();
+	_rows.reserve(_rowCount);
+
+	for (size_t i = 0; i < _rowCount; i++)
+		_rows.push_back(TwoDARow(*this, i));
+}
+
+static const Common::UString kEmpty;
+const Common::UString &TwoDAFile::getCell(size_t row, size_t column) const {
+	if ((row >= _rowCount) || (column >= _columns.size()))
+		return kEmpty;
+
+	return _strings[_columns[column].cells[row]].string;
+}
+
+bool TwoDAFile::isEmpty(size_t row, size_t column) const {
+	if ((row >= _rowCount) || (column >= _columns.size()))
+		return true;
+
+	return (_columns[column].empty[row / 32] & (1U << (row % 32))) != 0;
+}
+
+int32 TwoDAFile::getCellInt(size_t row, size_t column) const {
+	const std::vector<int32> &ints = _columns[column].ints;
+
+	return ints.empty() ? 0 : ints[row];
+}
+
+float TwoDAFile::getCellFloat(size_t row, size_t column) const {
+	const std::vector<float> &floats = _columns[column].floats;
+
+	return floats.empty() ? 0.0f : floats[row];
+}
+
+void TwoDAFile::createIndex(size_t column) const {
+	const Column &c = _columns[column];
+	if (c.indexed)
+		return;
+
+	c.index.reserve(_rowCount);
+
+	for (size_t i = 0; i < _rowCount; i++) {
+		const uint64 hash = hashStringIgnoreCase(_rows[i].getString(column));
+
+		if (!c.index.contains(hash))
+			c.index[hash] = i;
+	}
+
+	c.indexed = true;
 }
 
 void TwoDAFile::load(const GDAFile &gda) {
@@ -374,31 +532,33 @@ void TwoDAFile::load(const GDAFile &gda) {
 			_headers[i] = headerString ? headerString : Common::UString::format("[%u]", headers[i].hash);
 		}
 
-		_rows.resize(gda.getRowCount(), 0);
+		_columns.resize(gda.getColumnCount());
+
+		std::vector<Common::UString> cells;
 		for (size_t i = 0; i < gda.getRowCount(); i++) {
 			const GFF4Struct *row = gda.getRow(i);
 
-			_rows[i] = new TwoDARow(*this);
-			_rows[i]->_data.resize(gda.getColumnCount());
+			cells.clear();
+			cells.resize(gda.getColumnCount());
 
 			for (size_t j = 0; j < gda.getColumnCount(); j++) {
 				if (row) {
 					switch (headers[j].type) {
 						case GDAFile::kTypeString:
 						case GDAFile::kTypeResource:
-							_rows[i]->_data[j] = row->getString(headers[j].field);
+							cells[j] = row->getString(headers[j].field);
 							break;
 
 						case GDAFile::kTypeInt:
-							_rows[i]->_data[j] = Common::UString::format("%d", (int) row->getSint(headers[j].field));
+							cells[j] = Common::UString::format("%d", (int) row->getSint(headers[j].field));
 							break;
 
 						case GDAFile::kTypeFloat:
-							_rows[i]->_data[j] = Common::UString::format("%f", row->getDouble(headers[j].field));
+							cells[j] = Common::UString::format("%f", row->getDouble(headers[j].field));
 							break;
 
 						case GDAFile::kTypeBool:
-							_rows[i]->_data[j] = Common::UString::format("%u", (uint) row->getUint(headers[j].field));
+							cells[j] = Common::UString::format("%u", (uint) row->getUint(headers[j].field));
 							break;
 
 						default:
@@ -406,12 +566,16 @@ void TwoDAFile::load(const GDAFile &gda) {
 					}
 				}
 
-				if (_rows[i]->_data[j].empty())
-					_rows[i]->_data[j] = "****";
+				if (cells[j].empty())
+					cells[j] = "****";
 
 			}
+
+			addRow(cells);
 		}
 
+		finishColumns();
+
 	} catch (Common::Exception &e) {
 		clear();
 
@@ -423,7 +587,7 @@ void TwoDAFile::load(const GDAFile &gda) {
 }
 
 size_t TwoDAFile::getRowCount() const {
-	return _rows.size();
+	return _rowCount;
 }
 
 size_t TwoDAFile::getColumnCount() const {
@@ -435,20 +599,29 @@ const std::vector<Common::UString> &TwoDAFile::getHeaders() const {
 }
 
 size_t TwoDAFile::headerToColumn(const Common::UString &header) const {
-	HeaderMap::const_iterator column = _headerMap.find(header);
-	if (column == _headerMap.end())
+	if (_headerHashCollision) {
+		for (size_t i = 0; i < _headers.size(); i++)
+			if (_headers[i].equalsIgnoreCase(header))
+				return i;
+
+		// No such header
+		return kFieldIDInvalid;
+	}
+
+	const uint32 *column = _headerMap.find(hashStringIgnoreCase(header));
+	if (!column || !_headers[*column].equalsIgnoreCase(header))
 		// No such header
 		return kFieldIDInvalid;
 
-	return column->second;
+	return *column;
 }
 
 const TwoDARow &TwoDAFile::getRow(size_t row) const {
-	if ((row >= _rows.size()) || !_rows[row])
+	if (row >= _rowCount)
 		// No such row
 		return _emptyRow;
 
-	return *_rows[row];
+	return _rows[row];
 }
 
 const TwoDARow &TwoDAFile::getRow(const Common::UString &header, const Common::UString &value) const {
@@ -456,10 +629,22 @@ const TwoDARow &TwoDAFile::getRow(const Common::UString &header, const Common::U
 	if (columnIndex == kFieldIDInvalid)
 		return _emptyRow;
 
-	for (std::vector<TwoDARow *>::const_iterator row = _rows.begin(); row != _rows.end(); ++row) {
-		if ((*row)->getString(columnIndex).equalsIgnoreCase(value))
-			return **row;
-	}
+	Common::StackLock lock(_indexMutex);
+
+	createIndex(columnIndex);
+
+	const uint32 *row = _columns[columnIndex].index.find(hashStringIgnoreCase(value));
+	if (!row)
+		// No such row
+		return _emptyRow;
+
+	if (_rows[*row].getString(columnIndex).equalsIgnoreCase(value))
+		return _rows[*row];
+
+	// A different value with the same hash. Fall back to searching the rest of the rows
+	for (size_t i = *row + 1; i < _rowCount; i++)
+		if (_rows[i].getString(columnIndex).equalsIgnoreCase(value))
+			return _rows[i];
 
 	// No such row
 	return _emptyRow;
@@ -478,16 +663,18 @@ void TwoDAFile::writeASCII(Common::WriteStream &out) const {
 	std::vector<size_t> colLength;
 	colLength.resize(_headers.size() + 1, 0);
 
-	const Common::UString maxRow = Common::UString::format("%d", (int)_rows.size() - 1);
+	const Common::UString maxRow = Common::UString::format("%d", (int)_rowCount - 1);
 	colLength[0] = maxRow.size();
 
 	for (size_t i = 0; i < _headers.size(); i++)
 		colLength[i + 1] = _headers[i].size();
 
-	for (size_t i = 0; i < _rows.size(); i++) {
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool   needQuote = _rows[i]->_data[j].contains(' ');
-			const size_t length    = needQuote ? _rows[i]->_data[j].size() + 2 : _rows[i]->_data[j].size();
+	for (size_t i = 0; i < _rowCount; i++) {
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = getCell(i, j);
+
+			const bool   needQuote = cell.contains(' ');
+			const size_t length    = needQuote ? cell.size() + 2 : cell.size();
 
 			colLength[j + 1] = MAX<size_t>(colLength[j + 1], length);
 		}
@@ -504,17 +691,19 @@ void TwoDAFile::writeASCII(Common::WriteStream &out) const {
 
 	// Write array
 
-	for (size_t i = 0; i < _rows.size(); i++) {
+	for (size_t i = 0; i < _rowCount; i++) {
 		out.writeString(Common::UString::format("%*u", (int)colLength[0], (uint)i));
 
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool needQuote = _rows[i]->_data[j].contains(' ');
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = getCell(i, j);
+
+			const bool needQuote = cell.contains(' ');
 
 			Common::UString cellString;
 			if (needQuote)
-				cellString = Common::UString::format("\"%s\"", _rows[i]->_data[j].c_str());
+				cellString = Common::UString::format("\"%s\"", cell.c_str());
 			else
-				cellString = _rows[i]->_data[j];
+				cellString = cell;
 
 			out.writeString(Common::UString::format(" %-*s", (int)colLength[j + 1], cellString.c_str()));
 
@@ -539,7 +728,7 @@ bool TwoDAFile::writeASCII(const Common::UString &fileName) const {
 
 void TwoDAFile::writeBinary(Common::WriteStream &out) const {
 	const size_t columnCount = _headers.size();
-	const size_t rowCount    = _rows.size();
+	const size_t rowCount    = _rowCount;
 	const size_t cellCount   = columnCount * rowCount;
 
 	out.writeString("2DA V2.b\n");
@@ -587,10 +776,8 @@ void TwoDAFile::writeBinary(Common::WriteStream &out) const {
 	cells.reserve(cellCount);
 
 	for (size_t i = 0; i < rowCount; i++) {
-		assert(_rows[i]);
-
 		for (size_t j = 0; j < columnCount; j++) {
-			const Common::UString cell = _rows[i]->getString(j);
+			const Common::UString cell = _rows[i].getString(j);
 
 			// Do we already know about this cell data string?
 			size_t foundCell = SIZE_MAX;
@@ -662,20 +849,22 @@ void TwoDAFile::writeCSV(Common::WriteStream &out) const {
 
 	// Write array
 
-	for (size_t i = 0; i < _rows.size(); i++) {
-		for (size_t j = 0; j < _rows[i]->_data.size(); j++) {
-			const bool needQuote = _rows[i]->_data[j].contains(',');
+	for (size_t i = 0; i < _rowCount; i++) {
+		for (size_t j = 0; j < _columns.size(); j++) {
+			const Common::UString &cell = getCell(i, j);
+
+			const bool needQuote = cell.contains(',');
 
 			if (needQuote)
 				out.writeByte('"');
 
-			if (_rows[i]->_data[j] != "****")
-				out.writeString(_rows[i]->_data[j]);
+			if (cell != "****")
+				out.writeString(cell);
 
 			if (needQuote)
 				out.writeByte('"');
 
-			if (j < (_rows[i]->_data.size() - 1))
+			if (j < (_columns.size() - 1))
 				out.writeByte(',');
 		}
 
@@ -26,10 +26,11 @@
 #define AURORA_2DAFILE_H
 
 #include <vector>
-#include <map>
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/flathashmap.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/aurorafile.h"
 
@@ -43,6 +44,7 @@ namespace Aurora {
 
 class TwoDAFile;
 class GDAFile;
+class TwoDASnapshot;
 
 /** A row within a 2DA file.
  *
@@ -53,6 +55,9 @@ class GDAFile;
  *  For convenience's sake, there are also methods to directly parse
  *  the cell strings into integer or floating point values.
  *
+ *  A TwoDARow doesn't hold any data itself. It's a lightweight view
+ *  into the columns of its parent TwoDAFile.
+ *
  *  See also class TwoDAFile.
  */
 class TwoDARow {
@@ -78,14 +83,11 @@ public:
 	bool empty(const Common::UString &column) const;
 
 private:
-	TwoDAFile *_parent; ///< The parent 2DA.
-
-	std::vector<Common::UString> _data;
+	const TwoDAFile *_parent; ///< The parent 2DA.
 
-	TwoDARow(TwoDAFile &parent);
-	~TwoDARow();
+	size_t _row; ///< The index of this row within the parent 2DA.
 
-	const Common::UString &getCell(size_t n) const;
+	TwoDARow(const TwoDAFile &parent, size_t row);
 
 	friend class TwoDAFile;
 };
@@ -113,6 +115,12 @@ private:
  *  be read and modified with a simple text editor. The binary
  *  version cannot.
  *
+ *  Internally, the data is stored by column. The distinct cell strings
+ *  are kept once each in a string pool, and parsed into integer and
+ *  floating point values only once, when loading. Each column then holds
+ *  the pool index of each of its cells, a bitmap of empty cells and, if
+ *  the column contains any numbers at all, arrays of the parsed values.
+ *
  *  See also classes TwoDARow and TwoDARegistry.
  */
 class TwoDAFile : public AuroraFile {
@@ -157,17 +165,60 @@ public:
 	// '---
 
 private:
-	typedef std::map<Common::UString, size_t, Common::UString::iless> HeaderMap;
+	/** A distinct cell string, with its parsed values. */
+	struct PoolString {
+		Common::UString string; ///< The raw cell string.
+
+		bool  empty;      ///< Is this an empty cell?
+		int32 intValue;   ///< The cell string parsed as an int.
+		float floatValue; ///< The cell string parsed as a float.
+
+		PoolString(const Common::UString &str);
+		PoolString(const Common::UString &str, bool e, int32 i, float f);
+	};
+
+	/** A column of cells. */
+	struct Column {
+		std::vector<uint32> cells;  ///< The index of each cell's string in the string pool.
+		std::vector<uint32> empty;  ///< Bitmap of the empty cells.
+		std::vector<int32>  ints;   ///< The parsed int cell values. Empty if all are 0.
+		std::vector<float>  floats; ///< The parsed float cell values. Empty if all are 0.0f.
+
+		/** The first row for each value, indexed by the case-insensitive hash of the value. */
+		mutable Common::FlatHashMap<uint32> index;
+		/** Was the index created? */
+		mutable bool indexed;
+
+		Column();
+	};
 
 	Common::UString _defaultString; ///< The default string to return should a cell not exist.
 	int32           _defaultInt;    ///< The default int to return should a cell not exist.
 	float           _defaultFloat;  ///< The default float to return should a cell not exist.
 
 	std::vector<Common::UString> _headers;
-	HeaderMap _headerMap;
+
+	/** The column indices, indexed by the case-insensitive hash of the header. */
+	Common::FlatHashMap<uint32> _headerMap;
+	/** Do two different headers share the same hash? */
+	bool _headerHashCollision;
+
+	size_t _rowCount; ///< The number of rows.
+
+	std::vector<PoolString> _strings; ///< All distinct cell strings.
+	std::vector<Column>     _columns; ///< All columns.
+
+	/** The string pool indices, indexed by the hash of the string. Only used while loading. */
+	Common::FlatHashMap<uint32> _stringMap;
 
 	TwoDARow _emptyRow;
-	std::vector<TwoDARow *> _rows;
+	std::vector<TwoDARow> _rows;
+
+	/** Protects the lazy creation of the column indices. */
+	mutable Common::Mutex _indexMutex;
+
+	/** Create an empty 2DA, to be filled by TwoDASnapshot. */
+	TwoDAFile();
 
 	// Loading helpers
 	void load(Common::SeekableReadStream &twoda);
@@ -189,11 +240,36 @@ private:
 	void load(const GDAFile &gda);
 
 	void createHeaderMap();
+	/** Map the header with this case-insensitive hash to this column. */
+	void mapHeader(uint64 hash, uint32 column);
+
+	// Columnar storage helpers
+	/** Add a string to the string pool, returning its index. */
+	uint32 addString(const Common::UString &str);
+	/** Add a row of cell strings. */
+	void addRow(const std::vector<Common::UString> &cells);
+	/** Create the rows and the parsed column data after all cells have been added. */
+	void finishColumns();
+	/** Create the row views onto the columns. */
+	void createRows();
+
+	/** Return the raw string of a cell. */
+	const Common::UString &getCell(size_t row, size_t column) const;
+	/** Is this cell empty or non-existent? */
+	bool isEmpty(size_t row, size_t column) const;
+	/** Return the parsed int value of a non-empty cell. */
+	int32 getCellInt(size_t row, size_t column) const;
+	/** Return the parsed float value of a non-empty cell. */
+	float getCellFloat(size_t row, size_t column) const;
+
+	/** Create the index for value lookups in this column, if it doesn't exist yet. */
+	void createIndex(size_t column) const;
 
 	static int32 parseInt(const Common::UString &str);
 	static float parseFloat(const Common::UString &str);
 
 	friend class TwoDARow;
+	friend class TwoDASnapshot;
 };
 
 } // End of namespace Aurora
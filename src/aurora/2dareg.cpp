@@ -22,8 +22,10 @@
  *  The global 2DA registry.
  */
 
+#include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
+#include "src/common/timestamp.h"
 
 #include "src/aurora/2dareg.h"
 #include "src/aurora/types.h"
@@ -35,6 +37,12 @@ DECLARE_SINGLETON(Aurora::TwoDARegistry)
 
 namespace Aurora {
 
+TwoDARegistry::LoadStats::LoadStats() : twodasSnapshot(0), twodasParsed(0),
+	timeSnapshot(0), timeParsed(0) {
+
+}
+
+
 TwoDARegistry::TwoDARegistry() {
 }
 
@@ -156,6 +164,40 @@ void TwoDARegistry::removeGDA(const Common::UString &name) {
 	_gdas.erase(gda);
 }
 
+void TwoDARegistry::setSnapshot(const Common::UString &file) {
+	_snapshotFile = file;
+	_snapshot.clear();
+
+	_loadStats = LoadStats();
+
+	if (_snapshotFile.empty())
+		return;
+
+	if (!TwoDASnapshot::isSupported()) {
+		_snapshotFile.clear();
+		return;
+	}
+
+	if (_snapshot.load(_snapshotFile))
+		status("Loaded 2DA snapshot \"%s\" (%u 2DAs)", _snapshotFile.c_str(), (uint) _snapshot.getCount());
+}
+
+void TwoDARegistry::saveSnapshot() {
+	if (_snapshotFile.empty() || !_snapshot.isDirty())
+		return;
+
+	try {
+		_snapshot.save(_snapshotFile);
+	} catch (Common::Exception &e) {
+		e.add("Failed saving the 2DA snapshot \"%s\"", _snapshotFile.c_str());
+		Common::printException(e, "WARNING: ");
+	}
+}
+
+const TwoDARegistry::LoadStats &TwoDARegistry::getLoadStats() const {
+	return _loadStats;
+}
+
 TwoDAFile *TwoDARegistry::load2DA(const Common::UString &name) {
 	Common::SeekableReadStream *twodaFile = 0;
 	TwoDAFile *twoda = 0;
@@ -164,7 +206,26 @@ TwoDAFile *TwoDARegistry::load2DA(const Common::UString &name) {
 		if (!(twodaFile = ResMan.getResource(name, kFileType2DA)))
 			throw Common::Exception("No such 2DA");
 
-		twoda = new TwoDAFile(*twodaFile);
+		const uint64 startTime = Common::getMicroTimestamp();
+
+		// Try to create the 2DA out of the snapshot first, and only parse it if that fails
+
+		const uint64 sourceHash = _snapshotFile.empty() ? 0 : TwoDASnapshot::hashSource(*twodaFile);
+
+		if (!_snapshotFile.empty() && (twoda = _snapshot.find(name, sourceHash))) {
+			_loadStats.twodasSnapshot++;
+			_loadStats.timeSnapshot += Common::getMicroTimestamp() - startTime;
+
+		} else {
+			twoda = new TwoDAFile(*twodaFile);
+
+			_loadStats.twodasParsed++;
+			_loadStats.timeParsed += Common::getMicroTimestamp() - startTime;
+
+			if (!_snapshotFile.empty())
+				_snapshot.add(name, sourceHash, *twoda);
+		}
+
 	} catch (Common::Exception &e) {
 		delete twoda;
 
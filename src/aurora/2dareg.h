@@ -30,6 +30,8 @@
 #include "src/common/ustring.h"
 #include "src/common/singleton.h"
 
+#include "src/aurora/2dasnapshot.h"
+
 namespace Aurora {
 
 class TwoDAFile;
@@ -52,9 +54,25 @@ class GDAFile;
  *  the same resource type, each GDA holding the information for a
  *  range of resources. These GDAs complete each other instead of
  *  overwriting each other.
+ *
+ *  Additionally, TwoDARegistry can keep a persistent snapshot of all
+ *  parsed 2DAs (see TwoDASnapshot). A 2DA whose source data hasn't
+ *  changed since it was last parsed is then created out of the snapshot,
+ *  instead of being parsed again. GDAs are not included in the snapshot.
  */
 class TwoDARegistry : public Common::Singleton<TwoDARegistry> {
 public:
+	/** Statistics about the loading of 2DAs. */
+	struct LoadStats {
+		uint32 twodasSnapshot; ///< Number of 2DAs created out of the snapshot.
+		uint32 twodasParsed;   ///< Number of 2DAs parsed from their source data.
+
+		uint64 timeSnapshot; ///< Time spent creating 2DAs out of the snapshot, in microseconds.
+		uint64 timeParsed;   ///< Time spent parsing 2DAs, in microseconds.
+
+		LoadStats();
+	};
+
 	TwoDARegistry();
 	~TwoDARegistry();
 
@@ -81,6 +99,20 @@ public:
 	/** Remove a certain GDA from the registry. */
 	void removeGDA(const Common::UString &name);
 
+	// .--- 2DA snapshot
+	/** Use this file as the persistent 2DA snapshot.
+	 *
+	 *  If the file exists and is a valid snapshot, it is mapped into memory.
+	 *  An empty file name disables the snapshot.
+	 */
+	void setSnapshot(const Common::UString &file);
+	/** Save the 2DA snapshot, if it was changed. */
+	void saveSnapshot();
+
+	/** Return statistics about the loading of 2DAs. */
+	const LoadStats &getLoadStats() const;
+	// '---
+
 private:
 	typedef std::map<Common::UString, TwoDAFile *> TwoDAMap;
 	typedef std::map<Common::UString, GDAFile *> GDAMap;
@@ -88,6 +120,11 @@ private:
 	TwoDAMap _twodas;
 	GDAMap   _gdas;
 
+	Common::UString _snapshotFile; ///< The file the 2DA snapshot is saved to.
+	TwoDASnapshot   _snapshot;     ///< The persistent snapshot of parsed 2DAs.
+
+	LoadStats _loadStats; ///< Time spent loading 2DAs.
+
 	TwoDAFile *load2DA(const Common::UString &name);
 	GDAFile   *loadGDA(const Common::UString &name);
 	GDAFile   *loadMGDA(Common::UString prefix);
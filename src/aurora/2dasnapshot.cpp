@@ -0,0 +1,569 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file
+ *  A memory-mappable snapshot of parsed 2DA files.
+ */
+
+#include <cstring>
+
+#include "src/common/util.h"
+#include "src/common/strutil.h"
+#include "src/common/error.h"
+#include "src/common/hash.h"
+#include "src/common/filepath.h"
+#include "src/common/mappedfile.h"
+#include "src/common/writefile.h"
+#include "src/common/readstream.h"
+#include "src/common/memwritestream.h"
+#include "src/common/encoding.h"
+
+#include "src/aurora/2dasnapshot.h"
+#include "src/aurora/2dafile.h"
+
+static const uint32 k2DASnapshotID = MKTAG('X', '2', 'D', 'S');
+static const uint32 kVersion10     = MKTAG('V', '1', '.', '0');
+
+static const uint32 kHeaderSize    = 32;
+static const uint32 kDirectorySize = 24;
+
+static const uint32 kFlagHeaderHashCollision = 1 << 0;
+
+static const uint32 kColumnFlagInts   = 1 << 0;
+static const uint32 kColumnFlagFloats = 1 << 1;
+
+namespace Aurora {
+
+namespace {
+
+/** Helper class reading out of the raw data of a snapshot. */
+struct SnapshotReader {
+	const byte *data;
+	size_t size;
+	size_t pos;
+
+	SnapshotReader(const byte *d, size_t s) : data(d), size(s), pos(0) {
+	}
+
+	void check(size_t count, size_t elementSize) const {
+		if (count > ((size - pos) / elementSize))
+			throw Common::Exception("2DA snapshot data truncated");
+	}
+
+	uint32 readUint32() {
+		check(1, 4);
+
+		const uint32 value = READ_LE_UINT32(data + pos);
+		pos += 4;
+
+		return value;
+	}
+
+	uint64 readUint64() {
+		const uint64 low  = readUint32();
+		const uint64 high = readUint32();
+
+		return (high << 32) | low;
+	}
+
+	const byte *readBytes(size_t count) {
+		check(count, 1);
+
+		const byte *bytes = data + pos;
+		pos += count;
+
+		return bytes;
+	}
+
+	/** Read an array of 4-byte values. */
+	template<typename T>
+	void readArray(std::vector<T> &array, size_t count) {
+		check(count, 4);
+
+		array.resize(count);
+		if (count == 0)
+			return;
+
+#if defined(XOREOS_LITTLE_ENDIAN)
+		// The data is already in the right byte order, so just copy it
+		std::memcpy(&array[0], data + pos, count * 4);
+#else
+		for (size_t i = 0; i < count; i++) {
+			const uint32 value = READ_LE_UINT32(data + pos + i * 4);
+			std::memcpy(&array[i], &value, 4);
+		}
+#endif
+
+		pos += count * 4;
+	}
+
+	void align(size_t alignment) {
+		pos = MIN(size, ((pos + alignment - 1) / alignment) * alignment);
+	}
+};
+
+/** Helper class collecting the data of a single 2DA in a snapshot. */
+struct TableWriter {
+	Common::MemoryWriteStreamDynamic strings;
+
+	TableWriter() : strings(true) {
+	}
+
+	/** Add a string to the string data, writing its offset and size. */
+	void addString(Common::WriteStream &out, const Common::UString &str) {
+		const size_t size = std::strlen(str.c_str());
+
+		out.writeUint32LE(strings.size());
+		out.writeUint32LE(size);
+
+		strings.write(str.c_str(), size);
+	}
+};
+
+/** Write padding bytes until the stream position is aligned. */
+static void writeAlignment(Common::MemoryWriteStreamDynamic &out, size_t alignment) {
+	while ((out.size() % alignment) != 0)
+		out.writeByte(0);
+}
+
+/** Write an array of 4-byte values. */
+template<typename T>
+static void writeArray(Common::WriteStream &out, const std::vector<T> &array) {
+	for (typename std::vector<T>::const_iterator a = array.begin(); a != array.end(); ++a) {
+		uint32 value;
+		std::memcpy(&value, &*a, 4);
+
+		out.writeUint32LE(value);
+	}
+}
+
+/** Read a string out of the string data. */
+static Common::UString readString(const byte *strings, size_t stringsSize, uint32 offset, uint32 size) {
+	if ((offset > stringsSize) || (size > (stringsSize - offset)))
+		throw Common::Exception("2DA snapshot string out of range (%u+%u/%u)", offset, size, (uint) stringsSize);
+
+	return Common::UString(reinterpret_cast<const char *>(strings + offset), size);
+}
+
+} // End of anonymous namespace
+
+
+TwoDASnapshot::TwoDASnapshot() : _dirty(false) {
+}
+
+TwoDASnapshot::~TwoDASnapshot() {
+	clear();
+}
+
+void TwoDASnapshot::clear() {
+	_mapping.reset();
+
+	_loaded.clear();
+	_added.clear();
+
+	_dirty = false;
+}
+
+bool TwoDASnapshot::isSupported() {
+	return Common::FileMapping::isSupported();
+}
+
+bool TwoDASnapshot::load(const Common::UString &file) {
+	clear();
+
+	if (!isSupported() || !Common::FilePath::isRegularFile(file))
+		return false;
+
+	try {
+		_mapping.reset(new Common::FileMapping(file));
+
+		readDirectory();
+
+	} catch (Common::Exception &e) {
+		e.add("Failed loading the 2DA snapshot \"%s\"", file.c_str());
+		Common::printException(e, "WARNING: ");
+
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+void TwoDASnapshot::readDirectory() {
+	SnapshotReader header(_mapping->getData(), _mapping->getSize());
+
+	header.check(1, kHeaderSize);
+
+	const uint32 id      = READ_BE_UINT32(header.readBytes(4));
+	const uint32 version = READ_BE_UINT32(header.readBytes(4));
+
+	if (id != k2DASnapshotID)
+		throw Common::Exception("Not a 2DA snapshot (%s)", Common::debugTag(id).c_str());
+
+	if (version != kVersion10)
+		throw Common::Exception("Unsupported 2DA snapshot version %s", Common::debugTag(version).c_str());
+
+	const uint32 count           = header.readUint32();
+	const uint32 directoryOffset = header.readUint32();
+	const uint32 namesSize       = header.readUint32();
+	const uint32 namesOffset     = header.readUint32();
+
+	if ((namesOffset > _mapping->getSize()) || (namesSize > (_mapping->getSize() - namesOffset)))
+		throw Common::Exception("2DA snapshot names out of range");
+
+	const char *names = reinterpret_cast<const char *>(_mapping->getData() + namesOffset);
+
+	SnapshotReader directory(_mapping->getData(), _mapping->getSize());
+	directory.pos = MIN<size_t>(directoryOffset, _mapping->getSize());
+
+	directory.check(count, kDirectorySize);
+
+	for (uint32 i = 0; i < count; i++) {
+		const uint32 nameOffset = directory.readUint32();
+		directory.readUint32(); // Reserved
+
+		Entry entry;
+		entry.sourceHash = directory.readUint64();
+		entry.offset     = directory.readUint32();
+		entry.size       = directory.readUint32();
+
+		if ((nameOffset >= namesSize) || !std::memchr(names + nameOffset, 0, namesSize - nameOffset))
+			throw Common::Exception("2DA snapshot name out of range");
+
+		if ((entry.offset > _mapping->getSize()) || (entry.size > (_mapping->getSize() - entry.offset)))
+			throw Common::Exception("2DA snapshot data out of range");
+
+		_loaded[Common::UString(names + nameOffset)] = entry;
+	}
+}
+
+bool TwoDASnapshot::isDirty() const {
+	return _dirty;
+}
+
+size_t TwoDASnapshot::getCount() const {
+	size_t count = _added.size();
+
+	for (LoadedMap::const_iterator l = _loaded.begin(); l != _loaded.end(); ++l)
+		if (_added.find(l->first) == _added.end())
+			count++;
+
+	return count;
+}
+
+TwoDAFile *TwoDASnapshot::find(const Common::UString &name, uint64 sourceHash) const {
+	const Common::UString lowerName = name.toLower();
+
+	try {
+		AddedMap::const_iterator added = _added.find(lowerName);
+		if (added != _added.end()) {
+			if ((added->second.sourceHash != sourceHash) || added->second.data.empty())
+				return 0;
+
+			return read(&added->second.data[0], added->second.data.size());
+		}
+
+		LoadedMap::const_iterator loaded = _loaded.find(lowerName);
+		if ((loaded == _loaded.end()) || (loaded->second.sourceHash != sourceHash))
+			return 0;
+
+		return read(_mapping->getData() + loaded->second.offset, loaded->second.size);
+
+	} catch (Common::Exception &e) {
+		e.add("Failed reading 2DA \"%s\" from the snapshot", name.c_str());
+		Common::printException(e, "WARNING: ");
+	}
+
+	return 0;
+}
+
+void TwoDASnapshot::add(const Common::UString &name, uint64 sourceHash, const TwoDAFile &twoda) {
+	Common::MemoryWriteStreamDynamic data(true);
+	write(data, twoda);
+
+	Added &added = _added[name.toLower()];
+
+	added.sourceHash = sourceHash;
+	added.data.assign(data.getData(), data.getData() + data.size());
+
+	_dirty = true;
+}
+
+uint64 TwoDASnapshot::hashSource(Common::SeekableReadStream &stream) {
+	uint64 hash = 0xCBF29CE484222325LL;
+
+	stream.seek(0);
+
+	byte buffer[4096];
+
+	size_t n;
+	while ((n = stream.read(buffer, sizeof(buffer))) > 0)
+		for (size_t i = 0; i < n; i++)
+			hash = Common::hashFNV64(hash, buffer[i]);
+
+	stream.seek(0);
+
+	return hash;
+}
+
+void TwoDASnapshot::write(Common::WriteStream &out, const TwoDAFile &twoda) {
+	/* We first collect the string data and the tables referencing it
+	 * separately, because the string data has to come first. */
+
+	TableWriter writer;
+	Common::MemoryWriteStreamDynamic tables(true);
+
+	for (std::vector<Common::UString>::const_iterator h = twoda._headers.begin(); h != twoda._headers.end(); ++h)
+		writer.addString(tables, *h);
+
+	for (Common::FlatHashMap<uint32>::const_iterator h = twoda._headerMap.begin(); h != twoda._headerMap.end(); ++h) {
+		tables.writeUint64LE(h.key());
+		tables.writeUint32LE(h.value());
+		tables.writeUint32LE(0); // Reserved
+	}
+
+	for (std::vector<TwoDAFile::PoolString>::const_iterator s = twoda._strings.begin(); s != twoda._strings.end(); ++s) {
+		writer.addString(tables, s->string);
+
+		tables.writeSint32LE(s->intValue);
+		tables.writeUint32LE(convertIEEEFloat(s->floatValue));
+		tables.writeUint32LE(s->empty ? 1 : 0);
+	}
+
+	for (std::vector<TwoDAFile::Column>::const_iterator c = twoda._columns.begin(); c != twoda._columns.end(); ++c) {
+		uint32 flags = 0;
+		if (!c->ints.empty())
+			flags |= kColumnFlagInts;
+		if (!c->floats.empty())
+			flags |= kColumnFlagFloats;
+
+		tables.writeUint32LE(flags);
+
+		writeArray(tables, c->cells);
+		writeArray(tables, c->empty);
+		writeArray(tables, c->ints);
+		writeArray(tables, c->floats);
+	}
+
+	Common::MemoryWriteStreamDynamic defaultString(true);
+	writer.addString(defaultString, twoda._defaultString);
+
+	writeAlignment(writer.strings, 4);
+
+	out.writeUint32LE(twoda._rowCount);
+	out.writeUint32LE(twoda._headers.size());
+	out.writeUint32LE(twoda._strings.size());
+	out.writeUint32LE(writer.strings.size());
+	out.writeUint32LE(twoda._headerMap.size());
+	out.writeUint32LE(twoda._headerHashCollision ? kFlagHeaderHashCollision : 0);
+
+	out.writeSint32LE(twoda._defaultInt);
+	out.writeUint32LE(convertIEEEFloat(twoda._defaultFloat));
+	out.write(defaultString.getData(), defaultString.size());
+
+	out.write(writer.strings.getData(), writer.strings.size());
+	out.write(tables.getData(), tables.size());
+}
+
+TwoDAFile *TwoDASnapshot::read(const byte *data, size_t size) {
+	SnapshotReader reader(data, size);
+
+	const uint32 rowCount        = reader.readUint32();
+	const uint32 columnCount     = reader.readUint32();
+	const uint32 stringCount     = reader.readUint32();
+	const uint32 stringsSize     = reader.readUint32();
+	const uint32 headerHashCount = reader.readUint32();
+	const uint32 flags           = reader.readUint32();
+
+	TwoDAFile *twoda = new TwoDAFile;
+
+	try {
+		twoda->_rowCount            = rowCount;
+		twoda->_headerHashCollision = (flags & kFlagHeaderHashCollision) != 0;
+
+		twoda->_defaultInt   = (int32) reader.readUint32();
+		twoda->_defaultFloat = convertIEEEFloat(reader.readUint32());
+
+		const uint32 defaultOffset = reader.readUint32();
+		const uint32 defaultSize   = reader.readUint32();
+
+		const byte *strings = reader.readBytes(stringsSize);
+
+		twoda->_defaultString = readString(strings, stringsSize, defaultOffset, defaultSize);
+
+		// Headers
+
+		reader.check(columnCount, 8);
+
+		twoda->_headers.reserve(columnCount);
+		for (uint32 i = 0; i < columnCount; i++) {
+			const uint32 offset = reader.readUint32();
+			const uint32 length = reader.readUint32();
+
+			twoda->_headers.push_back(readString(strings, stringsSize, offset, length));
+		}
+
+		reader.check(headerHashCount, 16);
+
+		twoda->_headerMap.reserve(headerHashCount);
+		for (uint32 i = 0; i < headerHashCount; i++) {
+			const uint64 hash   = reader.readUint64();
+			const uint32 column = reader.readUint32();
+			reader.readUint32(); // Reserved
+
+			if (column >= columnCount)
+				throw Common::Exception("2DA snapshot header column out of range (%u/%u)", column, columnCount);
+
+			twoda->_headerMap[hash] = column;
+		}
+
+		// String pool
+
+		reader.check(stringCount, 20);
+
+		twoda->_strings.reserve(stringCount);
+		for (uint32 i = 0; i < stringCount; i++) {
+			const uint32 offset = reader.readUint32();
+			const uint32 length = reader.readUint32();
+
+			const int32  intValue   = (int32) reader.readUint32();
+			const float  floatValue = convertIEEEFloat(reader.readUint32());
+			const bool   empty      = reader.readUint32() != 0;
+
+			twoda->_strings.push_back(TwoDAFile::PoolString(readString(strings, stringsSize, offset, length),
+			                                                empty, intValue, floatValue));
+		}
+
+		// Columns
+
+		reader.check(columnCount, 4);
+
+		twoda->_columns.resize(columnCount);
+		for (std::vector<TwoDAFile::Column>::iterator c = twoda->_columns.begin(); c != twoda->_columns.end(); ++c) {
+			const uint32 columnFlags = reader.readUint32();
+
+			reader.readArray(c->cells, rowCount);
+			reader.readArray(c->empty, (rowCount + 31) / 32);
+
+			if (columnFlags & kColumnFlagInts)
+				reader.readArray(c->ints, rowCount);
+			if (columnFlags & kColumnFlagFloats)
+				reader.readArray(c->floats, rowCount);
+
+			for (std::vector<uint32>::const_iterator cell = c->cells.begin(); cell != c->cells.end(); ++cell)
+				if (*cell >= stringCount)
+					throw Common::Exception("2DA snapshot cell out of range (%u/%u)", *cell, stringCount);
+		}
+
+		twoda->createRows();
+
+	} catch (...) {
+		delete twoda;
+		throw;
+	}
+
+	return twoda;
+}
+
+void TwoDASnapshot::save(const Common::UString &file) {
+	/* The snapshot file might be the one we currently have mapped, so
+	 * we collect everything in memory first, and only then write it. */
+
+	Common::MemoryWriteStreamDynamic directory(true);
+	Common::MemoryWriteStreamDynamic names(true);
+	Common::MemoryWriteStreamDynamic data(true);
+
+	uint32 count = 0;
+
+	for (LoadedMap::const_iterator l = _loaded.begin(); l != _loaded.end(); ++l) {
+		if (_added.find(l->first) != _added.end())
+			continue;
+
+		writeAlignment(data, 8);
+
+		directory.writeUint32LE(names.size());
+		directory.writeUint32LE(0); // Reserved
+		directory.writeUint64LE(l->second.sourceHash);
+		directory.writeUint32LE(data.size());
+		directory.writeUint32LE(l->second.size);
+
+		Common::writeString(names, l->first, Common::kEncodingUTF8, true);
+		data.write(_mapping->getData() + l->second.offset, l->second.size);
+
+		count++;
+	}
+
+	for (AddedMap::const_iterator a = _added.begin(); a != _added.end(); ++a) {
+		writeAlignment(data, 8);
+
+		directory.writeUint32LE(names.size());
+		directory.writeUint32LE(0); // Reserved
+		directory.writeUint64LE(a->second.sourceHash);
+		directory.writeUint32LE(data.size());
+		directory.writeUint32LE(a->second.data.size());
+
+		Common::writeString(names, a->first, Common::kEncodingUTF8, true);
+		if (!a->second.data.empty())
+			data.write(&a->second.data[0], a->second.data.size());
+
+		count++;
+	}
+
+	writeAlignment(names, 8);
+
+	const uint32 directoryOffset = kHeaderSize;
+	const uint32 namesOffset     = directoryOffset + directory.size();
+	const uint32 dataOffset      = namesOffset + names.size();
+
+	// Fix up the data offsets in the directory
+	for (uint32 i = 0; i < count; i++) {
+		byte *offset = directory.getData() + i * kDirectorySize + 16;
+
+		WRITE_LE_UINT32(offset, READ_LE_UINT32(offset) + dataOffset);
+	}
+
+	clear();
+
+	Common::WriteFile snapshotFile;
+	if (!snapshotFile.open(file))
+		throw Common::Exception(Common::kOpenError);
+
+	snapshotFile.writeUint32BE(k2DASnapshotID);
+	snapshotFile.writeUint32BE(kVersion10);
+
+	snapshotFile.writeUint32LE(count);
+	snapshotFile.writeUint32LE(directoryOffset);
+	snapshotFile.writeUint32LE(names.size());
+	snapshotFile.writeUint32LE(namesOffset);
+	snapshotFile.writeUint32LE(0); // Reserved
+	snapshotFile.writeUint32LE(0); // Reserved
+
+	snapshotFile.write(directory.getData(), directory.size());
+	snapshotFile.write(names.getData()    , names.size());
+	snapshotFile.write(data.getData()     , data.size());
+
+	snapshotFile.flush();
+	snapshotFile.close();
+
+	// Map the new snapshot
+	load(file);
+}
+
+} // End of namespace Aurora
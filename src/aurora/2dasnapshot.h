@@ -0,0 +1,150 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file
+ *  A memory-mappable snapshot of parsed 2DA files.
+ */
+
+#ifndef AURORA_2DASNAPSHOT_H
+#define AURORA_2DASNAPSHOT_H
+
+#include <vector>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+
+namespace Common {
+	class SeekableReadStream;
+	class WriteStream;
+	class FileMapping;
+}
+
+namespace Aurora {
+
+class TwoDAFile;
+
+/** A snapshot of parsed 2DA files.
+ *
+ *  Parsing a 2DA, especially an ASCII one, takes a considerable amount of
+ *  time: every cell needs to be tokenized, and every cell string parsed
+ *  into a number. This snapshot stores the already parsed, columnar data
+ *  of 2DA files, keyed on the 2DA's name and validated against a hash of
+ *  the 2DA's source data. This way, TwoDARegistry can create an unchanged
+ *  2DA by simply copying the arrays of its columns out of the snapshot.
+ *
+ *  The snapshot file is mapped into memory, and only the 2DAs that are
+ *  actually requested are ever read out of it. It's a flat, versioned
+ *  structure, with all values in little endian byte order:
+ *
+ *  - Header: ID, version, 2DA count, directory offset, name pool size and
+ *            offset.
+ *  - Directory: name (name pool offset), source data hash, data offset,
+ *               data size.
+ *  - Name pool: NUL-terminated UTF-8 strings.
+ *  - 2DA data, each aligned to 8 bytes:
+ *    - Sizes: row count, column count, string count, string data size,
+ *             header hash count, flags.
+ *    - Defaults: int, float, string (offset and size in the string data).
+ *    - String data: UTF-8 strings, padded to 4 bytes.
+ *    - Headers: offset and size in the string data.
+ *    - Header hashes: case-insensitive hash, column.
+ *    - String pool: offset and size in the string data, parsed int,
+ *                   parsed float, is empty.
+ *    - Columns: flags, cells (string pool indices), bitmap of empty cells,
+ *               and if the flags say so, the parsed ints and floats.
+ */
+class TwoDASnapshot {
+public:
+	TwoDASnapshot();
+	~TwoDASnapshot();
+
+	/** Clear the snapshot. */
+	void clear();
+
+	/** Map a snapshot file into memory.
+	 *
+	 *  If the file does not exist or is not a valid snapshot, the
+	 *  snapshot will be empty instead.
+	 */
+	bool load(const Common::UString &file);
+
+	/** Save the snapshot to a file. */
+	void save(const Common::UString &file);
+
+	/** Has the snapshot been changed since it was loaded or saved? */
+	bool isDirty() const;
+
+	/** Return the number of 2DAs in the snapshot. */
+	size_t getCount() const;
+
+	/** Create a 2DA out of the snapshot.
+	 *
+	 *  Only succeeds if the 2DA is in the snapshot and was created from
+	 *  source data with the same hash. Otherwise, 0 is returned.
+	 */
+	TwoDAFile *find(const Common::UString &name, uint64 sourceHash) const;
+
+	/** Add a 2DA to the snapshot, replacing any existing entry. */
+	void add(const Common::UString &name, uint64 sourceHash, const TwoDAFile &twoda);
+
+	/** Hash the source data of a 2DA, for the validation of snapshot entries. */
+	static uint64 hashSource(Common::SeekableReadStream &stream);
+
+	/** Can snapshot files be used on this platform? */
+	static bool isSupported();
+
+private:
+	/** A 2DA found in the mapped snapshot file. */
+	struct Entry {
+		uint64 sourceHash; ///< The hash of the 2DA's source data.
+		uint32 offset;     ///< The offset of the 2DA's data within the snapshot file.
+		uint32 size;       ///< The size of the 2DA's data.
+	};
+
+	/** A 2DA added since the snapshot was loaded. */
+	struct Added {
+		uint64 sourceHash;      ///< The hash of the 2DA's source data.
+		std::vector<byte> data; ///< The 2DA's data.
+	};
+
+	typedef std::map<Common::UString, Entry> LoadedMap;
+	typedef std::map<Common::UString, Added> AddedMap;
+
+	/** The mapped snapshot file. */
+	boost::shared_ptr<Common::FileMapping> _mapping;
+
+	/** 2DAs found in the mapped snapshot file. */
+	LoadedMap _loaded;
+	/** 2DAs added since the snapshot was loaded. */
+	AddedMap _added;
+
+	bool _dirty;
+
+	void readDirectory();
+
+	static void write(Common::WriteStream &out, const TwoDAFile &twoda);
+	static TwoDAFile *read(const byte *data, size_t size);
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_2DASNAPSHOT_H
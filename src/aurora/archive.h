@@ -71,6 +71,13 @@ public:
 	 */
 	virtual Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const = 0;
 
+	/** Does reading this resource require decompressing or decrypting it?
+	 *
+	 *  If true, getResource() has to do real work to produce the resource's
+	 *  contents, and it's worthwhile to hold on to the result.
+	 */
+	virtual bool isResourceCompressed(uint32 index) const;
+
 	/** Return with which algorithm the name is hashed. */
 	virtual Common::HashAlgo getNameHashAlgo() const;
 
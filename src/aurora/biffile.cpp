@@ -32,6 +32,7 @@
 #include "src/common/strutil.h"
 #include "src/common/error.h"
 #include "src/common/memreadstream.h"
+#include "src/common/mappedfile.h"
 
 #include "src/aurora/biffile.h"
 #include "src/aurora/keyfile.h"
@@ -144,9 +145,18 @@ uint32 BIFFile::getResourceSize(uint32 index) const {
 	return getIResource(index).size;
 }
 
+uint32 BIFFile::getInternalResourceCount() const {
+	return _iResources.size();
+}
+
 Common::SeekableReadStream *BIFFile::getResource(uint32 index, bool tryNoCopy) const {
 	const IResource &res = getIResource(index);
 
+	// If the archive is mapped into memory, point straight into the mapping
+	const Common::MappedReadStream *mapped = dynamic_cast<const Common::MappedReadStream *>(_bif);
+	if (mapped)
+		return mapped->createSubStream(res.offset, res.size);
+
 	if (tryNoCopy)
 		return new Common::SeekableSubReadStream(_bif, res.offset, res.offset + res.size);
 
@@ -54,6 +54,9 @@ public:
 	/** Return the size of a resource. */
 	uint32 getResourceSize(uint32 index) const;
 
+	/** Return the number of resources in the BIF, whether or not they have a name from a KEY. */
+	uint32 getInternalResourceCount() const;
+
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
@@ -148,6 +148,11 @@ uint32 BZFFile::getResourceSize(uint32 index) const {
 	return getIResource(index).size;
 }
 
+bool BZFFile::isResourceCompressed(uint32 UNUSED(index)) const {
+	// All resources in a BZF are LZMA-compressed
+	return true;
+}
+
 Common::SeekableReadStream *BZFFile::getResource(uint32 index, bool UNUSED(tryNoCopy)) const {
 	const IResource &res = getIResource(index);
 
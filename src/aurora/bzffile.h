@@ -60,6 +60,9 @@ public:
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
+	/** Does reading this resource require decompressing or decrypting it? */
+	bool isResourceCompressed(uint32 index) const;
+
 	/** Merge information from the KEY into the BZF. */
 	void mergeKEY(const KEYFile &key, uint32 bifIndex);
 
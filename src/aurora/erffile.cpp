@@ -29,6 +29,7 @@
 #include <cassert>
 
 #include "src/common/memreadstream.h"
+#include "src/common/mappedfile.h"
 #include "src/common/readfile.h"
 #include "src/common/util.h"
 #include "src/common/strutil.h"
@@ -684,16 +685,28 @@ uint32 ERFFile::getResourceSize(uint32 index) const {
 	return getIResource(index).unpackedSize;
 }
 
+bool ERFFile::isResourceCompressed(uint32 UNUSED(index)) const {
+	return (_header.encryption != kEncryptionNone) || (_header.compression != kCompressionNone);
+}
+
 Common::SeekableReadStream *ERFFile::getResource(uint32 index, bool tryNoCopy) const {
 	const IResource &res = getIResource(index);
 
-	if (tryNoCopy && (_header.encryption == kEncryptionNone) && (_header.compression == kCompressionNone))
-		return new Common::SeekableSubReadStream(_erf, res.offset, res.offset + res.packedSize);
+	// If the ERF is mapped into memory, point straight into the mapping
+	const Common::MappedReadStream *mapped = dynamic_cast<const Common::MappedReadStream *>(_erf);
 
-	_erf->seek(res.offset);
+	if (!mapped && tryNoCopy && (_header.encryption == kEncryptionNone) && (_header.compression == kCompressionNone))
+		return new Common::SeekableSubReadStream(_erf, res.offset, res.offset + res.packedSize);
 
 	// Read
-	Common::MemoryReadStream *stream = _erf->readStream(res.packedSize);
+	Common::MemoryReadStream *stream = 0;
+	if (mapped) {
+		stream = mapped->createSubStream(res.offset, res.packedSize);
+	} else {
+		_erf->seek(res.offset);
+
+		stream = _erf->readStream(res.packedSize);
+	}
 
 	// Decrypt
 	if (_header.encryption != kEncryptionNone)
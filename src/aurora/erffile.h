@@ -69,6 +69,9 @@ public:
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
+	/** Does reading this resource require decompressing or decrypting it? */
+	bool isResourceCompressed(uint32 index) const;
+
 	/** Return the year the ERF was built. */
 	uint32 getBuildYear() const;
 	/** Return the day of year the ERF was built. */
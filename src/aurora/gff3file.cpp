@@ -27,12 +27,17 @@
  */
 
 #include <cassert>
+#include <cstring>
 
+#include <algorithm>
+
+#include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/memreadstream.h"
 #include "src/common/encoding.h"
 #include "src/common/ustring.h"
 #include "src/common/strutil.h"
+#include "src/common/hash.h"
 
 #include "src/aurora/gff3file.h"
 #include "src/aurora/util.h"
@@ -64,13 +69,15 @@ void GFF3File::Header::read(Common::SeekableReadStream &gff3) {
 
 
 GFF3File::GFF3File(Common::SeekableReadStream *gff3, uint32 id, bool repairNWNPremium) :
-	_stream(gff3), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
+	_stream(gff3), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0),
+	_labelHashCollision(false) {
 
 	load(id);
 }
 
 GFF3File::GFF3File(const Common::UString &gff3, FileType type, uint32 id, bool repairNWNPremium) :
-	_stream(0), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0) {
+	_stream(0), _repairNWNPremium(repairNWNPremium), _offsetCorrection(0),
+	_labelHashCollision(false) {
 
 	_stream = ResMan.getResource(gff3, type);
 	if (!_stream)
@@ -107,6 +114,8 @@ void GFF3File::load(uint32 id) {
 	try {
 
 		loadHeader(id);
+		loadLabels();
+		loadFieldData();
 		loadStructs();
 		loadLists();
 
@@ -116,6 +125,10 @@ void GFF3File::load(uint32 id) {
 		e.add("Failed reading GFF3 file");
 		throw;
 	}
+
+	// Everything we need is in memory now
+	delete _stream;
+	_stream = 0;
 }
 
 void GFF3File::loadHeader(uint32 id) {
@@ -191,12 +204,83 @@ void GFF3File::loadHeader(uint32 id) {
 		throw Common::Exception("GFF3 header broken: section offset points outside stream");
 }
 
+void GFF3File::readTable(std::vector<uint32> &table, uint32 offset, uint64 count) {
+	if ((offset > _stream->size()) || (count > ((_stream->size() - offset) / 4)))
+		throw Common::Exception("GFF3: Table of %s entries at %u exceeds the stream",
+		                        Common::composeString(count).c_str(), offset);
+
+	_stream->seek(offset);
+
+	table.resize(count);
+	for (std::vector<uint32>::iterator t = table.begin(); t != table.end(); ++t)
+		*t = _stream->readUint32LE();
+}
+
+void GFF3File::loadLabels() {
+	/* Read all labels and intern them.
+	 *
+	 * Every distinct label gets a small integer ID, and the fields in the
+	 * structs then only store that ID. Looking up a field by name means
+	 * finding the ID of the name once, instead of comparing strings.
+	 */
+
+	static const uint32 kLabelSize = 16;
+
+	if (_header.labelCount > ((_stream->size() - _header.labelOffset) / kLabelSize))
+		throw Common::Exception("GFF3: Labels exceed the stream");
+
+	_stream->seek(_header.labelOffset);
+
+	_labelIDs.resize(_header.labelCount, kInvalidLabel);
+	_labelMap.reserve(_header.labelCount);
+
+	for (uint32 i = 0; i < _header.labelCount; i++) {
+		Common::UString label = Common::readStringFixed(*_stream, Common::kEncodingASCII, kLabelSize);
+
+		const uint64 hash = Common::hashStringFNV64(label);
+
+		uint32 *id = _labelMap.find(hash);
+		if (id) {
+			if (_labels[*id] == label) {
+				// Duplicate label, share the ID
+				_labelIDs[i] = *id;
+				continue;
+			}
+
+			// Two different labels with the same hash. Unlikely, but possible
+			_labelHashCollision = true;
+		}
+
+		_labelIDs[i] = _labels.size();
+		if (!id)
+			_labelMap[hash] = _labels.size();
+
+		_labels.push_back(label);
+	}
+}
+
+void GFF3File::loadFieldData() {
+	const size_t available = _stream->size() - _header.fieldDataOffset;
+
+	_fieldData.resize(MIN<size_t>(_header.fieldDataCount, available));
+	if (_fieldData.empty())
+		return;
+
+	_stream->seek(_header.fieldDataOffset);
+	if (_stream->read(&_fieldData[0], _fieldData.size()) != _fieldData.size())
+		throw Common::Exception(Common::kReadError);
+}
+
 void GFF3File::loadStructs() {
-	static const uint32 kStructSize = 12;
+	RawTables tables;
+
+	readTable(tables.structs     , _header.structOffset      , ((uint64) _header.structCount) * 3);
+	readTable(tables.fields      , _header.fieldOffset       , ((uint64) _header.fieldCount ) * 3);
+	readTable(tables.fieldIndices, _header.fieldIndicesOffset, _header.fieldIndicesCount / 4);
 
 	_structs.reserve(_header.structCount);
 	for (uint32 i = 0; i < _header.structCount; i++)
-		_structs.push_back(new GFF3Struct(*this, _header.structOffset + i * kStructSize));
+		_structs.push_back(new GFF3Struct(*this, tables, i));
 }
 
 void GFF3File::loadLists() {
@@ -283,37 +367,71 @@ const GFF3List &GFF3File::getList(uint32 i) const {
 	return _lists[listIndex];
 }
 
-Common::SeekableReadStream &GFF3File::getStream(uint32 offset) const {
-	_stream->seek(offset);
+uint32 GFF3File::findLabel(const Common::UString &label) const {
+	if (_labelHashCollision) {
+		// Fall back to comparing all labels
+		for (size_t i = 0; i < _labels.size(); i++)
+			if (_labels[i] == label)
+				return i;
+
+		return kInvalidLabel;
+	}
+
+	const uint32 *id = _labelMap.find(Common::hashStringFNV64(label));
+	if (!id || (_labels[*id] != label))
+		return kInvalidLabel;
+
+	return *id;
+}
+
+uint32 GFF3File::getLabelID(uint32 index) const {
+	if (index >= _labelIDs.size())
+		throw Common::Exception("GFF3: Label index out of range (%u >= %u)", index, (uint) _labelIDs.size());
+
+	return _labelIDs[index];
+}
+
+const Common::UString &GFF3File::getLabel(uint32 id) const {
+	assert(id < _labels.size());
 
-	return *_stream;
+	return _labels[id];
 }
 
-Common::SeekableReadStream &GFF3File::getFieldData() const {
-	return getStream(_header.fieldDataOffset);
+uint32 GFF3File::getFieldDataSize() const {
+	return _fieldData.size();
 }
 
+const byte *GFF3File::getFieldData(uint32 offset) const {
+	assert(offset <= _fieldData.size());
 
-GFF3Struct::Field::Field() : type(kFieldTypeNone), data(0), extended(false) {
+	if (_fieldData.empty())
+		return 0;
+
+	return &_fieldData[0] + offset;
 }
 
-GFF3Struct::Field::Field(FieldType t, uint32 d) : type(t), data(d) {
-	// These field types need extended field data
-	extended = (type == kFieldTypeUint64     ) ||
-	           (type == kFieldTypeSint64     ) ||
-	           (type == kFieldTypeDouble     ) ||
-	           (type == kFieldTypeExoString  ) ||
-	           (type == kFieldTypeResRef     ) ||
-	           (type == kFieldTypeLocString  ) ||
-	           (type == kFieldTypeVoid       ) ||
-	           (type == kFieldTypeOrientation) ||
-	           (type == kFieldTypeVector     ) ||
-	           (type == kFieldTypeStrRef     );
+
+GFF3Struct::Field::Field() : label(GFF3File::kInvalidLabel), type(kFieldTypeNone),
+	data(0), size(0), valid(true) {
+
+	value.integer = 0;
 }
 
+GFF3Struct::Field::Field(uint32 l, FieldType t, uint32 d) : label(l), type(t),
+	data(d), size(0), valid(true) {
+
+	value.integer = 0;
+}
 
-GFF3Struct::GFF3Struct(const GFF3File &parent, uint32 offset) : _parent(&parent) {
-	load(offset);
+bool GFF3Struct::Field::operator<(const Field &right) const {
+	return label < right.label;
+}
+
+
+GFF3Struct::GFF3Struct(const GFF3File &parent, const GFF3File::RawTables &tables, uint32 index) :
+	_parent(&parent) {
+
+	load(tables, index);
 }
 
 GFF3Struct::~GFF3Struct() {
@@ -325,81 +443,187 @@ uint32 GFF3Struct::getID() const {
 
 // --- Loader ---
 
-void GFF3Struct::load(uint32 offset) {
-	Common::SeekableReadStream &data = _parent->getStream(offset);
+void GFF3Struct::load(const GFF3File::RawTables &tables, uint32 index) {
+	assert((index * 3 + 2) < tables.structs.size());
+
+	_id = tables.structs[index * 3 + 0];
 
-	_id         = data.readUint32LE();
-	_fieldIndex = data.readUint32LE();
-	_fieldCount = data.readUint32LE();
+	const uint32 fieldIndex = tables.structs[index * 3 + 1];
+	const uint32 fieldCount = tables.structs[index * 3 + 2];
 
 	// Read the field(s)
-	if      (_fieldCount == 1)
-		readField (data, _fieldIndex);
-	else if (_fieldCount > 1)
-		readFields(data, _fieldIndex, _fieldCount);
-}
+	if (fieldCount == 1) {
+		// A single field is referenced directly
+		_fields.reserve(1);
+		_fieldNames.reserve(1);
 
-void GFF3Struct::readField(Common::SeekableReadStream &data, uint32 index) {
-	// Sanity check
-	if (index > _parent->_header.fieldCount)
-		throw Common::Exception("GFF3: Field index out of range (%d/%d)",
-				index, _parent->_header.fieldCount);
+		readField(tables, fieldIndex);
+
+	} else if (fieldCount > 1) {
+		// Multiple fields are referenced through a byte offset into the field indices
+		const uint32 indicesIndex = fieldIndex / 4;
+
+		if ((indicesIndex > tables.fieldIndices.size()) ||
+		    (fieldCount > (tables.fieldIndices.size() - indicesIndex)))
+			throw Common::Exception("GFF3: Field indices index out of range (%u+%u/%u)",
+			                        indicesIndex, fieldCount, (uint) tables.fieldIndices.size());
+
+		// Only reserve space now that the field count has been checked against the file
+		_fields.reserve(fieldCount);
+		_fieldNames.reserve(fieldCount);
 
-	// Seek
-	data.seek(_parent->_header.fieldOffset + index * 12);
+		for (uint32 i = 0; i < fieldCount; i++)
+			readField(tables, tables.fieldIndices[indicesIndex + i]);
+	}
 
-	// Read the field data
-	const uint32 fieldType  = data.readUint32LE();
-	const uint32 fieldLabel = data.readUint32LE();
-	const uint32 fieldData  = data.readUint32LE();
+	/* Sort the fields by label ID, for a binary search. If a label occurs
+	 * more than once, only the last field with that label is reachable. */
+	std::stable_sort(_fields.begin(), _fields.end());
 
-	// Read the name
-	Common::UString fieldName = readLabel(data, fieldLabel);
+	FieldArray::iterator field = _fields.begin();
+	for (FieldArray::iterator f = _fields.begin(); f != _fields.end(); ++f) {
+		if ((field != _fields.begin()) && ((field - 1)->label == f->label))
+			--field;
 
-	// And add the field to the map and name list
-	_fields[fieldName] = Field((FieldType) fieldType, fieldData);
+		*field++ = *f;
+	}
 
-	_fieldNames.push_back(fieldName);
+	_fields.erase(field, _fields.end());
 }
 
-void GFF3Struct::readFields(Common::SeekableReadStream &data, uint32 index, uint32 count) {
+void GFF3Struct::readField(const GFF3File::RawTables &tables, uint32 index) {
 	// Sanity check
-	if (index > _parent->_header.fieldIndicesCount)
-		throw Common::Exception("GFF3: Field indices index out of range (%d/%d)",
-		                        index , _parent->_header.fieldIndicesCount);
+	if (index >= (tables.fields.size() / 3))
+		throw Common::Exception("GFF3: Field index out of range (%u/%u)",
+		                        index, (uint) (tables.fields.size() / 3));
 
-	// Seek
-	data.seek(_parent->_header.fieldIndicesOffset + index);
+	const uint32 fieldType  = tables.fields[index * 3 + 0];
+	const uint32 fieldLabel = tables.fields[index * 3 + 1];
+	const uint32 fieldData  = tables.fields[index * 3 + 2];
 
-	// Read the field indices
-	std::vector<uint32> indices;
-	readIndices(data, indices, count);
+	const uint32 label = _parent->getLabelID(fieldLabel);
 
-	// Read the fields
-	for (std::vector<uint32>::const_iterator i = indices.begin(); i != indices.end(); ++i)
-		readField(data, *i);
-}
+	_fields.push_back(Field(label, (FieldType) fieldType, fieldData));
+	readFieldData(_fields.back());
 
-void GFF3Struct::readIndices(Common::SeekableReadStream &data,
-                             std::vector<uint32> &indices, uint32 count) const {
-	indices.reserve(count);
-	while (count-- > 0)
-		indices.push_back(data.readUint32LE());
+	_fieldNames.push_back(_parent->getLabel(label));
 }
 
-Common::UString GFF3Struct::readLabel(Common::SeekableReadStream &data, uint32 index) const {
-	data.seek(_parent->_header.labelOffset + index * 16);
+void GFF3Struct::readFieldData(Field &field) const {
+	/* Decode the values that are stored in the field data section, and
+	 * find the range of the data of variable-length fields. A field whose
+	 * data lies outside the field data section is marked as invalid. It
+	 * only throws an exception when its value is actually requested. */
+
+	uint32 headerSize = 0, dataSize = 0;
+
+	switch (field.type) {
+		case kFieldTypeUint64:
+		case kFieldTypeSint64:
+		case kFieldTypeDouble:
+			dataSize = 8;
+			break;
+
+		case kFieldTypeStrRef:
+			headerSize = 4;
+			dataSize   = 4;
+			break;
+
+		case kFieldTypeVector:
+			dataSize = 12;
+			break;
+
+		case kFieldTypeOrientation:
+			dataSize = 16;
+			break;
+
+		case kFieldTypeExoString:
+		case kFieldTypeLocString:
+		case kFieldTypeVoid:
+			headerSize = 4;
+			break;
+
+		case kFieldTypeResRef:
+			headerSize = 1;
+			break;
+
+		case kFieldTypeFloat:
+			field.value.real = convertIEEEFloat(field.data);
+			return;
+
+		default:
+			// Everything else is stored directly in the field
+			return;
+	}
+
+	const uint32 fieldDataSize = _parent->getFieldDataSize();
+
+	if ((field.data > fieldDataSize) || (headerSize > (fieldDataSize - field.data))) {
+		field.valid = false;
+		return;
+	}
+
+	const byte *data = _parent->getFieldData(field.data);
+
+	// Variable-length data, prefixed by its size
+	if      (headerSize == 4)
+		field.size = READ_LE_UINT32(data);
+	else if (headerSize == 1)
+		field.size = *data;
+
+	// StrRefs have a size field, but only 4 bytes of data
+	if (field.type == kFieldTypeStrRef)
+		field.size = 4;
+
+	if (dataSize != 0)
+		field.size = dataSize;
+
+	if (field.size > (fieldDataSize - field.data - headerSize)) {
+		field.valid = false;
+		return;
+	}
+
+	field.data += headerSize;
+	data       += headerSize;
 
-	return Common::readStringFixed(data, Common::kEncodingASCII, 16);
+	switch (field.type) {
+		case kFieldTypeUint64:
+		case kFieldTypeSint64:
+			field.value.integer = READ_LE_UINT64(data);
+			break;
+
+		case kFieldTypeStrRef:
+			field.value.integer = READ_LE_UINT32(data);
+			break;
+
+		case kFieldTypeDouble:
+			field.value.real = convertIEEEDouble(READ_LE_UINT64(data));
+			break;
+
+		case kFieldTypeOrientation:
+			field.value.floats[3] = convertIEEEFloat(READ_LE_UINT32(data + 12));
+			// fall through
+
+		case kFieldTypeVector:
+			field.value.floats[0] = convertIEEEFloat(READ_LE_UINT32(data + 0));
+			field.value.floats[1] = convertIEEEFloat(READ_LE_UINT32(data + 4));
+			field.value.floats[2] = convertIEEEFloat(READ_LE_UINT32(data + 8));
+			break;
+
+		default:
+			break;
+	}
 }
 
-Common::SeekableReadStream &GFF3Struct::getData(const Field &field) const {
-	assert(field.extended);
+void GFF3Struct::checkData(const Field &field) const {
+	if (!field.valid)
+		throw Common::Exception("GFF3: Field data out of range");
+}
 
-	Common::SeekableReadStream &data = _parent->getFieldData();
-	data.skip(field.data);
+const byte *GFF3Struct::getData(const Field &field) const {
+	checkData(field);
 
-	return data;
+	return _parent->getFieldData(field.data);
 }
 
 // --- Field properties ---
@@ -427,13 +651,110 @@ GFF3Struct::FieldType GFF3Struct::getFieldType(const Common::UString &field) con
 // --- Field value reader helpers ---
 
 const GFF3Struct::Field *GFF3Struct::getField(const Common::UString &name) const {
-	FieldMap::const_iterator field = _fields.find(name);
-	if (field == _fields.end())
+	if (_fields.empty())
+		return 0;
+
+	Field key;
+	key.label = _parent->findLabel(name);
+	if (key.label == GFF3File::kInvalidLabel)
+		return 0;
+
+	FieldArray::const_iterator field = std::lower_bound(_fields.begin(), _fields.end(), key);
+	if ((field == _fields.end()) || (field->label != key.label))
 		return 0;
 
-	return &field->second;
+	return &*field;
 }
 
+uint64 GFF3Struct::getUint(const Field &field) const {
+	// Int types
+	if (field.type == kFieldTypeByte)
+		return (uint64) ((uint8 ) field.data);
+	if (field.type == kFieldTypeUint16)
+		return (uint64) ((uint16) field.data);
+	if (field.type == kFieldTypeUint32)
+		return (uint64) ((uint32) field.data);
+	if (field.type == kFieldTypeChar)
+		return (uint64) ((int64) ((int8 ) ((uint8 ) field.data)));
+	if (field.type == kFieldTypeSint16)
+		return (uint64) ((int64) ((int16) ((uint16) field.data)));
+	if (field.type == kFieldTypeSint32)
+		return (uint64) ((int64) ((int32) ((uint32) field.data)));
+
+	// Int types and StrRef, a numerical reference to a string in a talk table
+	if ((field.type == kFieldTypeUint64) ||
+	    (field.type == kFieldTypeSint64) ||
+	    (field.type == kFieldTypeStrRef)) {
+
+		checkData(field);
+		return field.value.integer;
+	}
+
+	throw Common::Exception("GFF3: Field is not an int type");
+}
+
+int64 GFF3Struct::getSint(const Field &field) const {
+	// Int types
+	if (field.type == kFieldTypeByte)
+		return (int64) ((int8 ) ((uint8 ) field.data));
+	if (field.type == kFieldTypeUint16)
+		return (int64) ((int16) ((uint16) field.data));
+	if (field.type == kFieldTypeUint32)
+		return (int64) ((int32) ((uint32) field.data));
+	if (field.type == kFieldTypeChar)
+		return (int64) ((int8 ) ((uint8 ) field.data));
+	if (field.type == kFieldTypeSint16)
+		return (int64) ((int16) ((uint16) field.data));
+	if (field.type == kFieldTypeSint32)
+		return (int64) ((int32) ((uint32) field.data));
+
+	// Int types and StrRef, a numerical reference to a string in a talk table
+	if ((field.type == kFieldTypeUint64) ||
+	    (field.type == kFieldTypeSint64) ||
+	    (field.type == kFieldTypeStrRef)) {
+
+		checkData(field);
+		return (int64) field.value.integer;
+	}
+
+	throw Common::Exception("GFF3: Field is not an int type");
+}
+
+double GFF3Struct::getDouble(const Field &field) const {
+	if (field.type == kFieldTypeFloat)
+		return field.value.real;
+
+	if (field.type == kFieldTypeDouble) {
+		checkData(field);
+		return field.value.real;
+	}
+
+	throw Common::Exception("GFF3: Field is not a double type");
+}
+
+bool GFF3Struct::getLocString(const Field &field, LocString &str) const {
+	if (field.type != kFieldTypeLocString)
+		return false;
+
+	LocString locString;
+
+	try {
+
+		// A private stream over the field data, so that concurrent reads don't interfere
+		Common::MemoryReadStream locStringData(getData(field), field.size);
+
+		locString.readLocString(locStringData);
+
+	} catch (...) {
+		return false;
+	}
+
+	str.swap(locString);
+	return true;
+}
+
+// --- Field value readers ---
+
 char GFF3Struct::getChar(const Common::UString &field, char def) const {
 	const Field *f = getField(field);
 	if (!f)
@@ -449,36 +770,7 @@ uint64 GFF3Struct::getUint(const Common::UString &field, uint64 def) const {
 	if (!f)
 		return def;
 
-	// Int types
-	if (f->type == kFieldTypeByte)
-		return (uint64) ((uint8 ) f->data);
-	if (f->type == kFieldTypeUint16)
-		return (uint64) ((uint16) f->data);
-	if (f->type == kFieldTypeUint32)
-		return (uint64) ((uint32) f->data);
-	if (f->type == kFieldTypeChar)
-		return (uint64) ((int64) ((int8 ) ((uint8 ) f->data)));
-	if (f->type == kFieldTypeSint16)
-		return (uint64) ((int64) ((int16) ((uint16) f->data)));
-	if (f->type == kFieldTypeSint32)
-		return (uint64) ((int64) ((int32) ((uint32) f->data)));
-	if (f->type == kFieldTypeUint64)
-		return (uint64) getData(*f).readUint64LE();
-	if (f->type == kFieldTypeSint64)
-		return ( int64) getData(*f).readUint64LE();
-
-	// StrRef, a numerical reference to a string in a talk table
-	if (f->type == kFieldTypeStrRef) {
-		Common::SeekableReadStream &data = getData(*f);
-
-		const uint32 size = data.readUint32LE();
-		if (size != 4)
-			Common::Exception("StrRef field with invalid size (%d)", size);
-
-		return (uint64) data.readUint32LE();
-	}
-
-	throw Common::Exception("GFF3: Field is not an int type");
+	return getUint(*f);
 }
 
 int64 GFF3Struct::getSint(const Common::UString &field, int64 def) const {
@@ -486,36 +778,7 @@ int64 GFF3Struct::getSint(const Common::UString &field, int64 def) const {
 	if (!f)
 		return def;
 
-	// Int types
-	if (f->type == kFieldTypeByte)
-		return (int64) ((int8 ) ((uint8 ) f->data));
-	if (f->type == kFieldTypeUint16)
-		return (int64) ((int16) ((uint16) f->data));
-	if (f->type == kFieldTypeUint32)
-		return (int64) ((int32) ((uint32) f->data));
-	if (f->type == kFieldTypeChar)
-		return (int64) ((int8 ) ((uint8 ) f->data));
-	if (f->type == kFieldTypeSint16)
-		return (int64) ((int16) ((uint16) f->data));
-	if (f->type == kFieldTypeSint32)
-		return (int64) ((int32) ((uint32) f->data));
-	if (f->type == kFieldTypeUint64)
-		return (int64) getData(*f).readUint64LE();
-	if (f->type == kFieldTypeSint64)
-		return (int64) getData(*f).readUint64LE();
-
-	// StrRef, a numerical reference to a string in a talk table
-	if (f->type == kFieldTypeStrRef) {
-		Common::SeekableReadStream &data = getData(*f);
-
-		const uint32 size = data.readUint32LE();
-		if (size != 4)
-			Common::Exception("GFF3: StrRef field with invalid size (%d)", size);
-
-		return (int64) ((uint64) data.readUint32LE());
-	}
-
-	throw Common::Exception("GFF3: Field is not an int type");
+	return getSint(*f);
 }
 
 bool GFF3Struct::getBool(const Common::UString &field, bool def) const {
@@ -527,12 +790,7 @@ double GFF3Struct::getDouble(const Common::UString &field, double def) const {
 	if (!f)
 		return def;
 
-	if (f->type == kFieldTypeFloat)
-		return convertIEEEFloat(f->data);
-	if (f->type == kFieldTypeDouble)
-		return getData(*f).readIEEEDoubleLE();
-
-	throw Common::Exception("GFF3: Field is not a double type");
+	return getDouble(*f);
 }
 
 Common::UString GFF3Struct::getString(const Common::UString &field,
@@ -542,32 +800,25 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 	if (!f)
 		return def;
 
-	// Direct string
-	if (f->type == kFieldTypeExoString) {
-		Common::SeekableReadStream &data = getData(*f);
-
-		const uint32 length = data.readUint32LE();
-		return Common::readStringFixed(data, Common::kEncodingASCII, length);
-	}
-
-	// ResRef, resource reference, a shorter string
-	if (f->type == kFieldTypeResRef) {
-		/* In most games, this field has a limit of 16 characters, because
-		 * resource filenames were limited to 16 characters (without extension)
-		 * inside the archives. In Dragon Age: Origins and Dragon Age II,
-		 * however, this limit has been lifted, and a full 255 characters
-		 * are available in ResRef string fields. */
-
-		Common::SeekableReadStream &data = getData(*f);
-
-		const uint32 length = data.readByte();
-		return Common::readStringFixed(data, Common::kEncodingASCII, length);
+	/* Direct string, or a ResRef, a resource reference.
+	 *
+	 * In most games, a ResRef field has a limit of 16 characters, because
+	 * resource filenames were limited to 16 characters (without extension)
+	 * inside the archives. In Dragon Age: Origins and Dragon Age II,
+	 * however, this limit has been lifted, and a full 255 characters
+	 * are available in ResRef string fields. */
+	if ((f->type == kFieldTypeExoString) || (f->type == kFieldTypeResRef)) {
+		const byte *data = getData(*f);
+		if (f->size == 0)
+			return "";
+
+		return Common::readString(data, f->size, Common::kEncodingASCII);
 	}
 
 	// LocString, a localized string
 	if (f->type == kFieldTypeLocString) {
 		LocString locString;
-		getLocString(field, locString);
+		getLocString(*f, locString);
 
 		return locString.getString();
 	}
@@ -579,7 +830,7 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 	    (f->type == kFieldTypeUint64) ||
 	    (f->type == kFieldTypeStrRef)) {
 
-		return Common::composeString(getUint(field));
+		return Common::composeString(getUint(*f));
 	}
 
 	// Signed integer type, compose a string representation
@@ -588,35 +839,33 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 	    (f->type == kFieldTypeSint32) ||
 	    (f->type == kFieldTypeSint64)) {
 
-		return Common::composeString(getSint(field));
+		return Common::composeString(getSint(*f));
 	}
 
 	// Floating point type, compose a string representation
 	if ((f->type == kFieldTypeFloat) ||
 	    (f->type == kFieldTypeDouble)) {
 
-		return Common::composeString(getDouble(field));
+		return Common::composeString(getDouble(*f));
 	}
 
 	// Vector, consisting of 3 floats
 	if (f->type == kFieldTypeVector) {
-		float x = 0.0, y = 0.0, z = 0.0;
+		checkData(*f);
 
-		getVector(field, x, y, z);
-		return Common::composeString(x) + "/" +
-		       Common::composeString(y) + "/" +
-		       Common::composeString(z);
+		return Common::composeString(f->value.floats[0]) + "/" +
+		       Common::composeString(f->value.floats[1]) + "/" +
+		       Common::composeString(f->value.floats[2]);
 	}
 
 	// Orientation, consisting of 4 floats
 	if (f->type == kFieldTypeOrientation) {
-		float a = 0.0, b = 0.0, c = 0.0, d = 0.0;
+		checkData(*f);
 
-		getOrientation(field, a, b, c, d);
-		return Common::composeString(a) + "/" +
-		       Common::composeString(b) + "/" +
-		       Common::composeString(c) + "/" +
-		       Common::composeString(d);
+		return Common::composeString(f->value.floats[0]) + "/" +
+		       Common::composeString(f->value.floats[1]) + "/" +
+		       Common::composeString(f->value.floats[2]) + "/" +
+		       Common::composeString(f->value.floats[3]);
 	}
 
 	throw Common::Exception("GFF3: Field is not a string(able) type");
@@ -624,26 +873,10 @@ Common::UString GFF3Struct::getString(const Common::UString &field,
 
 bool GFF3Struct::getLocString(const Common::UString &field, LocString &str) const {
 	const Field *f = getField(field);
-	if (!f || (f->type != kFieldTypeLocString))
-		return false;
-
-	LocString locString;
-
-	try {
-
-		Common::SeekableReadStream &data = getData(*f);
-
-		const uint32 size = data.readUint32LE();
-		Common::SeekableSubReadStream locStringData(&data, data.pos(), data.pos() + size);
-
-		locString.readLocString(locStringData);
-
-	} catch (...) {
+	if (!f)
 		return false;
-	}
 
-	str.swap(locString);
-	return true;
+	return getLocString(*f, str);
 }
 
 Common::SeekableReadStream *GFF3Struct::getData(const Common::UString &field) const {
@@ -651,17 +884,16 @@ Common::SeekableReadStream *GFF3Struct::getData(const Common::UString &field) co
 	if (!f)
 		return 0;
 
-	Common::SeekableReadStream &data = getData(*f);
-
-	uint32 size = 0;
-	if      ((f->type == kFieldTypeVoid) || (f->type == kFieldTypeExoString))
-		size = data.readUint32LE();
-	else if ( f->type == kFieldTypeResRef)
-		size = data.readByte();
-	else
+	if ((f->type != kFieldTypeVoid) && (f->type != kFieldTypeExoString) && (f->type != kFieldTypeResRef))
 		throw Common::Exception("GFF3: Field is not a data type");
 
-	return data.readStream(size);
+	const byte *data = getData(*f);
+
+	byte *copy = new byte[f->size];
+	if (f->size > 0)
+		std::memcpy(copy, data, f->size);
+
+	return new Common::MemoryReadStream(copy, f->size, true);
 }
 
 void GFF3Struct::getVector(const Common::UString &field,
@@ -673,11 +905,11 @@ void GFF3Struct::getVector(const Common::UString &field,
 	if (f->type != kFieldTypeVector)
 		throw Common::Exception("GFF3: Field is not a vector type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	checkData(*f);
 
-	x = data.readIEEEFloatLE();
-	y = data.readIEEEFloatLE();
-	z = data.readIEEEFloatLE();
+	x = f->value.floats[0];
+	y = f->value.floats[1];
+	z = f->value.floats[2];
 }
 
 void GFF3Struct::getOrientation(const Common::UString &field,
@@ -689,12 +921,12 @@ void GFF3Struct::getOrientation(const Common::UString &field,
 	if (f->type != kFieldTypeOrientation)
 		throw Common::Exception("GFF3: Field is not an orientation type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	checkData(*f);
 
-	a = data.readIEEEFloatLE();
-	b = data.readIEEEFloatLE();
-	c = data.readIEEEFloatLE();
-	d = data.readIEEEFloatLE();
+	a = f->value.floats[0];
+	b = f->value.floats[1];
+	c = f->value.floats[2];
+	d = f->value.floats[3];
 }
 
 void GFF3Struct::getVector(const Common::UString &field,
@@ -706,11 +938,11 @@ void GFF3Struct::getVector(const Common::UString &field,
 	if (f->type != kFieldTypeVector)
 		throw Common::Exception("GFF3: Field is not a vector type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	checkData(*f);
 
-	x = data.readIEEEFloatLE();
-	y = data.readIEEEFloatLE();
-	z = data.readIEEEFloatLE();
+	x = f->value.floats[0];
+	y = f->value.floats[1];
+	z = f->value.floats[2];
 }
 
 void GFF3Struct::getOrientation(const Common::UString &field,
@@ -722,12 +954,12 @@ void GFF3Struct::getOrientation(const Common::UString &field,
 	if (f->type != kFieldTypeOrientation)
 		throw Common::Exception("GFF3: Field is not an orientation type");
 
-	Common::SeekableReadStream &data = getData(*f);
+	checkData(*f);
 
-	a = data.readIEEEFloatLE();
-	b = data.readIEEEFloatLE();
-	c = data.readIEEEFloatLE();
-	d = data.readIEEEFloatLE();
+	a = f->value.floats[0];
+	b = f->value.floats[1];
+	c = f->value.floats[2];
+	d = f->value.floats[3];
 }
 
 // --- Struct reader ---
@@ -26,10 +26,10 @@
 #define AURORA_GFF3FILE_H
 
 #include <vector>
-#include <map>
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/flathashmap.h"
 
 #include "src/aurora/types.h"
 #include "src/aurora/aurorafile.h"
@@ -69,6 +69,11 @@ class GFF3Struct;
  *  parameter is set to false, no detection will take place, and these
  *  broken files will lead the loader to throw an exception.
  *
+ *  All field labels, simple field values and the raw field data are read
+ *  into memory when loading, and the file's stream is released afterwards.
+ *  Reading fields therefore never touches a stream, and several threads
+ *  can safely read out of the same GFF3File at the same time.
+ *
  *  See also: GFF4File in gff4file.h for the later V4.0/V4.1 versions of
  *  the GFF format.
  */
@@ -108,9 +113,19 @@ private:
 		void read(Common::SeekableReadStream &gff3);
 	};
 
+	/** The raw struct, field and field indices tables, used while loading. */
+	struct RawTables {
+		std::vector<uint32> structs;      ///< Struct ID, field index and field count.
+		std::vector<uint32> fields;       ///< Field type, label and data.
+		std::vector<uint32> fieldIndices; ///< Field indices of multi-field structs.
+	};
+
 	typedef std::vector<GFF3Struct *> StructArray;
 	typedef std::vector<GFF3List> ListArray;
 
+	/** Label ID returned for labels no field in this GFF3 uses. */
+	static const uint32 kInvalidLabel = 0xFFFFFFFF;
+
 
 	Common::SeekableReadStream *_stream;
 
@@ -127,26 +142,49 @@ private:
 	/** To convert list offsets found in GFF3 to real indices. */
 	std::vector<uint32> _listOffsetToIndex;
 
+	/** All distinct field labels. A field's label ID is an index into this array. */
+	std::vector<Common::UString> _labels;
+	/** To convert label indices found in the GFF3 to label IDs. */
+	std::vector<uint32> _labelIDs;
+	/** The label IDs, indexed by the hash of the label. */
+	Common::FlatHashMap<uint32> _labelMap;
+	/** Do two distinct labels share the same hash? */
+	bool _labelHashCollision;
+
+	/** The complete field data section. */
+	std::vector<byte> _fieldData;
+
 
 	// .--- Loading helpers
 	void load(uint32 id);
 	void loadHeader(uint32 id);
+	void loadLabels();
+	void loadFieldData();
 	void loadStructs();
 	void loadLists();
 
+	void readTable(std::vector<uint32> &table, uint32 offset, uint64 count);
+
 	void clear();
 	// '---
 
 	// .--- Helper methods called by GFF3Struct
-	/** Return the GFF3 stream. */
-	Common::SeekableReadStream &getStream(uint32 offset) const;
-	/** Return the GFF3 stream seeked to the start of the field data. */
-	Common::SeekableReadStream &getFieldData() const;
-
 	/** Return a struct within the GFF3. */
 	const GFF3Struct &getStruct(uint32 i) const;
 	/** Return a list within the GFF3. */
 	const GFF3List   &getList  (uint32 i) const;
+
+	/** Return the ID of this label, or kInvalidLabel if no field uses this label. */
+	uint32 findLabel(const Common::UString &label) const;
+	/** Convert a label index found in the GFF3 into a label ID. */
+	uint32 getLabelID(uint32 index) const;
+	/** Return the label with this ID. */
+	const Common::UString &getLabel(uint32 id) const;
+
+	/** Return the size of the field data section. */
+	uint32 getFieldDataSize() const;
+	/** Return a pointer into the field data section. */
+	const byte *getFieldData(uint32 offset) const;
 	// '---
 
 	friend class GFF3Struct;
@@ -234,50 +272,68 @@ public:
 	// '---
 
 private:
-	/** A field in the GFF3 struct. */
+	/** A field in the GFF3 struct.
+	 *
+	 *  Values that fit are decoded when loading. Fields with variable-length
+	 *  data (strings, localized strings and void data) instead reference a
+	 *  range within the parent GFF3's field data section.
+	 */
 	struct Field {
-		FieldType type;     ///< Type of the field.
-		uint32    data;     ///< Data of the field.
-		bool      extended; ///< Does this field need extended data?
+		uint32    label; ///< ID of the field's label.
+		FieldType type;  ///< Type of the field.
+		uint32    data;  ///< Data of the field, or offset of its data within the field data.
+		uint32    size;  ///< Size of the field's data within the field data.
+		bool      valid; ///< Is the field's extended data within the field data section?
+
+		/** Decoded value of a field with extended data. */
+		union {
+			uint64 integer;   ///< Uint64, Sint64 and StrRef fields.
+			double real;      ///< Float and Double fields.
+			float  floats[4]; ///< Vector and Orientation fields.
+		} value;
 
 		Field();
-		Field(FieldType t, uint32 d);
+		Field(uint32 l, FieldType t, uint32 d);
+
+		bool operator<(const Field &right) const;
 	};
 
-	typedef std::map<Common::UString, Field> FieldMap;
+	typedef std::vector<Field> FieldArray;
 
 
 	const GFF3File *_parent; ///< The parent GFF3.
 
-	uint32 _id;         ///< The struct's ID.
-	uint32 _fieldIndex; ///< Field / Field indices index.
-	uint32 _fieldCount; ///< Field count.
+	uint32 _id; ///< The struct's ID.
 
-	FieldMap _fields; ///< The fields, indexed by their label.
+	FieldArray _fields; ///< The fields, sorted by their label ID.
 
 	/** The names of all fields in this struct. */
 	std::vector<Common::UString> _fieldNames;
 
 
 	// .--- Loader
-	GFF3Struct(const GFF3File &parent, uint32 offset);
+	GFF3Struct(const GFF3File &parent, const GFF3File::RawTables &tables, uint32 index);
 	~GFF3Struct();
 
-	void load(uint32 offset);
+	void load(const GFF3File::RawTables &tables, uint32 index);
 
-	void readField  (Common::SeekableReadStream &data, uint32 index);
-	void readFields (Common::SeekableReadStream &data, uint32 index, uint32 count);
-	void readIndices(Common::SeekableReadStream &data,
-	                 std::vector<uint32> &indices, uint32 count) const;
-
-	Common::UString readLabel(Common::SeekableReadStream &data, uint32 index) const;
+	void readField(const GFF3File::RawTables &tables, uint32 index);
+	void readFieldData(Field &field) const;
 	// '---
 
 	// .--- Field and field data accessors
 	/** Returns the field with this tag. */
 	const Field *getField(const Common::UString &name) const;
+	/** Throw if this field's extended data lies outside the field data section. */
+	void checkData(const Field &field) const;
 	/** Returns the extended field data for this field. */
-	Common::SeekableReadStream &getData(const Field &field) const;
+	const byte *getData(const Field &field) const;
+
+	uint64 getUint(const Field &field) const;
+	 int64 getSint(const Field &field) const;
+	double getDouble(const Field &field) const;
+
+	bool getLocString(const Field &field, LocString &str) const;
 	// '---
 
 	friend class GFF3File;
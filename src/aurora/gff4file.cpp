@@ -28,6 +28,8 @@
 
 #include <cassert>
 
+#include <algorithm>
+
 #include "src/common/error.h"
 #include "src/common/readstream.h"
 #include "src/common/encoding.h"
@@ -43,6 +45,11 @@ static const uint32 kVersion41 = MKTAG('V', '4', '.', '1');
 
 namespace Aurora {
 
+struct GFF4File::FieldTable {
+	GFF4Struct::FieldArray fields; ///< The decoded fields, sorted by label.
+	std::vector<uint32>    labels; ///< The labels of all fields, in template order.
+};
+
 void GFF4File::Header::read(Common::SeekableReadStream &gff4, uint32 version) {
 	platformID   = gff4.readUint32BE();
 	type         = gff4.readUint32BE();
@@ -63,14 +70,14 @@ void GFF4File::Header::read(Common::SeekableReadStream &gff4, uint32 version) {
 }
 
 
-GFF4File::GFF4File(Common::SeekableReadStream *gff4, uint32 type) :
-	_stream(gff4), _topLevelStruct(0) {
+GFF4File::GFF4File(Common::SeekableReadStream *gff4, uint32 type, bool lazy) :
+	_stream(gff4), _lazy(lazy), _topLevelStruct(0) {
 
 	load(type);
 }
 
-GFF4File::GFF4File(const Common::UString &gff4, FileType fileType, uint32 type) :
-	_stream(0), _topLevelStruct(0) {
+GFF4File::GFF4File(const Common::UString &gff4, FileType fileType, uint32 type, bool lazy) :
+	_stream(0), _lazy(lazy), _topLevelStruct(0) {
 
 	_stream = ResMan.getResource(gff4, fileType);
 	if (!_stream)
@@ -92,6 +99,11 @@ void GFF4File::clear() {
 
 	_structs.clear();
 	_topLevelStruct = 0;
+
+	for (FieldTables::iterator t = _fieldTables.begin(); t != _fieldTables.end(); ++t)
+		delete *t;
+
+	_fieldTables.clear();
 }
 
 uint32 GFF4File::getType() const {
@@ -106,6 +118,10 @@ uint32 GFF4File::getPlatform() const {
 	return _header.platformID;
 }
 
+bool GFF4File::isLazy() const {
+	return _lazy;
+}
+
 const GFF4Struct &GFF4File::getTopLevel() const {
 	assert(_topLevelStruct);
 
@@ -193,11 +209,45 @@ void GFF4File::loadStructs() {
 		}
 	}
 
+	loadFieldTables();
+
 	// And load the top level struct, which itself recurses into field structs
 	_topLevelStruct = new GFF4Struct(*this, _header.dataOffset, _structTemplates[0]);
 	_topLevelStruct->_refCount++;
 }
 
+void GFF4File::loadFieldTables() {
+	/* Decode the fields of all struct templates, so that all structs of a
+	 * template can share them. For fields with the same label, the last
+	 * one wins. */
+
+	_fieldTables.reserve(_structTemplates.size());
+	for (StructTemplates::const_iterator t = _structTemplates.begin(); t != _structTemplates.end(); ++t) {
+		_fieldTables.push_back(new FieldTable);
+		FieldTable &table = *_fieldTables.back();
+
+		GFF4Struct::FieldArray fields;
+		fields.reserve(t->fields.size());
+
+		table.labels.reserve(t->fields.size());
+		for (std::vector<StructTemplate::Field>::const_iterator f = t->fields.begin(); f != t->fields.end(); ++f) {
+			table.labels.push_back(f->label);
+			fields.push_back(GFF4Struct::Field(f->label, f->type, f->flags, f->offset));
+		}
+
+		std::stable_sort(fields.begin(), fields.end());
+
+		table.fields.reserve(fields.size());
+		for (size_t i = 0; i < fields.size(); i++) {
+			if (((i + 1) < fields.size()) && (fields[i].label == fields[i + 1].label))
+				continue;
+
+			table.fields.push_back(fields[i]);
+			table.fields.back().index = table.fields.size() - 1;
+		}
+	}
+}
+
 void GFF4File::loadStrings() {
 	if (!_header.hasSharedStrings)
 		return;
@@ -249,6 +299,12 @@ const GFF4File::StructTemplate &GFF4File::getStructTemplate(uint32 i) const {
 	return _structTemplates[i];
 }
 
+const GFF4File::FieldTable &GFF4File::getFieldTable(uint32 i) const {
+	assert(i < _fieldTables.size());
+
+	return *_fieldTables[i];
+}
+
 bool GFF4File::hasSharedStrings() const {
 	return _header.hasSharedStrings;
 }
@@ -264,12 +320,12 @@ Common::UString GFF4File::getSharedString(uint32 i) const {
 
 
 GFF4Struct::Field::Field() : label(0), type(kFieldTypeNone), offset(0xFFFFFFFF),
-	isList(false), isReference(false), isGeneric(false), structIndex(0) {
+	isList(false), isReference(false), isGeneric(false), structIndex(0), index(0) {
 
 }
 
 GFF4Struct::Field::Field(uint32 l, uint16 t, uint16 f, uint32 o, bool g) :
-	label(l), offset(o), isGeneric(g) {
+	label(l), offset(o), isGeneric(g), index(0) {
 
 	isList      = (f & 0x8000) != 0;
 	isReference = (f & 0x2000) != 0;
@@ -292,15 +348,24 @@ GFF4Struct::Field::Field(uint32 l, uint16 t, uint16 f, uint32 o, bool g) :
 GFF4Struct::Field::~Field() {
 }
 
+bool GFF4Struct::Field::operator<(const Field &right) const {
+	return label < right.label;
+}
+
+bool GFF4Struct::Field::operator<(uint32 right) const {
+	return label < right;
+}
+
 
 GFF4Struct::GFF4Struct(GFF4File &parent, uint32 offset, const GFF4File::StructTemplate &tmplt) :
-	_parent(&parent), _label(tmplt.label), _refCount(0), _fieldCount(0) {
+	_parent(&parent), _label(tmplt.label), _refCount(0), _offset(offset), _fieldCount(0),
+	_fields(0), _fieldLabels(0) {
 
 	_id = generateID(offset, &tmplt);
 	parent.registerStruct(_id, this);
 
 	try {
-		load(parent, offset, tmplt);
+		load(parent, tmplt);
 	} catch (...) {
 		parent.unregisterStruct(_id);
 		throw;
@@ -308,7 +373,8 @@ GFF4Struct::GFF4Struct(GFF4File &parent, uint32 offset, const GFF4File::StructTe
 }
 
 GFF4Struct::GFF4Struct(GFF4File &parent, const Field &genericParent) :
-	_parent(&parent), _label(0), _refCount(0), _fieldCount(0) {
+	_parent(&parent), _label(0), _refCount(0), _offset(0xFFFFFFFF), _fieldCount(0),
+	_fields(0), _fieldLabels(0) {
 
 	_id = generateID(genericParent.offset);
 	parent.registerStruct(_id, this);
@@ -338,98 +404,100 @@ uint32 GFF4Struct::getLabel() const {
 
 // --- Loader ---
 
-void GFF4Struct::load(GFF4File &parent, uint32 offset, const GFF4File::StructTemplate &tmplt) {
-	for (size_t i = 0; i < tmplt.fields.size(); i++) {
-		const GFF4File::StructTemplate::Field &field = tmplt.fields[i];
+void GFF4Struct::load(GFF4File &parent, const GFF4File::StructTemplate &tmplt) {
+	const GFF4File::FieldTable &table = parent.getFieldTable(tmplt.index);
+
+	_fields      = &table.fields;
+	_fieldLabels = &table.labels;
+	_fieldCount  = _fields->size();
+
+	if (!parent.isLazy())
+		loadStructs();
+}
+
+void GFF4Struct::load(GFF4File &parent, const Field &genericParent) {
+	static const uint32 kGenericSize = 8;
+
+	Common::SeekableReadStream &data = parent.getStream(genericParent.offset);
 
-		_fieldLabels.push_back(field.label);
+	const uint32 genericCount = genericParent.isList ? data.readUint32LE() : 1;
+	const uint32 genericStart = data.pos();
+
+	for (uint32 i = 0; i < genericCount; i++) {
+		data.seek(genericStart + i * kGenericSize);
+
+		const uint16 fieldType   = data.readUint16LE();
+		const uint16 fieldFlags  = data.readUint16LE();
+
+		const uint32 fieldOffset = getDataOffset(genericParent.isReference, data.pos());
+
+		if (fieldOffset == 0xFFFFFFFF)
+			continue;
 
-		// Calculate the offset for the field data, but guard against NULL pointers
-		uint32 fieldOffset = offset + field.offset;
-		if ((offset == 0xFFFFFFFF) || (field.offset == 0xFFFFFFFF))
-			fieldOffset = 0xFFFFFFFF;
+		_genericFieldLabels.push_back(i);
 
-		// Load the field and its struct(s), if any
-		Field &f = _fields[field.label] = Field(field.label, field.type, field.flags, fieldOffset);
-		if (f.type == kFieldTypeStruct)
-			loadStructs(parent, f);
-		if (f.type == kFieldTypeGeneric)
-			loadGeneric(parent, f);
+		// The labels are the element indices, so the fields are already sorted
+		_genericFields.push_back(Field(i, fieldType, fieldFlags, fieldOffset, true));
+		_genericFields.back().index = _genericFields.size() - 1;
 	}
 
-	_fieldCount = _fields.size();
+	_fields      = &_genericFields;
+	_fieldLabels = &_genericFieldLabels;
+	_fieldCount  = genericCount;
+
+	if (!parent.isLazy())
+		loadStructs();
+}
+
+void GFF4Struct::loadStructs() {
+	for (FieldArray::const_iterator f = _fields->begin(); f != _fields->end(); ++f)
+		if ((f->type == kFieldTypeStruct) || (f->type == kFieldTypeGeneric))
+			getStructs(*f);
 }
 
-void GFF4Struct::loadStructs(GFF4File &parent, Field &field) {
-	if (field.offset == 0xFFFFFFFF)
+void GFF4Struct::loadStructs(const Field &field, GFF4List &structs) const {
+	const uint32 fieldOffset = getFieldOffset(field);
+	if (fieldOffset == 0xFFFFFFFF)
 		return;
 
-	const GFF4File::StructTemplate &tmplt = parent.getStructTemplate(field.structIndex);
+	const GFF4File::StructTemplate &tmplt = _parent->getStructTemplate(field.structIndex);
 
-	Common::SeekableReadStream &data = parent.getStream(field.offset);
+	Common::SeekableReadStream &data = _parent->getStream(fieldOffset);
 
 	const uint32 structCount = getListCount(data, field);
 	const uint32 structSize  = field.isReference ? 4 : tmplt.size;
 	const uint32 structStart = data.pos();
 
-	field.structs.resize(structCount, 0);
+	structs.resize(structCount, 0);
 	for (uint32 i = 0; i < structCount; i++) {
 		const uint32 offset = getDataOffset(field.isReference, structStart + i * structSize);
 		if (offset == 0xFFFFFFFF)
 			continue;
 
-		GFF4Struct *strct = parent.findStruct(generateID(offset, &tmplt));
+		GFF4Struct *strct = _parent->findStruct(generateID(offset, &tmplt));
 		if (!strct)
-			strct = new GFF4Struct(parent, offset, tmplt);
+			strct = new GFF4Struct(*_parent, offset, tmplt);
 
 		strct->_refCount++;
 
-		field.structs[i] = strct;
+		structs[i] = strct;
 	}
 }
 
-void GFF4Struct::loadGeneric(GFF4File &parent, Field &field) {
-	field.offset = getDataOffset(field.isList, field.offset);
-	if (field.offset == 0xFFFFFFFF)
+void GFF4Struct::loadGeneric(const Field &field, GFF4List &structs) const {
+	Field generic = field;
+
+	generic.offset = getDataOffset(field.isList, getFieldOffset(field));
+	if (generic.offset == 0xFFFFFFFF)
 		return;
 
-	GFF4Struct *strct = parent.findStruct(generateID(field.offset));
+	GFF4Struct *strct = _parent->findStruct(generateID(generic.offset));
 	if (!strct)
-		strct = new GFF4Struct(parent, field);
+		strct = new GFF4Struct(*_parent, generic);
 
 	strct->_refCount++;
 
-	field.structs.push_back(strct);
-}
-
-void GFF4Struct::load(GFF4File &parent, const Field &genericParent) {
-	static const uint32 kGenericSize = 8;
-
-	Common::SeekableReadStream &data = parent.getStream(genericParent.offset);
-
-	const uint32 genericCount = genericParent.isList ? data.readUint32LE() : 1;
-	const uint32 genericStart = data.pos();
-
-	for (uint32 i = 0; i < genericCount; i++) {
-		data.seek(genericStart + i * kGenericSize);
-
-		const uint16 fieldType   = data.readUint16LE();
-		const uint16 fieldFlags  = data.readUint16LE();
-
-		const uint32 fieldOffset = getDataOffset(genericParent.isReference, data.pos());
-
-		if (fieldOffset == 0xFFFFFFFF)
-			continue;
-
-		_fieldLabels.push_back(i);
-
-		// Load the field and its struct(s), if any
-		Field &f = _fields[i] = Field(i, fieldType, fieldFlags, fieldOffset, true);
-		if (f.type == kFieldTypeStruct)
-			loadStructs(parent, f);
-	}
-
-	_fieldCount = genericCount;
+	structs.push_back(strct);
 }
 
 uint64 GFF4Struct::generateID(uint32 offset, const GFF4File::StructTemplate *tmplt) {
@@ -447,7 +515,7 @@ bool GFF4Struct::hasField(uint32 field) const {
 }
 
 const std::vector<uint32> &GFF4Struct::getFieldLabels() const {
-	return _fieldLabels;
+	return *_fieldLabels;
 }
 
 GFF4Struct::FieldType GFF4Struct::getFieldType(uint32 field) const {
@@ -480,11 +548,48 @@ bool GFF4Struct::getFieldProperties(uint32 field, FieldType &type, uint32 &label
 // --- Field value reader helpers ---
 
 const GFF4Struct::Field *GFF4Struct::getField(uint32 field) const {
-	FieldMap::const_iterator f = _fields.find(field);
-	if (f == _fields.end())
+	FieldArray::const_iterator f = std::lower_bound(_fields->begin(), _fields->end(), field);
+	if ((f == _fields->end()) || (f->label != field))
 		return 0;
 
-	return &f->second;
+	return &*f;
+}
+
+const GFF4List &GFF4Struct::getStructs(const Field &field) const {
+	if (_structs.empty()) {
+		_structs.resize(_fields->size());
+		_structsLoaded.resize(_fields->size(), false);
+	}
+
+	GFF4List &structs = _structs[field.index];
+	if (_structsLoaded[field.index])
+		return structs;
+
+	try {
+		if (field.type == kFieldTypeStruct)
+			loadStructs(field, structs);
+		else if (field.type == kFieldTypeGeneric)
+			loadGeneric(field, structs);
+	} catch (...) {
+		structs.clear();
+		throw;
+	}
+
+	_structsLoaded[field.index] = true;
+
+	return structs;
+}
+
+uint32 GFF4Struct::getFieldOffset(const Field &field) const {
+	// Fields found in generics have an absolute offset
+	if (field.isGeneric)
+		return field.offset;
+
+	// Fields in structs are relative to the struct, but guard against NULL pointers
+	if ((_offset == 0xFFFFFFFF) || (field.offset == 0xFFFFFFFF))
+		return 0xFFFFFFFF;
+
+	return _offset + field.offset;
 }
 
 uint32 GFF4Struct::getDataOffset(bool isReference, uint32 offset) const {
@@ -504,7 +609,7 @@ uint32 GFF4Struct::getDataOffset(const Field &field) const {
 	if (field.type == kFieldTypeStruct)
 		return 0xFFFFFFFF;
 
-	return getDataOffset(field.isReference, field.offset);
+	return getDataOffset(field.isReference, getFieldOffset(field));
 }
 
 Common::SeekableReadStream *GFF4Struct::getData(const Field &field) const {
@@ -1197,8 +1302,9 @@ const GFF4Struct *GFF4Struct::getStruct(uint32 field) const {
 	if (f->isList)
 		throw Common::Exception("GFF4: Tried reading list as singular value");
 
-	if (!f->structs.empty())
-		return f->structs[0];
+	const GFF4List &structs = getStructs(*f);
+	if (!structs.empty())
+		return structs[0];
 
 	return 0;
 }
@@ -1213,8 +1319,9 @@ const GFF4Struct *GFF4Struct::getGeneric(uint32 field) const {
 	if (f->type != kFieldTypeGeneric)
 		throw Common::Exception("GFF4: Field is not of generic type");
 
-	if (!f->structs.empty())
-		return f->structs[0];
+	const GFF4List &structs = getStructs(*f);
+	if (!structs.empty())
+		return structs[0];
 
 	return 0;
 }
@@ -1229,7 +1336,7 @@ const GFF4List &GFF4Struct::getList(uint32 field) const {
 	if (f->type != kFieldTypeStruct)
 		throw Common::Exception("GFF4: Field is not of struct type");
 
-	return f->structs;
+	return getStructs(*f);
 }
 
 // --- Struct data reader ---
@@ -69,15 +69,24 @@ class GFF4Struct;
  *    the English, French, Italian, German and Spanish (EFIGS) versions have
  *    the strings in TLK files encoded in Windows CP-1252.
  *
+ *  All structs of the same struct template share that template's decoded
+ *  field descriptions, which are sorted by label for field lookups. By
+ *  default, all structs reachable from the top-level struct are created
+ *  when loading the GFF4. In lazy mode, structs are instead only created
+ *  when they are first requested through getStruct(), getGeneric() or
+ *  getList(). This saves time and memory when only a few fields of a big
+ *  GFF4 are of interest. Note that in lazy mode, GFF4Struct::getRefCount()
+ *  only counts references from structs that have already been created.
+ *
  *  See also: GFF3File in gff3file.h for the earlier V3.2/V3.3 versions of
  *  the GFF format.
  */
 class GFF4File : public AuroraFile {
 public:
 	/** Take over this stream and read a GFF4 file out of it. */
-	GFF4File(Common::SeekableReadStream *gff4, uint32 type = 0xFFFFFFFF);
+	GFF4File(Common::SeekableReadStream *gff4, uint32 type = 0xFFFFFFFF, bool lazy = false);
 	/** Request this resource from the ResourceManager and read a GFF4 file out of it. */
-	GFF4File(const Common::UString &gff4, FileType fileType, uint32 type = 0xFFFFFFFF);
+	GFF4File(const Common::UString &gff4, FileType fileType, uint32 type = 0xFFFFFFFF, bool lazy = false);
 	~GFF4File();
 
 	/** Return the GFF4's specific type. */
@@ -87,6 +96,9 @@ public:
 	/** Return the platform this GFF4 is for. */
 	uint32 getPlatform() const;
 
+	/** Are structs only created when they're first requested? */
+	bool isLazy() const;
+
 	/** Returns the top-level struct. */
 	const GFF4Struct &getTopLevel() const;
 
@@ -123,7 +135,11 @@ private:
 		std::vector<Field> fields;
 	};
 
+	/** The decoded fields of a struct template. */
+	struct FieldTable;
+
 	typedef std::vector<StructTemplate> StructTemplates;
+	typedef std::vector<FieldTable *> FieldTables;
 	typedef std::vector<Common::UString> SharedStrings;
 	typedef std::map<uint64, GFF4Struct *> StructMap;
 
@@ -135,11 +151,16 @@ private:
 	Header          _header;
 	/** All struct templates in this GFF4. */
 	StructTemplates _structTemplates;
+	/** The decoded fields of all struct templates. */
+	FieldTables     _fieldTables;
+
+	/** Create structs only when they're requested? */
+	bool _lazy;
 
 	/** The shared strings used in V4.1. */
 	SharedStrings _sharedStrings;
 
-	/** All actual structs in this GFF4. */
+	/** All actual structs in this GFF4 (that have been created so far, in lazy mode). */
 	StructMap   _structs;
 	/** The top-level struct. */
 	GFF4Struct *_topLevelStruct;
@@ -149,6 +170,7 @@ private:
 	void load(uint32 type);
 	void loadHeader(uint32 type);
 	void loadStructs();
+	void loadFieldTables();
 	void loadStrings();
 
 	void clear();
@@ -161,6 +183,7 @@ private:
 
 	Common::SeekableReadStream &getStream(uint32 offset) const;
 	const StructTemplate &getStructTemplate(uint32 i) const;
+	const FieldTable &getFieldTable(uint32 i) const;
 	uint32 getDataOffset() const;
 
 	bool hasSharedStrings() const;
@@ -200,7 +223,10 @@ public:
 
 	/** Return the struct's unique ID within the GFF4. */
 	uint64 getID() const;
-	/** Return the number of structs that refer to this struct. */
+	/** Return the number of structs that refer to this struct.
+	 *
+	 *  In lazy mode, only structs that have already been created are counted.
+	 */
 	uint32 getRefCount() const;
 
 	/** Return the struct's label.
@@ -324,30 +350,47 @@ private:
 		bool isReference; ///< Is this field a reference (pointer) to another field?
 		bool isGeneric;   ///< Is this field found in a generic?
 
-		uint16   structIndex; ///< Index of the field's struct type (if kFieldTypeStruct).
-		GFF4List structs;     ///< List of GFF4Struct (if kFieldTypeStruct).
+		uint16 structIndex; ///< Index of the field's struct type (if kFieldTypeStruct).
+		uint32 index;       ///< Index of the field within the struct's fields.
 
 		Field();
 		Field(uint32 l, uint16 t, uint16 f, uint32 o, bool g = false);
 		~Field();
+
+		bool operator<(const Field &right) const;
+		bool operator<(uint32 right) const;
 	};
 
-	typedef std::map<uint32, Field> FieldMap;
+	/** The fields of a struct, sorted by label. */
+	typedef std::vector<Field> FieldArray;
 
 
-	const GFF4File *_parent;
+	GFF4File *_parent;
 
 	uint32 _label;
 
 	uint64 _id;
 	uint32 _refCount;
 
-	size_t _fieldCount;
+	/** Offset of the struct data, for structs created from a template. */
+	uint32 _offset;
 
-	FieldMap _fields;
+	size_t _fieldCount;
 
+	/** The fields of this struct, shared with all structs of the same template. */
+	const FieldArray *_fields;
 	/** The labels of all fields in this struct. */
-	std::vector<uint32> _fieldLabels;
+	const std::vector<uint32> *_fieldLabels;
+
+	/** The fields of this struct, if it was loaded from a generic. */
+	FieldArray _genericFields;
+	/** The labels of the fields of this struct, if it was loaded from a generic. */
+	std::vector<uint32> _genericFieldLabels;
+
+	/** The structs referenced by each field, created when they're first requested. */
+	mutable std::vector<GFF4List> _structs;
+	/** Have the structs referenced by a field been created yet? */
+	mutable std::vector<bool> _structsLoaded;
 
 
 	// .--- Loader
@@ -357,18 +400,25 @@ private:
 	GFF4Struct(GFF4File &parent, const Field &genericParent);
 	~GFF4Struct();
 
-	void load(GFF4File &parent, uint32 offset, const GFF4File::StructTemplate &tmplt);
-	void loadStructs(GFF4File &parent, Field &field);
-	void loadGeneric(GFF4File &parent, Field &field);
-
+	void load(GFF4File &parent, const GFF4File::StructTemplate &tmplt);
 	void load(GFF4File &parent, const Field &genericParent);
 
+	/** Create all structs referenced by this struct's fields. */
+	void loadStructs();
+	void loadStructs(const Field &field, GFF4List &structs) const;
+	void loadGeneric(const Field &field, GFF4List &structs) const;
+
 	static uint64 generateID(uint32 offset, const GFF4File::StructTemplate *tmplt = 0);
 	// '---
 
 	// .--- Field and field data accessors
 	const Field *getField(uint32 field) const;
 
+	/** Return the structs referenced by this field, creating them if necessary. */
+	const GFF4List &getStructs(const Field &field) const;
+
+	uint32 getFieldOffset(const Field &field) const;
+
 	uint32 getDataOffset(bool isReference, uint32 offset) const;
 	uint32 getDataOffset(const Field &field) const;
 
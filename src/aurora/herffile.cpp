@@ -28,6 +28,7 @@
 #include "src/common/error.h"
 #include "src/common/filepath.h"
 #include "src/common/memreadstream.h"
+#include "src/common/mappedfile.h"
 #include "src/common/encoding.h"
 #include "src/common/hash.h"
 
@@ -160,6 +161,11 @@ uint32 HERFFile::getResourceSize(uint32 index) const {
 Common::SeekableReadStream *HERFFile::getResource(uint32 index, bool tryNoCopy) const {
 	const IResource &res = getIResource(index);
 
+	// If the archive is mapped into memory, point straight into the mapping
+	const Common::MappedReadStream *mapped = dynamic_cast<const Common::MappedReadStream *>(_herf);
+	if (mapped)
+		return mapped->createSubStream(res.offset, res.size);
+
 	if (tryNoCopy)
 		return new Common::SeekableSubReadStream(_herf, res.offset, res.offset + res.size);
 
@@ -0,0 +1,392 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of archive resource indices.
+ */
+
+#include <list>
+
+#include "src/common/util.h"
+#include "src/common/strutil.h"
+#include "src/common/error.h"
+#include "src/common/encoding.h"
+#include "src/common/filepath.h"
+#include "src/common/readfile.h"
+#include "src/common/writefile.h"
+#include "src/common/memreadstream.h"
+#include "src/common/memwritestream.h"
+
+#include "src/aurora/indexcache.h"
+
+static const uint32 kIndexCacheID = MKTAG('X', 'R', 'I', 'C');
+static const uint32 kVersion10    = MKTAG('V', '1', '.', '0');
+
+static const uint32 kHeaderSize       = 32;
+static const uint32 kArchiveEntrySize = 40;
+static const uint32 kResourceSize     = 24;
+
+static const uint32 kNoParent = 0xFFFFFFFF;
+
+namespace Aurora {
+
+IndexCache::ArchiveFile::ArchiveFile() : size(0), time(0) {
+}
+
+IndexCache::ArchiveFile::ArchiveFile(const Common::UString &p) : path(p) {
+	size = Common::FilePath::getFileSize(p);
+	time = Common::FilePath::getModificationTime(p);
+}
+
+bool IndexCache::ArchiveFile::isValid() const {
+	if (!Common::FilePath::isRegularFile(path))
+		return false;
+
+	return (Common::FilePath::getFileSize(path) == size) &&
+	       (Common::FilePath::getModificationTime(path) == time);
+}
+
+
+IndexCache::Entry::Entry() : hashAlgo(Common::kHashNone) {
+}
+
+
+IndexCache::IndexCache() : _data(0), _archiveCount(0), _archiveOffset(0), _resourceCount(0),
+	_resourceOffset(0), _stringsSize(0), _stringsOffset(0), _dirty(false) {
+
+}
+
+IndexCache::~IndexCache() {
+	clear();
+}
+
+void IndexCache::clear() {
+	delete _data;
+	_data = 0;
+
+	_archiveCount   = 0;
+	_archiveOffset  = 0;
+	_resourceCount  = 0;
+	_resourceOffset = 0;
+	_stringsSize    = 0;
+	_stringsOffset  = 0;
+
+	_loaded.clear();
+	_entries.clear();
+
+	_dirty = false;
+}
+
+bool IndexCache::load(const Common::UString &file) {
+	clear();
+
+	if (!Common::FilePath::isRegularFile(file))
+		return false;
+
+	try {
+		Common::ReadFile cacheFile(file);
+
+		_data = cacheFile.readStream(cacheFile.size());
+
+		readHeader();
+
+		// Remember where to find all archives that aren't BIFs of a KEY
+		for (uint32 i = 0; i < _archiveCount; i++) {
+			_data->seek(_archiveOffset + i * kArchiveEntrySize);
+
+			const uint32 pathOffset = _data->readUint32LE();
+			const uint32 parent     = _data->readUint32LE();
+
+			if (parent == kNoParent)
+				_loaded[readString(pathOffset)] = i;
+		}
+
+	} catch (Common::Exception &e) {
+		e.add("Failed loading the resource index cache \"%s\"", file.c_str());
+		Common::printException(e, "WARNING: ");
+
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+void IndexCache::readHeader() {
+	const uint32 id      = _data->readUint32BE();
+	const uint32 version = _data->readUint32BE();
+
+	if (id != kIndexCacheID)
+		throw Common::Exception("Not a resource index cache (%s)", Common::debugTag(id).c_str());
+
+	if (version != kVersion10)
+		throw Common::Exception("Unsupported resource index cache version %s",
+		                        Common::debugTag(version).c_str());
+
+	_archiveCount   = _data->readUint32LE();
+	_archiveOffset  = _data->readUint32LE();
+	_resourceCount  = _data->readUint32LE();
+	_resourceOffset = _data->readUint32LE();
+	_stringsSize    = _data->readUint32LE();
+	_stringsOffset  = _data->readUint32LE();
+
+	const uint64 size = _data->size();
+
+	if ((((uint64) _archiveOffset)  + ((uint64) _archiveCount)  * kArchiveEntrySize > size) ||
+	    (((uint64) _resourceOffset) + ((uint64) _resourceCount) * kResourceSize     > size) ||
+	    (((uint64) _stringsOffset)  + ((uint64) _stringsSize)                       > size))
+		throw Common::Exception("Resource index cache truncated");
+}
+
+Common::UString IndexCache::readString(uint32 offset) const {
+	if (offset >= _stringsSize)
+		throw Common::Exception("Resource index cache string offset out of range (%u/%u)",
+		                        offset, _stringsSize);
+
+	_data->seek(_stringsOffset + offset);
+
+	return Common::readString(*_data, Common::kEncodingUTF8);
+}
+
+void IndexCache::readArchiveFile(uint32 index, ArchiveFile &file, uint32 &parent, uint32 &hashAlgo) const {
+	if (index >= _archiveCount)
+		throw Common::Exception("Resource index cache archive index out of range (%u/%u)",
+		                        index, _archiveCount);
+
+	_data->seek(_archiveOffset + index * kArchiveEntrySize);
+
+	const uint32 pathOffset = _data->readUint32LE();
+
+	parent   = _data->readUint32LE();
+	hashAlgo = _data->readUint32LE();
+
+	const uint32 firstResource = _data->readUint32LE();
+	const uint32 resourceCount = _data->readUint32LE();
+
+	_data->skip(4); // Reserved
+
+	file.size = _data->readUint64LE();
+	file.time = _data->readUint64LE();
+
+	if ((((uint64) firstResource) + resourceCount) > _resourceCount)
+		throw Common::Exception("Resource index cache resource index out of range (%u+%u/%u)",
+		                        firstResource, resourceCount, _resourceCount);
+
+	std::vector<uint32> nameOffsets;
+	nameOffsets.reserve(resourceCount);
+
+	file.resources.clear();
+
+	_data->seek(_resourceOffset + firstResource * kResourceSize);
+	for (uint32 i = 0; i < resourceCount; i++) {
+		file.resources.push_back(Archive::Resource());
+		Archive::Resource &res = file.resources.back();
+
+		res.hash = _data->readUint64LE();
+		nameOffsets.push_back(_data->readUint32LE());
+		res.type  = (FileType) _data->readSint32LE();
+		res.index = _data->readUint32LE();
+
+		_data->skip(4); // Reserved
+	}
+
+	// Now read the strings, which will seek around in the string pool
+	std::vector<uint32>::const_iterator nameOffset = nameOffsets.begin();
+	for (Archive::ResourceList::iterator r = file.resources.begin(); r != file.resources.end(); ++r, ++nameOffset)
+		r->name = readString(*nameOffset);
+
+	file.path = readString(pathOffset);
+}
+
+void IndexCache::readEntry(uint32 index, Entry &entry) const {
+	uint32 parent, hashAlgo;
+	readArchiveFile(index, entry.file, parent, hashAlgo);
+
+	entry.hashAlgo = (Common::HashAlgo) (int32) hashAlgo;
+
+	/* The BIFs of a KEY always directly follow the KEY itself. */
+	for (uint32 i = index + 1; i < _archiveCount; i++) {
+		ArchiveFile bif;
+		uint32 bifParent, bifHashAlgo;
+
+		readArchiveFile(i, bif, bifParent, bifHashAlgo);
+		if (bifParent != index)
+			break;
+
+		entry.bifs.push_back(bif);
+	}
+}
+
+bool IndexCache::isDirty() const {
+	return _dirty;
+}
+
+bool IndexCache::find(const Common::UString &path, Entry &entry) const {
+	EntryMap::const_iterator added = _entries.find(path);
+	if (added != _entries.end()) {
+		if (!added->second.file.isValid())
+			return false;
+
+		entry = added->second;
+		return true;
+	}
+
+	LoadedMap::const_iterator l = _loaded.find(path);
+	if (l == _loaded.end())
+		return false;
+
+	try {
+		Entry loaded;
+		readEntry(l->second, loaded);
+
+		if (!loaded.file.isValid())
+			return false;
+
+		entry = loaded;
+
+	} catch (Common::Exception &e) {
+		e.add("Failed reading \"%s\" from the resource index cache", path.c_str());
+		Common::printException(e, "WARNING: ");
+
+		return false;
+	}
+
+	return true;
+}
+
+void IndexCache::add(const Entry &entry) {
+	_entries[entry.file.path] = entry;
+
+	_dirty = true;
+}
+
+namespace {
+
+/** Helper class collecting the data of a resource index cache file. */
+struct CacheWriter {
+	Common::MemoryWriteStreamDynamic archives;
+	Common::MemoryWriteStreamDynamic resources;
+	Common::MemoryWriteStreamDynamic strings;
+
+	std::map<Common::UString, uint32> stringOffsets;
+
+	uint32 archiveCount;
+	uint32 resourceCount;
+
+	CacheWriter() : archives(true), resources(true), strings(true), archiveCount(0), resourceCount(0) {
+	}
+
+	uint32 addString(const Common::UString &str) {
+		std::map<Common::UString, uint32>::const_iterator s = stringOffsets.find(str);
+		if (s != stringOffsets.end())
+			return s->second;
+
+		const uint32 offset = strings.size();
+		Common::writeString(strings, str, Common::kEncodingUTF8, true);
+
+		stringOffsets.insert(std::make_pair(str, offset));
+		return offset;
+	}
+
+	uint32 addArchive(const IndexCache::ArchiveFile &file, uint32 parent, Common::HashAlgo hashAlgo) {
+		const uint32 firstResource = resourceCount;
+
+		for (Archive::ResourceList::const_iterator r = file.resources.begin(); r != file.resources.end(); ++r) {
+			resources.writeUint64LE(r->hash);
+			resources.writeUint32LE(addString(r->name));
+			resources.writeSint32LE((int32) r->type);
+			resources.writeUint32LE(r->index);
+			resources.writeUint32LE(0); // Reserved
+
+			resourceCount++;
+		}
+
+		archives.writeUint32LE(addString(file.path));
+		archives.writeUint32LE(parent);
+		archives.writeUint32LE((uint32) (int32) hashAlgo);
+		archives.writeUint32LE(firstResource);
+		archives.writeUint32LE(resourceCount - firstResource);
+		archives.writeUint32LE(0); // Reserved
+		archives.writeUint64LE(file.size);
+		archives.writeUint64LE(file.time);
+
+		return archiveCount++;
+	}
+};
+
+} // End of anonymous namespace
+
+void IndexCache::save(const Common::UString &file) {
+	// Collect all still valid entries from the loaded cache that haven't been replaced
+	std::list<Entry> loaded;
+	for (LoadedMap::const_iterator l = _loaded.begin(); l != _loaded.end(); ++l) {
+		if (_entries.find(l->first) != _entries.end())
+			continue;
+
+		loaded.push_back(Entry());
+		readEntry(l->second, loaded.back());
+
+		if (!loaded.back().file.isValid())
+			loaded.pop_back();
+	}
+
+	std::vector<const Entry *> entries;
+	for (std::list<Entry>::const_iterator l = loaded.begin(); l != loaded.end(); ++l)
+		entries.push_back(&*l);
+	for (EntryMap::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+		entries.push_back(&e->second);
+
+	CacheWriter writer;
+	for (std::vector<const Entry *>::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		const uint32 parent = writer.addArchive((*e)->file, kNoParent, (*e)->hashAlgo);
+
+		for (std::vector<ArchiveFile>::const_iterator b = (*e)->bifs.begin(); b != (*e)->bifs.end(); ++b)
+			writer.addArchive(*b, parent, (*e)->hashAlgo);
+	}
+
+	const uint32 archiveOffset  = kHeaderSize;
+	const uint32 resourceOffset = archiveOffset  + writer.archives.size();
+	const uint32 stringsOffset  = resourceOffset + writer.resources.size();
+
+	Common::WriteFile cacheFile;
+	if (!cacheFile.open(file))
+		throw Common::Exception(Common::kOpenError);
+
+	cacheFile.writeUint32BE(kIndexCacheID);
+	cacheFile.writeUint32BE(kVersion10);
+
+	cacheFile.writeUint32LE(writer.archiveCount);
+	cacheFile.writeUint32LE(archiveOffset);
+	cacheFile.writeUint32LE(writer.resourceCount);
+	cacheFile.writeUint32LE(resourceOffset);
+	cacheFile.writeUint32LE(writer.strings.size());
+	cacheFile.writeUint32LE(stringsOffset);
+
+	cacheFile.write(writer.archives.getData() , writer.archives.size());
+	cacheFile.write(writer.resources.getData(), writer.resources.size());
+	cacheFile.write(writer.strings.getData()  , writer.strings.size());
+
+	cacheFile.flush();
+	cacheFile.close();
+
+	_dirty = false;
+}
+
+} // End of namespace Aurora
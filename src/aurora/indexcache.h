@@ -0,0 +1,157 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A persistent on-disk cache of archive resource indices.
+ */
+
+#ifndef AURORA_INDEXCACHE_H
+#define AURORA_INDEXCACHE_H
+
+#include <vector>
+#include <map>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/hash.h"
+
+#include "src/aurora/types.h"
+#include "src/aurora/archive.h"
+
+namespace Common {
+	class SeekableReadStream;
+}
+
+namespace Aurora {
+
+/** A persistent cache of archive resource indices.
+ *
+ *  Indexing all the archives of a game (the KEYs with all their BIFs, all
+ *  ERFs, RIMs, HAKs, ...) takes a considerable amount of time, because every
+ *  single archive has to be opened and parsed. This cache stores the resource
+ *  lists of all indexed archive files, keyed on the archive's path, and
+ *  validated against the archive's size and modification time. This way, the
+ *  ResourceManager can add an unchanged archive's resources without touching
+ *  the archive itself at all.
+ *
+ *  The cache file is a flat, versioned structure of fixed-size records with
+ *  an accompanying string pool, laid out so that it can be read in one go and
+ *  then only decoded on demand:
+ *
+ *  - Header: ID, version, archive count, archive table offset, resource
+ *            count, resource table offset, string pool size and offset.
+ *  - Archive table: path (string pool offset), parent (index of the KEY
+ *                   this is a BIF of, or 0xFFFFFFFF), name hashing algorithm,
+ *                   file size, modification time, first resource, resource
+ *                   count.
+ *  - Resource table: hash, name (string pool offset), type, index.
+ *  - String pool: NUL-terminated UTF-8 strings.
+ */
+class IndexCache {
+public:
+	/** An archive file found in the cache. */
+	struct ArchiveFile {
+		Common::UString path; ///< The archive's path.
+
+		uint64 size; ///< The archive's size, in bytes.
+		uint64 time; ///< The archive's modification time.
+
+		Archive::ResourceList resources; ///< The resources found in the archive.
+
+		ArchiveFile();
+		ArchiveFile(const Common::UString &p);
+
+		/** Does the archive file on disk still match the cached information? */
+		bool isValid() const;
+	};
+
+	/** An archive, as indexed by the ResourceManager. */
+	struct Entry {
+		ArchiveFile file; ///< The archive itself.
+
+		/** The hashing algorithm used for the resource names. */
+		Common::HashAlgo hashAlgo;
+
+		/** If the archive is a KEY, the BIFs it indexes. */
+		std::vector<ArchiveFile> bifs;
+
+		Entry();
+	};
+
+	IndexCache();
+	~IndexCache();
+
+	/** Clear the cache. */
+	void clear();
+
+	/** Load the cache from a file.
+	 *
+	 *  If the file does not exist or is not a valid cache file, the cache
+	 *  will be empty instead.
+	 */
+	bool load(const Common::UString &file);
+
+	/** Save the cache to a file. */
+	void save(const Common::UString &file);
+
+	/** Has the cache been changed since it was loaded or saved? */
+	bool isDirty() const;
+
+	/** Find the cached information of this archive file.
+	 *
+	 *  Only returns the information if the archive has not changed since it
+	 *  was put into the cache. The BIFs of a KEY are not validated here.
+	 */
+	bool find(const Common::UString &path, Entry &entry) const;
+
+	/** Add an archive's information to the cache, replacing any existing entry. */
+	void add(const Entry &entry);
+
+private:
+	typedef std::map<Common::UString, uint32> LoadedMap;
+	typedef std::map<Common::UString, Entry>  EntryMap;
+
+	/** The raw contents of the loaded cache file. */
+	Common::SeekableReadStream *_data;
+
+	uint32 _archiveCount;
+	uint32 _archiveOffset;
+	uint32 _resourceCount;
+	uint32 _resourceOffset;
+	uint32 _stringsSize;
+	uint32 _stringsOffset;
+
+	/** Archive paths found in the loaded cache file, and their index there. */
+	LoadedMap _loaded;
+	/** Archive information added since the cache was loaded. */
+	EntryMap _entries;
+
+	bool _dirty;
+
+	void readHeader();
+	void readEntry(uint32 index, Entry &entry) const;
+	void readArchiveFile(uint32 index, ArchiveFile &file, uint32 &parent, uint32 &hashAlgo) const;
+	Common::UString readString(uint32 offset) const;
+
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_INDEXCACHE_H
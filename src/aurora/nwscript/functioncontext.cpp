@@ -57,6 +57,19 @@ FunctionContext &FunctionContext::operator=(const FunctionContext &ctx) {
 	return *this;
 }
 
+void FunctionContext::reset(const FunctionContext &ctx) {
+	assert(_parameters.size() == ctx._parameters.size());
+
+	_caller          = ctx._caller;
+	_triggerer       = ctx._triggerer;
+	_return          = ctx._return;
+	_currentScript   = ctx._currentScript;
+	_paramsSpecified = ctx._paramsSpecified;
+
+	for (size_t i = 0; i < _parameters.size(); i++)
+		_parameters[i] = ctx._parameters[i];
+}
+
 const Common::UString &FunctionContext::getName() const {
 	return _name;
 }
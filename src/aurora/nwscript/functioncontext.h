@@ -46,6 +46,14 @@ public:
 
 	FunctionContext &operator=(const FunctionContext &ctx);
 
+	/** Reset the return value and parameters to those of the function's pristine context.
+	 *
+	 *  This reuses the storage of the existing values, so that a context can
+	 *  serve as a call frame for many calls of the same function without
+	 *  allocating memory every time.
+	 */
+	void reset(const FunctionContext &ctx);
+
 	const Common::UString &getName() const;
 
 	void setSignature(const Signature &signature);
@@ -24,6 +24,7 @@
 
 #include "src/common/util.h"
 #include "src/common/error.h"
+#include "src/common/timestamp.h"
 
 #include "src/aurora/nwscript/functionman.h"
 
@@ -34,7 +35,10 @@ namespace Aurora {
 namespace NWScript {
 
 FunctionManager::FunctionEntry::FunctionEntry(const Common::UString &name) :
-	empty(true), ctx(name) {
+	empty(true), id(0), ctx(name) {
+}
+
+FunctionManager::CallStats::CallStats() : calls(0), time(0) {
 }
 
 
@@ -47,6 +51,7 @@ FunctionManager::~FunctionManager() {
 void FunctionManager::clear() {
 	_functionMap.clear();
 	_functionArray.clear();
+	_callStats.clear();
 }
 
 void FunctionManager::registerFunction(const Common::UString &name, uint32 id,
@@ -68,6 +73,7 @@ void FunctionManager::registerFunction(const Common::UString &name, uint32 id,
 
 	FunctionEntry &f = result.first->second;
 
+	f.id   = id;
 	f.func = func;
 	f.ctx.setSignature(signature);
 	f.ctx.setDefaults(defaults);
@@ -75,6 +81,8 @@ void FunctionManager::registerFunction(const Common::UString &name, uint32 id,
 
 	if (_functionArray.size() <= id)
 		_functionArray.resize(id + 1);
+	if (_callStats.size() <= id)
+		_callStats.resize(id + 1);
 
 	_functionArray[id] = f;
 }
@@ -84,7 +92,7 @@ FunctionContext FunctionManager::createContext(const Common::UString &function)
 }
 
 void FunctionManager::call(const Common::UString &function, FunctionContext &ctx) const {
-	find(function).func(ctx);
+	call(find(function), ctx);
 }
 
 FunctionContext FunctionManager::createContext(uint32 function) const {
@@ -92,7 +100,43 @@ FunctionContext FunctionManager::createContext(uint32 function) const {
 }
 
 void FunctionManager::call(uint32 function, FunctionContext &ctx) const {
-	find(function).func(ctx);
+	call(find(function), ctx);
+}
+
+const FunctionContext &FunctionManager::getContext(uint32 function) const {
+	return find(function).ctx;
+}
+
+void FunctionManager::call(const FunctionEntry &function, FunctionContext &ctx) const {
+	const uint64 start = Common::getMicroTimestamp();
+
+	function.func(ctx);
+
+	CallStats &stats = _callStats[function.id];
+
+	stats.calls++;
+	stats.time += Common::getMicroTimestamp() - start;
+}
+
+void FunctionManager::getStats(std::vector<FunctionStats> &stats) const {
+	stats.clear();
+
+	for (size_t i = 0; i < _callStats.size(); i++) {
+		if (_callStats[i].calls == 0)
+			continue;
+
+		stats.push_back(FunctionStats());
+
+		stats.back().name  = _functionArray[i].ctx.getName();
+		stats.back().id    = i;
+		stats.back().calls = _callStats[i].calls;
+		stats.back().time  = _callStats[i].time;
+	}
+}
+
+void FunctionManager::clearStats() {
+	for (std::vector<CallStats>::iterator s = _callStats.begin(); s != _callStats.end(); ++s)
+		*s = CallStats();
 }
 
 const FunctionManager::FunctionEntry &FunctionManager::find(const Common::UString &function) const {
@@ -26,6 +26,7 @@
 #define AURORA_NWSCRIPT_FUNCTIONMAN_H
 
 #include <map>
+#include <vector>
 
 #include "src/common/ustring.h"
 #include "src/common/singleton.h"
@@ -56,24 +57,60 @@ public:
 	FunctionContext createContext(uint32 function) const;
 	void call(uint32 function, FunctionContext &ctx) const;
 
+	/** Return the pristine context of a function.
+	 *
+	 *  Used together with FunctionContext::reset() to reuse a call frame
+	 *  over several calls of the same function, instead of creating a new
+	 *  context with createContext() every time.
+	 */
+	const FunctionContext &getContext(uint32 function) const;
+
+	/** Statistics about the calls of one engine function. */
+	struct FunctionStats {
+		Common::UString name; ///< The name of the function.
+		uint32 id;            ///< The ID of the function.
+
+		uint64 calls; ///< The number of times the function was called.
+		uint64 time;  ///< The time spent in the function, including nested calls, in microseconds.
+	};
+
+	/** Return the statistics of all functions that were called at least once. */
+	void getStats(std::vector<FunctionStats> &stats) const;
+	/** Reset all function call statistics. */
+	void clearStats();
+
 private:
 	struct FunctionEntry {
 		bool empty;
 
+		uint32 id;
+
 		Function func;
 		FunctionContext ctx;
 
 		FunctionEntry(const Common::UString &name = "");
 	};
 
+	struct CallStats {
+		uint64 calls;
+		uint64 time;
+
+		CallStats();
+	};
+
 	typedef std::map<Common::UString, FunctionEntry> FunctionMap;
 	typedef std::vector<FunctionEntry> FunctionArray;
 
 	FunctionMap _functionMap;
 	FunctionArray _functionArray;
 
+	/** Call statistics, indexed by function ID. Only ever touched by the script thread. */
+	mutable std::vector<CallStats> _callStats;
+
 	const FunctionEntry &find(const Common::UString &function) const;
 	const FunctionEntry &find(uint32 function) const;
+
+	void call(const FunctionEntry &function, FunctionContext &ctx) const;
 };
 
 } // End of namespace NWScript
@@ -43,6 +43,7 @@
 #include "src/aurora/nwscript/ncsfile.h"
 #include "src/aurora/nwscript/object.h"
 #include "src/aurora/nwscript/functionman.h"
+#include "src/aurora/nwscript/scriptcache.h"
 
 using Common::kDebugScripts;
 
@@ -58,7 +59,16 @@ namespace Aurora {
 
 namespace NWScript {
 
+/** Number of stack slots to reserve up-front.
+ *
+ *  The slots are kept and reused across runs, so that pushing values
+ *  doesn't need to allocate memory for all but the largest scripts.
+ */
+static const size_t kStackReserve = 256;
+
 NCSStack::NCSStack() {
+	reserve(kStackReserve);
+
 	reset();
 }
 
@@ -146,6 +156,13 @@ void NCSStack::setRelBP(int32 pos, const Variable &obj) {
 	at(stackPos) = obj;
 }
 
+void NCSStack::discard(size_t count) {
+	if (count > (size_t)(_stackPtr + 1))
+		throw Common::Exception("NCSStack: Stack underflow");
+
+	_stackPtr -= count;
+}
+
 int32 NCSStack::getStackPtr() {
 	return (_stackPtr + 1) * -4;
 }
@@ -274,28 +291,71 @@ void NCSFile::setupOpcodes() {
 
 #undef OPCODE
 
-NCSFile::NCSFile(Common::SeekableReadStream *ncs) : _owner(0), _triggerer(0) {
-	_script = ncs;
+/** Marks a jump target that doesn't point to the start of an instruction. */
+static const size_t kInvalidTarget = (size_t) -1;
+
+NCSFile::Instruction::Instruction() : address(0), opcode(0), type(kInstTypeNone), proc(0),
+	target(kInvalidTarget) {
+
+	args[0] = args[1] = args[2] = 0;
+}
+
+struct NCSFile::Image {
+	Instructions instructions; ///< The decoded instructions.
+
+	uint32 size; ///< The size of the script bytecode.
+
+	Image() : size(0) { }
+};
+
+NCSFile::NCSFile(Common::SeekableReadStream *ncs) : _pc(0), _executed(0), _owner(0), _triggerer(0) {
+	setupOpcodes();
 
 	try {
-		load();
+		load(*ncs);
 	} catch (...) {
-		delete _script;
+		delete ncs;
+		throw;
 	}
+
+	delete ncs;
 }
 
-NCSFile::NCSFile(const Common::UString &ncs) : _name(ncs), _script(0),
+NCSFile::NCSFile(const Common::UString &ncs) : _name(ncs), _pc(0), _executed(0),
 	_owner(0), _triggerer(0) {
 
-	_script = ResMan.getResource(ncs, kFileTypeNCS);
-	if (!_script)
+	setupOpcodes();
+
+	// Only load the script if we don't have the current version decoded already
+
+	uint64 changeID = 0;
+	_image = ScriptCacheMan.find(ncs, changeID);
+
+	if (_image) {
+		_id      = kNCSTag;
+		_version = kVersion10;
+
+		reset();
+		return;
+	}
+
+	Common::SeekableReadStream *script = ResMan.getResource(ncs, kFileTypeNCS);
+	if (!script)
 		throw Common::Exception("No such NCS \"%s\"", ncs.c_str());
 
-	load();
+	try {
+		load(*script);
+	} catch (...) {
+		delete script;
+		throw;
+	}
+
+	delete script;
+
+	ScriptCacheMan.add(ncs, changeID, _image);
 }
 
 NCSFile::~NCSFile() {
-	delete _script;
 }
 
 const Common::UString &NCSFile::getName() const {
@@ -318,8 +378,16 @@ ScriptState NCSFile::getEmptyState() {
 	return state;
 }
 
-void NCSFile::load() {
-	readHeader(*_script);
+size_t NCSFile::getInstructionCount() const {
+	return _image->instructions.size();
+}
+
+uint64 NCSFile::getExecutedCount() const {
+	return _executed;
+}
+
+void NCSFile::load(Common::SeekableReadStream &ncs) {
+	readHeader(ncs);
 
 	if (_id != kNCSTag)
 		throw Common::Exception("Try to load non-NCS file");
@@ -327,21 +395,188 @@ void NCSFile::load() {
 	if (_version != kVersion10)
 		throw Common::Exception("Unsupported NCS file version %08X", _version);
 
-	byte lengthOpcode = _script->readByte();
+	byte lengthOpcode = ncs.readByte();
 	if (lengthOpcode != 0x42)
 		throw Common::Exception("Script size opcode != 0x42 (0x%02X)", lengthOpcode);
 
-	uint32 length = _script->readUint32BE();
-	if (length > ((uint32) _script->size()))
-		throw Common::Exception("Script size %u > stream size %u", length, (uint)_script->size());
-	if (length < ((uint32) _script->size()))
-		warning("TODO: NCSFile::load(): Script size %u < stream size %u", length, (uint)_script->size());
+	uint32 length = ncs.readUint32BE();
+	if (length > ((uint32) ncs.size()))
+		throw Common::Exception("Script size %u > stream size %u", length, (uint)ncs.size());
+	if (length < ((uint32) ncs.size()))
+		warning("TODO: NCSFile::load(): Script size %u < stream size %u", length, (uint)ncs.size());
 
-	setupOpcodes();
+	boost::shared_ptr<Image> image(new Image);
+
+	decode(ncs, *image);
+	resolveTargets(*image);
+
+	_image = image;
 
 	reset();
 }
 
+void NCSFile::decode(Common::SeekableReadStream &ncs, Image &image) const {
+	/* Decode all instructions in one go, so that running the script doesn't
+	 * need to touch the bytecode at all. The script execution then only
+	 * moves an index through this list of instructions. */
+
+	image.size = ncs.size();
+
+	image.instructions.clear();
+	image.instructions.reserve((image.size - ncs.pos()) / 4);
+
+	// The script ends where no further opcode and type can be read
+	while ((image.size - ncs.pos()) >= 2) {
+		image.instructions.push_back(Instruction());
+		Instruction &instr = image.instructions.back();
+
+		instr.address = ncs.pos();
+		instr.opcode  = ncs.readByte();
+		instr.type    = (InstructionType) ncs.readByte();
+
+		/* Illegal and truncated instructions only throw when they are executed.
+		 * We don't know how long they are, so we can't decode any further. */
+
+		if ((instr.opcode >= _opcodeListSize) || (!_opcodes[instr.opcode].proc)) {
+			instr.proc = &NCSFile::o_invalid;
+			break;
+		}
+
+		instr.proc = _opcodes[instr.opcode].proc;
+
+		bool knownLength = false;
+		try {
+			knownLength = decodeArguments(ncs, instr);
+		} catch (...) {
+			instr.proc = &NCSFile::o_invalid;
+			break;
+		}
+
+		if (!knownLength)
+			break;
+	}
+}
+
+bool NCSFile::decodeArguments(Common::SeekableReadStream &ncs, Instruction &instr) {
+	switch (instr.opcode) {
+		case 0x01: // CPDOWNSP
+		case 0x03: // CPTOPSP
+		case 0x26: // CPDOWNBP
+		case 0x27: // CPTOPBP
+		case 0x30: // WRITEARRAY
+		case 0x32: // READARRAY
+		case 0x37: // GETREF
+		case 0x39: // GETREFARRAY
+			instr.args[0] = ncs.readSint32BE();
+			instr.args[1] = ncs.readSint16BE();
+			break;
+
+		case 0x04: // CONST
+			switch (instr.type) {
+				case kInstTypeInt:
+					instr.constant = Variable((int32) ncs.readSint32BE());
+					break;
+
+				case kInstTypeFloat:
+					instr.constant = Variable(ncs.readIEEEFloatBE());
+					break;
+
+				case kInstTypeString:
+				case kInstTypeResource:
+					instr.constant = Variable(Common::readStringFixed(ncs, Common::kEncodingASCII, ncs.readUint16BE()));
+					break;
+
+				case kInstTypeObject:
+					instr.args[0] = ncs.readUint32BE();
+					break;
+
+				default:
+					// A constant of an unknown type has an unknown length
+					return false;
+			}
+			break;
+
+		case 0x05: // ACTION
+			instr.args[0] = ncs.readUint16BE();
+			instr.args[1] = ncs.readByte();
+			break;
+
+		case 0x0B: // EQ
+		case 0x0C: // NEQ
+			// Comparisons between two structs (or two vectors) come with the size of the type
+			if (instr.type == kInstTypeStructStruct)
+				instr.args[0] = ncs.readUint16BE();
+			break;
+
+		case 0x1B: // MOVSP
+		case 0x1D: // JMP
+		case 0x1E: // JSR
+		case 0x1F: // JZ
+		case 0x23: // DECSP
+		case 0x24: // INCSP
+		case 0x25: // JNZ
+		case 0x28: // DECBP
+		case 0x29: // INCBP
+			instr.args[0] = ncs.readSint32BE();
+			break;
+
+		case 0x21: // DESTRUCT
+			instr.args[0] = ncs.readSint16BE();
+			instr.args[1] = ncs.readSint16BE();
+			instr.args[2] = ncs.readSint16BE();
+			break;
+
+		case 0x2C: // STORESTATE
+			instr.args[0] = ncs.readUint32BE();
+			instr.args[1] = ncs.readUint32BE();
+			break;
+
+		default:
+			break;
+	}
+
+	return true;
+}
+
+void NCSFile::resolveTargets(Image &image) {
+	for (Instructions::iterator instr = image.instructions.begin(); instr != image.instructions.end(); ++instr) {
+		switch (instr->opcode) {
+			case 0x1D: // JMP
+			case 0x1E: // JSR
+			case 0x1F: // JZ
+			case 0x25: // JNZ
+				// Jump offsets are relative to the start of the jump instruction
+				instr->target = findInstruction(image, instr->address + instr->args[0]);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+size_t NCSFile::findInstruction(const Image &image, uint32 address) {
+	const Instructions &instructions = image.instructions;
+
+	// Jumping right behind the last instruction ends the script
+	if (address == image.size)
+		return instructions.size();
+
+	size_t low = 0, high = instructions.size();
+	while (low < high) {
+		const size_t mid = low + (high - low) / 2;
+
+		if      (instructions[mid].address < address)
+			low  = mid + 1;
+		else if (instructions[mid].address > address)
+			high = mid;
+		else
+			return mid;
+	}
+
+	return kInvalidTarget;
+}
+
 void NCSFile::reset() {
 	_stack.reset();
 
@@ -351,7 +586,8 @@ void NCSFile::reset() {
 	_storedState.setType(kTypeVoid);
 	_return.setType(kTypeVoid);
 
-	_script->seek(13); // 8 byte header + 5 byte program size dummy op
+	_pc       = 0;
+	_executed = 0;
 }
 
 const Variable &NCSFile::run(Object *owner, Object *triggerer) {
@@ -364,7 +600,9 @@ const Variable &NCSFile::run(const ScriptState &state, Object *owner, Object *tr
 
 	reset();
 
-	_script->seek(state.offset);
+	_pc = findInstruction(*_image, state.offset);
+	if (_pc == kInvalidTarget)
+		throw Common::Exception("NCSFile::run(): Invalid script offset %u", (uint)state.offset);
 
 	// Push global variables
 	std::vector<class Variable>::const_reverse_iterator var;
@@ -384,8 +622,25 @@ const Variable &NCSFile::execute(Object *owner, Object *triggerer) {
 	_owner     = owner;
 	_triggerer = triggerer;
 
-	while (executeStep())
-		;
+	if (DebugMan.isEnabled(1, kDebugScripts)) {
+		// Step through the script, printing what's going on
+
+		while (executeStep())
+			;
+
+	} else {
+		// Dispatch straight through the pre-resolved opcode handlers
+
+		const Instructions &instructions = _image->instructions;
+
+		const size_t count = instructions.size();
+		while (_pc < count) {
+			const Instruction &instr = instructions[_pc++];
+			_executed++;
+
+			(this->*(instr.proc))(instr);
+		}
+	}
 
 	if (!_stack.empty())
 		_return = _stack.top();
@@ -401,47 +656,52 @@ const Variable &NCSFile::execute(Object *owner, Object *triggerer) {
 }
 
 bool NCSFile::executeStep() {
-	byte opcode, type;
-
-	try {
-		opcode = _script->readByte();
-		type   = _script->readByte();
-	} catch (...) {
+	if (_pc >= _image->instructions.size())
 		return false;
-	}
 
-	if ((opcode >= _opcodeListSize) || (!_opcodes[opcode].proc))
-		throw Common::Exception("NCSFile::executeStep(): Illegal instruction 0x%02x", opcode);
+	const Instruction &instr = _image->instructions[_pc++];
+	_executed++;
 
-	debugC(1, kDebugScripts, "NWScript opcode %s [0x%02X]", _opcodes[opcode].desc, opcode);
+	const char *desc = (instr.proc != &NCSFile::o_invalid) ? _opcodes[instr.opcode].desc : "";
+	debugC(1, kDebugScripts, "NWScript opcode %s [0x%02X]", desc, instr.opcode);
 
-	try {
-		(this->*(_opcodes[opcode].proc))((InstructionType)type);
-	} catch (Common::Exception &UNUSED(e)) {
-		throw;
-	}
+	(this->*(instr.proc))(instr);
 
 	_stack.print();
 	debugC(2, kDebugScripts, "[RETURN: %d]",
-	       _returnOffsets.empty() ? -1 : _returnOffsets.top());
+	       _returnOffsets.empty() ? -1 : (int) _returnOffsets.top());
 
 	return true;
 }
 
-void NCSFile::decompile() {
-	uint32 oldScriptPos = _script->pos();
-	_script->seek(13); // 8 byte header + 5 byte program size dummy op
+void NCSFile::jump(const Instruction &instr) {
+	if (instr.target == kInvalidTarget)
+		throw Common::Exception("NCSFile::jump(): Invalid jump target %d at %u",
+		                        instr.args[0], (uint)instr.address);
 
-	// TODO
+	_pc = instr.target;
+}
+
+bool NCSFile::popEqual(size_t count) {
+	bool equal = true;
 
-	_script->seek(oldScriptPos);
+	for (size_t i = 0; (i < count) && equal; i++)
+		equal = _stack.getRelSP(-4 * (int32)(i + 1)) == _stack.getRelSP(-4 * (int32)(count + i + 1));
+
+	_stack.discard(2 * count);
+
+	return equal;
+}
+
+void NCSFile::decompile() {
+	// TODO
 }
 
 // OPCODES!
 
 /** RSADD: push an empty variable onto the stack. */
-void NCSFile::o_rsadd(InstructionType type) {
-	switch (type) {
+void NCSFile::o_rsadd(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
 			_stack.push(kTypeInt);
 			break;
@@ -477,26 +737,20 @@ void NCSFile::o_rsadd(InstructionType type) {
 			_stack.push(kTypeArray);
 			break;
 		default:
-			throw Common::Exception("NCSFile::o_rsadd(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_rsadd(): Illegal type %d", instr.type);
 	}
 }
 
 /** CONST: push a constant (predetermined value) variable onto the stack. */
-void NCSFile::o_const(InstructionType type) {
-	switch (type) {
+void NCSFile::o_const(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
-			_stack.push(_script->readSint32BE());
-			break;
-
 		case kInstTypeFloat:
-			_stack.push(_script->readIEEEFloatBE());
-			break;
-
 		case kInstTypeString:
-		case kInstTypeResource: {
-			_stack.push(Common::readStringFixed(*_script, Common::kEncodingASCII, _script->readUint16BE()));
+		case kInstTypeResource:
+			// Parsed when the script was loaded
+			_stack.push(instr.constant);
 			break;
-		}
 
 		case kInstTypeObject: {
 			/* The scripts only know of two constant objects:
@@ -507,7 +761,7 @@ void NCSFile::o_const(InstructionType type) {
 			 * magic values. They *should* all have the same effect, though.
 			 */
 
-			uint32 objectID = _script->readUint32BE();
+			uint32 objectID = instr.args[0];
 
 			if      (objectID == kScriptObjectSelf)
 				_stack.push(_owner);
@@ -524,10 +778,22 @@ void NCSFile::o_const(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_const(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_const(): Illegal type %d", instr.type);
 	}
 }
 
+FunctionContext &NCSFile::getCallFrame(uint32 function) {
+	const FunctionContext &pristine = FunctionMan.getContext(function);
+
+	CallFrames::iterator frame = _callFrames.find(function);
+	if (frame == _callFrames.end())
+		return _callFrames.insert(std::make_pair(function, pristine)).first->second;
+
+	frame->second.reset(pristine);
+
+	return frame->second;
+}
+
 /** Helper function for o_action(), doing the actual engine function calling. */
 void NCSFile::callEngine(Aurora::NWScript::FunctionContext &ctx,
                          uint32 function, uint8 argCount) {
@@ -557,7 +823,8 @@ void NCSFile::callEngine(Aurora::NWScript::FunctionContext &ctx,
 			case kTypeEngineType:
 			case kTypeReference:
 			case kTypeArray:
-				param = _stack.pop();
+				param = _stack.top();
+				_stack.discard(1);
 				break;
 
 			case kTypeVector: {
@@ -574,7 +841,10 @@ void NCSFile::callEngine(Aurora::NWScript::FunctionContext &ctx,
 			case kTypeScriptState:
 				// The script state, "action" type, isn't stored on the stack at all
 
-				param.getScriptState() = _storedState.getScriptState();
+				if (_storedState.getType() != kTypeScriptState)
+					throw Common::Exception("NCSFile::callEngine(): No stored script state");
+
+				param = _storedState;
 				_storedState.setType(kTypeVoid);
 				break;
 
@@ -625,14 +895,14 @@ void NCSFile::callEngine(Aurora::NWScript::FunctionContext &ctx,
 }
 
 /** ACTION: call a game-specific engine function. */
-void NCSFile::o_action(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_action(): Illegal type %d", type);
+void NCSFile::o_action(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_action(): Illegal type %d", instr.type);
 
-	uint16 routineNumber = _script->readUint16BE();
-	uint8  argCount      = _script->readByte();
+	uint16 routineNumber = instr.args[0];
+	uint8  argCount      = instr.args[1];
 
-	Aurora::NWScript::FunctionContext ctx = FunctionMan.createContext(routineNumber);
+	Aurora::NWScript::FunctionContext &ctx = getCallFrame(routineNumber);
 
 	try {
 		callEngine(ctx, routineNumber, argCount);
@@ -644,9 +914,9 @@ void NCSFile::o_action(InstructionType type) {
 }
 
 /** LOGAND: perform a logical boolean AND (&&). */
-void NCSFile::o_logand(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_logand(): Illegal type %d", type);
+void NCSFile::o_logand(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_logand(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -658,9 +928,9 @@ void NCSFile::o_logand(InstructionType type) {
 }
 
 /** LOGOR: perform a logical boolean OR (||). */
-void NCSFile::o_logor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_logor(): Illegal type %d", type);
+void NCSFile::o_logor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_logor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -672,9 +942,9 @@ void NCSFile::o_logor(InstructionType type) {
 }
 
 /** INCOR: perform a bit-wise inclusive OR (|). */
-void NCSFile::o_incor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_incor(): Illegal type %d", type);
+void NCSFile::o_incor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_incor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -686,9 +956,9 @@ void NCSFile::o_incor(InstructionType type) {
 }
 
 /** EXCOR: perform a bit-wise exclusive OR (^). */
-void NCSFile::o_excor(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_excor(): Illegal type %d", type);
+void NCSFile::o_excor(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_excor(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -700,9 +970,9 @@ void NCSFile::o_excor(InstructionType type) {
 }
 
 /** BOOLAND: perform a bit-wise AND (&). */
-void NCSFile::o_booland(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_booland(): Illegal type %d", type);
+void NCSFile::o_booland(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_booland(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -714,13 +984,13 @@ void NCSFile::o_booland(InstructionType type) {
 }
 
 /** EQ: compare the top-most stack elements for equality (==). */
-void NCSFile::o_eq(InstructionType type) {
+void NCSFile::o_eq(const Instruction &instr) {
 	size_t n = 1;
 
-	if (type == kInstTypeStructStruct) {
+	if (instr.type == kInstTypeStructStruct) {
 		// Comparisons between two structs (or two vectors) come with the size of the type
 
-		const size_t size = _script->readUint16BE();
+		const size_t size = instr.args[0];
 
 		if ((size % 4) != 0)
 			throw Common::Exception("NCSFile::o_eq(): size %% 4 != 0");
@@ -728,28 +998,17 @@ void NCSFile::o_eq(InstructionType type) {
 		n = size / 4;
 	}
 
-	std::vector<Variable> args1, args2;
-
-	args1.reserve(n);
-	args2.reserve(n);
-
-	for (size_t i = 0; i < n; i++)
-		args1.push_back(_stack.pop());
-
-	for (size_t i = 0; i < n; i++)
-		args2.push_back(_stack.pop());
-
-	_stack.push(args1 == args2);
+	_stack.push(popEqual(n));
 }
 
 /** NEQ: compare the top-most stack elements for inequality (!=). */
-void NCSFile::o_neq(InstructionType type) {
+void NCSFile::o_neq(const Instruction &instr) {
 	size_t n = 1;
 
-	if (type == kInstTypeStructStruct) {
+	if (instr.type == kInstTypeStructStruct) {
 		// Comparisons between two structs (or two vectors) come with the size of the type
 
-		const size_t size = _script->readUint16BE();
+		const size_t size = instr.args[0];
 
 		if ((size % 4) != 0)
 			throw Common::Exception("NCSFile::o_neq(): size %% 4 != 0");
@@ -757,23 +1016,12 @@ void NCSFile::o_neq(InstructionType type) {
 		n = size / 4;
 	}
 
-	std::vector<Variable> args1, args2;
-
-	args1.reserve(n);
-	args2.reserve(n);
-
-	for (size_t i = 0; i < n; i++)
-		args1.push_back(_stack.pop());
-
-	for (size_t i = 0; i < n; i++)
-		args2.push_back(_stack.pop());
-
-	_stack.push(args1 != args2);
+	_stack.push(!popEqual(n));
 }
 
 /** GEQ: compare the top-most stack elements, greater-or-equal (>=). */
-void NCSFile::o_geq(InstructionType type) {
-	switch (type) {
+void NCSFile::o_geq(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -795,13 +1043,13 @@ void NCSFile::o_geq(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_geq(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_geq(): Illegal type %d", instr.type);
 	}
 }
 
 /** GT: compare the top-most stack elements, greater (>). */
-void NCSFile::o_gt(InstructionType type) {
-	switch (type) {
+void NCSFile::o_gt(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -823,13 +1071,13 @@ void NCSFile::o_gt(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_gt(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_gt(): Illegal type %d", instr.type);
 	}
 }
 
 /** LT: compare the top-most stack elements, less (<). */
-void NCSFile::o_lt(InstructionType type) {
-	switch (type) {
+void NCSFile::o_lt(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -851,13 +1099,13 @@ void NCSFile::o_lt(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_lt(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_lt(): Illegal type %d", instr.type);
 	}
 }
 
 /** LEQ: compare the top-most stack elements, less-or-equal (<=). */
-void NCSFile::o_leq(InstructionType type) {
-	switch (type) {
+void NCSFile::o_leq(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt:
 			try {
 				int32 arg1 = _stack.pop().getInt();
@@ -879,14 +1127,14 @@ void NCSFile::o_leq(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_leq(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_leq(): Illegal type %d", instr.type);
 	}
 }
 
 /** SHLEFT: shift the top-most stack element to the left (<<). */
-void NCSFile::o_shleft(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_shleft(): Illegal type %d", type);
+void NCSFile::o_shleft(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_shleft(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -898,15 +1146,15 @@ void NCSFile::o_shleft(InstructionType type) {
 }
 
 /** SHRIGHT: signed-shift the top-most stack element to the right (>>>). */
-void NCSFile::o_shright(InstructionType type) {
+void NCSFile::o_shright(const Instruction &instr) {
 	/* According to Skywing's NWNScriptLib
 	 * (<https://github.com/SkywingvL/nwn2dev-public/blob/master/NWNScriptLib/NWScriptVM.cpp#L2233>):
 	 * "The operation implemented here is actually a complex sequence that, if
 	 *  the amount to be shifted is negative, involves both a front-loaded and
 	 *  end-loaded negate built on top of a signed shift." */
 
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_shright(): Illegal type %d", type);
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_shright(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -924,14 +1172,14 @@ void NCSFile::o_shright(InstructionType type) {
 }
 
 /** USHRIGHT: shift the top-most stack element to the right (>>). */
-void NCSFile::o_ushright(InstructionType type) {
+void NCSFile::o_ushright(const Instruction &instr) {
 	/* According to Skywing's NWNScriptLib
 	 * (<https://github.com/SkywingvL/nwn2dev-public/blob/master/NWNScriptLib/NWScriptVM.cpp#L2272>):
 	 * "While this operator may have originally been intended to implement
 	 *  an unsigned shift, it actually performs an arithmetic (signed) shift." */
 
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_ushright(): Illegal type %d", type);
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_ushright(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -943,9 +1191,9 @@ void NCSFile::o_ushright(InstructionType type) {
 }
 
 /** MOD: calculate the remainder (modulo) of an integer division (%). */
-void NCSFile::o_mod(InstructionType type) {
-	if (type != kInstTypeIntInt)
-		throw Common::Exception("NCSFile::o_mod(): Illegal type %d", type);
+void NCSFile::o_mod(const Instruction &instr) {
+	if (instr.type != kInstTypeIntInt)
+		throw Common::Exception("NCSFile::o_mod(): Illegal type %d", instr.type);
 
 	try {
 		int32 arg1 = _stack.pop().getInt();
@@ -963,8 +1211,8 @@ void NCSFile::o_mod(InstructionType type) {
 }
 
 /** NEQ: negate the top-most stack element (unary -). */
-void NCSFile::o_neg(InstructionType type) {
-	switch (type) {
+void NCSFile::o_neg(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeInt:
 			try {
 				_stack.push(-_stack.pop().getInt());
@@ -982,14 +1230,14 @@ void NCSFile::o_neg(InstructionType type) {
 			break;
 
 		default:
-			throw Common::Exception("NCSFile::o_neg(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_neg(): Illegal type %d", instr.type);
 	}
 }
 
 /** COMP: calculate the 1-complement of the top-most stack element (~). */
-void NCSFile::o_comp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_comp(): Illegal type %d", type);
+void NCSFile::o_comp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_comp(): Illegal type %d", instr.type);
 
 	try {
 		_stack.push(~_stack.pop().getInt());
@@ -999,88 +1247,83 @@ void NCSFile::o_comp(InstructionType type) {
 }
 
 /** MOVSP: pop elements off the stack. */
-void NCSFile::o_movsp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_movsp(): Illegal type %d", type);
+void NCSFile::o_movsp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_movsp(): Illegal type %d", instr.type);
 
-	_stack.setStackPtr(_stack.getStackPtr() - _script->readSint32BE());
+	_stack.setStackPtr(_stack.getStackPtr() - instr.args[0]);
 }
 
 /** JMP: jump directly to a different script offset. */
-void NCSFile::o_jmp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jmp(): Illegal type %d", type);
+void NCSFile::o_jmp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jmp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	_script->skip(offset - 6);
+	jump(instr);
 }
 
 /** JZ: jump conditionally if the top-most stack element is 0. */
-void NCSFile::o_jz(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jz(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jz(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jz(): Illegal type %d", instr.type);
 
 	if (!_stack.pop().getInt())
-		_script->skip(offset - 6);
+		jump(instr);
 }
 
 /** NOT: boolean-negate the top-most stack element (!). */
-void NCSFile::o_not(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_not(): Illegal type %d", type);
+void NCSFile::o_not(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_not(): Illegal type %d", instr.type);
 
 	_stack.push(!_stack.pop().getInt());
 }
 
 /** DECSP: decrement the value of a stack element (--). */
-void NCSFile::o_decsp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_decsp(): Illegal type %d", type);
+void NCSFile::o_decsp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_decsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelSP(offset, _stack.getRelSP(offset).getInt() - 1);
 }
 
 /** INCSP: increment the value of a stack element (++). */
-void NCSFile::o_incsp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_incsp(): Illegal type %d", type);
+void NCSFile::o_incsp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_incsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelSP(offset, _stack.getRelSP(offset).getInt() + 1);
 }
 
 /** JNZ: jump conditionally if the top-most stack element is not 0. */
-void NCSFile::o_jnz(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jnz(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jnz(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jnz(): Illegal type %d", instr.type);
 
 	if (_stack.pop().getInt())
-		_script->skip(offset - 6);
+		jump(instr);
 }
 
 /** DECBP: decrement the value of a base-pointer stack element (--). */
-void NCSFile::o_decbp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_decbp(): Illegal type %d", type);
+void NCSFile::o_decbp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_decbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelBP(offset, _stack.getRelBP(offset).getInt() - 1);
 }
 
 /** INCBP: increment the value of a base-pointer stack element (++). */
-void NCSFile::o_incbp(InstructionType type) {
-	if (type != kInstTypeInt)
-		throw Common::Exception("NCSFile::o_incbp(): Illegal type %d", type);
+void NCSFile::o_incbp(const Instruction &instr) {
+	if (instr.type != kInstTypeInt)
+		throw Common::Exception("NCSFile::o_incbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
+	int32 offset = instr.args[0];
 
 	_stack.setRelBP(offset, _stack.getRelBP(offset).getInt() + 1);
 }
@@ -1089,9 +1332,9 @@ void NCSFile::o_incbp(InstructionType type) {
  *
  *  Used to create an anchor point to access global variables.
  */
-void NCSFile::o_savebp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_savebp(): Illegal type %d", type);
+void NCSFile::o_savebp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_savebp(): Illegal type %d", instr.type);
 
 	_stack.push(_stack.getBasePtr());
 	_stack.setBasePtr(_stack.getStackPtr());
@@ -1101,25 +1344,34 @@ void NCSFile::o_savebp(InstructionType type) {
  *
  *  Destroy the global variables anchor point after use.
  */
-void NCSFile::o_restorebp(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_restorebp(): Illegal type %d", type);
+void NCSFile::o_restorebp(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_restorebp(): Illegal type %d", instr.type);
 
 	_stack.setBasePtr(_stack.pop().getInt());
 }
 
+/** Not an actual opcode: an instruction that couldn't be decoded. */
+void NCSFile::o_invalid(const Instruction &instr) {
+	if ((instr.opcode < _opcodeListSize) && _opcodes[instr.opcode].proc)
+		throw Common::Exception("NCSFile::o_invalid(): Truncated instruction 0x%02x at %u",
+		                        instr.opcode, (uint)instr.address);
+
+	throw Common::Exception("NCSFile::executeStep(): Illegal instruction 0x%02x", instr.opcode);
+}
+
 /** NOP: no operation. */
-void NCSFile::o_nop(InstructionType UNUSED(type)) {
+void NCSFile::o_nop(const Instruction &UNUSED(instr)) {
 	// Nothing! Yay!
 }
 
 /** CPDOWNSP: copy a value into an existing stack element. */
-void NCSFile::o_cpdownsp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal type %d", type);
+void NCSFile::o_cpdownsp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cpdownsp(): Illegal size %d", size);
@@ -1135,12 +1387,12 @@ void NCSFile::o_cpdownsp(InstructionType type) {
 }
 
 /** CPTOPSP: push a copy of a stack element on top of the stack. */
-void NCSFile::o_cptopsp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cptopsp(): Illegal type %d", type);
+void NCSFile::o_cptopsp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cptopsp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cptopsp(): Illegal size %d", size);
@@ -1153,8 +1405,8 @@ void NCSFile::o_cptopsp(InstructionType type) {
 }
 
 /** ADD: add the top-most stack elements (+). */
-void NCSFile::o_add(InstructionType type) {
-	switch (type) {
+void NCSFile::o_add(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1210,13 +1462,13 @@ void NCSFile::o_add(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_add(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_add(): Illegal type %d", instr.type);
 	}
 }
 
 /** SUB: subtract the top-most stack elements (-). */
-void NCSFile::o_sub(InstructionType type) {
-	switch (type) {
+void NCSFile::o_sub(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1264,13 +1516,13 @@ void NCSFile::o_sub(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_sub(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_sub(): Illegal type %d", instr.type);
 	}
 }
 
 /** MUL: multiply the top-most stack elements (*). */
-void NCSFile::o_mul(InstructionType type) {
-	switch (type) {
+void NCSFile::o_mul(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1328,13 +1580,13 @@ void NCSFile::o_mul(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_mul(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_mul(): Illegal type %d", instr.type);
 	}
 }
 
 /** DIV: divide the top-most stack elements (/). */
-void NCSFile::o_div(InstructionType type) {
-	switch (type) {
+void NCSFile::o_div(const Instruction &instr) {
+	switch (instr.type) {
 		case kInstTypeIntInt: {
 			Variable op2 = _stack.pop();
 			Variable op1 = _stack.pop();
@@ -1413,13 +1665,13 @@ void NCSFile::o_div(InstructionType type) {
 		}
 
 		default:
-			throw Common::Exception("NCSFile::o_div(): Illegal type %d", type);
+			throw Common::Exception("NCSFile::o_div(): Illegal type %d", instr.type);
 	}
 }
 
 /** STORESTATEALL: unused, obsolete opcode. Hopefully. */
-void NCSFile::o_storestateall(InstructionType type) {
-	uint8  offset = (uint8) type;
+void NCSFile::o_storestateall(const Instruction &instr) {
+	uint8  offset = (uint8) instr.type;
 
 	// TODO: NCSFile::o_storestateall(): See o_storestate.
 	//       Supposedly obsolete. Whether it's used anywhere remains to be seen.
@@ -1427,37 +1679,36 @@ void NCSFile::o_storestateall(InstructionType type) {
 }
 
 /** JSR: call a subroutine. */
-void NCSFile::o_jsr(InstructionType type) {
-	if (type != kInstTypeNone)
-		throw Common::Exception("NCSFile::o_jsr(): Illegal type %d", type);
-
-	int32 offset = _script->readSint32BE();
+void NCSFile::o_jsr(const Instruction &instr) {
+	if (instr.type != kInstTypeNone)
+		throw Common::Exception("NCSFile::o_jsr(): Illegal type %d", instr.type);
 
-	// Push the current script position
-	_returnOffsets.push(_script->pos());
+	// Push the index of the instruction after this one
+	_returnOffsets.push(_pc);
 
-	_script->skip(offset - 6);
+	jump(instr);
 }
 
 /** RETN: return from a subroutine call. */
-void NCSFile::o_retn(InstructionType UNUSED(type)) {
-	uint32 returnAddress = _script->size();
+void NCSFile::o_retn(const Instruction &UNUSED(instr)) {
+	// Returning from the outermost "subroutine" ends the script
+	size_t returnAddress = _image->instructions.size();
 	if (!_returnOffsets.empty()) {
 		returnAddress = _returnOffsets.top();
 		_returnOffsets.pop();
 	}
 
-	_script->seek(returnAddress);
+	_pc = returnAddress;
 }
 
 /** DESTRUCT: remove elements from the stack.
  *
  *  Used to isolate struct elements.
  */
-void NCSFile::o_destruct(InstructionType UNUSED(type)) {
-	int16 stackSize        = _script->readSint16BE();
-	int16 dontRemoveOffset = _script->readSint16BE();
-	int16 dontRemoveSize   = _script->readSint16BE();
+void NCSFile::o_destruct(const Instruction &instr) {
+	int16 stackSize        = instr.args[0];
+	int16 dontRemoveOffset = instr.args[1];
+	int16 dontRemoveSize   = instr.args[2];
 
 	if ((stackSize % 4) != 0)
 		throw Common::Exception("NCSFile::o_destruct(): Illegal stack size %d", stackSize);
@@ -1488,12 +1739,12 @@ void NCSFile::o_destruct(InstructionType UNUSED(type)) {
  *
  *  Used to write into a global variable.
  */
-void NCSFile::o_cpdownbp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal type %d", type);
+void NCSFile::o_cpdownbp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE() - 4;
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0] - 4;
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cpdownbp(): Illegal size %d", size);
@@ -1512,12 +1763,12 @@ void NCSFile::o_cpdownbp(InstructionType type) {
  *
  *  Used to read from a global variable.
  */
-void NCSFile::o_cptopbp(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_cptopbp(): Illegal type %d", type);
+void NCSFile::o_cptopbp(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_cptopbp(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE() - 4;
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0] - 4;
+	int16 size   = instr.args[1];
 
 	if ((size % 4) != 0)
 		throw Common::Exception("NCSFile::o_cptopbp(): Illegal size %d", size);
@@ -1535,10 +1786,10 @@ void NCSFile::o_cptopbp(InstructionType type) {
  *  Used to create the "action" variables when calling an engine function that
  *  assigns a function to an object, or delays a function, or similar.
  */
-void NCSFile::o_storestate(InstructionType type) {
-	uint8  offset = (uint8) type;
-	uint32 sizeBP = _script->readUint32BE();
-	uint32 sizeSP = _script->readUint32BE();
+void NCSFile::o_storestate(const Instruction &instr) {
+	uint8  offset = (uint8) instr.type;
+	uint32 sizeBP = instr.args[0];
+	uint32 sizeSP = instr.args[1];
 
 	if ((sizeBP % 4) != 0)
 		throw Common::Exception("NCSFile::o_storestate(): Illegal BP size %d", sizeBP);
@@ -1548,7 +1799,7 @@ void NCSFile::o_storestate(InstructionType type) {
 	_storedState.setType(kTypeScriptState);
 	ScriptState &state = _storedState.getScriptState();
 
-	state.offset = _script->pos() - 10 + offset;
+	state.offset = instr.address + offset;
 
 	sizeBP /= 4;
 	sizeSP /= 4;
@@ -1571,12 +1822,12 @@ void NCSFile::o_storestate(InstructionType type) {
  *
  *  The index is popped off the stack, but the value written remains.
  */
-void NCSFile::o_writearray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_writearray(): Illegal type %d", type);
+void NCSFile::o_writearray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_writearray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_writearray(): Invalid size %d", size);
@@ -1606,12 +1857,12 @@ void NCSFile::o_writearray(InstructionType type) {
  *  The index is popped off the stack, and the value read out of the
  *  array is pushed on top.
  */
-void NCSFile::o_readarray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_readarray(): Illegal type %d", type);
+void NCSFile::o_readarray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_readarray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_readarray(): Invalid size %d", size);
@@ -1638,12 +1889,12 @@ void NCSFile::o_readarray(InstructionType type) {
  *  The offset to the variable to create a reference to is passed
  *  as a direct argument to the instruction.
  */
-void NCSFile::o_getref(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_getref(): Illegal type %d", type);
+void NCSFile::o_getref(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_getref(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_getref(): Invalid size %d", size);
@@ -1669,12 +1920,12 @@ void NCSFile::o_getref(InstructionType type) {
  *  The index is popped off the stack, and the reference to the
  *  variable inside the array is pushed on top.
  */
-void NCSFile::o_getrefarray(InstructionType type) {
-	if (type != kInstTypeDirect)
-		throw Common::Exception("NCSFile::o_getrefarray(): Illegal type %d", type);
+void NCSFile::o_getrefarray(const Instruction &instr) {
+	if (instr.type != kInstTypeDirect)
+		throw Common::Exception("NCSFile::o_getrefarray(): Illegal type %d", instr.type);
 
-	int32 offset = _script->readSint32BE();
-	int16 size   = _script->readSint16BE();
+	int32 offset = instr.args[0];
+	int16 size   = instr.args[1];
 
 	if (size != 4)
 		throw Common::Exception("NCSFile::o_getrefarray(): Invalid size %d", size);
@@ -27,6 +27,9 @@
 
 #include <vector>
 #include <stack>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
 
 #include "src/common/types.h"
 
@@ -36,6 +39,7 @@
 #include "src/aurora/nwscript/types.h"
 #include "src/aurora/nwscript/variable.h"
 #include "src/aurora/nwscript/variablecontainer.h"
+#include "src/aurora/nwscript/functioncontext.h"
 
 namespace Common {
 	class UString;
@@ -59,6 +63,9 @@ public:
 	Variable pop();
 	void push(const Variable &obj);
 
+	/** Remove the top-most count values, without returning them. */
+	void discard(size_t count);
+
 	Variable &getRelSP(int32 pos);
 	void setRelSP(int32 pos, const Variable &obj);
 
@@ -78,11 +85,20 @@ private:
 	int32 _basePtr;
 };
 
-#define DECLARE_OPCODE(x) void x(InstructionType type)
+#define DECLARE_OPCODE(x) void x(const Instruction &instr)
 
-/** An NCS, BioWare's NWN Compile Script. */
+/** An NCS, BioWare's NWN Compile Script.
+ *
+ *  The script's bytecode is decoded into an immutable image when loading. An
+ *  NCSFile itself is only the execution context running that image. Images
+ *  of scripts loaded by resref are shared through the ScriptCache, so that
+ *  creating an NCSFile for a script that ran before is cheap.
+ */
 class NCSFile : public AuroraFile {
 public:
+	/** The decoded, immutable image of a script. */
+	struct Image;
+
 	NCSFile(Common::SeekableReadStream *ncs);
 	NCSFile(const Common::UString &ncs);
 	~NCSFile();
@@ -108,6 +124,11 @@ public:
 
 	static ScriptState getEmptyState();
 
+	/** Return the number of instructions the script consists of. */
+	size_t getInstructionCount() const;
+	/** Return the number of instructions executed during the last run. */
+	uint64 getExecutedCount() const;
+
 private:
 	enum InstructionType {
 		// Unary
@@ -157,10 +178,49 @@ private:
 		kInstTypeFloatVector            = 60
 	};
 
+	struct Instruction;
+
+	typedef void (NCSFile::*OpcodeProc)(const Instruction &instr);
+	struct Opcode {
+		OpcodeProc proc;
+		const char *desc;
+	};
+
+	/** A script instruction, decoded from the bytecode when loading the script. */
+	struct Instruction {
+		uint32 address; ///< The offset of the instruction within the script.
+
+		uint8           opcode; ///< The instruction's opcode.
+		InstructionType type;   ///< The instruction's type.
+
+		/** The opcode handler, resolved when decoding. */
+		OpcodeProc proc;
+
+		/** The instruction's direct arguments, in the order they appear in the bytecode. */
+		int32 args[3];
+
+		/** For jumps and subroutine calls, the index of the instruction to jump to. */
+		size_t target;
+
+		/** For CONST, the pre-parsed constant (except for objects). */
+		Variable constant;
+
+		Instruction();
+	};
+
+	typedef std::vector<Instruction> Instructions;
+
 	Common::UString _name;
 
+	/** The decoded script. */
+	boost::shared_ptr<const Image> _image;
+
+	/** The index of the next instruction to execute. */
+	size_t _pc;
+	/** The number of instructions executed during the current run. */
+	uint64 _executed;
+
 	NCSStack _stack;
-	Common::SeekableReadStream *_script;
 
 	Variable _return;
 
@@ -169,20 +229,30 @@ private:
 
 	VariableContainer _env;
 
-	std::stack<uint32> _returnOffsets;
+	std::stack<size_t> _returnOffsets;
 
 	Variable _storedState;
 
-	typedef void (NCSFile::*OpcodeProc)(InstructionType type);
-	struct Opcode {
-		OpcodeProc proc;
-		const char *desc;
-	};
+	typedef std::map<uint32, FunctionContext> CallFrames;
+
+	/** Contexts of the engine functions called so far, reused for every further call. */
+	CallFrames _callFrames;
+
 	const Opcode *_opcodes;
 	size_t _opcodeListSize;
 	void setupOpcodes();
 
-	void load();
+	void load(Common::SeekableReadStream &ncs);
+
+	/** Decode the whole script bytecode into a list of instructions. */
+	void decode(Common::SeekableReadStream &ncs, Image &image) const;
+	/** Decode the direct arguments of one instruction. Return false if its length is unknown. */
+	static bool decodeArguments(Common::SeekableReadStream &ncs, Instruction &instr);
+	/** Resolve the jump targets of all instructions into instruction indices. */
+	static void resolveTargets(Image &image);
+
+	/** Find the index of the instruction at this script offset. */
+	static size_t findInstruction(const Image &image, uint32 address);
 
 	/** Reset the script for another execution. */
 	void reset();
@@ -192,11 +262,21 @@ private:
 	/** Execute one script step. */
 	bool executeStep();
 
+	/** Jump to the target instruction of a jump instruction. */
+	void jump(const Instruction &instr);
+
+	/** Pop two sequences of count values off the stack and compare them. */
+	bool popEqual(size_t count);
+
 	void decompile(); // TODO
 
+	/** Return the call frame for an engine function, reset to the function's pristine context. */
+	FunctionContext &getCallFrame(uint32 function);
+
 	void callEngine(Aurora::NWScript::FunctionContext &ctx, uint32 function, uint8 argCount);
 
 	// Opcode declarations
+	DECLARE_OPCODE(o_invalid);
 	DECLARE_OPCODE(o_nop);
 	DECLARE_OPCODE(o_cpdownsp);
 	DECLARE_OPCODE(o_rsadd);
@@ -0,0 +1,120 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of decoded NWScript script images.
+ */
+
+#include "src/aurora/resman.h"
+
+#include "src/aurora/nwscript/scriptcache.h"
+
+DECLARE_SINGLETON(Aurora::NWScript::ScriptCache)
+
+namespace Aurora {
+
+namespace NWScript {
+
+ScriptCache::Stats::Stats() : hits(0), misses(0), invalidations(0), entries(0) {
+}
+
+
+ScriptCache::ScriptCache() : _removals(0) {
+}
+
+ScriptCache::~ScriptCache() {
+}
+
+void ScriptCache::clear() {
+	Common::StackLock lock(_mutex);
+
+	_entries.clear();
+
+	_stats = Stats();
+}
+
+boost::shared_ptr<const NCSFile::Image> ScriptCache::find(const Common::UString &name, uint64 &changeID) {
+	changeID = ResMan.getResourceChangeID(name, kFileTypeNCS);
+
+	Common::StackLock lock(_mutex);
+
+	dropRemoved();
+
+	if (changeID == 0)
+		return boost::shared_ptr<const NCSFile::Image>();
+
+	EntryMap::const_iterator e = _entries.find(name);
+	if ((e == _entries.end()) || (e->second.changeID != changeID)) {
+		_stats.misses++;
+
+		return boost::shared_ptr<const NCSFile::Image>();
+	}
+
+	_stats.hits++;
+
+	return e->second.image;
+}
+
+void ScriptCache::add(const Common::UString &name, uint64 changeID,
+                      const boost::shared_ptr<const NCSFile::Image> &image) {
+
+	if ((changeID == 0) || !image)
+		return;
+
+	Common::StackLock lock(_mutex);
+
+	std::pair<EntryMap::iterator, bool> e = _entries.insert(std::make_pair(name, Entry()));
+	if (!e.second && (e.first->second.changeID != changeID))
+		_stats.invalidations++;
+
+	e.first->second.changeID = changeID;
+	e.first->second.image    = image;
+
+	_stats.entries = _entries.size();
+}
+
+ScriptCache::Stats ScriptCache::getStats() const {
+	Common::StackLock lock(_mutex);
+
+	return _stats;
+}
+
+void ScriptCache::dropRemoved() {
+	const uint32 removals = ResMan.getRemovalCount();
+	if (removals == _removals)
+		return;
+
+	_removals = removals;
+
+	for (EntryMap::iterator e = _entries.begin(); e != _entries.end(); ) {
+		if (ResMan.getResourceChangeID(e->first, kFileTypeNCS) != e->second.changeID) {
+			_entries.erase(e++);
+
+			_stats.invalidations++;
+		} else
+			++e;
+	}
+
+	_stats.entries = _entries.size();
+}
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
@@ -0,0 +1,113 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A cache of decoded NWScript script images.
+ */
+
+#ifndef AURORA_NWSCRIPT_SCRIPTCACHE_H
+#define AURORA_NWSCRIPT_SCRIPTCACHE_H
+
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/ustring.h"
+#include "src/common/singleton.h"
+#include "src/common/mutex.h"
+
+#include "src/aurora/nwscript/ncsfile.h"
+
+namespace Aurora {
+
+namespace NWScript {
+
+/** A cache of decoded script images, shared between all NCSFile instances.
+ *
+ *  Scripts are identified by their resref and the change ID of the resource
+ *  they were loaded from (see ResourceManager::getResourceChangeID()). A cached
+ *  image is only handed out while the same resource still provides the script,
+ *  and images of scripts whose resources were removed are dropped.
+ */
+class ScriptCache : public Common::Singleton<ScriptCache> {
+public:
+	/** Statistics about the script cache. */
+	struct Stats {
+		uint64 hits;          ///< Number of script images found in the cache.
+		uint64 misses;        ///< Number of scripts that had to be loaded.
+		uint64 invalidations; ///< Number of images dropped because their resource changed.
+
+		size_t entries; ///< Number of script images currently in the cache.
+
+		Stats();
+	};
+
+	ScriptCache();
+	~ScriptCache();
+
+	/** Drop all cached script images. */
+	void clear();
+
+	/** Look up the image of a script.
+	 *
+	 *  @param  name The resref of the script.
+	 *  @param  changeID The change ID of the resource currently providing the script
+	 *                   is stored here, or 0 if there's no such script.
+	 *  @return The cached image, or an empty pointer if the current version of the script isn't cached.
+	 */
+	boost::shared_ptr<const NCSFile::Image> find(const Common::UString &name, uint64 &changeID);
+
+	/** Add the image of a script, loaded from the resource with this change ID. */
+	void add(const Common::UString &name, uint64 changeID, const boost::shared_ptr<const NCSFile::Image> &image);
+
+	/** Return statistics about the script cache. */
+	Stats getStats() const;
+
+private:
+	struct Entry {
+		uint64 changeID; ///< The change ID of the resource the script was loaded from.
+
+		boost::shared_ptr<const NCSFile::Image> image; ///< The decoded script.
+	};
+
+	typedef std::map<Common::UString, Entry, Common::UString::iless> EntryMap;
+
+	EntryMap _entries;
+
+	/** The resource manager's removal count when the entries were last checked. */
+	uint32 _removals;
+
+	Stats _stats;
+
+	mutable Common::Mutex _mutex;
+
+	/** Drop the images of all scripts whose resources changed, if resources were removed. */
+	void dropRemoved();
+};
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
+
+/** Shortcut for accessing the script cache. */
+#define ScriptCacheMan Aurora::NWScript::ScriptCache::instance()
+
+#endif // AURORA_NWSCRIPT_SCRIPTCACHE_H
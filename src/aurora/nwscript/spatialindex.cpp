@@ -0,0 +1,401 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A spatial index over NWScript objects.
+ */
+
+#include <cmath>
+#include <cfloat>
+
+#include <algorithm>
+
+#include "src/common/util.h"
+
+#include "src/aurora/nwscript/spatialindex.h"
+#include "src/aurora/nwscript/object.h"
+
+/** Cell coordinates are clamped to this range, to keep ring distances from overflowing. */
+static const int32 kMaxCellCoordinate = 1 << 28;
+
+static bool isFinite(float x, float y, float z) {
+	// NaN fails every comparison
+	return (ABS(x) <= FLT_MAX) && (ABS(y) <= FLT_MAX) && (ABS(z) <= FLT_MAX);
+}
+
+namespace Aurora {
+
+namespace NWScript {
+
+const float SpatialIndex::kDefaultCellSize = 10.0f;
+
+bool SpatialIndex::Candidate::operator<(const Candidate &c) const {
+	if (distance != c.distance)
+		return distance < c.distance;
+
+	return id < c.id;
+}
+
+
+SpatialIndex::SpatialIndex(float cellSize) : _cellSize(MAX(cellSize, 0.1f)),
+	_minX(0), _maxX(-1), _minY(0), _maxY(-1), _boundsDirty(false) {
+
+}
+
+SpatialIndex::~SpatialIndex() {
+}
+
+void SpatialIndex::clear() {
+	_cells.clear();
+	_objects.clear();
+
+	_minX = 0;
+	_maxX = -1;
+	_minY = 0;
+	_maxY = -1;
+
+	_boundsDirty = false;
+}
+
+size_t SpatialIndex::size() const {
+	return _objects.size();
+}
+
+int32 SpatialIndex::getCellCoordinate(float c) const {
+	const float cell = floorf(c / _cellSize);
+
+	if (!(cell > -kMaxCellCoordinate))
+		return -kMaxCellCoordinate;
+	if (cell > kMaxCellCoordinate)
+		return kMaxCellCoordinate;
+
+	return (int32) cell;
+}
+
+uint64 SpatialIndex::getCellKey(int32 x, int32 y) {
+	return (((uint64) (uint32) x) << 32) | ((uint64) (uint32) y);
+}
+
+void SpatialIndex::getCellCoordinates(uint64 key, int32 &x, int32 &y) {
+	x = (int32) (uint32) (key >> 32);
+	y = (int32) (uint32) (key & 0xFFFFFFFF);
+}
+
+uint64 SpatialIndex::getObjectKey(const Object &object) {
+	return (uint64) reinterpret_cast<size_t>(&object);
+}
+
+void SpatialIndex::update(Object &object, uint32 type, float x, float y, float z) {
+	if (!isFinite(x, y, z)) {
+		remove(object);
+		return;
+	}
+
+	const int32 cellX = getCellCoordinate(x);
+	const int32 cellY = getCellCoordinate(y);
+
+	const uint64 objectKey = getObjectKey(object);
+	const uint64 cellKey   = getCellKey(cellX, cellY);
+
+	uint64 *oldCellKey = _objects.find(objectKey);
+	if (oldCellKey && (*oldCellKey == cellKey)) {
+		// Still in the same cell, just update the position
+
+		Cell *cell = _cells.find(cellKey);
+		for (Cell::iterator e = cell->begin(); e != cell->end(); ++e) {
+			if (e->object == &object) {
+				e->type = type;
+				e->x    = x;
+				e->y    = y;
+				e->z    = z;
+				break;
+			}
+		}
+
+		return;
+	}
+
+	if (oldCellKey)
+		remove(object);
+
+	Entry entry;
+
+	entry.object = &object;
+	entry.type   = type;
+	entry.x      = x;
+	entry.y      = y;
+	entry.z      = z;
+
+	_cells[cellKey].push_back(entry);
+	_objects[objectKey] = cellKey;
+
+	if (_boundsDirty)
+		return;
+
+	if (_minX > _maxX) {
+		_minX = _maxX = cellX;
+		_minY = _maxY = cellY;
+	} else {
+		_minX = MIN(_minX, cellX);
+		_maxX = MAX(_maxX, cellX);
+		_minY = MIN(_minY, cellY);
+		_maxY = MAX(_maxY, cellY);
+	}
+}
+
+void SpatialIndex::remove(Object &object) {
+	const uint64 objectKey = getObjectKey(object);
+
+	const uint64 *cellKey = _objects.find(objectKey);
+	if (!cellKey)
+		return;
+
+	Cell *cell = _cells.find(*cellKey);
+	if (cell) {
+		for (size_t i = 0; i < cell->size(); i++) {
+			if ((*cell)[i].object == &object) {
+				(*cell)[i] = cell->back();
+				cell->pop_back();
+				break;
+			}
+		}
+
+		if (cell->empty()) {
+			int32 x, y;
+			getCellCoordinates(*cellKey, x, y);
+
+			if ((x == _minX) || (x == _maxX) || (y == _minY) || (y == _maxY))
+				_boundsDirty = true;
+
+			_cells.erase(*cellKey);
+		}
+	}
+
+	_objects.erase(objectKey);
+}
+
+void SpatialIndex::updateBounds() const {
+	if (!_boundsDirty)
+		return;
+
+	_minX = 0;
+	_maxX = -1;
+	_minY = 0;
+	_maxY = -1;
+
+	for (Common::FlatHashMap<Cell>::const_iterator c = _cells.begin(); c != _cells.end(); ++c) {
+		int32 x, y;
+		getCellCoordinates(c.key(), x, y);
+
+		if (_minX > _maxX) {
+			_minX = _maxX = x;
+			_minY = _maxY = y;
+		} else {
+			_minX = MIN(_minX, x);
+			_maxX = MAX(_maxX, x);
+			_minY = MIN(_minY, y);
+			_maxY = MAX(_maxY, y);
+		}
+	}
+
+	_boundsDirty = false;
+}
+
+int32 SpatialIndex::getMaxRing(int32 x, int32 y) const {
+	updateBounds();
+
+	if (_minX > _maxX)
+		return -1;
+
+	return MAX(MAX(ABS(x - _minX), ABS(x - _maxX)), MAX(ABS(y - _minY), ABS(y - _maxY)));
+}
+
+void SpatialIndex::collectCell(const Cell &cell, float px, float py, float pz, float maxDistance,
+                               uint32 typeMask, const Filter *filter, Candidates &candidates,
+                               size_t count) const {
+
+	for (Cell::const_iterator e = cell.begin(); e != cell.end(); ++e) {
+		if (!(e->type & typeMask))
+			continue;
+
+		Candidate candidate;
+
+		candidate.distance = (e->x - px) * (e->x - px) + (e->y - py) * (e->y - py) + (e->z - pz) * (e->z - pz);
+		if (candidate.distance > maxDistance)
+			continue;
+
+		candidate.id     = e->object->getID();
+		candidate.object = e->object;
+
+		// Already enough candidates, all of them closer?
+		if ((candidates.size() >= count) && !(candidate < candidates.front()))
+			continue;
+
+		if (filter && !(*filter)(*e->object))
+			continue;
+
+		// Keep the candidates as a max-heap, so the farthest one can be replaced quickly
+
+		if (candidates.size() >= count) {
+			std::pop_heap(candidates.begin(), candidates.end());
+			candidates.back() = candidate;
+		} else
+			candidates.push_back(candidate);
+
+		std::push_heap(candidates.begin(), candidates.end());
+	}
+}
+
+size_t SpatialIndex::collectRing(int32 x, int32 y, int32 ring, float px, float py, float pz, float maxDistance,
+                                 uint32 typeMask, const Filter *filter, Candidates &candidates,
+                                 size_t count) const {
+
+	size_t visited = 0;
+
+	// Top and bottom row of the ring, clipped to the bounds
+	const int32 minRowX = MAX(x - ring, _minX);
+	const int32 maxRowX = MIN(x + ring, _maxX);
+
+	const int32 rows[2] = { y - ring, y + ring };
+	for (int32 r = 0; r < ((ring == 0) ? 1 : 2); r++) {
+		if ((rows[r] < _minY) || (rows[r] > _maxY))
+			continue;
+
+		for (int32 i = minRowX; i <= maxRowX; i++, visited++) {
+			const Cell *cell = _cells.find(getCellKey(i, rows[r]));
+			if (cell)
+				collectCell(*cell, px, py, pz, maxDistance, typeMask, filter, candidates, count);
+		}
+	}
+
+	if (ring == 0)
+		return visited;
+
+	// Left and right column, without the corners, clipped to the bounds
+	const int32 minColumnY = MAX(y - ring + 1, _minY);
+	const int32 maxColumnY = MIN(y + ring - 1, _maxY);
+
+	const int32 columns[2] = { x - ring, x + ring };
+	for (int32 c = 0; c < 2; c++) {
+		if ((columns[c] < _minX) || (columns[c] > _maxX))
+			continue;
+
+		for (int32 i = minColumnY; i <= maxColumnY; i++, visited++) {
+			const Cell *cell = _cells.find(getCellKey(columns[c], i));
+			if (cell)
+				collectCell(*cell, px, py, pz, maxDistance, typeMask, filter, candidates, count);
+		}
+	}
+
+	return visited;
+}
+
+void SpatialIndex::collectRings(int32 x, int32 y, int32 minRing, int32 maxRing, float px, float py, float pz,
+                                float maxDistance, uint32 typeMask, const Filter *filter,
+                                Candidates &candidates, size_t count) const {
+
+	for (Common::FlatHashMap<Cell>::const_iterator c = _cells.begin(); c != _cells.end(); ++c) {
+		int32 cellX, cellY;
+		getCellCoordinates(c.key(), cellX, cellY);
+
+		const int32 ring = MAX(ABS(cellX - x), ABS(cellY - y));
+		if ((ring >= minRing) && (ring <= maxRing))
+			collectCell(c.value(), px, py, pz, maxDistance, typeMask, filter, candidates, count);
+	}
+}
+
+void SpatialIndex::sortCandidates(Candidates &candidates, std::vector<Object *> &objects) {
+	std::sort_heap(candidates.begin(), candidates.end());
+
+	objects.reserve(candidates.size());
+	for (Candidates::const_iterator c = candidates.begin(); c != candidates.end(); ++c)
+		objects.push_back(c->object);
+}
+
+void SpatialIndex::findNearest(float x, float y, float z, size_t count, uint32 typeMask,
+                               std::vector<Object *> &objects, const Filter *filter) const {
+
+	objects.clear();
+	if ((count == 0) || !isFinite(x, y, z))
+		return;
+
+	const int32 cellX = getCellCoordinate(x);
+	const int32 cellY = getCellCoordinate(y);
+
+	const int32 maxRing = getMaxRing(cellX, cellY);
+
+	Candidates candidates;
+	size_t visited = 0;
+	for (int32 ring = 0; ring <= maxRing; ring++) {
+		/* With few objects spread far apart, we'd look at a lot of empty cells.
+		 * Once that costs more than looking at every cell, just do that. */
+		if (visited > _cells.size()) {
+			collectRings(cellX, cellY, ring, maxRing, x, y, z, FLT_MAX, typeMask, filter, candidates, count);
+			break;
+		}
+
+		visited += collectRing(cellX, cellY, ring, x, y, z, FLT_MAX, typeMask, filter, candidates, count);
+
+		// All objects in the rings further out are at least this far away
+		const float minDistance = ring * _cellSize;
+
+		if ((candidates.size() >= count) && (candidates.front().distance <= (minDistance * minDistance)))
+			break;
+	}
+
+	sortCandidates(candidates, objects);
+}
+
+void SpatialIndex::findInRadius(float x, float y, float z, float radius, uint32 typeMask,
+                                std::vector<Object *> &objects, const Filter *filter) const {
+
+	objects.clear();
+	if (!(radius >= 0.0f) || !isFinite(x, y, z))
+		return;
+
+	const int32 cellX = getCellCoordinate(x);
+	const int32 cellY = getCellCoordinate(y);
+
+	const float maxRadiusRing = ceilf(radius / _cellSize);
+
+	int32 maxRing = getMaxRing(cellX, cellY);
+	if (maxRadiusRing < maxRing)
+		maxRing = (int32) maxRadiusRing;
+
+	Candidates candidates;
+	size_t visited = 0;
+	for (int32 ring = 0; ring <= maxRing; ring++) {
+		// Like in findNearest(), don't look at more empty cells than there are cells
+		if (visited > _cells.size()) {
+			collectRings(cellX, cellY, ring, maxRing, x, y, z, radius * radius,
+			             typeMask, filter, candidates, SIZE_MAX);
+			break;
+		}
+
+		visited += collectRing(cellX, cellY, ring, x, y, z, radius * radius,
+		                       typeMask, filter, candidates, SIZE_MAX);
+	}
+
+	sortCandidates(candidates, objects);
+}
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
@@ -0,0 +1,165 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A spatial index over NWScript objects.
+ */
+
+#ifndef AURORA_NWSCRIPT_SPATIALINDEX_H
+#define AURORA_NWSCRIPT_SPATIALINDEX_H
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/flathashmap.h"
+
+namespace Aurora {
+
+namespace NWScript {
+
+class Object;
+
+/** A spatial index over the objects within one area.
+ *
+ *  The objects are sorted into a uniform grid of square cells on the x/y
+ *  plane. Nearest-object and radius queries only look at the cells around
+ *  the queried position, spiraling outwards until no closer object can
+ *  be found, instead of looking at every object in the area.
+ *
+ *  Together with its position, every object is stored with a bitfield of
+ *  its type, which queries can filter on directly.
+ *
+ *  Distances are the straight 3D distances between the positions. Objects
+ *  at a position that's not finite are not indexed, and queries around such
+ *  a position don't find anything.
+ */
+class SpatialIndex {
+public:
+	/** Default length of a grid cell's side. */
+	static const float kDefaultCellSize;
+
+	/** An additional filter on the results of a query. */
+	class Filter {
+	public:
+		virtual ~Filter() { }
+
+		/** Should this object be included in the results? */
+		virtual bool operator()(Object &object) const = 0;
+	};
+
+	SpatialIndex(float cellSize = kDefaultCellSize);
+	~SpatialIndex();
+
+	/** Remove all objects from the index. */
+	void clear();
+
+	/** Return the number of objects in the index. */
+	size_t size() const;
+
+	/** Add an object at this position, or move it there if it's already in the index. */
+	void update(Object &object, uint32 type, float x, float y, float z);
+	/** Remove an object from the index. */
+	void remove(Object &object);
+
+	/** Find the count objects nearest to a position, ordered by distance.
+	 *
+	 *  Only objects whose type has a bit in common with the typeMask, and
+	 *  that pass the optional filter, are considered.
+	 */
+	void findNearest(float x, float y, float z, size_t count, uint32 typeMask,
+	                 std::vector<Object *> &objects, const Filter *filter = 0) const;
+
+	/** Find all objects within a radius around a position, ordered by distance.
+	 *
+	 *  Only objects whose type has a bit in common with the typeMask, and
+	 *  that pass the optional filter, are considered.
+	 */
+	void findInRadius(float x, float y, float z, float radius, uint32 typeMask,
+	                  std::vector<Object *> &objects, const Filter *filter = 0) const;
+
+private:
+	struct Entry {
+		Object *object;
+		uint32 type;
+
+		float x, y, z;
+	};
+
+	typedef std::vector<Entry> Cell;
+
+	/** An object found by a query, with the squared distance to the queried position. */
+	struct Candidate {
+		float distance;
+		uint32 id;
+
+		Object *object;
+
+		bool operator<(const Candidate &c) const;
+	};
+
+	typedef std::vector<Candidate> Candidates;
+
+	float _cellSize;
+
+	Common::FlatHashMap<Cell>   _cells;   ///< All non-empty cells, by cell key.
+	Common::FlatHashMap<uint64> _objects; ///< The cell key of every object, by object pointer.
+
+	/** The bounds of all cells containing objects. */
+	mutable int32 _minX, _maxX, _minY, _maxY;
+	/** Have cells at the bounds been emptied since the bounds were calculated? */
+	mutable bool _boundsDirty;
+
+	int32 getCellCoordinate(float c) const;
+
+	static uint64 getCellKey(int32 x, int32 y);
+	static void getCellCoordinates(uint64 key, int32 &x, int32 &y);
+	static uint64 getObjectKey(const Object &object);
+
+	/** Recalculate the bounds of all cells containing objects, if necessary. */
+	void updateBounds() const;
+
+	/** Return the number of rings around this cell needed to cover all cells. */
+	int32 getMaxRing(int32 x, int32 y) const;
+
+	/** Collect the candidates out of one cell. */
+	void collectCell(const Cell &cell, float px, float py, float pz, float maxDistance,
+	                 uint32 typeMask, const Filter *filter, Candidates &candidates,
+	                 size_t count) const;
+	/** Collect the candidates out of the ring of cells at this distance around a cell.
+	 *
+	 *  Only the part of the ring within the bounds is looked at.
+	 *  Returns the number of cells looked at.
+	 */
+	size_t collectRing(int32 x, int32 y, int32 ring, float px, float py, float pz, float maxDistance,
+	                   uint32 typeMask, const Filter *filter, Candidates &candidates,
+	                   size_t count) const;
+	/** Collect the candidates out of all cells from this ring up to the maximum ring around a cell. */
+	void collectRings(int32 x, int32 y, int32 minRing, int32 maxRing, float px, float py, float pz,
+	                  float maxDistance, uint32 typeMask, const Filter *filter, Candidates &candidates,
+	                  size_t count) const;
+
+	static void sortCandidates(Candidates &candidates, std::vector<Object *> &objects);
+};
+
+} // End of namespace NWScript
+
+} // End of namespace Aurora
+
+#endif // AURORA_NWSCRIPT_SPATIALINDEX_H
@@ -22,6 +22,8 @@
  *  NWScript variable.
  */
 
+#include <new>
+
 #include <boost/make_shared.hpp>
 
 #include "src/common/error.h"
@@ -85,28 +87,19 @@ Variable::Variable(const Variable &var) : _type(kTypeVoid) {
 }
 
 Variable::~Variable() {
-	setType(kTypeVoid);
+	destroyValue();
 }
 
 void Variable::setType(Type type) {
-	_array.reset();
-
-	if      (_type == kTypeString)
-		delete _value._string;
-	else if (_type == kTypeEngineType)
-		delete _value._engineType;
-	else if (_type == kTypeScriptState)
-		delete _value._scriptState;
+	destroyValue();
 
-	_type = type;
-
-	switch (_type) {
+	switch (type) {
 		case kTypeVoid:
 		case kTypeAny:
 			break;
 
 		case kTypeArray:
-			_array = boost::make_shared<Array>();
+			new (_value._array) ArrayPtr(boost::make_shared<Array>());
 			break;
 
 		case kTypeInt:
@@ -118,7 +111,7 @@ void Variable::setType(Type type) {
 			break;
 
 		case kTypeString:
-			_value._string = new Common::UString;
+			new (_value._string) Common::UString;
 			break;
 
 		case kTypeObject:
@@ -136,7 +129,7 @@ void Variable::setType(Type type) {
 			break;
 
 		case kTypeScriptState:
-			_value._scriptState = new ScriptState;
+			new (_value._scriptState) ScriptStatePtr(boost::make_shared<ScriptState>());
 			break;
 
 		case kTypeReference:
@@ -147,22 +140,81 @@ void Variable::setType(Type type) {
 			throw Common::Exception("Variable::setType(): Invalid type %d", type);
 			break;
 	}
+
+	_type = type;
+}
+
+void Variable::destroyValue() {
+	if      (_type == kTypeString)
+		string().~UString();
+	else if (_type == kTypeArray)
+		array().~ArrayPtr();
+	else if (_type == kTypeScriptState)
+		scriptState().~ScriptStatePtr();
+	else if (_type == kTypeEngineType)
+		delete _value._engineType;
+
+	_type = kTypeVoid;
+}
+
+Common::UString &Variable::string() {
+	return *reinterpret_cast<Common::UString *>(_value._string);
+}
+
+const Common::UString &Variable::string() const {
+	return *reinterpret_cast<const Common::UString *>(_value._string);
+}
+
+Variable::ArrayPtr &Variable::array() {
+	return *reinterpret_cast<ArrayPtr *>(_value._array);
+}
+
+const Variable::ArrayPtr &Variable::array() const {
+	return *reinterpret_cast<const ArrayPtr *>(_value._array);
+}
+
+Variable::ScriptStatePtr &Variable::scriptState() {
+	return *reinterpret_cast<ScriptStatePtr *>(_value._scriptState);
+}
+
+const Variable::ScriptStatePtr &Variable::scriptState() const {
+	return *reinterpret_cast<const ScriptStatePtr *>(_value._scriptState);
 }
 
 Variable &Variable::operator=(const Variable &var) {
 	if (&var == this)
 		return *this;
 
-	setType(var._type);
+	if (_type != var._type) {
+		destroyValue();
+
+		// Construct the in-place values by copying, everything else is plain data
+		if      (var._type == kTypeString)
+			new (_value._string) Common::UString(var.string());
+		else if (var._type == kTypeArray)
+			new (_value._array) ArrayPtr(var.array());
+		else if (var._type == kTypeScriptState)
+			new (_value._scriptState) ScriptStatePtr(var.scriptState());
+		else if (var._type == kTypeEngineType)
+			_value._engineType = var._value._engineType ? var._value._engineType->clone() : 0;
+		else
+			_value = var._value;
+
+		_type = var._type;
+
+		return *this;
+	}
+
+	// Same type: reuse the value we already have where possible
 
 	if      (_type == kTypeString)
-		*_value._string = *var._value._string;
+		string() = var.string();
+	else if (_type == kTypeArray)
+		array() = var.array();
+	else if (_type == kTypeScriptState)
+		scriptState() = var.scriptState();
 	else if (_type == kTypeEngineType)
 		*this = var._value._engineType;
-	else if (_type == kTypeScriptState)
-		*_value._scriptState = *var._value._scriptState;
-	else if (_type == kTypeArray)
-		_array = var._array;
 	else
 		_value = var._value;
 
@@ -191,7 +243,7 @@ Variable &Variable::operator=(const Common::UString &value) {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't assign a string value to a non-string variable");
 
-	*_value._string = value;
+	string() = value;
 
 	return *this;
 }
@@ -242,7 +294,7 @@ bool Variable::operator==(const Variable &var) const {
 			return _value._float == var._value._float;
 
 		case kTypeString:
-			return *_value._string == *var._value._string;
+			return string() == var.string();
 
 		case kTypeObject:
 			return _value._object == var._value._object;
@@ -253,7 +305,7 @@ bool Variable::operator==(const Variable &var) const {
 			       _value._vector[2] == var._value._vector[2];
 
 		case kTypeArray:
-			return _array.get() && var._array.get() && *_array == *var._array;
+			return *array() == *var.array();
 
 		default:
 			break;
@@ -288,14 +340,14 @@ const Common::UString &Variable::getString() const {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't get a string value from a non-string variable");
 
-	return *_value._string;
+	return string();
 }
 
 Common::UString &Variable::getString() {
 	if (_type != kTypeString)
 		throw Common::Exception("Can't get a string value from a non-string variable");
 
-	return *_value._string;
+	return string();
 }
 
 Object *Variable::getObject() const {
@@ -334,55 +386,54 @@ const Variable::Array &Variable::getArray() const {
 	if (_type != kTypeArray)
 		throw Common::Exception("Can't get an array value from a non-array variable");
 
-	assert(_array.get());
-
-	return *_array;
+	return *array();
 }
 
 Variable::Array &Variable::getArray() {
 	if (_type != kTypeArray)
 		throw Common::Exception("Can't get an array value from a non-array variable");
 
-	assert(_array.get());
-
-	return *_array;
+	return *array();
 }
 
 size_t Variable::getArraySize() const {
 	if (_type != kTypeArray)
 		throw Common::Exception("Can't get an array size from a non-array variable");
 
-	assert(_array.get());
-
-	return _array->size();
+	return array()->size();
 }
 
 void Variable::growArray(Type type, size_t size) {
 	if (_type != kTypeArray)
 		throw Common::Exception("Can't grow a non-array variable");
 
-	assert(_array.get());
+	Array &values = *array();
 
-	if (!_array->empty() && (*_array)[0].get() && (*_array)[0]->getType() != type)
-		throw Common::Exception("Array type mismatch (%d vs %d)", (*_array)[0]->getType(), type);
+	if (!values.empty() && values[0].get() && values[0]->getType() != type)
+		throw Common::Exception("Array type mismatch (%d vs %d)", values[0]->getType(), type);
 
-	_array->reserve(size);
-	while (_array->size() < size)
-		_array->push_back(boost::make_shared<Variable>(Variable(type)));
+	values.reserve(size);
+	while (values.size() < size)
+		values.push_back(boost::make_shared<Variable>(type));
 }
 
 ScriptState &Variable::getScriptState() {
 	if (_type != kTypeScriptState)
 		throw Common::Exception("Can't get a script state value from a non-script-state variable");
 
-	return *_value._scriptState;
+	// Script states are shared between copies. Make our own before it's modified
+	ScriptStatePtr &state = scriptState();
+	if (!state.unique())
+		state = boost::make_shared<ScriptState>(*state);
+
+	return *state;
 }
 
 const ScriptState &Variable::getScriptState() const {
 	if (_type != kTypeScriptState)
 		throw Common::Exception("Can't get a script state value from a non-script-state variable");
 
-	return *_value._scriptState;
+	return *scriptState();
 }
 
 Variable *Variable::getReference() const {
@@ -30,15 +30,12 @@
 #include <boost/shared_ptr.hpp>
 
 #include "src/common/types.h"
+#include "src/common/ustring.h"
 
 #include "src/aurora/types.h"
 
 #include "src/aurora/nwscript/types.h"
 
-namespace Common {
-	class UString;
-}
-
 namespace Aurora {
 
 namespace NWScript {
@@ -107,20 +104,47 @@ public:
 	void setReference(Variable *reference);
 
 private:
+	typedef boost::shared_ptr<Array> ArrayPtr;
+	typedef boost::shared_ptr<ScriptState> ScriptStatePtr;
+
 	Type _type;
 
+	/** The value.
+	 *
+	 *  Strings, arrays and script states are constructed in-place, so that
+	 *  no extra heap allocation is needed for them. Short strings fit into
+	 *  the string's own small buffer, arrays and script states are shared
+	 *  between copies.
+	 */
 	union {
 		int32 _int;
 		float _float;
-		Common::UString *_string;
 		Object *_object;
 		float _vector[3];
-		ScriptState *_scriptState;
 		EngineType *_engineType;
 		Variable *_reference;
+
+		byte _string[sizeof(Common::UString)];
+		byte _array[sizeof(ArrayPtr)];
+		byte _scriptState[sizeof(ScriptStatePtr)];
+
+		// Force a suitable alignment for the in-place objects
+		void *_alignPointer;
+		uint64 _alignInteger;
+		double _alignDouble;
 	} _value;
 
-	boost::shared_ptr<Array> _array;
+	Common::UString &string();
+	const Common::UString &string() const;
+
+	ArrayPtr &array();
+	const ArrayPtr &array() const;
+
+	ScriptStatePtr &scriptState();
+	const ScriptStatePtr &scriptState() const;
+
+	/** Destroy the current value, leaving the variable's type dangling. */
+	void destroyValue();
 };
 
 } // End of namespace NWScript
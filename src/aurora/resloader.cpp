@@ -0,0 +1,311 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Loading resources asynchronously, in background threads.
+ */
+
+#include <cassert>
+
+#include "src/common/util.h"
+#include "src/common/readstream.h"
+#include "src/common/memreadstream.h"
+#include "src/common/thread.h"
+
+#include "src/aurora/resloader.h"
+
+/** Time in milliseconds an idle worker waits for a new request before checking if it should quit. */
+static const uint32 kIdleTimeout = 100;
+
+namespace Aurora {
+
+ResourceRequest::ResourceRequest(ResourceLoader &loader, const LoadFunction &load, uint32 priority) :
+	_loader(&loader), _load(load), _priority(priority), _state(kStateQueued),
+	_cancelLoad(false), _discarded(false), _stream(0), _foundType(kFileTypeNone), _failed(false) {
+
+}
+
+ResourceRequest::~ResourceRequest() {
+	cancel();
+	wait();
+
+	// Make sure the worker is completely done with us
+	Common::StackLock lock(_loader->_mutex);
+
+	delete _stream;
+}
+
+uint32 ResourceRequest::getPriority() const {
+	return _priority;
+}
+
+bool ResourceRequest::isDone() const {
+	Common::StackLock lock(_loader->_mutex);
+
+	return (_state == kStateDone) || (_state == kStateCancelled);
+}
+
+bool ResourceRequest::isCancelled() const {
+	Common::StackLock lock(_loader->_mutex);
+
+	return (_state == kStateCancelled) || _cancelLoad;
+}
+
+void ResourceRequest::wait() {
+	_done.lock();
+	_done.unlock();
+}
+
+void ResourceRequest::cancel() {
+	_loader->cancel(*this);
+}
+
+Common::SeekableReadStream *ResourceRequest::getStream(FileType *foundType) {
+	wait();
+
+	Common::StackLock lock(_loader->_mutex);
+
+	if (_failed)
+		throw _error;
+
+	if (foundType)
+		*foundType = _foundType;
+
+	Common::SeekableReadStream *stream = _stream;
+	_stream = 0;
+
+	return stream;
+}
+
+
+class ResourceLoader::Worker : public Common::Thread {
+public:
+	Worker(ResourceLoader &loader) : _loader(&loader) {
+	}
+
+	~Worker() {
+		destroyThread();
+	}
+
+private:
+	ResourceLoader *_loader;
+
+	void threadMethod() {
+		while (!_killThread) {
+			ResourceRequest *request = _loader->takeRequest(kIdleTimeout);
+			if (request)
+				_loader->load(*request);
+		}
+	}
+};
+
+
+ResourceLoader::ResourceLoader(size_t threadCount) : _threadCount(MAX<size_t>(threadCount, 1)),
+	_newRequest(_mutex) {
+
+}
+
+ResourceLoader::~ResourceLoader() {
+	stop();
+}
+
+void ResourceLoader::startWorkers() {
+	if (!_workers.empty())
+		return;
+
+	for (size_t i = 0; i < _threadCount; i++) {
+		_workers.push_back(new Worker(*this));
+
+		if (!_workers.back()->createThread())
+			throw Common::Exception("Failed to create resource loader thread");
+	}
+}
+
+void ResourceLoader::stop() {
+	{
+		Common::StackLock lock(_mutex);
+
+		// Cancel everything that's still waiting in the queue
+		while (!_queue.empty()) {
+			ResourceRequest *request = _queue.begin()->second;
+			_queue.erase(_queue.begin());
+
+			request->_state = ResourceRequest::kStateCancelled;
+			request->_done.unlock();
+		}
+	}
+
+	// Stop the workers. This waits for requests currently being loaded to finish
+	for (std::vector<Worker *>::iterator w = _workers.begin(); w != _workers.end(); ++w)
+		delete *w;
+
+	_workers.clear();
+}
+
+size_t ResourceLoader::getQueueSize() const {
+	Common::StackLock lock(_mutex);
+
+	return _queue.size();
+}
+
+ResourceRequest *ResourceLoader::request(const ResourceRequest::LoadFunction &load, uint32 priority) {
+	ResourceRequest *request = new ResourceRequest(*this, load, priority);
+
+	Common::StackLock lock(_mutex);
+
+	try {
+		startWorkers();
+	} catch (...) {
+		delete request;
+		throw;
+	}
+
+	_queue.insert(std::make_pair(priority, request));
+	_newRequest.signal();
+
+	return request;
+}
+
+void ResourceLoader::discard(ResourceRequest *request) {
+	if (!request)
+		return;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (request->_state == ResourceRequest::kStateLoading) {
+			// The worker will delete the request once it's done
+			request->_cancelLoad = true;
+			request->_discarded  = true;
+			return;
+		}
+
+		/* Take it out of the queue while we still hold the lock, so that no
+		 * worker can pick it up before it's deleted. Deleting it then never
+		 * has to wait on a worker. */
+		dequeue(*request);
+	}
+
+	delete request;
+}
+
+void ResourceLoader::cancel(ResourceRequest &request) {
+	Common::StackLock lock(_mutex);
+
+	if (request._state == ResourceRequest::kStateLoading) {
+		request._cancelLoad = true;
+		return;
+	}
+
+	dequeue(request);
+}
+
+void ResourceLoader::dequeue(ResourceRequest &request) {
+	if (request._state != ResourceRequest::kStateQueued)
+		return;
+
+	std::pair<Queue::iterator, Queue::iterator> range = _queue.equal_range(request._priority);
+	for (Queue::iterator q = range.first; q != range.second; ++q) {
+		if (q->second == &request) {
+			_queue.erase(q);
+			break;
+		}
+	}
+
+	request._state = ResourceRequest::kStateCancelled;
+	request._done.unlock();
+}
+
+ResourceRequest *ResourceLoader::takeRequest(uint32 timeout) {
+	Common::StackLock lock(_mutex);
+
+	if (_queue.empty())
+		_newRequest.wait(timeout);
+
+	if (_queue.empty())
+		return 0;
+
+	ResourceRequest *request = _queue.begin()->second;
+	_queue.erase(_queue.begin());
+
+	request->_state = ResourceRequest::kStateLoading;
+
+	return request;
+}
+
+void ResourceLoader::load(ResourceRequest &request) {
+	Common::SeekableReadStream *stream = 0;
+	FileType foundType = kFileTypeNone;
+
+	bool failed = false;
+	Common::Exception error;
+
+	try {
+		stream = request._load(foundType);
+
+		/* Make sure the whole resource is read into memory here, in the worker
+		 * thread. Resources from archives already are, but plain files might
+		 * otherwise only be read once the stream is used. */
+		if (stream && !dynamic_cast<Common::MemoryReadStream *>(stream)) {
+			Common::SeekableReadStream *memStream = stream->readStream(stream->size());
+
+			delete stream;
+			stream = memStream;
+		}
+
+	} catch (Common::Exception &e) {
+		failed = true;
+		error  = e;
+	} catch (std::exception &e) {
+		failed = true;
+		error  = Common::Exception(e);
+	} catch (...) {
+		failed = true;
+		error  = Common::Exception("Unknown exception thrown while loading a resource");
+	}
+
+	bool discarded = false;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (request._cancelLoad) {
+			delete stream;
+
+			request._state = ResourceRequest::kStateCancelled;
+		} else {
+			request._stream    = stream;
+			request._foundType = foundType;
+			request._failed    = failed;
+			request._error     = error;
+
+			request._state = ResourceRequest::kStateDone;
+		}
+
+		discarded = request._discarded;
+
+		request._done.unlock();
+	}
+
+	if (discarded)
+		delete &request;
+}
+
+} // End of namespace Aurora
@@ -0,0 +1,179 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Loading resources asynchronously, in background threads.
+ */
+
+#ifndef AURORA_RESLOADER_H
+#define AURORA_RESLOADER_H
+
+#include <vector>
+#include <map>
+#include <functional>
+
+#include <boost/function.hpp>
+
+#include "src/common/types.h"
+#include "src/common/noncopyable.h"
+#include "src/common/error.h"
+#include "src/common/mutex.h"
+
+#include "src/aurora/types.h"
+
+namespace Common {
+	class SeekableReadStream;
+}
+
+namespace Aurora {
+
+class ResourceLoader;
+
+/** A handle on a resource that's being loaded in the background.
+ *
+ *  Deleting the handle cancels the request. If the resource is currently
+ *  being loaded, the destructor waits for the load to finish.
+ */
+class ResourceRequest : Common::NonCopyable {
+public:
+	/** The function that actually loads the resource, in a worker thread. */
+	typedef boost::function<Common::SeekableReadStream *(FileType &)> LoadFunction;
+
+	~ResourceRequest();
+
+	/** Return the priority of this request. */
+	uint32 getPriority() const;
+
+	/** Has this request finished, either by loading the resource or by being cancelled? */
+	bool isDone() const;
+	/** Has this request been cancelled? */
+	bool isCancelled() const;
+
+	/** Wait until this request has finished. */
+	void wait();
+
+	/** Cancel this request.
+	 *
+	 *  If the request is still waiting in the queue, it will never be loaded.
+	 *  If it's currently being loaded, the result is thrown away.
+	 */
+	void cancel();
+
+	/** Wait for the request to finish and return the loaded resource.
+	 *
+	 *  The caller takes over the stream. If the resource doesn't exist, or the
+	 *  request was cancelled, or the stream has already been taken, 0 is returned.
+	 *  If loading the resource failed, the exception is rethrown here.
+	 *
+	 *  @param foundType If != 0, that's where the actually found type is stored.
+	 */
+	Common::SeekableReadStream *getStream(FileType *foundType = 0);
+
+private:
+	enum State {
+		kStateQueued,    ///< Waiting in the queue.
+		kStateLoading,   ///< Currently being loaded by a worker.
+		kStateDone,      ///< Finished loading.
+		kStateCancelled  ///< Cancelled before it finished.
+	};
+
+	ResourceRequest(ResourceLoader &loader, const LoadFunction &load, uint32 priority);
+
+	ResourceLoader *_loader;
+	LoadFunction    _load;
+	uint32          _priority;
+
+	State _state;
+
+	/** Cancelled while loading, throw away the result. */
+	bool _cancelLoad;
+	/** Nobody holds this handle any more, the worker deletes it when done. */
+	bool _discarded;
+
+	Common::SeekableReadStream *_stream;
+	FileType                    _foundType;
+
+	bool              _failed;
+	Common::Exception _error;
+
+	/** Unlocked once the request is done. */
+	Common::Semaphore _done;
+
+	friend class ResourceLoader;
+};
+
+/** A pool of worker threads loading resources in the background.
+ *
+ *  Requests with a higher priority are loaded first. Requests of the same
+ *  priority are loaded in the order they were made.
+ */
+class ResourceLoader : Common::NonCopyable {
+public:
+	ResourceLoader(size_t threadCount);
+	~ResourceLoader();
+
+	/** Queue a new request, starting the worker threads if necessary.
+	 *
+	 *  The caller takes over the returned request handle.
+	 */
+	ResourceRequest *request(const ResourceRequest::LoadFunction &load, uint32 priority);
+
+	/** Throw away a request handle without waiting for it to finish.
+	 *
+	 *  Unlike deleting the request, this never blocks. A request that is
+	 *  currently being loaded is deleted by its worker once it's done.
+	 */
+	void discard(ResourceRequest *request);
+
+	/** Cancel all queued requests and stop the worker threads. */
+	void stop();
+
+	/** Return the number of requests currently waiting in the queue. */
+	size_t getQueueSize() const;
+
+private:
+	class Worker;
+
+	typedef std::multimap<uint32, ResourceRequest *, std::greater<uint32> > Queue;
+
+	size_t _threadCount;
+
+	std::vector<Worker *> _workers;
+
+	Queue _queue;
+
+	mutable Common::Mutex _mutex;
+	Common::Condition     _newRequest;
+
+	void startWorkers();
+
+	void cancel(ResourceRequest &request);
+	/** Remove a queued request from the queue and mark it cancelled. Needs the lock held. */
+	void dequeue(ResourceRequest &request);
+
+	ResourceRequest *takeRequest(uint32 timeout);
+	void load(ResourceRequest &request);
+
+	friend class ResourceRequest;
+};
+
+} // End of namespace Aurora
+
+#endif // AURORA_RESLOADER_H
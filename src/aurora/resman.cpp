@@ -24,12 +24,19 @@
 
 #include <cassert>
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
 #include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
 #include "src/common/filepath.h"
 #include "src/common/readfile.h"
 #include "src/common/writefile.h"
+#include "src/common/timestamp.h"
+#include "src/common/mappedfile.h"
+#include "src/common/sharedmemreadstream.h"
 
 #include "src/aurora/resman.h"
 #include "src/aurora/util.h"
@@ -48,6 +55,9 @@
 // Check for hash collisions (if possible)
 #define CHECK_HASH_COLLISION 1
 
+/** Default maximum size of the decompressed resource cache, in bytes. */
+static const size_t kResourceCacheSize = 32 * 1024 * 1024;
+
 DECLARE_SINGLETON(Aurora::ResourceManager)
 
 namespace Aurora {
@@ -66,9 +76,10 @@ ResourceManager::KnownArchive::KnownArchive(ArchiveType t, const Common::UString
 ResourceManager::OpenedArchive::OpenedArchive() : archive(0), known(0), parent(0) {
 }
 
-void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive &a) {
-	archive = &a;
-	known   = &kA;
+void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive *a, const std::vector<byte> &p) {
+	archive  = a;
+	known    = &kA;
+	password = p;
 
 	if (known->opened)
 		throw Common::Exception("Archive \"%s\" already opened", known->name.c_str());
@@ -90,7 +101,7 @@ void ResourceManager::OpenedArchive::set(KnownArchive &kA, Archive &a) {
 }
 
 
-ResourceManager::Resource::Resource() : type(kFileTypeNone), isSmall(false), priority(0),
+ResourceManager::Resource::Resource() : type(kFileTypeNone), isSmall(false), priority(0), changeID(0),
 		source(kSourceNone), archive(0), archiveIndex(0xFFFFFFFF) {
 
 	selfArchive.first = 0;
@@ -100,9 +111,37 @@ bool ResourceManager::Resource::operator<(const Resource &right) const {
 	return priority < right.priority;
 }
 
+bool ResourceManager::Resource::comparePriority(const Resource *left, const Resource *right) {
+	return *left < *right;
+}
+
+
+ResourceManager::IndexStats::IndexStats() : archivesCached(0), archivesIndexed(0),
+	timeCached(0), timeIndexed(0) {
+
+}
+
+ResourceManager::CacheStats::CacheStats() : hits(0), misses(0), evictions(0),
+	entries(0), size(0), budget(0) {
+
+}
+
+
+ResourceManager::ResourceRead::ResourceRead() : resource(0), removals(0), source(kSourceNone),
+	archiveIndex(0xFFFFFFFF), archive(0), rootArchive(0), archiveLock(0),
+	isSmall(false), tryNoCopy(false), cacheable(false) {
+
+}
+
+ResourceManager::ArchiveUse::ArchiveUse() : lock(0), readers(0), retired(false) {
+}
+
 
 ResourceManager::ResourceManager() : _hasSmall(false),
-	_hashAlgo(Common::kHashFNV64) {
+	_hashAlgo(Common::kHashFNV64), _lastChangeID(0), _removals(0),
+	_mapArchives(Common::FileMapping::isSupported() && (sizeof(void *) >= 8)), _loader(kLoaderThreads) {
+
+	_cacheStats.budget = kResourceCacheSize;
 
 	// These file types are archives
 
@@ -165,10 +204,14 @@ ResourceManager::ResourceManager() : _hasSmall(false),
 }
 
 ResourceManager::~ResourceManager() {
+	_loader.stop();
+
 	clearResources();
 }
 
 void ResourceManager::clear() {
+	Common::StackLock lock(_mutex);
+
 	_typeAliases.clear();
 
 	_hasSmall = false;
@@ -179,6 +222,8 @@ void ResourceManager::clear() {
 }
 
 void ResourceManager::clearResources() {
+	dropPrefetches();
+
 	_cursorRemap.clear();
 
 	_baseDir.clear();
@@ -188,15 +233,24 @@ void ResourceManager::clearResources() {
 		_knownArchives[i].clear();
 
 	for (OpenedArchives::iterator a = _openedArchives.begin(); a != _openedArchives.end(); ++a)
-		delete a->archive;
+		retireArchive(a->archive);
 	_openedArchives.clear();
 
+	clearCache();
+
 	_resources.clear();
+	freeResources();
 
 	_changes.clear();
+
+	_removals++;
+
+	_indexStats = IndexStats();
 }
 
 void ResourceManager::setRIMsAreERFs(bool rimsAreERFs) {
+	Common::StackLock lock(_mutex);
+
 	// Treat RIM and RIMP as either RIM or ERF
 
 	_archiveTypeTypes[kArchiveRIM].erase(kFileTypeRIM);
@@ -214,10 +268,14 @@ void ResourceManager::setRIMsAreERFs(bool rimsAreERFs) {
 }
 
 void ResourceManager::setHasSmall(bool hasSmall) {
+	Common::StackLock lock(_mutex);
+
 	_hasSmall = hasSmall;
 }
 
 void ResourceManager::setHashAlgo(Common::HashAlgo algo) {
+	Common::StackLock lock(_mutex);
+
 	if ((algo != _hashAlgo) && !_resources.empty())
 		throw Common::Exception("ResourceManager::setHashAlgo(): We already have resources!");
 
@@ -225,10 +283,14 @@ void ResourceManager::setHashAlgo(Common::HashAlgo algo) {
 }
 
 void ResourceManager::setCursorRemap(const std::vector<Common::UString> &remap) {
+	Common::StackLock lock(_mutex);
+
 	_cursorRemap = remap;
 }
 
 void ResourceManager::registerDataBase(const Common::UString &path) {
+	Common::StackLock lock(_mutex);
+
 	clearResources();
 
 	Common::UString base = Common::FilePath::canonicalize(path);
@@ -278,6 +340,8 @@ ResourceManager::KnownArchive *ResourceManager::findArchive(Common::UString file
 }
 
 bool ResourceManager::hasArchive(const Common::UString &file) {
+	Common::StackLock lock(_mutex);
+
 	return findArchive(file) != 0;
 }
 
@@ -285,12 +349,128 @@ Common::SeekableReadStream *ResourceManager::openArchiveStream(const KnownArchiv
 	if (!archive.resource)
 		throw Common::Exception("Archive without resource reference");
 
-	return getResource(*archive.resource, true);
+	// Map archive files into memory, if requested
+	const Resource &res = *archive.resource;
+	if (_mapArchives && (res.source == kSourceFile) && !res.isSmall) {
+		try {
+			boost::shared_ptr<Common::FileMapping> mapping(new Common::FileMapping(res.path));
+
+			return new Common::MappedReadStream(mapping, 0, mapping->getSize());
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to map archive \"%s\", reading it instead",
+			                                   res.path.c_str());
+		}
+	}
+
+	return getResource(res, true);
+}
+
+Archive *ResourceManager::createArchive(const KnownArchive &knownArchive,
+                                        const std::vector<byte> &password) const {
+
+	/* An archive within another archive reads through the stream of the outermost
+	 * archive, which might be in use by a read happening without our lock.
+	 * Otherwise, just take our own lock again, which the caller already holds. */
+	Common::Mutex *rootLock = 0;
+
+	const Resource *res = knownArchive.resource;
+	if (res && (res->source == kSourceArchive) && res->archive)
+		rootLock = &getArchiveLock(getRootArchive(*res->archive));
+
+	Common::StackLock archiveLock(rootLock ? *rootLock : _mutex);
+
+	Common::SeekableReadStream *archiveStream = openArchiveStream(knownArchive);
+
+	switch (knownArchive.type) {
+		case kArchiveBIF:
+			return new BIFFile(archiveStream);
+
+		case kArchiveNDS:
+			return new NDSFile(archiveStream);
+
+		case kArchiveHERF:
+			return new HERFFile(archiveStream);
+
+		case kArchiveERF:
+			return new ERFFile(archiveStream, password);
+
+		case kArchiveRIM:
+			return new RIMFile(archiveStream);
+
+		case kArchiveZIP:
+			return new ZIPFile(archiveStream);
+
+		case kArchiveEXE:
+			return new PEFile(archiveStream, _cursorRemap);
+
+		case kArchiveNSBTX:
+			return new NSBTXFile(archiveStream);
+
+		default:
+			break;
+	}
+
+	delete archiveStream;
+	throw Common::Exception("Invalid archive type %d", knownArchive.type);
+}
+
+Archive *ResourceManager::getArchive(OpenedArchive &archive) const {
+	if (archive.archive)
+		return archive.archive;
+
+	/* This archive has been indexed from the index cache, and not actually
+	 * opened yet. Since it's needed now, open it. */
+
+	if (!archive.known)
+		throw Common::Exception("Opened archive without archive information");
+
+	archive.archive = createArchive(*archive.known, archive.password);
+
+	return archive.archive;
+}
+
+Archive *ResourceManager::getRootArchive(OpenedArchive &archive) const {
+	OpenedArchive *root = &archive;
+	while (root->parent)
+		root = root->parent;
+
+	return getArchive(*root);
+}
+
+Common::Mutex &ResourceManager::getArchiveLock(const Archive *archive) const {
+	ArchiveUse &use = _archiveUses[archive];
+	if (!use.lock)
+		use.lock = new Common::Mutex;
+
+	return *use.lock;
+}
+
+void ResourceManager::retireArchive(Archive *archive) {
+	if (!archive)
+		return;
+
+	ArchiveUseMap::iterator use = _archiveUses.find(archive);
+	if (use != _archiveUses.end()) {
+		// Still being read from. The last reader will delete it
+		if (use->second.readers > 0) {
+			use->second.retired = true;
+			return;
+		}
+
+		delete use->second.lock;
+		_archiveUses.erase(use);
+	}
+
+	delete archive;
 }
 
 void ResourceManager::indexArchive(const Common::UString &file, uint32 priority,
                                    const std::vector<byte> &password, Common::ChangeID *changeID) {
 
+	Common::StackLock lock(_mutex);
+
+	dropPrefetches();
+
 	KnownArchive *knownArchive = findArchive(file);
 	if (!knownArchive)
 		throw Common::Exception("No such archive file \"%s\"", file.c_str());
@@ -302,54 +482,49 @@ void ResourceManager::indexArchive(const Common::UString &file, uint32 priority,
 	if (changeID)
 		change = newChangeSet(*changeID);
 
-	Archive *archive = 0;
-	try {
-		Common::SeekableReadStream *archiveStream = openArchiveStream(*knownArchive);
-
-		switch (knownArchive->type) {
-			case kArchiveKEY:
-				indexKEY(archiveStream, priority, change);
-				break;
-
-			case kArchiveNDS:
-				archive = new NDSFile(archiveStream);
-				break;
+	const uint64 startTime = Common::getMicroTimestamp();
 
-			case kArchiveHERF:
-				archive = new HERFFile(archiveStream);
-				break;
-
-			case kArchiveERF:
-				archive = new ERFFile(archiveStream, password);
-				break;
+	// Try to find the archive in the index cache first
+	if (indexCachedArchive(*knownArchive, priority, password, change)) {
+		_indexStats.archivesCached++;
+		_indexStats.timeCached += Common::getMicroTimestamp() - startTime;
+		return;
+	}
 
-			case kArchiveRIM:
-				archive = new RIMFile(archiveStream);
-				break;
+	IndexCache::Entry  cacheEntry;
+	IndexCache::Entry *cache = 0;
 
-			case kArchiveZIP:
-				archive = new ZIPFile(archiveStream);
-				break;
+	if (isCacheable(*knownArchive)) {
+		cache = &cacheEntry;
+		cache->file = IndexCache::ArchiveFile(knownArchive->resource->path);
+	}
 
-			case kArchiveEXE:
-				archive = new PEFile(archiveStream, _cursorRemap);
-				break;
+	Archive *archive = 0;
+	try {
+		if (knownArchive->type == kArchiveKEY) {
+			indexKEY(openArchiveStream(*knownArchive), priority, change, cache);
+		} else {
+			archive = createArchive(*knownArchive, password);
 
-			case kArchiveNSBTX:
-				archive = new NSBTXFile(archiveStream);
-				break;
+			indexArchive(*knownArchive, archive, priority, change);
 
-			default:
-				throw Common::Exception("Invalid archive type %d", knownArchive->type);
+			if (cache) {
+				cache->hashAlgo       = archive->getNameHashAlgo();
+				cache->file.resources = archive->getResources();
+			}
 		}
 
-		if (archive)
-			indexArchive(*knownArchive, archive, priority, change);
-
 	} catch (...) {
 		delete archive;
 		throw;
 	}
+
+	// An empty path means the archive turned out to be not cacheable after all
+	if (cache && !cache->file.path.empty())
+		_indexCache.add(*cache);
+
+	_indexStats.archivesIndexed++;
+	_indexStats.timeIndexed += Common::getMicroTimestamp() - startTime;
 }
 
 void ResourceManager::indexArchive(const Common::UString &file, uint32 priority, Common::ChangeID *changeID) {
@@ -358,6 +533,102 @@ void ResourceManager::indexArchive(const Common::UString &file, uint32 priority,
 	indexArchive(file, priority, password, changeID);
 }
 
+void ResourceManager::setIndexCache(const Common::UString &file) {
+	Common::StackLock lock(_mutex);
+
+	_indexCacheFile = file;
+	_indexCache.clear();
+
+	if (_indexCacheFile.empty())
+		return;
+
+	if (_indexCache.load(_indexCacheFile))
+		status("Loaded resource index cache \"%s\"", _indexCacheFile.c_str());
+}
+
+void ResourceManager::saveIndexCache() {
+	Common::StackLock lock(_mutex);
+
+	if (_indexCacheFile.empty() || !_indexCache.isDirty())
+		return;
+
+	try {
+		_indexCache.save(_indexCacheFile);
+	} catch (Common::Exception &e) {
+		e.add("Failed saving the resource index cache \"%s\"", _indexCacheFile.c_str());
+		Common::printException(e, "WARNING: ");
+	}
+}
+
+void ResourceManager::setMapArchives(bool mapArchives) {
+	Common::StackLock lock(_mutex);
+
+	_mapArchives = mapArchives && Common::FileMapping::isSupported();
+}
+
+bool ResourceManager::getMapArchives() const {
+	return _mapArchives;
+}
+
+const ResourceManager::IndexStats &ResourceManager::getIndexStats() const {
+	return _indexStats;
+}
+
+void ResourceManager::setResourceCacheSize(size_t size) {
+	Common::StackLock lock(_mutex);
+
+	_cacheStats.budget = size;
+
+	trimCache();
+}
+
+ResourceManager::CacheStats ResourceManager::getCacheStats() const {
+	Common::StackLock lock(_mutex);
+
+	return _cacheStats;
+}
+
+bool ResourceManager::isCacheable(const KnownArchive &archive) const {
+	// We can only cache archives that are real files we can look up the size and time of
+	return !_indexCacheFile.empty() && archive.resource && (archive.resource->source == kSourceFile);
+}
+
+bool ResourceManager::indexCachedArchive(KnownArchive &knownArchive, uint32 priority,
+                                         const std::vector<byte> &password, Change *change) {
+
+	if (!isCacheable(knownArchive))
+		return false;
+
+	IndexCache::Entry entry;
+	if (!_indexCache.find(knownArchive.resource->path, entry))
+		return false;
+
+	if ((entry.hashAlgo != Common::kHashNone) && (entry.hashAlgo != _hashAlgo))
+		return false;
+
+	if (knownArchive.type != kArchiveKEY) {
+		indexArchive(knownArchive, 0, entry.file.resources, entry.hashAlgo, password, priority, change);
+		return true;
+	}
+
+	// Make sure all the BIFs of this KEY are still the same
+	std::vector<KnownArchive *> bifs;
+	bifs.reserve(entry.bifs.size());
+
+	for (std::vector<IndexCache::ArchiveFile>::const_iterator b = entry.bifs.begin(); b != entry.bifs.end(); ++b) {
+		KnownArchive *bif = findArchive(b->path, _knownArchives[kArchiveBIF]);
+		if (!bif || !isCacheable(*bif) || (bif->resource->path != b->path) || !b->isValid())
+			return false;
+
+		bifs.push_back(bif);
+	}
+
+	for (size_t i = 0; i < bifs.size(); i++)
+		indexArchive(*bifs[i], 0, entry.bifs[i].resources, entry.hashAlgo, password, priority, change);
+
+	return true;
+}
+
 uint32 ResourceManager::openKEYBIFs(Common::SeekableReadStream *keyStream,
                                     std::vector<KnownArchive *> &archives,
                                     std::vector<BIFFile *> &bifs) {
@@ -393,7 +664,9 @@ uint32 ResourceManager::openKEYBIFs(Common::SeekableReadStream *keyStream,
 	return archives.size();
 }
 
-void ResourceManager::indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change) {
+void ResourceManager::indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change,
+                               IndexCache::Entry *cacheEntry) {
+
 	std::vector<KnownArchive *> archives;
 	std::vector<BIFFile *> bifs;
 
@@ -401,12 +674,37 @@ void ResourceManager::indexKEY(Common::SeekableReadStream *stream, uint32 priori
 
 	for (uint32 i = 0; i < count; i++)
 		indexArchive(*archives[i], bifs[i], priority, change);
+
+	if (!cacheEntry)
+		return;
+
+	// Only cache this KEY if all its BIFs are plain files we can validate later
+	for (uint32 i = 0; i < count; i++) {
+		if (!isCacheable(*archives[i])) {
+			cacheEntry->file.path.clear();
+			return;
+		}
+
+		cacheEntry->bifs.push_back(IndexCache::ArchiveFile(archives[i]->resource->path));
+		cacheEntry->bifs.back().resources = bifs[i]->getResources();
+	}
+
+	cacheEntry->hashAlgo = Common::kHashNone;
 }
 
 void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
                                    uint32 priority, Change *change) {
 
-	const Common::HashAlgo hashAlgo = archive->getNameHashAlgo();
+	assert(archive);
+
+	indexArchive(knownArchive, archive, archive->getResources(), archive->getNameHashAlgo(),
+	             std::vector<byte>(), priority, change);
+}
+
+void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
+                                   const Archive::ResourceList &resources, Common::HashAlgo hashAlgo,
+                                   const std::vector<byte> &password, uint32 priority, Change *change) {
+
 	if ((hashAlgo != Common::kHashNone) && (hashAlgo != _hashAlgo))
 		throw Common::Exception("ResourceManager::indexArchive(): Archive uses a different name hashing "
 		                        "algorithm than we do (%d vs. %d)", (int) hashAlgo, (int) _hashAlgo);
@@ -414,7 +712,7 @@ void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
 	_openedArchives.push_back(OpenedArchive());
 
 	try {
-		_openedArchives.back().set(knownArchive, *archive);
+		_openedArchives.back().set(knownArchive, archive, password);
 	} catch (...) {
 		_openedArchives.pop_back();
 		throw;
@@ -424,7 +722,6 @@ void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
 	if (change)
 		change->_change->openedArchives.push_back(--_openedArchives.end());
 
-	const Archive::ResourceList &resources = archive->getResources();
 	for (Archive::ResourceList::const_iterator resource = resources.begin(); resource != resources.end(); ++resource) {
 		// Build the resource record
 		Resource res;
@@ -457,6 +754,8 @@ void ResourceManager::indexArchive(KnownArchive &knownArchive, Archive *archive,
 }
 
 bool ResourceManager::hasResourceDir(const Common::UString &dir) {
+	Common::StackLock lock(_mutex);
+
 	if (_baseDir.empty())
 		return false;
 
@@ -466,6 +765,10 @@ bool ResourceManager::hasResourceDir(const Common::UString &dir) {
 void ResourceManager::indexResourceFile(const Common::UString &file, uint32 priority,
                                         Common::ChangeID *changeID) {
 
+	Common::StackLock lock(_mutex);
+
+	dropPrefetches();
+
 	Common::UString path;
 	path = _baseDir.empty() ? file : (_baseDir + "/" + file);
 	path = Common::FilePath::normalize(path, false);
@@ -482,6 +785,10 @@ void ResourceManager::indexResourceFile(const Common::UString &file, uint32 prio
 
 void ResourceManager::indexResourceDir(const Common::UString &dir, const char *glob, int depth,
                                        uint32 priority, Common::ChangeID *changeID) {
+	Common::StackLock lock(_mutex);
+
+	dropPrefetches();
+
 	if (_baseDir.empty())
 		throw Common::Exception("No base data directory set");
 
@@ -513,6 +820,10 @@ void ResourceManager::indexResourceDir(const Common::UString &dir, const char *g
 }
 
 void ResourceManager::undo(Common::ChangeID &changeID) {
+	Common::StackLock lock(_mutex);
+
+	dropPrefetches();
+
 	Change *change = dynamic_cast<Change *>(changeID.getContent());
 	if (!change || (change->_change == _changes.end()))
 		return;
@@ -546,7 +857,7 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 				throw Common::Exception("Couldn't find archive in the parent's children list");
 		}
 
-		delete (*oaChange)->archive;
+		retireArchive((*oaChange)->archive);
 		_openedArchives.erase(*oaChange);
 	}
 
@@ -570,45 +881,64 @@ void ResourceManager::undo(Common::ChangeID &changeID) {
 
 		// If the resource still has an archive attached, it was added by a
 		// declareResources() call and needs to be removed manually
-		if (resChange->resIt->selfArchive.first) {
-			if (resChange->resIt->selfArchive.second->opened)
+		if (resChange->resource->selfArchive.first) {
+			if (resChange->resource->selfArchive.second->opened)
 				throw Common::Exception("Attempted to deindex an archive resource that's still opened");
 
-			resChange->resIt->selfArchive.first->erase(resChange->resIt->selfArchive.second);
+			resChange->resource->selfArchive.first->erase(resChange->resource->selfArchive.second);
 		}
 
 		// Remove the resource, and the name list too if it's empty
-		resChange->hashIt->second.erase(resChange->resIt);
+		ResourceList *resList = _resources.find(resChange->hash);
+		if (!resList)
+			throw Common::Exception("Couldn't find the resource list of a resource to deindex");
+
+		ResourceList::iterator r = std::find(resList->begin(), resList->end(), resChange->resource);
+		if (r == resList->end())
+			throw Common::Exception("Couldn't find a resource to deindex in its resource list");
+
+		resList->erase(r);
+		freeResource(resChange->resource);
 
-		if (resChange->hashIt->second.empty())
-			_resources.erase(resChange->hashIt);
+		if (resList->empty())
+			_resources.erase(resChange->hash);
 	}
 
 	// Now we can remove the change set from our list of change sets
 	_changes.erase(change->_change);
 
+	_removals++;
+
 	// And finally set the change ID to a defined empty state
 	changeID.clear();
 }
 
 void ResourceManager::addTypeAlias(FileType alias, FileType realType) {
+	Common::StackLock lock(_mutex);
+
 	_typeAliases[alias] = realType;
 }
 
 void ResourceManager::blacklist(const Common::UString &name, FileType type) {
-	ResourceMap::iterator resList = _resources.find(getHash(name, type));
-	if (resList == _resources.end())
+	Common::StackLock lock(_mutex);
+
+	dropPrefetches();
+
+	ResourceList *resList = _resources.find(getHash(name, type));
+	if (!resList)
 		return;
 
-	for (ResourceList::iterator res = resList->second.begin(); res != resList->second.end(); ++res)
-		res->priority = 0;
+	for (ResourceList::iterator res = resList->begin(); res != resList->end(); ++res)
+		(*res)->priority = 0;
 }
 
 void ResourceManager::declareResource(const Common::UString &name, FileType type) {
+	Common::StackLock lock(_mutex);
+
 	bool isSmall = false;
 
-	ResourceMap::iterator resList = _resources.find(getHash(name, type));
-	if (resList == _resources.end()) {
+	ResourceList *resList = _resources.find(getHash(name, type));
+	if (!resList) {
 		if (_hasSmall) {
 			Common::UString smallName = TypeMan.addFileType(TypeMan.setFileType(name, type), kFileTypeSMALL);
 
@@ -616,16 +946,20 @@ void ResourceManager::declareResource(const Common::UString &name, FileType type
 			isSmall = true;
 		}
 
-		if (resList == _resources.end())
+		if (!resList)
 			return;
 	}
 
-	for (ResourceList::iterator r = resList->second.begin(); r != resList->second.end(); ++r) {
-		r->name    = name;
-		r->type    = type;
-		r->isSmall = isSmall;
+	for (ResourceList::iterator r = resList->begin(); r != resList->end(); ++r) {
+		// The resource might be read differently now
+		uncacheResource(*r);
+
+		(*r)->name     = name;
+		(*r)->type     = type;
+		(*r)->isSmall  = isSmall;
+		(*r)->changeID = ++_lastChangeID;
 
-		checkResourceIsArchive(*r, 0);
+		checkResourceIsArchive(**r, 0);
 	}
 }
 
@@ -652,10 +986,14 @@ bool ResourceManager::hasResource(const Common::UString &name) const {
 }
 
 bool ResourceManager::hasResource(const Common::UString &name, const std::vector<FileType> &types) const {
+	Common::StackLock lock(_mutex);
+
 	return getRes(name, types) != 0;
 }
 
 bool ResourceManager::hasResource(uint64 hash) const {
+	Common::StackLock lock(_mutex);
+
 	return getRes(hash) != 0;
 }
 
@@ -679,6 +1017,8 @@ Common::UString ResourceManager::findResourceFile(const Common::UString &name) c
 
 Common::UString ResourceManager::findResourceFile(const Common::UString &name,
                                                   const std::vector<FileType> &types) const {
+	Common::StackLock lock(_mutex);
+
 	const Resource *res = getRes(name, types);
 	if (res && (res->source == kSourceFile))
 		return res->path;
@@ -688,10 +1028,10 @@ Common::UString ResourceManager::findResourceFile(const Common::UString &name,
 
 uint32 ResourceManager::getResourceSize(const Resource &res) const {
 	if (res.source == kSourceArchive) {
-		if ((res.archive == 0) || (res.archive->archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
+		if ((res.archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
 			return 0xFFFFFFFF;
 
-		return res.archive->archive->getResourceSize(res.archiveIndex);
+		return getArchive(*res.archive)->getResourceSize(res.archiveIndex);
 	}
 
 	if (res.source == kSourceFile)
@@ -700,13 +1040,6 @@ uint32 ResourceManager::getResourceSize(const Resource &res) const {
 	return 0xFFFFFFFF;
 }
 
-Common::SeekableReadStream *ResourceManager::getArchiveResource(const Resource &res, bool tryNoCopy) const {
-	if ((res.archive == 0) || (res.archive->archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
-		throw Common::Exception("Archive resource has no archive");
-
-	return res.archive->archive->getResource(res.archiveIndex, tryNoCopy);
-}
-
 Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &name, FileType type) const {
 	std::vector<FileType> types;
 
@@ -722,39 +1055,120 @@ Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &
 Common::SeekableReadStream *ResourceManager::getResource(const Common::UString &name,
 		const std::vector<FileType> &types, FileType *foundType) const {
 
-	const Resource *res = getRes(name, types);
+	ResourceRequest *prefetch = 0;
+	ResourceRead     read;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		const Resource *res = getRes(name, types);
+		if (!res)
+			return 0;
+
+		// Return the actually found type
+		if (foundType)
+			*foundType = res->type;
+
+		if (!(prefetch = takePrefetch(*res))) {
+			Common::SeekableReadStream *cached = prepareRead(*res, false, read);
+			if (cached)
+				return cached;
+		}
+	}
+
+	if (prefetch)
+		return getPrefetchedResource(prefetch, name, types);
+
+	return readResource(read);
+}
+
+Common::SeekableReadStream *ResourceManager::getResourceMapped(const Common::UString &name, FileType type) const {
+	Common::StackLock lock(_mutex);
+
+	const Resource *res = getRes(name, type);
 	if (!res)
 		return 0;
 
-	// Return the actually found type
-	if (foundType)
-		*foundType = res->type;
+	if ((res->source == kSourceFile) && !res->isSmall && Common::FileMapping::isSupported()) {
+		try {
+			boost::shared_ptr<Common::FileMapping> mapping(new Common::FileMapping(res->path));
 
-	return getResource(*res);
+			return new Common::MappedReadStream(mapping, 0, mapping->getSize());
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to map \"%s\", reading it instead", res->path.c_str());
+		}
+	}
+
+	return getResource(*res, true);
 }
 
 Common::SeekableReadStream *ResourceManager::getResource(uint64 hash, FileType *type) const {
-	const Resource *res = getRes(hash);
-	if (!res)
-		return 0;
+	ResourceRead read;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		const Resource *res = getRes(hash);
+		if (!res)
+			return 0;
+
+		// Return the actually found type
+		if (type)
+			*type = res->type;
 
-	// Return the actually found type
-	if (type)
-		*type = res->type;
+		Common::SeekableReadStream *cached = prepareRead(*res, false, read);
+		if (cached)
+			return cached;
+	}
 
-	return getResource(*res);
+	return readResource(read);
 }
 
 Common::SeekableReadStream *ResourceManager::getResource(const Resource &res, bool tryNoCopy) const {
-	Common::SeekableReadStream *stream = 0;
+	ResourceRead read;
+
+	Common::SeekableReadStream *cached = prepareRead(res, tryNoCopy, read);
+	if (cached)
+		return cached;
+
+	return readResource(read);
+}
+
+Common::SeekableReadStream *ResourceManager::prepareRead(const Resource &res, bool tryNoCopy,
+		ResourceRead &read) const {
+
+	// Resources that need decompressing might already be in the cache
+	read.cacheable = (_cacheStats.budget > 0) && isResourceCompressed(res);
+	if (read.cacheable) {
+		Common::SeekableReadStream *cached = getCachedResource(res);
+		if (cached)
+			return cached;
+	}
+
+	read.resource     = &res;
+	read.removals     = _removals;
+	read.source       = res.source;
+	read.path         = res.path;
+	read.archiveIndex = res.archiveIndex;
+	read.isSmall      = res.isSmall;
+	read.tryNoCopy    = tryNoCopy;
 
 	switch (res.source) {
 		case kSourceFile:
-			stream = new Common::ReadFile(res.path);
 			break;
 
 		case kSourceArchive:
-			stream = getArchiveResource(res, tryNoCopy);
+			if ((res.archive == 0) || (res.archiveIndex == 0xFFFFFFFF))
+				throw Common::Exception("Archive resource has no archive");
+
+			// Open the archive now, and make sure it stays around until the read is done
+			read.archive     = getArchive(*res.archive);
+			read.rootArchive = getRootArchive(*res.archive);
+			read.archiveLock = &getArchiveLock(read.rootArchive);
+
+			_archiveUses[read.archive].readers++;
+			if (read.rootArchive != read.archive)
+				_archiveUses[read.rootArchive].readers++;
 			break;
 
 		default:
@@ -762,13 +1176,175 @@ Common::SeekableReadStream *ResourceManager::getResource(const Resource &res, bo
 			                        TypeMan.setFileType(res.name, res.type).c_str(), res.source);
 	}
 
-	// Transparently decompress "small" files
-	if (res.isSmall)
-		stream = Small::decompress(stream);
+	return 0;
+}
+
+Common::SeekableReadStream *ResourceManager::readResource(const ResourceRead &read) const {
+	/* Runs without holding the lock, unless the caller still holds it.
+	 * Only the archive's stream itself needs to be locked while reading. */
+
+	Common::SeekableReadStream *stream = 0;
+
+	try {
+		if (read.source == kSourceFile) {
+			stream = new Common::ReadFile(read.path);
+		} else {
+			Common::StackLock archiveLock(*read.archiveLock);
+
+			stream = read.archive->getResource(read.archiveIndex, read.tryNoCopy);
+		}
+
+		// Transparently decompress "small" files
+		if (read.isSmall)
+			stream = Small::decompress(stream);
+
+		if (read.cacheable)
+			stream = cacheResource(read, stream);
+
+	} catch (...) {
+		finishRead(read);
+		throw;
+	}
+
+	finishRead(read);
 
 	return stream;
 }
 
+void ResourceManager::finishRead(const ResourceRead &read) const {
+	if (!read.archive)
+		return;
+
+	Common::StackLock lock(_mutex);
+
+	releaseArchive(read.archive);
+	if (read.rootArchive != read.archive)
+		releaseArchive(read.rootArchive);
+}
+
+void ResourceManager::releaseArchive(const Archive *archive) const {
+	ArchiveUseMap::iterator use = _archiveUses.find(archive);
+	assert((use != _archiveUses.end()) && (use->second.readers > 0));
+
+	if ((--use->second.readers > 0) || !use->second.retired)
+		return;
+
+	// The archive has been removed while we were reading from it
+	delete use->second.lock;
+	_archiveUses.erase(use);
+
+	delete archive;
+}
+
+bool ResourceManager::isResourceCompressed(const Resource &res) const {
+	if (res.isSmall)
+		return true;
+
+	if ((res.source == kSourceArchive) && res.archive && (res.archiveIndex != 0xFFFFFFFF))
+		return getArchive(*res.archive)->isResourceCompressed(res.archiveIndex);
+
+	return false;
+}
+
+Common::SeekableReadStream *ResourceManager::getCachedResource(const Resource &res) const {
+	ResourceCacheMap::iterator c = _cacheMap.find(&res);
+	if (c == _cacheMap.end())
+		return 0;
+
+	// Move it to the front, as the most recently used
+	_cache.splice(_cache.begin(), _cache, c->second);
+
+	_cacheStats.hits++;
+
+	return new Common::SharedMemoryReadStream(c->second->data, c->second->size);
+}
+
+Common::SeekableReadStream *ResourceManager::cacheResource(const ResourceRead &read,
+		Common::SeekableReadStream *stream) const {
+
+	// Read the whole decompressed resource into a buffer we can share
+
+	size_t size = 0;
+	byte  *data = 0;
+
+	try {
+		size = stream->size();
+		data = new byte[size];
+
+		stream->seek(0);
+		if (stream->read(data, size) != size)
+			throw Common::Exception(Common::kReadError);
+
+	} catch (...) {
+		delete[] data;
+		delete stream;
+		throw;
+	}
+
+	delete stream;
+
+	CachedResource cached;
+	cached.resource = read.resource;
+	cached.data     = boost::shared_array<const byte>(data);
+	cached.size     = size;
+
+	Common::StackLock lock(_mutex);
+
+	_cacheStats.misses++;
+
+	/* Don't bother caching resources that would push everything else out.
+	 * Also don't cache anything if the resource record might have been removed
+	 * while we were reading, or another thread already cached it. */
+	const bool valid = (read.removals == _removals) && (_cacheMap.find(read.resource) == _cacheMap.end());
+
+	if (valid && (size <= _cacheStats.budget)) {
+		_cache.push_front(cached);
+		_cacheMap[read.resource] = _cache.begin();
+
+		_cacheStats.entries++;
+		_cacheStats.size += size;
+
+		trimCache();
+	}
+
+	return new Common::SharedMemoryReadStream(cached.data, cached.size);
+}
+
+void ResourceManager::uncacheResource(const Resource *res) {
+	ResourceCacheMap::iterator c = _cacheMap.find(res);
+	if (c == _cacheMap.end())
+		return;
+
+	_cacheStats.entries--;
+	_cacheStats.size -= c->second->size;
+
+	_cache.erase(c->second);
+	_cacheMap.erase(c);
+}
+
+void ResourceManager::clearCache() {
+	_cache.clear();
+	_cacheMap.clear();
+
+	// Reset the statistics, but keep the budget
+	const size_t budget = _cacheStats.budget;
+
+	_cacheStats = CacheStats();
+	_cacheStats.budget = budget;
+}
+
+void ResourceManager::trimCache() const {
+	// Drop the least recently used resources until we're within budget again
+	while (!_cache.empty() && (_cacheStats.size > _cacheStats.budget)) {
+		_cacheStats.entries--;
+		_cacheStats.size -= _cache.back().size;
+		_cacheStats.evictions++;
+
+		_cacheMap.erase(_cache.back().resource);
+		_cache.pop_back();
+	}
+}
+
 Common::SeekableReadStream *ResourceManager::getResource(ResourceType resType,
 		const Common::UString &name, FileType *foundType) const {
 
@@ -783,16 +1359,46 @@ Common::SeekableReadStream *ResourceManager::getResource(ResourceType resType,
 	return 0;
 }
 
+uint64 ResourceManager::getResourceChangeID(const Common::UString &name, FileType type) const {
+	Common::StackLock lock(_mutex);
+
+	const Resource *res = getRes(name, type);
+	if (!res)
+		return 0;
+
+	return res->changeID;
+}
+
+uint64 ResourceManager::getResourceChangeID(ResourceType resType, const Common::UString &name) const {
+	assert((resType >= 0) && (resType < kResourceMAX));
+
+	Common::StackLock lock(_mutex);
+
+	const Resource *res = getRes(name, _resourceTypeTypes[resType]);
+	if (!res)
+		return 0;
+
+	return res->changeID;
+}
+
+uint32 ResourceManager::getRemovalCount() const {
+	Common::StackLock lock(_mutex);
+
+	return _removals;
+}
+
 void ResourceManager::getAvailableResources(FileType type,
 		std::list<ResourceID> &list) const {
 
+	Common::StackLock lock(_mutex);
+
 	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
-		if (!r->second.empty() && (r->second.front().type == type)) {
+		if (!r.value().empty() && (r.value().front()->type == type)) {
 			list.push_back(ResourceID());
 
-			list.back().name = r->second.front().name;
-			list.back().type = r->second.front().type;
-			list.back().hash = r->first;
+			list.back().name = r.value().front()->name;
+			list.back().type = r.value().front()->type;
+			list.back().hash = r.key();
 		}
 	}
 }
@@ -800,14 +1406,16 @@ void ResourceManager::getAvailableResources(FileType type,
 void ResourceManager::getAvailableResources(const std::vector<FileType> &types,
 		std::list<ResourceID> &list) const {
 
+	Common::StackLock lock(_mutex);
+
 	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
 		for (std::vector<FileType>::const_iterator t = types.begin(); t != types.end(); ++t) {
-			if (!r->second.empty() && (r->second.front().type == *t)) {
+			if (!r.value().empty() && (r.value().front()->type == *t)) {
 				list.push_back(ResourceID());
 
-				list.back().name = r->second.front().name;
-				list.back().type = r->second.front().type;
-				list.back().hash = r->first;
+				list.back().name = r.value().front()->name;
+				list.back().type = r.value().front()->type;
+				list.back().hash = r.key();
 			}
 		}
 
@@ -820,6 +1428,123 @@ void ResourceManager::getAvailableResources(ResourceType type,
 	getAvailableResources(_resourceTypeTypes[type], list);
 }
 
+ResourceRequest *ResourceManager::requestResource(const Common::UString &name, FileType type,
+                                                  uint32 priority) {
+
+	return requestResource(name, std::vector<FileType>(1, type), priority);
+}
+
+ResourceRequest *ResourceManager::requestResource(ResourceType resType, const Common::UString &name,
+                                                  uint32 priority) {
+
+	assert((resType >= 0) && (resType < kResourceMAX));
+
+	return requestResource(name, _resourceTypeTypes[resType], priority);
+}
+
+ResourceRequest *ResourceManager::requestResource(const Common::UString &name,
+		const std::vector<FileType> &types, uint32 priority) {
+
+	return _loader.request(boost::bind(&ResourceManager::loadResource, this, name, types, _1), priority);
+}
+
+void ResourceManager::prefetchResource(const Common::UString &name, FileType type, uint32 priority) {
+	Common::StackLock lock(_mutex);
+
+	const Resource *res = getRes(name, type);
+	if (!res || (_prefetches.find(res) != _prefetches.end()))
+		return;
+
+	std::vector<FileType> types(1, type);
+
+	_prefetches[res] = _loader.request(boost::bind(&ResourceManager::loadResource, this, name, types, _1), priority);
+}
+
+void ResourceManager::dropPrefetches() {
+	Common::StackLock lock(_mutex);
+
+	for (PrefetchMap::iterator p = _prefetches.begin(); p != _prefetches.end(); ++p)
+		_loader.discard(p->second);
+
+	_prefetches.clear();
+}
+
+Common::SeekableReadStream *ResourceManager::loadResource(const Common::UString &name,
+		const std::vector<FileType> &types, FileType &foundType) const {
+
+	/* Runs in a loader thread. Like getResource(), but ignores the prefetched resources.
+	 * The lock is only held to find the resource, so the loader threads and the
+	 * main thread can read and decompress resources at the same time. */
+
+	ResourceRead read;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		const Resource *res = getRes(name, types);
+		if (!res)
+			return 0;
+
+		foundType = res->type;
+
+		Common::SeekableReadStream *cached = prepareRead(*res, false, read);
+		if (cached)
+			return cached;
+	}
+
+	return readResource(read);
+}
+
+ResourceRequest *ResourceManager::takePrefetch(const Resource &res) const {
+	PrefetchMap::iterator p = _prefetches.find(&res);
+	if (p == _prefetches.end())
+		return 0;
+
+	ResourceRequest *request = p->second;
+	_prefetches.erase(p);
+
+	return request;
+}
+
+Common::SeekableReadStream *ResourceManager::getPrefetchedResource(ResourceRequest *prefetch,
+		const Common::UString &name, const std::vector<FileType> &types) const {
+
+	// The prefetch is waited upon without holding the lock, so the loader threads can continue
+
+	Common::SeekableReadStream *stream = 0;
+	try {
+		stream = prefetch->getStream();
+	} catch (...) {
+		delete prefetch;
+		throw;
+	}
+
+	bool cancelled = prefetch->isCancelled();
+	delete prefetch;
+
+	if (cancelled) {
+		// The resources changed while we were waiting. Just load it again
+
+		ResourceRead read;
+
+		{
+			Common::StackLock lock(_mutex);
+
+			const Resource *res = getRes(name, types);
+			if (!res)
+				return 0;
+
+			Common::SeekableReadStream *cached = prepareRead(*res, false, read);
+			if (cached)
+				return cached;
+		}
+
+		return readResource(read);
+	}
+
+	return stream;
+}
+
 ArchiveType ResourceManager::getArchiveType(FileType type) const {
 	for (size_t i = 0; i < kArchiveMAX; i++)
 		if (_archiveTypeTypes[i].find(type) != _archiveTypeTypes[i].end())
@@ -886,17 +1611,17 @@ inline uint64 ResourceManager::getHash(const Common::UString &name) const {
 	return Common::hashString(name.toLower(), _hashAlgo);
 }
 
-void ResourceManager::checkHashCollision(const Resource &resource, ResourceMap::const_iterator resList) {
-	if (resource.name.empty() || resList->second.empty())
+void ResourceManager::checkHashCollision(const Resource &resource, const ResourceList &resList) {
+	if (resource.name.empty() || resList.empty())
 		return;
 
 	Common::UString newName = TypeMan.setFileType(resource.name, resource.type).toLower();
 
-	for (ResourceList::const_iterator r = resList->second.begin(); r != resList->second.end(); ++r) {
-		if (r->name.empty())
+	for (ResourceList::const_iterator r = resList.begin(); r != resList.end(); ++r) {
+		if ((*r)->name.empty())
 			continue;
 
-		Common::UString oldName = TypeMan.setFileType(r->name, r->type).toLower();
+		Common::UString oldName = TypeMan.setFileType((*r)->name, (*r)->type).toLower();
 		if (oldName != newName) {
 			warning("ResourceManager: Found hash collision: %s (\"%s\" and \"%s\")",
 					Common::formatHash(getHash(oldName)).c_str(), oldName.c_str(), newName.c_str());
@@ -936,37 +1661,66 @@ bool ResourceManager::checkResourceIsArchive(Resource &resource, Change *change)
 	return true;
 }
 
-void ResourceManager::addResource(Resource &resource, uint64 hash, Change *change) {
-	ResourceMap::iterator resList = _resources.find(hash);
-	if (resList == _resources.end()) {
-		// We don't have a resource with this name yet, create a new resource list for it
-
-		std::pair<ResourceMap::iterator, bool> result;
+ResourceManager::Resource *ResourceManager::allocResource(const Resource &resource) {
+	if (_freeResources.empty()) {
+		// No free resource records left, allocate a new block of them
 
-		result = _resources.insert(std::make_pair(hash, ResourceList()));
+		Resource *block = new Resource[kResourceBlockSize];
+		_resourceBlocks.push_back(block);
 
-		resList = result.first;
+		_freeResources.reserve(kResourceBlockSize);
+		for (size_t i = kResourceBlockSize; i-- > 0; )
+			_freeResources.push_back(&block[i]);
 	}
 
+	Resource *res = _freeResources.back();
+	_freeResources.pop_back();
+
+	*res = resource;
+
+	res->changeID = ++_lastChangeID;
+
+	return res;
+}
+
+void ResourceManager::freeResource(Resource *resource) {
+	uncacheResource(resource);
+
+	*resource = Resource();
+
+	_freeResources.push_back(resource);
+}
+
+void ResourceManager::freeResources() {
+	for (std::vector<Resource *>::iterator b = _resourceBlocks.begin(); b != _resourceBlocks.end(); ++b)
+		delete[] *b;
+
+	_resourceBlocks.clear();
+	_freeResources.clear();
+}
+
+void ResourceManager::addResource(Resource &resource, uint64 hash, Change *change) {
+	// Find the resource list for this name, creating it if necessary
+	ResourceList &resList = _resources[hash];
+
 #ifdef CHECK_HASH_COLLISION
 	checkHashCollision(resource, resList);
 #endif
 
-	// Add the resource to the list
-	resList->second.push_back(resource);
-	Resource *res = &resList->second.back();
+	Resource *res = allocResource(resource);
 
 	checkResourceIsArchive(*res, change);
 
 	// Remember the resource in the change set
 	if (change) {
 		change->_change->resources.push_back(ResourceChange());
-		change->_change->resources.back().hashIt = resList;
-		change->_change->resources.back().resIt  = --resList->second.end();
+		change->_change->resources.back().hash     = hash;
+		change->_change->resources.back().resource = res;
 	}
 
-	// Resort the list by priority
-	resList->second.sort();
+	/* Add the resource to the list, keeping it sorted by priority. Resources
+	 * with the same priority are kept in the order they were added in. */
+	resList.insert(std::upper_bound(resList.begin(), resList.end(), res, Resource::comparePriority), res);
 }
 
 void ResourceManager::addResource(const Common::UString &path, Change *change, uint32 priority) {
@@ -1000,11 +1754,11 @@ void ResourceManager::addResources(const Common::FileList &files, Change *change
 }
 
 const ResourceManager::Resource *ResourceManager::getRes(uint64 hash) const {
-	ResourceMap::const_iterator r = _resources.find(hash);
-	if ((r == _resources.end()) || r->second.empty() || (r->second.back().priority == 0))
+	const ResourceList *r = _resources.find(hash);
+	if (!r || r->empty() || (r->back()->priority == 0))
 		return 0;
 
-	return &r->second.back();
+	return r->back();
 }
 
 const ResourceManager::Resource *ResourceManager::getRes(const Common::UString &name,
@@ -1036,6 +1790,8 @@ const ResourceManager::Resource *ResourceManager::getRes(const Common::UString &
 }
 
 void ResourceManager::dumpResourcesList(const Common::UString &fileName) const {
+	Common::StackLock lock(_mutex);
+
 	Common::WriteFile file;
 
 	if (!file.open(fileName))
@@ -1044,15 +1800,22 @@ void ResourceManager::dumpResourcesList(const Common::UString &fileName) const {
 	file.writeString("                Name                 |        Hash        |     Size    \n");
 	file.writeString("-------------------------------------|--------------------|-------------\n");
 
-	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r) {
-		if (r->second.empty())
-			continue;
+	// Sort the list by hash, to get a stable output
+	std::vector<uint64> hashes;
+	hashes.reserve(_resources.size());
+
+	for (ResourceMap::const_iterator r = _resources.begin(); r != _resources.end(); ++r)
+		if (!r.value().empty())
+			hashes.push_back(r.key());
+
+	std::sort(hashes.begin(), hashes.end());
 
-		const Resource &res = r->second.back();
+	for (std::vector<uint64>::const_iterator h = hashes.begin(); h != hashes.end(); ++h) {
+		const Resource &res = *_resources.find(*h)->back();
 
 		const Common::UString &name = res.name;
 		const Common::UString   ext = TypeMan.setFileType("", res.type);
-		const uint64           hash = r->first;
+		const uint64           hash = *h;
 		const uint32           size = getResourceSize(res);
 
 		const Common::UString line =
@@ -30,14 +30,21 @@
 #include <map>
 #include <set>
 
+#include <boost/shared_array.hpp>
+
 #include "src/common/types.h"
 #include "src/common/ustring.h"
 #include "src/common/singleton.h"
 #include "src/common/filelist.h"
 #include "src/common/hash.h"
 #include "src/common/changeid.h"
+#include "src/common/flathashmap.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/types.h"
+#include "src/aurora/archive.h"
+#include "src/aurora/indexcache.h"
+#include "src/aurora/resloader.h"
 
 namespace Common {
 	class SeekableReadStream;
@@ -45,12 +52,14 @@ namespace Common {
 
 namespace Aurora {
 
-class Archive;
 class KEYFile;
 class BIFFile;
 
 /** A resource manager holding information about and handling all request for all
  *  resources usable by the game.
+ *
+ *  All public methods are thread-safe. Resources can also be loaded asynchronously,
+ *  by a pool of loader threads, see requestResource() and prefetchResource().
  */
 class ResourceManager : public Common::Singleton<ResourceManager> {
 public:
@@ -60,6 +69,30 @@ public:
 		uint64 hash;
 	};
 
+	/** Statistics about the time spent indexing archives. */
+	struct IndexStats {
+		uint32 archivesCached;  ///< Number of archives indexed from the index cache.
+		uint32 archivesIndexed; ///< Number of archives indexed by reading the archive.
+
+		uint64 timeCached;  ///< Time spent indexing archives from the cache, in microseconds.
+		uint64 timeIndexed; ///< Time spent indexing archives by reading them, in microseconds.
+
+		IndexStats();
+	};
+
+	/** Statistics about the cache of decompressed resources. */
+	struct CacheStats {
+		uint64 hits;      ///< Number of resources found in the cache.
+		uint64 misses;    ///< Number of resources decompressed and put into the cache.
+		uint64 evictions; ///< Number of resources dropped from the cache to make room.
+
+		size_t entries; ///< Number of resources currently in the cache.
+		size_t size;    ///< Memory currently used by the cache, in bytes.
+		size_t budget;  ///< Maximum memory the cache may use, in bytes.
+
+		CacheStats();
+	};
+
 	ResourceManager();
 	~ResourceManager();
 
@@ -137,6 +170,60 @@ public:
 	                  Common::ChangeID *changeID = 0);
 	// '---
 
+	// .--- Index cache
+	/** Use a persistent cache file for the resource indices of archives.
+	 *
+	 *  Archives that are found unchanged in the cache will not be read when
+	 *  indexing them. Instead, their list of resources is taken from the cache,
+	 *  and the archive itself is only opened once a resource is requested from it.
+	 *
+	 *  The index cache setting is kept over clear() calls.
+	 *
+	 *  @param file The cache file to use. If empty, don't use an index cache.
+	 */
+	void setIndexCache(const Common::UString &file);
+
+	/** Write the index cache back to disk, if anything changed. */
+	void saveIndexCache();
+
+	/** Return statistics about the time spent indexing archives since the data base was registered. */
+	const IndexStats &getIndexStats() const;
+	// '---
+
+	// .--- Archive mapping
+	/** Map archive files into memory, instead of reading them through a file handle.
+	 *
+	 *  Resources that are neither compressed nor encrypted are then returned
+	 *  as streams pointing straight into the mapping, without copying them
+	 *  and without sharing a file handle between concurrent readers.
+	 *
+	 *  Only affects archives opened after this call. The setting is kept
+	 *  over clear() calls. By default, archives are mapped on 64-bit systems.
+	 */
+	void setMapArchives(bool mapArchives);
+
+	/** Are archive files mapped into memory? */
+	bool getMapArchives() const;
+	// '---
+
+	// .--- Resource cache
+	/** Set the maximum memory used for caching decompressed resources.
+	 *
+	 *  Resources that need to be decompressed or decrypted when read (compressed
+	 *  ERF and ZIP entries, "small" files, ...) are kept in memory after reading,
+	 *  and handed out as shared read-only streams on subsequent requests. When the
+	 *  cache exceeds its budget, the least recently used resources are dropped.
+	 *
+	 *  The setting is kept over clear() calls.
+	 *
+	 *  @param size The maximum size of the cache, in bytes. 0 disables the cache.
+	 */
+	void setResourceCacheSize(size_t size);
+
+	/** Return statistics about the cache of decompressed resources. */
+	CacheStats getCacheStats() const;
+	// '---
+
 	// .--- Directories and files
 	/** Does a specific directory, relative to the base directory, exist?
 	 *
@@ -324,6 +411,45 @@ public:
 	Common::SeekableReadStream *getResource(ResourceType resType,
 			const Common::UString &name, FileType *foundType = 0) const;
 
+	/** Return a resource, mapped into memory if possible.
+	 *
+	 *  Resources found as plain files are mapped into memory as a whole,
+	 *  resources within archives are returned without copying them, if
+	 *  the archive allows it. Otherwise, this is the same as getResource().
+	 *
+	 *  This is meant for big resources that are kept around for a long
+	 *  time and read randomly, like talk tables.
+	 *
+	 *  @param  name The name (ResRef) of the resource.
+	 *  @param  type The resource's type.
+	 *  @return The resource stream or 0 if the resource doesn't exist.
+	 */
+	Common::SeekableReadStream *getResourceMapped(const Common::UString &name, FileType type) const;
+
+	/** Return an ID identifying the resource currently found under this name and type.
+	 *
+	 *  The ID changes whenever a different resource takes over the name, for
+	 *  example because an archive overriding it was indexed or undone. IDs are
+	 *  never reused, so they can be used to check whether data derived from a
+	 *  resource is still current.
+	 *
+	 *  @param  name The name (ResRef) of the resource.
+	 *  @param  type The resource's type.
+	 *  @return The resource's change ID, or 0 if the resource doesn't exist.
+	 */
+	uint64 getResourceChangeID(const Common::UString &name, FileType type) const;
+
+	/** Return an ID identifying the resource currently found under this name and resource type.
+	 *
+	 *  Like getResourceChangeID(const Common::UString &, FileType), but for
+	 *  whichever file type getResource(ResourceType, const Common::UString &)
+	 *  would return.
+	 */
+	uint64 getResourceChangeID(ResourceType resType, const Common::UString &name) const;
+
+	/** Return a counter that increases whenever resources are removed, by undo() or clear(). */
+	uint32 getRemovalCount() const;
+
 	/** Return a list of all available resources of the specified type. */
 	void getAvailableResources(FileType type, std::list<ResourceID> &list) const;
 	/** Return a list of all available resources of the specified type. */
@@ -332,6 +458,56 @@ public:
 	void getAvailableResources(ResourceType type, std::list<ResourceID> &list) const;
 	// '---
 
+	// .--- Asynchronous resource loading
+	/** Request a resource to be loaded in the background.
+	 *
+	 *  The lookup of the resource happens in the loader thread as well, taking
+	 *  into account all changes to the known resources up until then.
+	 *
+	 *  @param  name The name (ResRef) of the resource.
+	 *  @param  type The resource's type.
+	 *  @param  priority Requests with a higher priority are loaded first.
+	 *  @return A handle on the request. The caller takes over the handle.
+	 */
+	ResourceRequest *requestResource(const Common::UString &name, FileType type, uint32 priority = 0);
+
+	/** Request a resource to be loaded in the background.
+	 *
+	 *  @param  name The name (ResRef) of the resource.
+	 *  @param  types A list of file types to look for.
+	 *  @param  priority Requests with a higher priority are loaded first.
+	 *  @return A handle on the request. The caller takes over the handle.
+	 */
+	ResourceRequest *requestResource(const Common::UString &name, const std::vector<FileType> &types,
+	                                 uint32 priority = 0);
+
+	/** Request a resource of a specific type to be loaded in the background.
+	 *
+	 *  @param  resType The type of the resource.
+	 *  @param  name The name (ResRef or path) of the resource.
+	 *  @param  priority Requests with a higher priority are loaded first.
+	 *  @return A handle on the request. The caller takes over the handle.
+	 */
+	ResourceRequest *requestResource(ResourceType resType, const Common::UString &name, uint32 priority = 0);
+
+	/** Start loading a resource in the background, for a later getResource() call.
+	 *
+	 *  Useful for loading many resources, like all models of an area: prefetch
+	 *  all of them up front, then load them as usual. The getResource() calls
+	 *  will then pick up the prefetched data, waiting for it if necessary.
+	 *
+	 *  Any change to the known resources drops all prefetched resources.
+	 *
+	 *  @param name The name (ResRef) of the resource.
+	 *  @param type The resource's type.
+	 *  @param priority Requests with a higher priority are loaded first.
+	 */
+	void prefetchResource(const Common::UString &name, FileType type, uint32 priority = 0);
+
+	/** Drop all prefetched resources that haven't been picked up yet. */
+	void dropPrefetches();
+	// '---
+
 	/** Dump a list of all resources into a file. */
 	void dumpResourcesList(const Common::UString &fileName) const;
 
@@ -359,9 +535,12 @@ private:
 	};
 
 	struct OpenedArchive {
-		/** The actual archive. */
+		/** The actual archive, or 0 if it has been indexed from the cache and not yet opened. */
 		Archive *archive;
 
+		/** The password to decrypt the archive with, for opening it later. */
+		std::vector<byte> password;
+
 		/** The information we know about this archive. */
 		KnownArchive *known;
 
@@ -372,7 +551,7 @@ private:
 
 		OpenedArchive();
 
-		void set(KnownArchive &kA, Archive &a);
+		void set(KnownArchive &kA, Archive *a, const std::vector<byte> &p);
 	};
 
 	/** List of all known archive files. */
@@ -400,6 +579,9 @@ private:
 		/** The resource's priority over others with the same name and type. */
 		uint32 priority;
 
+		/** Uniquely identifies this resource record and its current name and type. */
+		uint64 changeID;
+
 		/** The archive this resource itself is. */
 		std::pair<KnownArchives *, KnownArchives::iterator> selfArchive;
 
@@ -416,12 +598,75 @@ private:
 		Resource();
 
 		bool operator<(const Resource &right) const;
+
+		/** Compare two resource pointers by priority. */
+		static bool comparePriority(const Resource *left, const Resource *right);
 	};
 
-	/** List of resources, sorted by priority. */
-	typedef std::list<Resource> ResourceList;
+	/** List of resources with the same hash, sorted by priority. */
+	typedef std::vector<Resource *> ResourceList;
 	/** Map over resources, indexed by their hashed name. */
-	typedef std::map<uint64, ResourceList> ResourceMap;
+	typedef Common::FlatHashMap<ResourceList> ResourceMap;
+
+	/** Prefetched resources, by the resource they are for. */
+	typedef std::map<const Resource *, ResourceRequest *> PrefetchMap;
+
+	/** A decompressed resource in the resource cache. */
+	struct CachedResource {
+		const Resource *resource; ///< The resource this is the data of.
+
+		boost::shared_array<const byte> data; ///< The decompressed data.
+		size_t size; ///< The size of the decompressed data.
+	};
+
+	/** All cached resources, the most recently used first. */
+	typedef std::list<CachedResource> ResourceCacheList;
+	/** Cached resources, by the resource they are for. */
+	typedef std::map<const Resource *, ResourceCacheList::iterator> ResourceCacheMap;
+
+	/** A resource read, prepared with the lock held and done without it. */
+	struct ResourceRead {
+		/** The resource. Only valid as long as no resources have been removed. */
+		const Resource *resource;
+		/** The number of resource removals when the read was prepared. */
+		uint32 removals;
+
+		Source          source;       ///< Where the resource can be found.
+		Common::UString path;         ///< The file's path, for kSourceFile.
+		uint32          archiveIndex; ///< Index into the archive, for kSourceArchive.
+
+		Archive *archive;     ///< The archive to read from, kept alive during the read.
+		Archive *rootArchive; ///< The archive that owns the underlying file stream.
+
+		Common::Mutex *archiveLock; ///< The lock of the root archive's stream.
+
+		bool isSmall;   ///< Does the resource need to be decompressed?
+		bool tryNoCopy; ///< Try not to copy the resource data?
+		bool cacheable; ///< Should the decompressed data be cached?
+
+		ResourceRead();
+	};
+
+	/** Bookkeeping for archives that are read from without holding the lock. */
+	struct ArchiveUse {
+		/** Serializes access to the archive's stream. */
+		Common::Mutex *lock;
+		/** Number of reads currently using the archive. */
+		uint32 readers;
+		/** Has the archive been removed while it was still being read? */
+		bool retired;
+
+		ArchiveUse();
+	};
+
+	/** Archive bookkeeping, by archive. */
+	typedef std::map<const Archive *, ArchiveUse> ArchiveUseMap;
+
+	/** Number of loader threads for asynchronous resource loading. */
+	static const size_t kLoaderThreads = 2;
+
+	/** Number of resource records allocated in one go. */
+	static const size_t kResourceBlockSize = 4096;
 	// '---
 
 	// .--- Changes
@@ -431,8 +676,8 @@ private:
 	typedef OpenedArchives::iterator OpenedArchiveChange;
 	/** A change produced by indexing archive resources. */
 	struct ResourceChange {
-		ResourceMap::iterator  hashIt;
-		ResourceList::iterator resIt;
+		uint64    hash;     ///< The hash the resource was added under.
+		Resource *resource; ///< The added resource.
 	};
 
 	typedef std::list<KnownArchiveChange>  KnownArchiveChanges;
@@ -487,9 +732,40 @@ private:
 	ResourceMap   _resources; ///< All currently known resources.
 	ChangeSetList _changes;   ///< Changes produced by indexing the currently known resources.
 
+	std::vector<Resource *> _resourceBlocks; ///< Storage for all resource records.
+	std::vector<Resource *> _freeResources;  ///< Currently unused resource records.
+
+	uint64 _lastChangeID; ///< The last change ID given to a resource record.
+	uint32 _removals;     ///< Number of times resources have been removed.
+
 	FileTypeSet  _archiveTypeTypes [kArchiveMAX];  ///< All valid archive types file types.
 	FileTypeList _resourceTypeTypes[kResourceMAX]; ///< All valid resource type file types.
 
+	Common::UString _indexCacheFile; ///< The file the index cache is stored in.
+	IndexCache      _indexCache;     ///< The persistent cache of archive indices.
+
+	IndexStats _indexStats; ///< Time spent indexing archives.
+
+	bool _mapArchives; ///< Map archive files into memory?
+
+	mutable ResourceCacheList _cache;      ///< Cached decompressed resources.
+	mutable ResourceCacheMap  _cacheMap;   ///< Cached decompressed resources, by resource.
+	mutable CacheStats        _cacheStats; ///< Statistics about the resource cache.
+
+	ResourceLoader      _loader;     ///< Loader threads for asynchronous resource loading.
+	mutable PrefetchMap _prefetches; ///< Prefetched resources waiting to be picked up.
+
+	/** Archives currently being read from, or with a stream lock. */
+	mutable ArchiveUseMap _archiveUses;
+
+	/** Lock protecting everything. Recursive, so public methods can call each other.
+	 *
+	 *  Reading and decompressing resource data happens without holding it, see
+	 *  prepareRead() and readResource(). Instead, the stream of each archive has
+	 *  its own lock, which is only ever taken after this one.
+	 */
+	mutable Common::Mutex _mutex;
+
 
 	void clearResources();
 
@@ -499,17 +775,38 @@ private:
 	// '---
 
 	// .--- Indexing archives
-	void indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change);
+	void indexKEY(Common::SeekableReadStream *stream, uint32 priority, Change *change,
+	              IndexCache::Entry *cacheEntry);
 	uint32 openKEYBIFs(Common::SeekableReadStream *keyStream,
 	                   std::vector<KnownArchive *> &archives, std::vector<BIFFile *> &bifs);
 
 	void indexArchive(KnownArchive &knownArchive, Archive *archive,
 	                  uint32 priority, Change *change);
+	void indexArchive(KnownArchive &knownArchive, Archive *archive,
+	                  const Archive::ResourceList &resources, Common::HashAlgo hashAlgo,
+	                  const std::vector<byte> &password, uint32 priority, Change *change);
 
 	Common::SeekableReadStream *openArchiveStream(const KnownArchive &archive) const;
+
+	Archive *createArchive(const KnownArchive &knownArchive, const std::vector<byte> &password) const;
+	Archive *getArchive(OpenedArchive &archive) const;
+
+	Archive *getRootArchive(OpenedArchive &archive) const;
+	Common::Mutex &getArchiveLock(const Archive *archive) const;
+	void retireArchive(Archive *archive);
+	// '---
+
+	// .--- Index cache
+	bool isCacheable(const KnownArchive &archive) const;
+
+	bool indexCachedArchive(KnownArchive &knownArchive, uint32 priority,
+	                        const std::vector<byte> &password, Change *change);
 	// '---
 
 	// .--- Adding resources
+	Resource *allocResource(const Resource &resource);
+	void freeResource(Resource *resource);
+	void freeResources();
 
 	bool checkResourceIsArchive(Resource &resource, Change *change);
 
@@ -526,11 +823,35 @@ private:
 
 	Common::SeekableReadStream *getResource(const Resource &res, bool tryNoCopy = false) const;
 
-	Common::SeekableReadStream *getArchiveResource(const Resource &res, bool tryNoCopy = false) const;
+	Common::SeekableReadStream *prepareRead(const Resource &res, bool tryNoCopy, ResourceRead &read) const;
+	Common::SeekableReadStream *readResource(const ResourceRead &read) const;
+	void finishRead(const ResourceRead &read) const;
+	void releaseArchive(const Archive *archive) const;
 
 	uint32 getResourceSize(const Resource &res) const;
 	// '---
 
+	// .--- Resource cache
+	bool isResourceCompressed(const Resource &res) const;
+
+	Common::SeekableReadStream *getCachedResource(const Resource &res) const;
+	Common::SeekableReadStream *cacheResource(const ResourceRead &read, Common::SeekableReadStream *stream) const;
+
+	void uncacheResource(const Resource *res);
+	void clearCache();
+	void trimCache() const;
+	// '---
+
+	// .--- Asynchronous resource loading
+	Common::SeekableReadStream *loadResource(const Common::UString &name,
+	                                         const std::vector<FileType> &types, FileType &foundType) const;
+
+	ResourceRequest *takePrefetch(const Resource &res) const;
+
+	Common::SeekableReadStream *getPrefetchedResource(ResourceRequest *prefetch, const Common::UString &name,
+	                                                  const std::vector<FileType> &types) const;
+	// '---
+
 	// .--- Resource utility methods
 	bool normalizeType(Resource &resource);
 
@@ -541,7 +862,7 @@ private:
 	inline uint64 getHash(const Common::UString &name, FileType type) const;
 	inline uint64 getHash(const Common::UString &name) const;
 
-	void checkHashCollision(const Resource &resource, ResourceMap::const_iterator resList);
+	void checkHashCollision(const Resource &resource, const ResourceList &resList);
 
 	Change *newChangeSet(Common::ChangeID &changeID);
 	// '---
@@ -22,11 +22,13 @@
  *  The global talk manager for Aurora strings.
  */
 
+#include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/ustring.h"
 #include "src/common/readstream.h"
 #include "src/common/uuid.h"
 #include "src/common/encoding.h"
+#include "src/common/timestamp.h"
 
 #include "src/aurora/talkman.h"
 #include "src/aurora/resman.h"
@@ -36,7 +38,10 @@ DECLARE_SINGLETON(Aurora::TalkManager)
 
 namespace Aurora {
 
-TalkManager::TalkManager() {
+/** Number of threads used to predecode talk tables. */
+static const size_t kPredecodeThreads = 4;
+
+TalkManager::TalkManager() : _predecode(false) {
 }
 
 TalkManager::~TalkManager() {
@@ -44,6 +49,8 @@ TalkManager::~TalkManager() {
 }
 
 void TalkManager::clear() {
+	Common::StackLock lock(_mutex);
+
 	for (Tables::iterator t = _tablesMain.begin(); t != _tablesMain.end(); ++t)
 		deleteTable(*t);
 	for (Tables::iterator t = _tablesAlt.begin(); t != _tablesAlt.end(); ++t)
@@ -53,11 +60,27 @@ void TalkManager::clear() {
 	_tablesAlt.clear();
 }
 
+void TalkManager::setPredecode(bool predecode) {
+	_predecode = predecode;
+}
+
+static void predecodeTable(TalkTable *table, const Common::UString &name) {
+	if (!table)
+		return;
+
+	const uint64 startTime = Common::getMicroTimestamp();
+
+	table->predecode(kPredecodeThreads);
+
+	status("Predecoded talk table \"%s\" in %.3fs", name.c_str(),
+	       (Common::getMicroTimestamp() - startTime) / 1000000.0);
+}
+
 static TalkTable *loadTable(const Common::UString &name, Common::Encoding encoding) {
 	if (name.empty())
 		return 0;
 
-	Common::SeekableReadStream *tlk = ResMan.getResource(name, kFileTypeTLK);
+	Common::SeekableReadStream *tlk = ResMan.getResourceMapped(name, kFileTypeTLK);
 	if (!tlk)
 		return 0;
 
@@ -87,6 +110,13 @@ void TalkManager::addTable(const Common::UString &nameMale, const Common::UStrin
 	if (!tableMale && !tableFemale)
 		throw Common::Exception("No such talk table \"%s\"/\"%s\"", nameMale.c_str(), nameFemale.c_str());
 
+	if (_predecode) {
+		predecodeTable(tableMale  , nameMale);
+		predecodeTable(tableFemale, nameFemale);
+	}
+
+	Common::StackLock lock(_mutex);
+
 	Tables *tables = &_tablesMain;
 	if (isAlt)
 		tables = &_tablesAlt;
@@ -113,6 +143,8 @@ void TalkManager::removeTable(Common::ChangeID &changeID) {
 	if (!change)
 		return;
 
+	Common::StackLock lock(_mutex);
+
 	Tables *tables = &_tablesMain;
 	if (change->_isAlt)
 		tables = &_tablesAlt;
@@ -137,6 +169,12 @@ const Common::UString &TalkManager::getString(uint32 strRef, LanguageGender gend
 	if (strRef == kStrRefInvalid)
 		return kEmptyString;
 
+	/* The talk table itself is safe to use from several threads, but we
+	 * need to hold the lock until we're done with it, so that it can't be
+	 * removed underneath us. */
+
+	Common::StackLock lock(_mutex);
+
 	const TalkTable *table = find(strRef, gender);
 	if (!table)
 		return kEmptyString;
@@ -151,6 +189,8 @@ const Common::UString &TalkManager::getSoundResRef(uint32 strRef, LanguageGender
 	if (strRef == kStrRefInvalid)
 		return kEmptyString;
 
+	Common::StackLock lock(_mutex);
+
 	const TalkTable *table = find(strRef, gender);
 	if (!table)
 		return kEmptyString;
@@ -31,6 +31,7 @@
 #include "src/common/ustring.h"
 #include "src/common/singleton.h"
 #include "src/common/changeid.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/language.h"
 
@@ -38,7 +39,12 @@ namespace Aurora {
 
 class TalkTable;
 
-/** The global Aurora talk manager, holding the current talk tables. */
+/** The global Aurora talk manager, holding the current talk tables.
+ *
+ *  getString() and getSoundResRef() may be called from several threads
+ *  at the same time. The returned strings stay valid until the talk
+ *  table they were found in is removed again.
+ */
 class TalkManager : public Common::Singleton<TalkManager> {
 public:
 	TalkManager();
@@ -46,6 +52,12 @@ public:
 
 	void clear();
 
+	/** Decode all strings of newly added talk tables right away, in several threads?
+	 *
+	 *  Otherwise, strings are only decoded once they're requested.
+	 */
+	void setPredecode(bool predecode);
+
 	/** Add a talk table to the talk manager.
 	 *
 	 *  @param nameMale   Resource name of the male version.
@@ -98,6 +110,10 @@ private:
 	Tables _tablesMain;
 	Tables _tablesAlt;
 
+	bool _predecode;
+
+	mutable Common::Mutex _mutex;
+
 
 	void deleteTable(Table &table);
 
@@ -41,6 +41,9 @@ TalkTable::TalkTable(Common::Encoding encoding) : _encoding(encoding) {
 TalkTable::~TalkTable() {
 }
 
+void TalkTable::predecode(size_t UNUSED(threadCount)) {
+}
+
 TalkTable *TalkTable::load(Common::SeekableReadStream *tlk, Common::Encoding encoding) {
 	if (!tlk)
 		return 0;
@@ -56,6 +56,15 @@ public:
 	virtual const Common::UString &getString     (uint32 strRef) const = 0;
 	virtual const Common::UString &getSoundResRef(uint32 strRef) const = 0;
 
+	/** Decode all strings up front, using this many threads.
+	 *
+	 *  Talk tables usually decode their strings only when they are first
+	 *  requested. This moves all that work to the time of calling, for
+	 *  callers that can't afford the latency later on. Talk tables that
+	 *  can't make use of this simply ignore it.
+	 */
+	virtual void predecode(size_t threadCount);
+
 	/** Take over this stream and read a talk table (of either format) out of it. */
 	static TalkTable *load(Common::SeekableReadStream *tlk, Common::Encoding encoding);
 
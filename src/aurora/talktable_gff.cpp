@@ -64,6 +64,8 @@ bool TalkTable_GFF::hasEntry(uint32 strRef) const {
 
 static const Common::UString kEmptyString = "";
 const Common::UString &TalkTable_GFF::getString(uint32 strRef) const {
+	Common::StackLock lock(_mutex);
+
 	Entries::iterator e = _entries.find(strRef);
 	if (e == _entries.end())
 		return kEmptyString;
@@ -29,6 +29,7 @@
 
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/mutex.h"
 
 #include "src/aurora/types.h"
 #include "src/aurora/talktable.h"
@@ -73,6 +74,9 @@ private:
 
 	mutable Entries _entries;
 
+	/** Mutex guarding the lazy decoding of strings. */
+	mutable Common::Mutex _mutex;
+
 	void load(Common::SeekableReadStream *tlk);
 	void load02(const GFF4Struct &top);
 	void load05(const GFF4Struct &top);
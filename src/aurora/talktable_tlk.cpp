@@ -33,6 +33,7 @@
 #include "src/common/memreadstream.h"
 #include "src/common/readfile.h"
 #include "src/common/error.h"
+#include "src/common/thread.h"
 
 #include "src/aurora/talktable_tlk.h"
 #include "src/aurora/language.h"
@@ -41,16 +42,88 @@ static const uint32 kTLKID    = MKTAG('T', 'L', 'K', ' ');
 static const uint32 kVersion3 = MKTAG('V', '3', '.', '0');
 static const uint32 kVersion4 = MKTAG('V', '4', '.', '0');
 
+static const uint32 kEntrySizeV3 = 40;
+static const uint32 kEntrySizeV4 = 10;
+
 namespace Aurora {
 
+static const Common::UString kEmptyString = "";
+
+/** A thread decoding a range of strings in a TLK. */
+class TLKPredecodeThread : public Common::Thread {
+public:
+	TLKPredecodeThread(const TalkTable_TLK &tlk, uint32 begin, uint32 end) :
+		_tlk(&tlk), _begin(begin), _end(end) {
+	}
+
+	~TLKPredecodeThread() {
+		destroyThread();
+	}
+
+	/** Wait for the decoding to finish. */
+	void wait() {
+		_done.lock();
+	}
+
+	/** Decode all strings in the range. */
+	void decode() {
+		try {
+			for (uint32 i = _begin; i < _end; i++) {
+				_tlk->getString(i);
+				_tlk->getSoundResRef(i);
+			}
+		} catch (...) {
+			// Broken strings will be tried (and fail) again when they're actually requested
+		}
+	}
+
+private:
+	const TalkTable_TLK *_tlk;
+
+	uint32 _begin;
+	uint32 _end;
+
+	Common::Semaphore _done;
+
+	void threadMethod() {
+		decode();
+
+		_done.unlock();
+	}
+};
+
+
 TalkTable_TLK::TalkTable_TLK(Common::SeekableReadStream *tlk, Common::Encoding encoding) :
-	TalkTable(encoding), _tlk(tlk) {
+	TalkTable(encoding), _tlk(tlk), _data(0), _size(0), _stringsOffset(0), _languageID(0),
+	_entryCount(0), _entryOffset(0), _entrySize(0), _texts(0), _soundResRefs(0), _arenaFill(0) {
 
 	load();
 }
 
 TalkTable_TLK::~TalkTable_TLK() {
+	clear();
+}
+
+void TalkTable_TLK::clear() {
+	delete[] _texts;
+	delete[] _soundResRefs;
+
+	_texts        = 0;
+	_soundResRefs = 0;
+
+	for (std::vector<Common::UString *>::iterator a = _arena.begin(); a != _arena.end(); ++a)
+		delete[] *a;
+
+	_arena.clear();
+	_arenaFill = 0;
+
 	delete _tlk;
+	_tlk = 0;
+
+	_data = 0;
+	_size = 0;
+
+	_entryCount = 0;
 }
 
 void TalkTable_TLK::load() {
@@ -66,78 +139,131 @@ void TalkTable_TLK::load() {
 			throw Common::Exception("Unsupported TLK file version %s", Common::debugTag(_version).c_str());
 
 		_languageID = _tlk->readUint32LE();
-
-		uint32 stringCount = _tlk->readUint32LE();
-		_entries.resize(stringCount);
+		_entryCount = _tlk->readUint32LE();
 
 		// V4 added this field; it's right after the header in V3
-		uint32 tableOffset = 20;
+		_entryOffset = 20;
 		if (_version == kVersion4)
-			tableOffset = _tlk->readUint32LE();
+			_entryOffset = _tlk->readUint32LE();
 
 		_stringsOffset = _tlk->readUint32LE();
 
-		// Go to the table
-		_tlk->seek(tableOffset);
+		_entrySize = (_version == kVersion3) ? kEntrySizeV3 : kEntrySizeV4;
+
+		readData();
+
+		if ((_entryOffset > _size) || (_entryCount > ((_size - _entryOffset) / _entrySize)))
+			throw Common::Exception("TLK entry table out of range (%u * %u @ %u, %u)",
+			                        _entryCount, _entrySize, _entryOffset, (uint) _size);
 
-		// Read in all the table data
-		if (_version == kVersion3)
-			readEntryTableV3();
-		else
-			readEntryTableV4();
+		_texts        = new CachedString[_entryCount];
+		_soundResRefs = new CachedString[_entryCount];
+
+		for (uint32 i = 0; i < _entryCount; i++) {
+			_texts       [i].store(0, boost::memory_order_relaxed);
+			_soundResRefs[i].store(0, boost::memory_order_relaxed);
+		}
 
 	} catch (Common::Exception &e) {
-		delete _tlk;
+		clear();
 
 		e.add("Failed reading TLK file");
 		throw;
 	}
 }
 
-void TalkTable_TLK::readEntryTableV3() {
-	for (Entries::iterator entry = _entries.begin(); entry != _entries.end(); ++entry) {
-		entry->flags          = _tlk->readUint32LE();
-		entry->soundResRef    = Common::readStringFixed(*_tlk, Common::kEncodingASCII, 16);
-		entry->volumeVariance = _tlk->readUint32LE();
-		entry->pitchVariance  = _tlk->readUint32LE();
-		entry->offset         = _tlk->readUint32LE() + _stringsOffset;
-		entry->length         = _tlk->readUint32LE();
-		entry->soundLength    = _tlk->readIEEEFloatLE();
+void TalkTable_TLK::readData() {
+	/* We want the whole TLK in memory. If the stream already is in memory,
+	 * for example because it's a file mapping, we use it directly. Otherwise,
+	 * we read it into memory once. */
+
+	Common::MemoryReadStream *memory = dynamic_cast<Common::MemoryReadStream *>(_tlk);
+	if (!memory) {
+		_tlk->seek(0);
+
+		memory = _tlk->readStream(_tlk->size());
+
+		delete _tlk;
+		_tlk = memory;
 	}
+
+	_data = memory->getData();
+	_size = memory->size();
 }
 
-void TalkTable_TLK::readEntryTableV4() {
-	for (Entries::iterator entry = _entries.begin(); entry != _entries.end(); ++entry) {
-		entry->soundID = _tlk->readUint32LE();
-		entry->offset  = _tlk->readUint32LE();
-		entry->length  = _tlk->readUint16LE();
-		entry->flags   = kFlagTextPresent;
+void TalkTable_TLK::readEntry(uint32 strRef, uint32 &offset, uint32 &length, uint32 &flags) const {
+	const byte *entry = _data + _entryOffset + strRef * _entrySize;
+
+	if (_version == kVersion3) {
+		flags  = READ_LE_UINT32(entry);
+		offset = READ_LE_UINT32(entry + 28) + _stringsOffset;
+		length = READ_LE_UINT32(entry + 32);
+	} else {
+		flags  = kFlagTextPresent;
+		offset = READ_LE_UINT32(entry +  4);
+		length = READ_LE_UINT16(entry +  8);
 	}
 }
 
-void TalkTable_TLK::readString(Entry &entry) const {
-	if (!entry.text.empty() || (entry.length == 0) || !(entry.flags & kFlagTextPresent))
-		// We already have the string
-		return;
+Common::UString TalkTable_TLK::decodeText(uint32 strRef) const {
+	uint32 offset, length, flags;
+	readEntry(strRef, offset, length, flags);
 
-	assert(_tlk);
+	if ((length == 0) || !(flags & kFlagTextPresent) || (offset >= _size))
+		return "";
 
-	_tlk->seek(entry.offset);
+	length = MIN<size_t>(length, _size - offset);
 
-	uint32 length = MIN<size_t>(entry.length, _tlk->size() - _tlk->pos());
-	if (length == 0)
-		return;
+	Common::MemoryReadStream data(_data + offset, length);
+	Common::MemoryReadStream *parsed = LangMan.preParseColorCodes(data);
 
-	Common::MemoryReadStream *data   = _tlk->readStream(length);
-	Common::MemoryReadStream *parsed = LangMan.preParseColorCodes(*data);
+	Common::UString text = "[???]";
 
-	if (_encoding != Common::kEncodingInvalid)
-		entry.text = Common::readString(*parsed, _encoding);
-	else
-		entry.text = "[???]";
+	try {
+		if (_encoding != Common::kEncodingInvalid)
+			text = Common::readString(*parsed, _encoding);
+	} catch (...) {
+		delete parsed;
+		throw;
+	}
 
 	delete parsed;
-	delete data;
+	return text;
+}
+
+Common::UString TalkTable_TLK::decodeSoundResRef(uint32 strRef) const {
+	// Only V3 has sound ResRefs
+	if (_version != kVersion3)
+		return "";
+
+	Common::MemoryReadStream resRef(_data + _entryOffset + strRef * _entrySize + 4, 16);
+
+	return Common::readStringFixed(resRef, Common::kEncodingASCII, 16);
+}
+
+const Common::UString &TalkTable_TLK::addString(CachedString &cached, Common::UString &str) const {
+	Common::StackLock lock(_mutex);
+
+	// Another thread might have decoded the same string in the meantime
+	const Common::UString *existing = cached.load(boost::memory_order_relaxed);
+	if (existing)
+		return *existing;
+
+	if (str.empty()) {
+		cached.store(&kEmptyString, boost::memory_order_release);
+		return kEmptyString;
+	}
+
+	if (_arena.empty() || (_arenaFill == kArenaBlockSize)) {
+		_arena.push_back(new Common::UString[kArenaBlockSize]);
+		_arenaFill = 0;
+	}
+
+	Common::UString &arenaString = _arena.back()[_arenaFill++];
+	arenaString.swap(str);
+
+	cached.store(&arenaString, boost::memory_order_release);
+	return arenaString;
 }
 
 uint32 TalkTable_TLK::getLanguageID() const {
@@ -145,24 +271,75 @@ uint32 TalkTable_TLK::getLanguageID() const {
 }
 
 bool TalkTable_TLK::hasEntry(uint32 strRef) const {
-	return strRef < _entries.size();
+	return strRef < _entryCount;
 }
 
-static const Common::UString kEmptyString = "";
 const Common::UString &TalkTable_TLK::getString(uint32 strRef) const {
-	if (strRef >= _entries.size())
+	if (strRef >= _entryCount)
 		return kEmptyString;
 
-	readString(_entries[strRef]);
+	const Common::UString *text = _texts[strRef].load(boost::memory_order_acquire);
+	if (text)
+		return *text;
 
-	return _entries[strRef].text;
+	Common::UString decoded = decodeText(strRef);
+
+	return addString(_texts[strRef], decoded);
 }
 
 const Common::UString &TalkTable_TLK::getSoundResRef(uint32 strRef) const {
-	if (strRef >= _entries.size())
+	if (strRef >= _entryCount)
 		return kEmptyString;
 
-	return _entries[strRef].soundResRef;
+	const Common::UString *soundResRef = _soundResRefs[strRef].load(boost::memory_order_acquire);
+	if (soundResRef)
+		return *soundResRef;
+
+	Common::UString decoded = decodeSoundResRef(strRef);
+
+	return addString(_soundResRefs[strRef], decoded);
+}
+
+void TalkTable_TLK::predecode(size_t threadCount) {
+	if (_entryCount == 0)
+		return;
+
+	threadCount = MAX<size_t>(threadCount, 1);
+
+	/* Decode strings here until we find one that's not empty. This makes sure
+	 * that the lazily created language and encoding helpers exist before the
+	 * threads start. */
+	uint32 first = 0;
+	while ((first < _entryCount) && getString(first).empty())
+		first++;
+
+	const uint32 count = _entryCount - first;
+
+	std::vector<TLKPredecodeThread *> threads;
+	threads.reserve(threadCount);
+
+	for (size_t i = 0; i < threadCount; i++) {
+		const uint32 begin = first + (uint32) (((uint64) count *  i     ) / threadCount);
+		const uint32 end   = first + (uint32) (((uint64) count * (i + 1)) / threadCount);
+
+		TLKPredecodeThread *thread = new TLKPredecodeThread(*this, begin, end);
+
+		if (!thread->createThread()) {
+			// Couldn't create a thread, so decode this range ourselves
+			thread->decode();
+
+			delete thread;
+			continue;
+		}
+
+		threads.push_back(thread);
+	}
+
+	for (std::vector<TLKPredecodeThread *>::iterator t = threads.begin(); t != threads.end(); ++t) {
+		(*t)->wait();
+
+		delete *t;
+	}
 }
 
 uint32 TalkTable_TLK::getLanguageID(Common::SeekableReadStream &tlk) {
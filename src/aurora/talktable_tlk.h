@@ -25,10 +25,12 @@
 #ifndef AURORA_TALKTABLE_TLK_H
 #define AURORA_TALKTABLE_TLK_H
 
-#include <vector>
-
+#include "src/common/atomic.h"
 #include "src/common/types.h"
 #include "src/common/ustring.h"
+#include "src/common/mutex.h"
+
+#include <vector>
 
 #include "src/aurora/aurorafile.h"
 #include "src/aurora/talktable.h"
@@ -43,6 +45,19 @@ namespace Aurora {
  *  format. It has a numerical, game-local ID of the language it
  *  contains, and stores a few more optional data points per string,
  *  like a reference to a voice-over file.
+ *
+ *  The whole TLK is held in memory, ideally as a file mapping (see
+ *  ResourceManager::getResourceMapped()), and its entry table is read
+ *  directly out of that memory when needed. A string is only decoded
+ *  the first time it's requested, into an append-only arena of strings
+ *  that never moves a string once it has been added. A reference to
+ *  a string returned by getString() therefore stays valid for the
+ *  lifetime of the talk table.
+ *
+ *  Concurrent getString() and getSoundResRef() calls are safe: the
+ *  decoding itself works on the immutable TLK data only, and adding
+ *  the decoded string to the arena is guarded by a mutex. Strings that
+ *  are already decoded are found without taking the mutex.
  */
 class TalkTable_TLK : public AuroraFile, public TalkTable {
 public:
@@ -58,6 +73,9 @@ public:
 	const Common::UString &getString     (uint32 strRef) const;
 	const Common::UString &getSoundResRef(uint32 strRef) const;
 
+	/** Decode all strings of the talk table, using several threads. */
+	void predecode(size_t threadCount);
+
 	static uint32 getLanguageID(Common::SeekableReadStream &tlk);
 	static uint32 getLanguageID(const Common::UString &file);
 
@@ -70,39 +88,53 @@ private:
 		kFlagSoundLengthPresent = (1 << 2)
 	};
 
-	/** A talk resource entry. */
-	struct Entry {
-		Common::UString text;
-		uint32 offset;
-		uint32 length;
-
-		// V3
-		uint32 flags;
-		Common::UString soundResRef;
-		uint32 volumeVariance; // Unused
-		uint32 pitchVariance; // Unused
-		float soundLength; // In seconds
-
-		// V4
-		uint32 soundID;
-	};
+	/** The decoded string of an entry, or 0 if it hasn't been decoded yet. */
+	typedef boost::atomic<const Common::UString *> CachedString;
 
-	typedef std::vector<Entry> Entries;
+	/** Number of strings in one block of the string arena. */
+	static const size_t kArenaBlockSize = 1024;
 
 
 	Common::SeekableReadStream *_tlk;
 
+	/** The raw TLK data. */
+	const byte *_data;
+	/** The size of the raw TLK data. */
+	size_t _size;
+
 	uint32 _stringsOffset;
 	uint32 _languageID;
 
-	mutable Entries _entries;
+	uint32 _entryCount;  ///< Number of entries in the entry table.
+	uint32 _entryOffset; ///< Offset of the entry table within the TLK data.
+	uint32 _entrySize;   ///< Size of one entry in the entry table.
+
+	CachedString *_texts;        ///< The decoded texts of all entries.
+	CachedString *_soundResRefs; ///< The decoded sound ResRefs of all entries.
+
+	/** Blocks of decoded strings. */
+	mutable std::vector<Common::UString *> _arena;
+	/** Number of strings used in the last arena block. */
+	mutable size_t _arenaFill;
+
+	/** Mutex guarding the string arena. */
+	mutable Common::Mutex _mutex;
+
 
 	void load();
 
-	void readEntryTableV3();
-	void readEntryTableV4();
+	void readData();
+
+	void clear();
+
+	/** Read the string offset, length and flags of an entry. */
+	void readEntry(uint32 strRef, uint32 &offset, uint32 &length, uint32 &flags) const;
+
+	Common::UString decodeText(uint32 strRef) const;
+	Common::UString decodeSoundResRef(uint32 strRef) const;
 
-	void readString(Entry &entry) const;
+	/** Add a decoded string to the cache, unless another thread was faster. */
+	const Common::UString &addString(CachedString &cached, Common::UString &str) const;
 };
 
 } // End of namespace Aurora
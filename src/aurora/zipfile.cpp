@@ -48,6 +48,10 @@ uint32 ZIPFile::getResourceSize(uint32 index) const {
 	return _zipFile->getFileSize(index);
 }
 
+bool ZIPFile::isResourceCompressed(uint32 index) const {
+	return _zipFile->isFileCompressed(index);
+}
+
 Common::SeekableReadStream *ZIPFile::getResource(uint32 index, bool tryNoCopy) const {
 	return _zipFile->getFile(index, tryNoCopy);
 }
@@ -53,6 +53,9 @@ public:
 	/** Return a stream of the resource's contents. */
 	Common::SeekableReadStream *getResource(uint32 index, bool tryNoCopy = false) const;
 
+	/** Does reading this resource require decompressing or decrypting it? */
+	bool isResourceCompressed(uint32 index) const;
+
 private:
 	/** The actual zip file. */
 	Common::ZipFile *_zipFile;
@@ -42,12 +42,21 @@ static void displayUsage(const Common::UString &name) {
 	std::printf("  -wSIZE  --width=SIZE        Set the window's width to SIZE.\n");
 	std::printf("  -hSIZE  --height=SIZE       Set the window's height to SIZE.\n");
 	std::printf("  -fBOOL  --fullscreen=BOOL   Switch fullscreen on/off.\n");
+	std::printf("          --vertexbuffers=BOOL\n");
+	std::printf("                              Keep model geometry in GL buffer objects.\n");
+	std::printf("          --instancing=BOOL   Draw repeated models with hardware instancing.\n");
 	std::printf("  -kBOOL  --skipvideos=BOOL   Disable videos on/off.\n");
 	std::printf("  -vVOL   --volume=VOL        Set global volume to VOL.\n");
 	std::printf("  -mVOL   --volume_music=VOL  Set music volume to VOL.\n");
 	std::printf("  -sVOL   --volume_sfx=VOL    Set SFX volume to VOL.\n");
 	std::printf("  -oVOL   --volume_voice=VOL  Set voice volume to VOL.\n");
 	std::printf("  -iVOL   --volume_video=VOL  Set video volume to VOL.\n");
+	std::printf("          --sounddevice=DEV   Output sound to the OpenAL device DEV.\n");
+	std::printf("          --soundlookahead=SIZE\n");
+	std::printf("                              Decode sounds SIZE milliseconds ahead.\n");
+	std::printf("          --sounddecoders=SIZE\n");
+	std::printf("                              Decode sounds in SIZE background threads.\n");
+	std::printf("          --soundcache=SIZE   Cache up to SIZE MB of decoded sounds.\n");
 	std::printf("  -qLANG  --lang=LANG         Set the game's language.\n");
 	std::printf("          --langtext=LANG     Set the game's text language.\n");
 	std::printf("          --langvoice=LANG    Set the game's voice language.\n");
@@ -60,6 +69,14 @@ static void displayUsage(const Common::UString &name) {
 	std::printf("          --nologfile=BOOL    Don't write a log file.\n");
 	std::printf("          --consolelog=FILE   Write all debug console output into this file too.\n");
 	std::printf("          --noconsolelog=BOOL Don't write a debug console log file.\n");
+	std::printf("          --indexcache=FILE   Cache the resource indices of archives in this file.\n");
+	std::printf("          --noindexcache=BOOL Don't use a resource index cache.\n");
+	std::printf("          --maparchives=BOOL  Map game archives into memory instead of reading them.\n");
+	std::printf("          --rescache=SIZE     Cache up to SIZE MB of decompressed resources.\n");
+	std::printf("          --2dasnapshot=FILE  Keep a snapshot of parsed 2DA files in this file.\n");
+	std::printf("          --no2dasnapshot=BOOL\n");
+	std::printf("                              Don't use a 2DA snapshot.\n");
+	std::printf("          --tlkpredecode=BOOL Decode all talk table strings when loading them.\n");
 	std::printf("\n");
 	std::printf("FILE: Absolute or relative path to a file.\n");
 	std::printf("DIR:  Absolute or relative path to a directory.\n");
@@ -72,6 +89,7 @@ static void displayUsage(const Common::UString &name) {
 	std::printf("LVL:  A positive integer.\n");
 	std::printf("CHAN: A comma-separated list of debug channels.\n");
 	std::printf("      Use \"All\" to enable all debug channels.\n");
+	std::printf("DEV:  The name of an OpenAL device.\n");
 	std::printf("\n");
 	std::printf("Examples:\n");
 	std::printf("%s -p/path/to/nwn/\n", name.c_str());
@@ -0,0 +1,134 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Counting of heap allocations, for benchmarking.
+ */
+
+#include "src/common/atomic.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "src/common/alloccount.h"
+
+#ifdef XOREOS_ALLOCCOUNT
+
+// Dynamic exception specifications are gone in newer C++ standards
+#if __cplusplus >= 201103L
+	#define ALLOC_THROWS
+	#define ALLOC_NOTHROW noexcept
+#else
+	#define ALLOC_THROWS  throw(std::bad_alloc)
+	#define ALLOC_NOTHROW throw()
+#endif
+
+static boost::atomic<uint64> allocationCount(0);
+
+static void *countedAllocate(std::size_t size) {
+	allocationCount.fetch_add(1, boost::memory_order_relaxed);
+
+	if (size == 0)
+		size = 1;
+
+	for (;;) {
+		void *ptr = std::malloc(size);
+		if (ptr)
+			return ptr;
+
+		std::new_handler handler = std::set_new_handler(0);
+		std::set_new_handler(handler);
+
+		if (!handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+}
+
+static void *countedAllocateNoThrow(std::size_t size) {
+	try {
+		return countedAllocate(size);
+	} catch (...) {
+		return 0;
+	}
+}
+
+// .--- Replacements of the global allocation functions
+void *operator new(std::size_t size) ALLOC_THROWS {
+	return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size) ALLOC_THROWS {
+	return countedAllocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) ALLOC_NOTHROW {
+	return countedAllocateNoThrow(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) ALLOC_NOTHROW {
+	return countedAllocateNoThrow(size);
+}
+
+void operator delete(void *ptr) ALLOC_NOTHROW {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) ALLOC_NOTHROW {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) ALLOC_NOTHROW {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) ALLOC_NOTHROW {
+	std::free(ptr);
+}
+// '--- Replacements of the global allocation functions
+
+namespace Common {
+
+bool hasAllocationCount() {
+	return true;
+}
+
+uint64 getAllocationCount() {
+	return allocationCount.load(boost::memory_order_relaxed);
+}
+
+} // End of namespace Common
+
+#else // XOREOS_ALLOCCOUNT
+
+namespace Common {
+
+bool hasAllocationCount() {
+	return false;
+}
+
+uint64 getAllocationCount() {
+	return 0;
+}
+
+} // End of namespace Common
+
+#endif // XOREOS_ALLOCCOUNT
@@ -0,0 +1,51 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Counting of heap allocations, for benchmarking.
+ */
+
+#ifndef COMMON_ALLOCCOUNT_H
+#define COMMON_ALLOCCOUNT_H
+
+#include "src/common/types.h"
+
+namespace Common {
+
+/** Are heap allocations being counted?
+ *
+ *  Counting replaces the global operator new and delete, so it is only
+ *  compiled in when configured with --enable-alloc-counting (or the
+ *  XOREOS_ALLOCCOUNT CMake option).
+ */
+bool hasAllocationCount();
+
+/** Return the number of heap allocations done through operator new so far.
+ *
+ *  The counter includes allocations made by all threads. To measure the
+ *  allocations a piece of code makes, compare the count before and after.
+ *
+ *  If heap allocations are not being counted, this always returns 0.
+ */
+uint64 getAllocationCount();
+
+} // End of namespace Common
+
+#endif // COMMON_ALLOCCOUNT_H
@@ -28,8 +28,10 @@
 #include <cassert>
 
 #include "src/common/types.h"
+#include "src/common/endianness.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
+#include "src/common/memreadstream.h"
 
 namespace Common {
 
@@ -63,6 +65,19 @@ public:
 	/** Add a bit to the value x, making it an n-bit value. */
 	virtual void addBit(uint32 &x, size_t n) = 0;
 
+	/** Return the next n bits (up to 32) without consuming them.
+	 *
+	 *  The bits are returned in the same order getBits() would return them.
+	 *  Bits past the end of the stream are read as 0.
+	 */
+	virtual uint32 peekBits(size_t n) = 0;
+
+	/** Skip n bits (up to 32), usually after looking at them with peekBits(). */
+	virtual void skipBits(size_t n) = 0;
+
+	/** Are the bits handed out in the order of MSB to LSB? */
+	virtual bool isMSBFirst() const = 0;
+
 protected:
 	BitStream() {
 	}
@@ -77,18 +92,81 @@ protected:
  * For example, a bit stream with the layout parameters 32, true, false
  * for valueBits, isLE and isMSB2LSB, reads 32bit little-endian values
  * from the data stream and hands out the bits in the order of LSB to MSB.
+ *
+ * The bits are handed out of a 64-bit cache, which is refilled with whole
+ * values from the data stream when necessary. 64-bit values are split into
+ * two 32-bit halves for that. This lets peekBits() look ahead up to 32 bits,
+ * regardless of the value width.
+ *
+ * If the data stream is a MemoryReadStream, the cache is refilled directly
+ * out of the stream's memory, 32 bits at a time. In that case, the position
+ * of the data stream itself is not updated while reading bits.
  */
 template<int valueBits, bool isLE, bool isMSB2LSB>
 class BitStreamImpl : public BitStream {
 private:
+	/** Number of bits put into the cache at once. */
+	static const size_t kChunkBits = (valueBits == 64) ? 32 : valueBits;
+
 	SeekableReadStream *_stream; ///< The input stream.
 	bool _disposeAfterUse;       ///< Should we delete the stream on destruction?
 
-	uint64 _value;   ///< Current value.
-	uint8  _inValue; ///< Position within the current value.
+	size_t _size; ///< The stream size in bits.
+
+	const byte *_data;    ///< The data of the stream, if it's a MemoryReadStream.
+	size_t      _dataPos; ///< The current byte position within _data.
+
+	/** The cached bits, starting at the MSB or LSB, depending on the bit order.
+	 *  All bits after the cached bits are always 0. */
+	uint64 _value;
+	uint8  _cached; ///< Number of bits in the cache.
+
+	uint32 _half;    ///< The second half of a 64-bit data value.
+	bool   _hasHalf; ///< Do we have a second half of a 64-bit data value waiting?
+
+	/** Return the current byte position within the data stream. */
+	inline size_t bytePos() const {
+		return _data ? _dataPos : _stream->pos();
+	}
+
+	/** Read a data value directly out of the memory data. */
+	inline uint64 readMemoryData() {
+		const byte *data = _data + _dataPos;
+		_dataPos += valueBits / 8;
+
+		if (valueBits ==  8)
+			return *data;
+		if (valueBits == 16)
+			return isLE ? READ_LE_UINT16(data) : READ_BE_UINT16(data);
+		if (valueBits == 32)
+			return isLE ? READ_LE_UINT32(data) : READ_BE_UINT32(data);
+
+		if (isLE)
+			return ((uint64) READ_LE_UINT32(data)) | (((uint64) READ_LE_UINT32(data + 4)) << 32);
+
+		return (((uint64) READ_BE_UINT32(data)) << 32) | ((uint64) READ_BE_UINT32(data + 4));
+	}
+
+	/** Read the next 32 bits worth of 8-bit or 16-bit values directly out of the memory data. */
+	inline uint32 readMemoryWord() {
+		const byte *data = _data + _dataPos;
+		_dataPos += 4;
+
+		// 8-bit values are just a 32-bit value in the byte order matching the bit order
+		if (valueBits == 8)
+			return isMSB2LSB ? READ_BE_UINT32(data) : READ_LE_UINT32(data);
+
+		const uint32 value1 = isLE ? READ_LE_UINT16(data    ) : READ_BE_UINT16(data    );
+		const uint32 value2 = isLE ? READ_LE_UINT16(data + 2) : READ_BE_UINT16(data + 2);
+
+		return isMSB2LSB ? ((value1 << 16) | value2) : (value1 | (value2 << 16));
+	}
 
 	/** Read a data value. */
 	inline uint64 readData() {
+		if (_data)
+			return readMemoryData();
+
 		if (isLE) {
 			if (valueBits ==  8)
 				return _stream->readByte();
@@ -113,33 +191,97 @@ private:
 		return 0;
 	}
 
-	/** Read the next data value. */
-	inline void readValue() {
-		if ((size() - pos()) < valueBits)
-			throw Exception("BitStream::readValue(): End of bit stream reached");
+	/** Read the next chunk of kChunkBits bits. */
+	inline uint32 readChunk() {
+		if (valueBits != 64)
+			return (uint32) readData();
+
+		if (_hasHalf) {
+			_hasHalf = false;
+			return _half;
+		}
+
+		const uint64 data = readData();
+
+		// Hand out the half that contains the first bits first
+		_hasHalf = true;
+		_half    = isMSB2LSB ? ((uint32) data) : ((uint32) (data >> 32));
+
+		return isMSB2LSB ? ((uint32) (data >> 32)) : ((uint32) data);
+	}
+
+	/** Add n bits (up to 32) to the end of the cache. */
+	inline void addToCache(uint64 bits, size_t n) {
+		if (isMSB2LSB)
+			_value |= bits << (64 - n - _cached);
+		else
+			_value |= bits << _cached;
+
+		_cached += n;
+	}
+
+	/** Try to fill the cache with at least n bits (up to 32). */
+	inline void refill(size_t n) {
+		while (_cached < n) {
+			// Read several small values from memory at once, if we can
+			if ((valueBits < 32) && _data && ((_size - _dataPos * 8) >= 32)) {
+				addToCache(readMemoryWord(), 32);
+				continue;
+			}
+
+			if (!_hasHalf && ((_size - bytePos() * 8) < valueBits))
+				return;
+
+			addToCache(readChunk(), kChunkBits);
+		}
+	}
+
+	/** Return the first n bits (1 up to 32) in the cache. */
+	inline uint32 peekCache(size_t n) const {
+		if (isMSB2LSB)
+			return (uint32) (_value >> (64 - n));
 
-		_value = readData();
+		return (uint32) (_value & ((((uint64) 1) << n) - 1));
+	}
 
-		// If we're reading the bits MSB first, we need to shift the value to that position
+	/** Remove the first n bits (up to 32) from the cache. */
+	inline void consumeCache(size_t n) {
 		if (isMSB2LSB)
-			_value <<= 64 - valueBits;
+			_value <<= n;
+		else
+			_value >>= n;
+
+		_cached -= n;
+	}
+
+	void init() {
+		if ((valueBits != 8) && (valueBits != 16) && (valueBits != 32) && (valueBits != 64))
+			throw Exception("BitStream: Invalid memory layout %d, %d, %d", valueBits, isLE, isMSB2LSB);
+
+		_size = (_stream->size() & ~((size_t) ((valueBits >> 3) - 1))) * 8;
+
+		MemoryReadStream *memoryStream = dynamic_cast<MemoryReadStream *>(_stream);
+		if (memoryStream) {
+			_data    = memoryStream->getData();
+			_dataPos = memoryStream->pos();
 		}
+	}
 
 public:
 	/** Create a bit stream using this input data stream and optionally delete it on destruction. */
 	BitStreamImpl(SeekableReadStream *stream, bool disposeAfterUse = false) :
-		_stream(stream), _disposeAfterUse(disposeAfterUse), _value(0), _inValue(0) {
+		_stream(stream), _disposeAfterUse(disposeAfterUse), _size(0), _data(0), _dataPos(0),
+		_value(0), _cached(0), _half(0), _hasHalf(false) {
 
-		if ((valueBits != 8) && (valueBits != 16) && (valueBits != 32) && (valueBits != 64))
-			throw Exception("BitStream: Invalid memory layout %d, %d, %d", valueBits, isLE, isMSB2LSB);
+		init();
 	}
 
 	/** Create a bit stream using this input data stream. */
 	BitStreamImpl(SeekableReadStream &stream) :
-		_stream(&stream), _disposeAfterUse(false), _value(0), _inValue(0) {
+		_stream(&stream), _disposeAfterUse(false), _size(0), _data(0), _dataPos(0),
+		_value(0), _cached(0), _half(0), _hasHalf(false) {
 
-		if ((valueBits != 8) && (valueBits != 16) && (valueBits != 32) && (valueBits != 64))
-			throw Exception("BitStream: Invalid memory layout %d, %d, %d", valueBits, isLE, isMSB2LSB);
+		init();
 	}
 
 	~BitStreamImpl() {
@@ -149,25 +291,15 @@ public:
 
 	/** Read a bit from the bit stream. */
 	uint32 getBit() {
-		// Check if we need the next value
-		if (_inValue == 0)
-			readValue();
-
-		// Get the current bit
-		int b = 0;
-		if (isMSB2LSB)
-			b = ((_value & 0x8000000000000000ULL) == 0) ? 0 : 1;
-		else
-			b = ((_value & 1) == 0) ? 0 : 1;
+		if (_cached == 0) {
+			refill(1);
 
-		// Shift to the next bit
-		if (isMSB2LSB)
-			_value <<= 1;
-		else
-			_value >>= 1;
+			if (_cached == 0)
+				throw Exception("BitStream::getBit(): End of bit stream reached");
+		}
 
-		// Increase the position within the current value
-		_inValue = (_inValue + 1) % valueBits;
+		const uint32 b = peekCache(1);
+		consumeCache(1);
 
 		return b;
 	}
@@ -177,18 +309,15 @@ public:
 		if (n > 32)
 			throw Exception("Too many bits requested to be read");
 
-		// Read the number of bits
-		uint32 v = 0;
+		if (n == 0)
+			return 0;
 
-		if (isMSB2LSB) {
-			while (n-- > 0)
-				v = (v << 1) | getBit();
-		} else {
-			for (uint32 i = 0; i < n; i++)
-				v = (v >> 1) | (((uint32) getBit()) << 31);
+		refill(n);
+		if (_cached < n)
+			throw Exception("BitStream::getBits(): End of bit stream reached");
 
-			v >>= (32 - n);
-		}
+		const uint32 v = peekCache(n);
+		consumeCache(n);
 
 		return v;
 	}
@@ -204,36 +333,70 @@ public:
 			x = (x & ~(1 << n)) | (getBit() << n);
 	}
 
+	/** Return the next n bits (up to 32) without consuming them. */
+	uint32 peekBits(size_t n) {
+		if (n > 32)
+			throw Exception("Too many bits requested to be read");
+
+		if (n == 0)
+			return 0;
+
+		// Since everything after the cached bits is 0, this pads the end of the stream
+		refill(n);
+
+		return peekCache(n);
+	}
+
+	/** Skip n bits (up to 32). */
+	void skipBits(size_t n) {
+		if (n > 32)
+			throw Exception("Too many bits requested to be skipped");
+
+		refill(n);
+		if (_cached < n)
+			throw Exception("BitStream::skipBits(): End of bit stream reached");
+
+		consumeCache(n);
+	}
+
+	/** Are the bits handed out in the order of MSB to LSB? */
+	bool isMSBFirst() const {
+		return isMSB2LSB;
+	}
+
 	/** Rewind the bit stream back to the start. */
 	void rewind() {
-		_stream->seek(0);
+		if (!_data)
+			_stream->seek(0);
+
+		_dataPos = 0;
 
 		_value   = 0;
-		_inValue = 0;
+		_cached  = 0;
+		_half    = 0;
+		_hasHalf = false;
 	}
 
 	/** Skip the specified amount of bits. */
 	void skip(size_t n) {
-		while (n-- > 0)
-			getBit();
+		for (; n > 32; n -= 32)
+			skipBits(32);
+
+		skipBits(n);
 	}
 
 	/** Return the stream position in bits. */
 	size_t pos() const {
-		if (_stream->pos() == 0)
-			return 0;
-
-		size_t p = (_inValue == 0) ? _stream->pos() : ((_stream->pos() - 1) & ~((size_t) ((valueBits >> 3) - 1)));
-		return p * 8 + _inValue;
+		return bytePos() * 8 - _cached - (_hasHalf ? 32 : 0);
 	}
 
 	/** Return the stream size in bits. */
 	size_t size() const {
-		return (_stream->size() & ~((size_t) ((valueBits >> 3) - 1))) * 8;
+		return _size;
 	}
 
 	bool eos() const {
-		return _stream->eos() || (pos() >= size());
+		return (_cached == 0 && !_hasHalf && _stream->eos()) || (pos() >= size());
 	}
 };
 
@@ -41,10 +41,11 @@ DebugManager::DebugManager() : _debugLevel(0), _logFileStartLine(false) {
 	for (size_t i = 0; i < kChannelCount; i++)
 		_channels[i].enabled = false;
 
-	addDebugChannel(kDebugGraphics, "GGraphics", "Global graphics debug channel");
-	addDebugChannel(kDebugSound   , "GSound"   , "Global sound debug channel");
-	addDebugChannel(kDebugEvents  , "GEvents"  , "Global events debug channel");
-	addDebugChannel(kDebugScripts , "GScripts" , "Global scripts debug channel");
+	addDebugChannel(kDebugGraphics , "GGraphics" , "Global graphics debug channel");
+	addDebugChannel(kDebugSound    , "GSound"    , "Global sound debug channel");
+	addDebugChannel(kDebugEvents   , "GEvents"   , "Global events debug channel");
+	addDebugChannel(kDebugScripts  , "GScripts"  , "Global scripts debug channel");
+	addDebugChannel(kDebugResources, "GResources", "Global resources debug channel");
 }
 
 DebugManager::~DebugManager() {
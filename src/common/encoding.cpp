@@ -32,6 +32,7 @@
 #include "src/common/encoding.h"
 #include "src/common/error.h"
 #include "src/common/singleton.h"
+#include "src/common/mutex.h"
 #include "src/common/ustring.h"
 #include "src/common/memreadstream.h"
 #include "src/common/writestream.h"
@@ -55,30 +56,33 @@ static const size_t kTerminatorLength  [kEncodingMAX] = {
 	1, 1, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1
 };
 
-/** A manager handling string encoding conversions. */
+/** A manager handling string encoding conversions.
+ *
+ *  An iconv context carries a conversion state, so it can't be used by
+ *  several threads at the same time. We therefore keep a pool of contexts
+ *  for each conversion, and hand out a free one for each conversion.
+ */
 class ConversionManager : public Singleton<ConversionManager> {
 public:
 	ConversionManager() {
 		for (size_t i = 0; i < kEncodingMAX; i++) {
-			_contextFrom[i] = (iconv_t) -1;
-			_contextTo  [i] = (iconv_t) -1;
+			_contextsFrom[i].open("UTF-8", kEncodingName[i]);
+			_contextsTo  [i].open(kEncodingName[i], "UTF-8");
 		}
 
 		for (size_t i = 0; i < kEncodingMAX; i++)
-			if ((_contextFrom[i] = iconv_open("UTF-8", kEncodingName[i])) == ((iconv_t) -1))
-				warning("Failed to initialize %s -> UTF-8 conversion: %s", kEncodingName[i], strerror(errno));
+			if (_contextsFrom[i].failed)
+				warning("Failed to initialize %s -> UTF-8 conversion: %s", kEncodingName[i], strerror(_contextsFrom[i].error));
 
 		for (size_t i = 0; i < kEncodingMAX; i++)
-			if ((_contextTo  [i] = iconv_open(kEncodingName[i], "UTF-8")) == ((iconv_t) -1))
-				warning("Failed to initialize UTF-8 -> %s conversion: %s", kEncodingName[i], strerror(errno));
+			if (_contextsTo  [i].failed)
+				warning("Failed to initialize UTF-8 -> %s conversion: %s", kEncodingName[i], strerror(_contextsTo  [i].error));
 	}
 
 	~ConversionManager() {
 		for (size_t i = 0; i < kEncodingMAX; i++) {
-			if (_contextFrom[i] != ((iconv_t) -1))
-				iconv_close(_contextFrom[i]);
-			if (_contextTo  [i] != ((iconv_t) -1))
-				iconv_close(_contextTo  [i]);
+			_contextsFrom[i].close();
+			_contextsTo  [i].close();
 		}
 	}
 
@@ -86,20 +90,105 @@ public:
 		if (((size_t) encoding) >= kEncodingMAX)
 			throw Exception("Invalid encoding %d", encoding);
 
-		return convert(_contextFrom[encoding], data, n, kEncodingGrowthFrom[encoding], 1);
+		iconv_t ctx = takeContext(_contextsFrom[encoding]);
+
+		try {
+			UString str = convert(ctx, data, n, kEncodingGrowthFrom[encoding], 1);
+
+			returnContext(_contextsFrom[encoding], ctx);
+			return str;
+
+		} catch (...) {
+			returnContext(_contextsFrom[encoding], ctx);
+			throw;
+		}
 	}
 
 	MemoryReadStream *convert(Encoding encoding, const UString &str, bool terminate = true) {
 		if (((size_t) encoding) >= kEncodingMAX)
 			throw Exception("Invalid encoding %d", encoding);
 
-		return convert(_contextTo[encoding], str, kEncodingGrowthTo[encoding],
-		               terminate ? kTerminatorLength[encoding] : 0);
+		iconv_t ctx = takeContext(_contextsTo[encoding]);
+
+		try {
+			MemoryReadStream *stream = convert(ctx, str, kEncodingGrowthTo[encoding],
+			                                   terminate ? kTerminatorLength[encoding] : 0);
+
+			returnContext(_contextsTo[encoding], ctx);
+			return stream;
+
+		} catch (...) {
+			returnContext(_contextsTo[encoding], ctx);
+			throw;
+		}
 	}
 
 private:
-	iconv_t _contextFrom[kEncodingMAX];
-	iconv_t _contextTo  [kEncodingMAX];
+	/** A pool of iconv contexts for one specific conversion. */
+	struct ContextPool {
+		const char *to;
+		const char *from;
+
+		bool failed; ///< Did opening the first context fail?
+		int  error;  ///< The reason opening the first context failed.
+
+		std::vector<iconv_t> contexts; ///< Currently unused contexts.
+
+		ContextPool() : to(0), from(0), failed(false), error(0) {
+		}
+
+		void open(const char *t, const char *f) {
+			to   = t;
+			from = f;
+
+			iconv_t ctx = iconv_open(to, from);
+			if (ctx == ((iconv_t) -1)) {
+				failed = true;
+				error  = errno;
+				return;
+			}
+
+			contexts.push_back(ctx);
+		}
+
+		void close() {
+			for (std::vector<iconv_t>::iterator c = contexts.begin(); c != contexts.end(); ++c)
+				iconv_close(*c);
+
+			contexts.clear();
+		}
+	};
+
+	ContextPool _contextsFrom[kEncodingMAX];
+	ContextPool _contextsTo  [kEncodingMAX];
+
+	Mutex _mutex;
+
+	/** Take an unused context out of the pool, opening a new one if there's none. */
+	iconv_t takeContext(ContextPool &pool) {
+		StackLock lock(_mutex);
+
+		if (pool.failed)
+			return (iconv_t) -1;
+
+		if (pool.contexts.empty())
+			return iconv_open(pool.to, pool.from);
+
+		iconv_t ctx = pool.contexts.back();
+		pool.contexts.pop_back();
+
+		return ctx;
+	}
+
+	/** Return a context to the pool. */
+	void returnContext(ContextPool &pool, iconv_t ctx) {
+		if (ctx == ((iconv_t) -1))
+			return;
+
+		StackLock lock(_mutex);
+
+		pool.contexts.push_back(ctx);
+	}
 
 	byte *doConvert(iconv_t &ctx, byte *data, size_t nIn, size_t nOut, size_t &size) {
 		size_t inBytes  = nIn;
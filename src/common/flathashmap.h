@@ -0,0 +1,296 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A flat, open-addressing hash map for keys that are already hashes.
+ */
+
+#ifndef COMMON_FLATHASHMAP_H
+#define COMMON_FLATHASHMAP_H
+
+#include <cassert>
+
+#include <vector>
+#include <algorithm>
+
+#include "src/common/types.h"
+#include "src/common/util.h"
+
+namespace Common {
+
+/** A flat hash map, mapping 64-bit hash values onto values of type T.
+ *
+ *  All entries live in a single contiguous array of slots. Collisions are
+ *  resolved by linear probing, and removing an entry shifts the following
+ *  entries of the same probe sequence back, so no tombstones are ever left
+ *  behind.
+ *
+ *  Since the keys are expected to already be good hash values (FNV, DJB2,
+ *  CRC32, ...), they are only spread over the table by a Fibonacci multiply.
+ *
+ *  Inserting or removing an entry may move other entries around, which
+ *  invalidates all pointers to values and all iterators.
+ *
+ *  T needs to be default-constructible and swappable. A swap is used to
+ *  move a value from one slot into another.
+ */
+template<typename T>
+class FlatHashMap {
+private:
+	struct Slot {
+		uint64 key;
+		bool   used;
+		T      value;
+
+		Slot() : key(0), used(false) { }
+	};
+
+	typedef std::vector<Slot> Slots;
+
+public:
+	class const_iterator {
+	public:
+		const_iterator() : _slots(0), _index(0) { }
+
+		uint64   key  () const { return (*_slots)[_index].key;   }
+		const T &value() const { return (*_slots)[_index].value; }
+
+		const_iterator &operator++() {
+			_index++;
+			skipUnused();
+
+			return *this;
+		}
+
+		bool operator==(const const_iterator &i) const { return (_slots == i._slots) && (_index == i._index); }
+		bool operator!=(const const_iterator &i) const { return !(*this == i); }
+
+	private:
+		const Slots *_slots;
+		size_t       _index;
+
+		const_iterator(const Slots &slots, size_t index) : _slots(&slots), _index(index) {
+			skipUnused();
+		}
+
+		void skipUnused() {
+			while ((_index < _slots->size()) && !(*_slots)[_index].used)
+				_index++;
+		}
+
+		friend class FlatHashMap;
+	};
+
+	FlatHashMap() : _size(0), _bits(0) {
+	}
+
+	/** Return the number of entries in the map. */
+	size_t size() const {
+		return _size;
+	}
+
+	/** Is the map empty? */
+	bool empty() const {
+		return _size == 0;
+	}
+
+	/** Return the number of slots currently allocated. */
+	size_t capacity() const {
+		return _slots.size();
+	}
+
+	/** Remove all entries and free the slots. */
+	void clear() {
+		Slots().swap(_slots);
+
+		_size = 0;
+		_bits = 0;
+	}
+
+	/** Make sure that there's enough room for this many entries without a rehash. */
+	void reserve(size_t count) {
+		uint bits = MAX<uint>(_bits, kMinBits);
+		while (!fits(count, bits))
+			bits++;
+
+		if (bits != _bits)
+			rehash(bits);
+	}
+
+	/** Find the value for this key. Returns 0 if there is none. */
+	T *find(uint64 key) {
+		const size_t index = findSlot(key);
+		if (index == kInvalidSlot)
+			return 0;
+
+		return &_slots[index].value;
+	}
+
+	/** Find the value for this key. Returns 0 if there is none. */
+	const T *find(uint64 key) const {
+		const size_t index = findSlot(key);
+		if (index == kInvalidSlot)
+			return 0;
+
+		return &_slots[index].value;
+	}
+
+	/** Does this key exist in the map? */
+	bool contains(uint64 key) const {
+		return findSlot(key) != kInvalidSlot;
+	}
+
+	/** Return the value for this key, creating a default-constructed value if necessary. */
+	T &operator[](uint64 key) {
+		size_t index = findSlot(key);
+		if (index != kInvalidSlot)
+			return _slots[index].value;
+
+		if (!fits(_size + 1, _bits))
+			rehash(MAX<uint>(_bits + 1, kMinBits));
+
+		index = home(key);
+		while (_slots[index].used)
+			index = (index + 1) & mask();
+
+		_slots[index].key  = key;
+		_slots[index].used = true;
+
+		_size++;
+
+		return _slots[index].value;
+	}
+
+	/** Remove the entry for this key. Returns false if there was none. */
+	bool erase(uint64 key) {
+		size_t index = findSlot(key);
+		if (index == kInvalidSlot)
+			return false;
+
+		/* Backward-shift deletion: move every following entry of this probe
+		 * sequence that would be unreachable after the removal into the gap. */
+
+		size_t next = (index + 1) & mask();
+		while (_slots[next].used) {
+			const size_t nextHome = home(_slots[next].key);
+
+			if (isBetween(nextHome, index, next)) {
+				next = (next + 1) & mask();
+				continue;
+			}
+
+			_slots[index].key = _slots[next].key;
+			std::swap(_slots[index].value, _slots[next].value);
+
+			index = next;
+			next  = (next + 1) & mask();
+		}
+
+		_slots[index].key   = 0;
+		_slots[index].used  = false;
+		_slots[index].value = T();
+
+		_size--;
+
+		return true;
+	}
+
+	const_iterator begin() const {
+		return const_iterator(_slots, 0);
+	}
+
+	const_iterator end() const {
+		return const_iterator(_slots, _slots.size());
+	}
+
+private:
+	static const uint   kMinBits    = 4;
+	static const size_t kInvalidSlot = SIZE_MAX;
+
+	Slots  _slots;
+	size_t _size;
+	uint   _bits;
+
+	size_t mask() const {
+		return _slots.size() - 1;
+	}
+
+	/** The slot a key would ideally be placed in. */
+	size_t home(uint64 key) const {
+		return (size_t) ((key * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - _bits));
+	}
+
+	/** Is index x within the cyclic range (from, to]? */
+	bool isBetween(size_t x, size_t from, size_t to) const {
+		if (from <= to)
+			return (x > from) && (x <= to);
+
+		return (x > from) || (x <= to);
+	}
+
+	/** Would this many entries fit into a table of 2^bits slots, at a load factor of at most 3/4? */
+	static bool fits(size_t count, uint bits) {
+		if (bits == 0)
+			return count == 0;
+
+		return (count * 4) <= ((((size_t) 1) << bits) * 3);
+	}
+
+	size_t findSlot(uint64 key) const {
+		if (_slots.empty())
+			return kInvalidSlot;
+
+		size_t index = home(key);
+		while (_slots[index].used) {
+			if (_slots[index].key == key)
+				return index;
+
+			index = (index + 1) & mask();
+		}
+
+		return kInvalidSlot;
+	}
+
+	void rehash(uint bits) {
+		assert(fits(_size, bits));
+
+		Slots oldSlots(((size_t) 1) << bits);
+		oldSlots.swap(_slots);
+
+		_bits = bits;
+
+		for (typename Slots::iterator s = oldSlots.begin(); s != oldSlots.end(); ++s) {
+			if (!s->used)
+				continue;
+
+			size_t index = home(s->key);
+			while (_slots[index].used)
+				index = (index + 1) & mask();
+
+			_slots[index].key  = s->key;
+			_slots[index].used = true;
+			std::swap(_slots[index].value, s->value);
+		}
+	}
+};
+
+} // End of namespace Common
+
+#endif // COMMON_FLATHASHMAP_H
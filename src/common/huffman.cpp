@@ -24,6 +24,8 @@
 
 #include <cassert>
 
+#include <algorithm>
+
 #include "src/common/huffman.h"
 #include "src/common/util.h"
 #include "src/common/error.h"
@@ -31,7 +33,27 @@
 
 namespace Common {
 
-Huffman::Symbol::Symbol(uint32 c, uint32 s) : code(c), symbol(s) {
+/** Number of bits resolved by the first-level lookup table, at most. */
+static const uint8 kMaxTableBits = 9;
+
+/** Reverse the order of the lowest n bits of v. */
+static uint32 reverseBits(uint32 v, uint8 n) {
+	uint32 r = 0;
+	for (uint8 i = 0; i < n; i++, v >>= 1)
+		r = (r << 1) | (v & 1);
+
+	return r;
+}
+
+
+Huffman::TableEntry::TableEntry() : value(0), length(0) {
+}
+
+Huffman::Code::Code(uint32 c, uint8 l, uint32 i) : code(c), length(l), index(i) {
+}
+
+bool Huffman::Code::operator<(const Code &right) const {
+	return length < right.length;
 }
 
 
@@ -59,19 +81,32 @@ void Huffman::init(uint8 maxLength, size_t codeCount, const uint32 *codes,
 
 	assert(maxLength <= 32);
 
-	_codes.resize(maxLength);
+	_tableBits = MIN(maxLength, kMaxTableBits);
+
 	_symbols.resize(codeCount);
+	setSymbols(symbols);
 
-	for (size_t i = 0; i < codeCount; i++) {
-		// The symbol. If none were specified, just assume it's identical to the code index
-		uint32 symbol = symbols ? symbols[i] : i;
+	/* Sort the codes by length, keeping codes of the same length in their
+	 * original order. When codes collide, the shortest and first one wins. */
 
-		// Put the code and symbol into the correct list
-		_codes[lengths[i] - 1].push_back(Symbol(codes[i], symbol));
+	Codes codesMSB, codesLSB;
+	codesMSB.reserve(codeCount);
+	codesLSB.reserve(codeCount);
 
-		// And put the pointer to the symbol/code struct into the symbol list.
-		_symbols[i] = &_codes[lengths[i] - 1].back();
+	for (size_t i = 0; i < codeCount; i++) {
+		if ((lengths[i] == 0) || (lengths[i] > maxLength))
+			continue;
+
+		// When reading from LSB to MSB, the first bit of a code is its LSB
+		codesMSB.push_back(Code(codes[i], lengths[i], i));
+		codesLSB.push_back(Code(reverseBits(codes[i], lengths[i]), lengths[i], i));
 	}
+
+	std::stable_sort(codesMSB.begin(), codesMSB.end());
+	std::stable_sort(codesLSB.begin(), codesLSB.end());
+
+	buildTable(_tableMSB, _tableBits, codesMSB, true);
+	buildTable(_tableLSB, _tableBits, codesLSB, false);
 }
 
 Huffman::~Huffman() {
@@ -79,18 +114,86 @@ Huffman::~Huffman() {
 
 void Huffman::setSymbols(const uint32 *symbols) {
 	for (size_t i = 0; i < _symbols.size(); i++)
-		_symbols[i]->symbol = symbols ? *symbols++ : i;
+		_symbols[i] = symbols ? *symbols++ : i;
+}
+
+uint32 Huffman::buildTable(Table &table, uint8 tableBits, const Codes &codes, bool msbFirst) {
+	const uint32 offset = table.size();
+	table.resize(offset + (1 << tableBits));
+
+	/* Codes that fit into this table fill all entries that start with the code.
+	 * The codes are sorted by length, so a shorter code always takes precedence. */
+
+	Codes::const_iterator code = codes.begin();
+	for (; (code != codes.end()) && (code->length <= tableBits); ++code) {
+		const uint32 start = code->code << (tableBits - code->length);
+		const uint32 count = 1 << (tableBits - code->length);
+
+		for (uint32 i = start; i < (start + count); i++) {
+			TableEntry &entry = table[offset + (msbFirst ? i : reverseBits(i, tableBits))];
+			if (entry.length != 0)
+				continue;
+
+			entry.value  = code->index;
+			entry.length = code->length;
+		}
+	}
+
+	/* Longer codes are grouped by their first tableBits bits, and each group
+	 * is put into its own sub-table. */
+
+	for (Codes::const_iterator c = code; c != codes.end(); ++c) {
+		const uint32 prefix = c->code >> (c->length - tableBits);
+		const uint32 index  = offset + (msbFirst ? prefix : reverseBits(prefix, tableBits));
+
+		// Either already handled, or shadowed by a shorter code
+		if (table[index].length != 0)
+			continue;
+
+		Codes subCodes;
+		uint8 subBits = 0;
+
+		for (Codes::const_iterator s = c; s != codes.end(); ++s) {
+			if ((s->code >> (s->length - tableBits)) != prefix)
+				continue;
+
+			const uint8 subLength = s->length - tableBits;
+
+			subCodes.push_back(Code(s->code & ((((uint64) 1) << subLength) - 1), subLength, s->index));
+			subBits = MAX(subBits, subLength);
+		}
+
+		const uint32 subTable = buildTable(table, MIN(subBits, kMaxTableBits), subCodes, msbFirst);
+
+		table[index].value  = subTable;
+		table[index].length = - (int8) MIN(subBits, kMaxTableBits);
+	}
+
+	return offset;
 }
 
 uint32 Huffman::getSymbol(BitStream &bits) const {
-	uint32 code = 0;
+	const Table &table = bits.isMSBFirst() ? _tableMSB : _tableLSB;
+
+	uint32 offset    = 0;
+	uint8  tableBits = _tableBits;
+
+	while (true) {
+		const TableEntry &entry = table[offset + bits.peekBits(tableBits)];
+
+		if (entry.length > 0) {
+			bits.skipBits(entry.length);
+			return _symbols[entry.value];
+		}
+
+		if (entry.length == 0)
+			break;
 
-	for (size_t i = 0; i < _codes.size(); i++) {
-		bits.addBit(code, i);
+		// Continue in the sub-table
+		bits.skipBits(tableBits);
 
-		for (CodeList::const_iterator cCode = _codes[i].begin(); cCode != _codes[i].end(); ++cCode)
-			if (code == cCode->code)
-				return cCode->symbol;
+		offset    = entry.value;
+		tableBits = - entry.length;
 	}
 
 	throw Exception("Unknown Huffman code");
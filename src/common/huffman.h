@@ -26,7 +26,6 @@
 #define COMMON_HUFFMAN_H
 
 #include <vector>
-#include <list>
 
 #include "src/common/types.h"
 
@@ -43,7 +42,17 @@ struct HuffmanTable {
 	const uint32 *symbols; ///< The symbols, 0 if identical to the codes.
 };
 
-/** Decode a Huffman'd bitstream. */
+/** Decode a Huffman'd bitstream.
+ *
+ *  The codes are decoded with the help of lookup tables: the first few bits
+ *  of the bitstream are peeked at once and directly resolved into a symbol
+ *  in most cases. Longer codes are resolved through further sub-tables.
+ *
+ *  Since the same codes result in different bit sequences depending on the
+ *  order in which the bitstream hands out its bits, there are two separate
+ *  sets of tables: one for bitstreams going from MSB to LSB and one for
+ *  bitstreams going from LSB to MSB.
+ */
 class Huffman {
 public:
 	/** Construct a Huffman decoder.
@@ -66,25 +75,48 @@ public:
 	uint32 getSymbol(BitStream &bits) const;
 
 private:
-	struct Symbol {
-		uint32 code;
-		uint32 symbol;
+	/** An entry in a lookup table. */
+	struct TableEntry {
+		/** Index of the code or, for sub-tables, the offset of the sub-table. */
+		uint32 value;
+		/** Length of the code, or the negative number of bits of a sub-table.
+		 *  0 means that there's no code for these bits. */
+		int8 length;
+
+		TableEntry();
+	};
 
-		Symbol(uint32 c, uint32 s);
+	/** A code, as used while building the lookup tables. */
+	struct Code {
+		uint32 code;   ///< The code, with its first bit as the MSB.
+		uint8  length; ///< The length of the code.
+		uint32 index;  ///< The index of the code.
+
+		Code(uint32 c, uint8 l, uint32 i);
+
+		/** Sort by length. */
+		bool operator<(const Code &right) const;
 	};
 
-	typedef std::list<Symbol>     CodeList;
-	typedef std::vector<CodeList> CodeLists;
-	typedef std::vector<Symbol *> SymbolList;
+	typedef std::vector<TableEntry> Table;
+	typedef std::vector<Code>       Codes;
 
-	/** Lists of codes and their symbols, sorted by code length. */
-	CodeLists _codes;
+	/** Number of bits resolved by the first-level tables. */
+	uint8 _tableBits;
 
-	/** Sorted list of pointers to the symbols. */
-	SymbolList _symbols;
+	/** Lookup tables for bitstreams going from MSB to LSB. */
+	Table _tableMSB;
+	/** Lookup tables for bitstreams going from LSB to MSB. */
+	Table _tableLSB;
+
+	/** The symbols of all codes, by code index. */
+	std::vector<uint32> _symbols;
 
 	void init(uint8 maxLength, size_t codeCount, const uint32 *codes,
 	          const uint8 *lengths, const uint32 *symbols);
+
+	/** Build a lookup table for these codes and return its offset. */
+	static uint32 buildTable(Table &table, uint8 tableBits, const Codes &codes, bool msbFirst);
 };
 
 } // End of namespace Common
@@ -0,0 +1,182 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Read-only memory mappings of whole files.
+ */
+
+#include "src/common/system.h"
+
+#if defined(WIN32)
+	#include <windows.h>
+	#include <io.h>
+#endif
+
+#if defined(UNIX)
+	#include <sys/types.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include <cstdio>
+
+#include "src/common/mappedfile.h"
+#include "src/common/error.h"
+#include "src/common/ustring.h"
+#include "src/common/platform.h"
+
+namespace Common {
+
+FileMapping::FileMapping(const UString &fileName) : _data(0), _size(0), _handle(0) {
+	std::FILE *file = Platform::openFile(fileName, Platform::kFileModeRead);
+	if (!file)
+		throw Exception("Can't open file \"%s\"", fileName.c_str());
+
+	bool mapped = false;
+
+#if defined(WIN32)
+
+	HANDLE fileHandle = (HANDLE) _get_osfhandle(_fileno(file));
+
+	LARGE_INTEGER fileSize;
+	if ((fileHandle != INVALID_HANDLE_VALUE) && GetFileSizeEx(fileHandle, &fileSize) &&
+	    ((uint64) fileSize.QuadPart <= (uint64) SIZE_MAX)) {
+
+		_size = (size_t) fileSize.QuadPart;
+
+		if (_size == 0) {
+			mapped = true;
+		} else {
+			HANDLE mapping = CreateFileMapping(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+			if (mapping) {
+				_data = static_cast<const byte *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+				if (_data) {
+					_handle = mapping;
+					mapped  = true;
+				} else
+					CloseHandle(mapping);
+			}
+		}
+	}
+
+#elif defined(UNIX)
+
+	const int fd = fileno(file);
+
+	struct stat fileStat;
+	if ((fd >= 0) && (fstat(fd, &fileStat) == 0) && ((uint64) fileStat.st_size <= (uint64) SIZE_MAX)) {
+		_size = (size_t) fileStat.st_size;
+
+		if (_size == 0) {
+			mapped = true;
+		} else {
+			void *data = mmap(0, _size, PROT_READ, MAP_SHARED, fd, 0);
+			if (data != MAP_FAILED) {
+				_data  = static_cast<const byte *>(data);
+				mapped = true;
+			}
+		}
+	}
+
+#endif
+
+	// The mapping stays valid after the file has been closed
+	std::fclose(file);
+
+	if (!mapped)
+		throw Exception("Can't map file \"%s\"", fileName.c_str());
+}
+
+FileMapping::~FileMapping() {
+	unmap();
+}
+
+void FileMapping::unmap() {
+	if (!_data)
+		return;
+
+#if defined(WIN32)
+	UnmapViewOfFile(_data);
+	CloseHandle((HANDLE) _handle);
+#elif defined(UNIX)
+	munmap(const_cast<byte *>(_data), _size);
+#endif
+
+	_data   = 0;
+	_size   = 0;
+	_handle = 0;
+}
+
+const byte *FileMapping::getData() const {
+	return _data;
+}
+
+size_t FileMapping::getSize() const {
+	return _size;
+}
+
+bool FileMapping::isSupported() {
+#if defined(WIN32) || defined(UNIX)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+MappedReadStream::MappedReadStream(const boost::shared_ptr<FileMapping> &mapping, size_t offset, size_t size) :
+	MemoryReadStream(getMappedData(mapping, offset, size), size), _mapping(mapping), _offset(offset) {
+
+}
+
+MappedReadStream::~MappedReadStream() {
+}
+
+const byte *MappedReadStream::getMappedData(const boost::shared_ptr<FileMapping> &mapping,
+                                            size_t offset, size_t size) {
+
+	if (!mapping)
+		throw Exception("No file mapping");
+
+	if ((offset > mapping->getSize()) || (size > (mapping->getSize() - offset)))
+		throw Exception("Mapped stream out of range (%u + %u > %u)",
+		                (uint)offset, (uint)size, (uint)mapping->getSize());
+
+	if (!mapping->getData())
+		return 0;
+
+	return mapping->getData() + offset;
+}
+
+MappedReadStream *MappedReadStream::createSubStream(size_t offset, size_t size) const {
+	if ((offset > this->size()) || (size > (this->size() - offset)))
+		throw Exception("Mapped sub stream out of range (%u + %u > %u)",
+		                (uint)offset, (uint)size, (uint)this->size());
+
+	return new MappedReadStream(_mapping, _offset + offset, size);
+}
+
+size_t MappedReadStream::getMappingOffset() const {
+	return _offset;
+}
+
+} // End of namespace Common
@@ -0,0 +1,90 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Read-only memory mappings of whole files.
+ */
+
+#ifndef COMMON_MAPPEDFILE_H
+#define COMMON_MAPPEDFILE_H
+
+#include <boost/shared_ptr.hpp>
+
+#include "src/common/types.h"
+#include "src/common/noncopyable.h"
+#include "src/common/memreadstream.h"
+
+namespace Common {
+
+class UString;
+
+/** A whole file, mapped read-only into memory. */
+class FileMapping : NonCopyable {
+public:
+	/** Map this file. Throws if the file can't be opened or mapped. */
+	FileMapping(const UString &fileName);
+	~FileMapping();
+
+	/** Return the mapped data. */
+	const byte *getData() const;
+	/** Return the size of the mapped data. */
+	size_t getSize() const;
+
+	/** Can files be mapped on this platform? */
+	static bool isSupported();
+
+private:
+	const byte *_data;
+	size_t      _size;
+
+	/** Platform-specific handle on the mapping, if needed. */
+	void *_handle;
+
+	void unmap();
+};
+
+/** A stream over (a part of) a file mapping.
+ *
+ *  The stream holds a reference onto the mapping, so the mapping stays
+ *  valid for as long as there's still a stream reading from it.
+ */
+class MappedReadStream : public MemoryReadStream {
+public:
+	/** Create a stream over a part of the mapping. Throws if the part is out of range. */
+	MappedReadStream(const boost::shared_ptr<FileMapping> &mapping, size_t offset, size_t size);
+	~MappedReadStream();
+
+	/** Create a new stream over a part of this stream, without copying the data. */
+	MappedReadStream *createSubStream(size_t offset, size_t size) const;
+
+	/** Return the offset of this stream within the mapping. */
+	size_t getMappingOffset() const;
+
+private:
+	boost::shared_ptr<FileMapping> _mapping;
+
+	size_t _offset;
+
+	static const byte *getMappedData(const boost::shared_ptr<FileMapping> &mapping, size_t offset, size_t size);
+};
+
+} // End of namespace Common
+
+#endif // COMMON_MAPPEDFILE_H
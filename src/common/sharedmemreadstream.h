@@ -0,0 +1,55 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A read stream over a shared, reference-counted memory buffer.
+ */
+
+#ifndef COMMON_SHAREDMEMREADSTREAM_H
+#define COMMON_SHAREDMEMREADSTREAM_H
+
+#include <boost/shared_array.hpp>
+
+#include "src/common/types.h"
+#include "src/common/memreadstream.h"
+
+namespace Common {
+
+/** A stream over a shared, reference-counted and read-only memory buffer.
+ *
+ *  Several streams can read from the same buffer at the same time, each
+ *  with their own position. The buffer is freed once the last stream
+ *  (and any other holder of the buffer) goes away.
+ */
+class SharedMemoryReadStream : public MemoryReadStream {
+public:
+	SharedMemoryReadStream(const boost::shared_array<const byte> &data, size_t size);
+	~SharedMemoryReadStream();
+
+	/** Return the shared buffer this stream reads from. */
+	const boost::shared_array<const byte> &getSharedData() const;
+
+private:
+	boost::shared_array<const byte> _data;
+};
+
+} // End of namespace Common
+
+#endif // COMMON_SHAREDMEMREADSTREAM_H
@@ -0,0 +1,46 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Timestamp helpers, for measuring how long things take.
+ */
+
+#include <SDL_timer.h>
+
+#include "src/common/timestamp.h"
+
+namespace Common {
+
+uint32 getTimestamp() {
+	return SDL_GetTicks();
+}
+
+uint64 getMicroTimestamp() {
+	static const uint64 frequency = SDL_GetPerformanceFrequency();
+	if (frequency == 0)
+		return ((uint64) SDL_GetTicks()) * 1000;
+
+	const uint64 counter = SDL_GetPerformanceCounter();
+
+	// Split the division to avoid overflowing on high-frequency counters
+	return (counter / frequency) * 1000000 + ((counter % frequency) * 1000000) / frequency;
+}
+
+} // End of namespace Common
@@ -0,0 +1,44 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  Timestamp helpers, for measuring how long things take.
+ */
+
+#ifndef COMMON_TIMESTAMP_H
+#define COMMON_TIMESTAMP_H
+
+#include "src/common/types.h"
+
+namespace Common {
+
+/** Return the number of milliseconds since the initialization of SDL. */
+uint32 getTimestamp();
+
+/** Return a high-resolution timestamp, in microseconds.
+ *
+ *  The point of origin is arbitrary, so the value is only meaningful when
+ *  compared against another value returned by this function.
+ */
+uint64 getMicroTimestamp();
+
+} // End of namespace Common
+
+#endif // COMMON_TIMESTAMP_H
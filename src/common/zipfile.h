@@ -55,6 +55,9 @@ public:
 	/** Return the size of a file. */
 	size_t getFileSize(uint32 index) const;
 
+	/** Is the file stored compressed? */
+	bool isFileCompressed(uint32 index) const;
+
 	/** Return a stream of the file's contents. */
 	SeekableReadStream *getFile(uint32 index, bool tryNoCopy = false) const;
 
@@ -63,6 +66,8 @@ private:
 	struct IFile {
 		uint32 offset; ///< The offset of the file within the ZIP.
 		uint32 size;   ///< The file's size.
+
+		uint16 compMethod; ///< The file's compression method.
 	};
 
 	typedef std::vector<IFile> IFileList;
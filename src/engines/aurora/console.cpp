@@ -25,26 +25,68 @@
 #include <cassert>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
+
+#include <map>
+#include <set>
+#include <algorithm>
+#include <list>
 
 #include <boost/bind.hpp>
 
 #include "src/common/util.h"
+#include "src/common/maths.h"
 #include "src/common/strutil.h"
 #include "src/common/filepath.h"
 #include "src/common/readline.h"
 #include "src/common/configman.h"
+#include "src/common/hash.h"
+#include "src/common/timestamp.h"
+#include "src/common/flathashmap.h"
+#include "src/common/readfile.h"
+#include "src/common/mappedfile.h"
+#include "src/common/alloccount.h"
+#include "src/common/thread.h"
+#include "src/common/mutex.h"
+#include "src/common/huffman.h"
+#include "src/common/bitstream.h"
+#include "src/common/memreadstream.h"
+#include "src/common/endianness.h"
 
 #include "src/aurora/resman.h"
+#include "src/aurora/util.h"
 #include "src/aurora/talkman.h"
+#include "src/aurora/biffile.h"
+#include "src/aurora/erffile.h"
+#include "src/aurora/rimfile.h"
+#include "src/aurora/herffile.h"
+#include "src/aurora/gff3file.h"
+#include "src/aurora/gff4file.h"
+#include "src/aurora/2dafile.h"
+#include "src/aurora/2dasnapshot.h"
+
+#include "src/aurora/nwscript/ncsfile.h"
+#include "src/aurora/nwscript/scriptcache.h"
+#include "src/aurora/nwscript/functionman.h"
 
 #include "src/graphics/graphics.h"
+#include "src/graphics/camera.h"
 #include "src/graphics/font.h"
 
 #include "src/sound/sound.h"
+#include "src/sound/audiostream.h"
+
+#include "src/sound/decoders/pcm.h"
+
+#include "src/sound/decoders/wmadata.h"
+
+#include "src/video/binkdata.h"
 
 #include "src/events/events.h"
 
 #include "src/graphics/aurora/textureman.h"
+#include "src/graphics/aurora/modelqueueman.h"
+#include "src/graphics/aurora/model.h"
 #include "src/graphics/aurora/cursorman.h"
 #include "src/graphics/aurora/fontman.h"
 #include "src/graphics/aurora/text.h"
@@ -54,6 +96,7 @@
 
 #include "src/engines/aurora/console.h"
 #include "src/engines/aurora/util.h"
+#include "src/engines/aurora/model.h"
 
 
 static const uint32 kDoubleClickTime = 500;
@@ -757,6 +800,62 @@ Console::Console(Engine &engine, const Common::UString &font, int fontHeight) :
 			"Change the game's current language");
 	registerCommand("getstring"  , boost::bind(&Console::cmdGetString  , this, _1),
 			"Usage: getstring <strref>\nGet a string from the talk manager and print it");
+	registerCommand("indexstats" , boost::bind(&Console::cmdIndexStats , this, _1),
+			"Usage: indexstats\nPrint how long indexing the game's archives took");
+	registerCommand("rescache"   , boost::bind(&Console::cmdResCache   , this, _1),
+			"Usage: rescache\nPrint statistics about the cache of decompressed resources");
+	registerCommand("soundcache" , boost::bind(&Console::cmdSoundCache , this, _1),
+			"Usage: soundcache\nPrint statistics about the cache of decoded sounds");
+	registerCommand("modelbuffers", boost::bind(&Console::cmdModelBuffers, this, _1),
+			"Usage: modelbuffers\nPrint statistics about the GL buffer objects holding model geometry,\n"
+			"and how much of it is shared between models");
+	registerCommand("resbench"   , boost::bind(&Console::cmdResBench   , this, _1),
+			"Usage: resbench [<count>]\nMeasure insert and lookup throughput of resource index structures");
+	registerCommand("archivebench", boost::bind(&Console::cmdArchiveBench, this, _1),
+			"Usage: archivebench <archive>\nMeasure reading all resources of a BIF, ERF, RIM or HERF,\n"
+			"from a file handle and from a memory mapping");
+	registerCommand("scriptbench", boost::bind(&Console::cmdScriptBench, this, _1),
+			"Usage: scriptbench <runs> <script> [<script> ...]\nRun scripts repeatedly, without an owner,\n"
+			"and measure how many instructions per second they execute\n"
+			"and how many heap allocations they make.\n"
+			"Note: engine functions called by the scripts are run for real");
+	registerCommand("scriptprof" , boost::bind(&Console::cmdScriptProf , this, _1),
+			"Usage: scriptprof [<count>|reset]\nShow the engine functions called by scripts,\n"
+			"sorted by the time spent in them, optionally only the top <count>.\n"
+			"\"reset\" clears the statistics");
+	registerCommand("gffbench"   , boost::bind(&Console::cmdGFFBench   , this, _1),
+			"Usage: gffbench [<runs>]\nLoad all available GIT, ARE and UTC files and measure\n"
+			"the time needed to read all their fields, <runs> times in a row\n"
+			"and once in several threads at the same time");
+	registerCommand("gff4bench"  , boost::bind(&Console::cmdGFF4Bench  , this, _1),
+			"Usage: gff4bench\nLoad all available ARL, RML, MMH and MSH files, once with\n"
+			"all structs created up front and once lazily, and compare the time\n"
+			"and heap allocations needed to load them and read their top level");
+	registerCommand("2dabench"   , boost::bind(&Console::cmd2DABench   , this, _1),
+			"Usage: 2dabench\nLoad all available 2DA files by parsing them, and then\n"
+			"again out of a temporary 2DA snapshot, and compare the times");
+
+	registerCommand("bitbench"   , boost::bind(&Console::cmdBitBench   , this, _1),
+			"Usage: bitbench [<megabytes>]\nRead <megabytes> of random data with each bit stream\n"
+			"memory layout, both directly from memory and through a generic\n"
+			"stream, and measure the throughput");
+	registerCommand("huffbench"  , boost::bind(&Console::cmdHuffBench  , this, _1),
+			"Usage: huffbench [<symbols>]\nDecode <symbols> random symbols with each of the WMA\n"
+			"coefficient and Bink Huffman tables, and measure the throughput");
+	registerCommand("soundbench" , boost::bind(&Console::cmdSoundBench , this, _1),
+			"Usage: soundbench [<channels>] [<seconds>]\nPlay <channels> looping sounds for <seconds>\n"
+			"and measure the time spent in the sound thread's updates\n"
+			"and the number of buffer underruns");
+	registerCommand("cullbench"  , boost::bind(&Console::cmdCullBench  , this, _1),
+			"Usage: cullbench [<frames>]\nMove the camera along a fixed path around its current\n"
+			"position for <frames> frames, once with and once without\n"
+			"frustum culling, and measure the time spent rendering the world");
+	registerCommand("renderbench", boost::bind(&Console::cmdRenderBench, this, _1),
+			"Usage: renderbench <model> [<count>] [<frames>]\nPlace <count> copies of <model> in front of the\n"
+			"camera and render <frames> frames without the model queue, and\n"
+			"with the model queue using each instancing mode, and measure\n"
+			"the time spent rendering the world and the number of draw calls\n"
+			"and texture binds");
 
 	_console->setPrompt(kPrompt);
 
@@ -1418,6 +1517,1339 @@ void Console::cmdGetString(const CommandLine &cl) {
 	printf("\"%s\"", TalkMan.getString(strRef).c_str());
 }
 
+void Console::cmdIndexStats(const CommandLine &UNUSED(cl)) {
+	const Aurora::ResourceManager::IndexStats &stats = ResMan.getIndexStats();
+
+	printf("Archives indexed from the index cache: %u (%.3fs)",
+	       stats.archivesCached, stats.timeCached / 1000000.0);
+	printf("Archives indexed directly: %u (%.3fs)",
+	       stats.archivesIndexed, stats.timeIndexed / 1000000.0);
+}
+
+void Console::cmdResCache(const CommandLine &UNUSED(cl)) {
+	const Aurora::ResourceManager::CacheStats stats = ResMan.getCacheStats();
+
+	if (stats.budget == 0) {
+		printf("The resource cache is disabled");
+		return;
+	}
+
+	const uint64 requests = stats.hits + stats.misses;
+	const double hitRate  = (requests > 0) ? ((100.0 * stats.hits) / requests) : 0.0;
+
+	printf("Hits: %s, misses: %s (%.1f%% hit rate)",
+	       Common::composeString(stats.hits).c_str(), Common::composeString(stats.misses).c_str(), hitRate);
+	printf("Evictions: %s", Common::composeString(stats.evictions).c_str());
+	printf("Memory: %.2f of %.2f MB, in %u resources",
+	       stats.size / (1024.0 * 1024.0), stats.budget / (1024.0 * 1024.0), (uint) stats.entries);
+}
+
+void Console::cmdSoundCache(const CommandLine &UNUSED(cl)) {
+	const Sound::SoundManager::CacheStats stats = SoundMan.getCacheStats();
+
+	if (stats.budget == 0) {
+		printf("The sound cache is disabled");
+		return;
+	}
+
+	const uint64 requests = stats.hits + stats.misses;
+	const double hitRate  = (requests > 0) ? ((100.0 * stats.hits) / requests) : 0.0;
+
+	printf("Hits: %s, misses: %s (%.1f%% hit rate)",
+	       Common::composeString(stats.hits).c_str(), Common::composeString(stats.misses).c_str(), hitRate);
+	printf("Evictions: %s, invalidations: %s",
+	       Common::composeString(stats.evictions).c_str(), Common::composeString(stats.invalidations).c_str());
+	printf("Memory: %.2f of %.2f MB, in %u sounds",
+	       stats.size / (1024.0 * 1024.0), stats.budget / (1024.0 * 1024.0), (uint) stats.entries);
+}
+
+void Console::printBufferStats() {
+	const Graphics::Aurora::Model::BufferStats stats = Graphics::Aurora::Model::getBufferStats();
+
+	printf("%u models in %u buffer object pairs, %.1fKB uploaded, %.1fKB more without sharing",
+	       stats.models, stats.buffers, stats.size / 1024.0, stats.sharedSize / 1024.0);
+}
+
+void Console::cmdModelBuffers(const CommandLine &UNUSED(cl)) {
+	printBufferStats();
+}
+
+/** Insert all hashes into a resource index the way the ResourceManager does, then look them all up. */
+static uint32 benchmarkFlatIndex(const std::vector<uint64> &hashes, uint64 &timeInsert, uint64 &timeLookup) {
+	Common::FlatHashMap< std::vector<uint32> > index;
+
+	uint64 start = Common::getMicroTimestamp();
+
+	for (size_t i = 0; i < hashes.size(); i++)
+		index[hashes[i]].push_back(i);
+
+	timeInsert = Common::getMicroTimestamp() - start;
+	start      = Common::getMicroTimestamp();
+
+	uint32 found = 0;
+	for (size_t i = 0; i < hashes.size(); i++) {
+		const std::vector<uint32> *list = index.find(hashes[i]);
+		if (list && !list->empty())
+			found += list->back() == i;
+	}
+
+	timeLookup = Common::getMicroTimestamp() - start;
+
+	return found;
+}
+
+/** Insert all hashes into an old-style map/list resource index, then look them all up. */
+static uint32 benchmarkMapIndex(const std::vector<uint64> &hashes, uint64 &timeInsert, uint64 &timeLookup) {
+	typedef std::map< uint64, std::list<uint32> > MapIndex;
+
+	MapIndex index;
+
+	uint64 start = Common::getMicroTimestamp();
+
+	for (size_t i = 0; i < hashes.size(); i++)
+		index[hashes[i]].push_back(i);
+
+	timeInsert = Common::getMicroTimestamp() - start;
+	start      = Common::getMicroTimestamp();
+
+	uint32 found = 0;
+	for (size_t i = 0; i < hashes.size(); i++) {
+		MapIndex::const_iterator list = index.find(hashes[i]);
+		if ((list != index.end()) && !list->second.empty())
+			found += list->second.back() == i;
+	}
+
+	timeLookup = Common::getMicroTimestamp() - start;
+
+	return found;
+}
+
+void Console::cmdResBench(const CommandLine &cl) {
+	uint32 count = 100000;
+	if (!cl.args.empty()) {
+		try {
+			Common::parseString(cl.args, count);
+		} catch (...) {
+			printCommandHelp(cl.cmd);
+			return;
+		}
+	}
+
+	if (count == 0) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	std::vector<uint64> hashes;
+	hashes.reserve(count);
+
+	for (uint32 i = 0; i < count; i++)
+		hashes.push_back(Common::hashString(Common::UString::format("res%u.tga", i), Common::kHashFNV64));
+
+	uint64 flatInsert = 0, flatLookup = 0, mapInsert = 0, mapLookup = 0;
+
+	const uint32 flatFound = benchmarkFlatIndex(hashes, flatInsert, flatLookup);
+	const uint32 mapFound  = benchmarkMapIndex (hashes, mapInsert , mapLookup );
+
+	printf("%u resources:", count);
+	printf("Flat hash index: insert %.3fms, lookup %.3fms (%u found)",
+	       flatInsert / 1000.0, flatLookup / 1000.0, flatFound);
+	printf("Map/list index:  insert %.3fms, lookup %.3fms (%u found)",
+	       mapInsert  / 1000.0, mapLookup  / 1000.0, mapFound);
+}
+
+/** Open an archive of the type the file name says it is. */
+static Aurora::Archive *openBenchArchive(const Common::UString &path, Common::SeekableReadStream *stream) {
+	switch (TypeMan.getFileType(path)) {
+		case Aurora::kFileTypeBIF:
+			return new Aurora::BIFFile(stream);
+
+		case Aurora::kFileTypeERF:
+		case Aurora::kFileTypeMOD:
+		case Aurora::kFileTypeHAK:
+		case Aurora::kFileTypeNWM:
+		case Aurora::kFileTypeSAV:
+			return new Aurora::ERFFile(stream);
+
+		case Aurora::kFileTypeRIM:
+			return new Aurora::RIMFile(stream);
+
+		case Aurora::kFileTypeHERF:
+			return new Aurora::HERFFile(stream);
+
+		default:
+			break;
+	}
+
+	delete stream;
+	throw Common::Exception("Unsupported archive type");
+}
+
+/** Open an archive and read every resource in it, fully. Return the number of bytes read. */
+static uint64 benchmarkArchive(const Common::UString &path, bool map, bool tryNoCopy, uint64 &time) {
+	const uint64 start = Common::getMicroTimestamp();
+
+	Common::SeekableReadStream *stream = 0;
+	if (map) {
+		boost::shared_ptr<Common::FileMapping> mapping(new Common::FileMapping(path));
+
+		stream = new Common::MappedReadStream(mapping, 0, mapping->getSize());
+	} else
+		stream = new Common::ReadFile(path);
+
+	Aurora::Archive *archive = openBenchArchive(path, stream);
+
+	uint64 bytes = 0;
+	byte buffer[4096];
+
+	try {
+		/* Without a KEY, the resources in a BIF have no names, and so they don't
+		 * show up in the resource list. Just read them all by their index. */
+		std::vector<uint32> indices;
+
+		Aurora::BIFFile *bif = dynamic_cast<Aurora::BIFFile *>(archive);
+		if (bif) {
+			for (uint32 i = 0; i < bif->getInternalResourceCount(); i++)
+				indices.push_back(i);
+		} else {
+			const Aurora::Archive::ResourceList &resources = archive->getResources();
+			for (Aurora::Archive::ResourceList::const_iterator r = resources.begin(); r != resources.end(); ++r)
+				indices.push_back(r->index);
+		}
+
+		for (std::vector<uint32>::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+			Common::SeekableReadStream *res = archive->getResource(*i, tryNoCopy);
+
+			size_t n;
+			while ((n = res->read(buffer, sizeof(buffer))) > 0)
+				bytes += n;
+
+			delete res;
+		}
+	} catch (...) {
+		delete archive;
+		throw;
+	}
+
+	delete archive;
+
+	time = Common::getMicroTimestamp() - start;
+
+	return bytes;
+}
+
+void Console::cmdArchiveBench(const CommandLine &cl) {
+	if (cl.args.empty()) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	Common::UString path = ResMan.findResourceFile(cl.args);
+	if (path.empty())
+		path = cl.args;
+
+	if (!Common::FilePath::isRegularFile(path)) {
+		printf("No such archive \"%s\"", cl.args.c_str());
+		return;
+	}
+
+	static const char * const kModeNames[3] = { "read, copy", "read, no copy", "mapped" };
+
+	for (int i = 0; i < 3; i++) {
+		try {
+			uint64 time = 0;
+			const uint64 bytes = benchmarkArchive(path, i == 2, i == 1, time);
+
+			printf("%-13s: %.2f MB in %.3fms (%.1f MB/s)", kModeNames[i], bytes / (1024.0 * 1024.0),
+			       time / 1000.0, (time > 0) ? ((bytes / (1024.0 * 1024.0)) / (time / 1000000.0)) : 0.0);
+
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to benchmark archive \"%s\"", path.c_str());
+			printf("%-13s: failed", kModeNames[i]);
+		}
+	}
+}
+
+/** Load a script and run it repeatedly, measuring the time spent loading and running.
+ *
+ *  Like the engines do, every run creates a new NCSFile instance for the script.
+ *  The heap allocations done while running, not counting the creation of the
+ *  NCSFile instances, are counted as well.
+ */
+static uint64 benchmarkScript(const Common::UString &script, uint32 runs,
+                              uint64 &timeLoad, uint64 &timeRun, uint64 &allocations) {
+
+	uint64 start = Common::getMicroTimestamp();
+
+	{
+		Aurora::NWScript::NCSFile ncs(script);
+	}
+
+	timeLoad = Common::getMicroTimestamp() - start;
+	start    = Common::getMicroTimestamp();
+
+	uint64 instructions = 0;
+
+	allocations = 0;
+	for (uint32 i = 0; i < runs; i++) {
+		Aurora::NWScript::NCSFile ncs(script);
+
+		const uint64 allocationsStart = Common::getAllocationCount();
+
+		ncs.run();
+
+		allocations  += Common::getAllocationCount() - allocationsStart;
+		instructions += ncs.getExecutedCount();
+	}
+
+	timeRun = Common::getMicroTimestamp() - start;
+
+	return instructions;
+}
+
+void Console::cmdScriptBench(const CommandLine &cl) {
+	std::vector<Common::UString> args;
+	splitArguments(cl.args, args);
+
+	uint32 runs = 0;
+	if (args.size() >= 2) {
+		try {
+			Common::parseString(args[0], runs);
+		} catch (...) {
+			runs = 0;
+		}
+	}
+
+	if (runs == 0) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	uint64 totalInstructions = 0, totalTime = 0, totalAllocations = 0;
+	for (size_t i = 1; i < args.size(); i++) {
+		try {
+			uint64 timeLoad = 0, timeRun = 0, allocations = 0;
+			const uint64 instructions = benchmarkScript(args[i], runs, timeLoad, timeRun, allocations);
+
+			printf("%s: loaded in %.3fms, %s instructions in %.3fms (%.0f instructions/s)",
+			       args[i].c_str(), timeLoad / 1000.0, Common::composeString(instructions).c_str(),
+			       timeRun / 1000.0, (timeRun > 0) ? (instructions / (timeRun / 1000000.0)) : 0.0);
+			if (Common::hasAllocationCount())
+				printf("%s: %s heap allocations (%.2f per run, %.4f per instruction)",
+				       args[i].c_str(), Common::composeString(allocations).c_str(), allocations / (double) runs,
+				       (instructions > 0) ? (allocations / (double) instructions) : 0.0);
+
+			totalInstructions += instructions;
+			totalTime         += timeRun;
+			totalAllocations  += allocations;
+
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to benchmark script \"%s\"", args[i].c_str());
+			printf("%s: failed", args[i].c_str());
+		}
+	}
+
+	if (args.size() > 2)
+		printf("Total: %s instructions in %.3fms (%.0f instructions/s), %s heap allocations",
+		       Common::composeString(totalInstructions).c_str(), totalTime / 1000.0,
+		       (totalTime > 0) ? (totalInstructions / (totalTime / 1000000.0)) : 0.0,
+		       Common::composeString(totalAllocations).c_str());
+
+	if (!Common::hasAllocationCount())
+		printf("Heap allocations are not counted in this build (configure with --enable-alloc-counting)");
+
+	const Aurora::NWScript::ScriptCache::Stats stats = ScriptCacheMan.getStats();
+	printf("Script cache: %s hits, %s misses, %s invalidations, %u scripts",
+	       Common::composeString(stats.hits).c_str(), Common::composeString(stats.misses).c_str(),
+	       Common::composeString(stats.invalidations).c_str(), (uint) stats.entries);
+}
+
+static bool compareFunctionTime(const Aurora::NWScript::FunctionManager::FunctionStats &a,
+                                const Aurora::NWScript::FunctionManager::FunctionStats &b) {
+
+	return a.time > b.time;
+}
+
+void Console::cmdScriptProf(const CommandLine &cl) {
+	if (cl.args == "reset") {
+		FunctionMan.clearStats();
+		return;
+	}
+
+	size_t count = SIZE_MAX;
+	if (!cl.args.empty()) {
+		try {
+			Common::parseString(cl.args, count);
+		} catch (...) {
+			printCommandHelp(cl.cmd);
+			return;
+		}
+	}
+
+	std::vector<Aurora::NWScript::FunctionManager::FunctionStats> stats;
+	FunctionMan.getStats(stats);
+
+	if (stats.empty()) {
+		printf("No engine functions called yet");
+		return;
+	}
+
+	std::sort(stats.begin(), stats.end(), compareFunctionTime);
+
+	uint64 totalCalls = 0, totalTime = 0;
+	for (size_t i = 0; i < stats.size(); i++) {
+		totalCalls += stats[i].calls;
+		totalTime  += stats[i].time;
+	}
+
+	printf("%s calls of %u functions, %.3fms (nested calls counted twice)",
+	       Common::composeString(totalCalls).c_str(), (uint) stats.size(), totalTime / 1000.0);
+
+	for (size_t i = 0; i < MIN(count, stats.size()); i++)
+		printf("%-32s (%3u): %10s calls, %10.3fms, %8.3fus per call",
+		       stats[i].name.c_str(), (uint) stats[i].id, Common::composeString(stats[i].calls).c_str(),
+		       stats[i].time / 1000.0, stats[i].time / (double) stats[i].calls);
+}
+
+/** Recursively read the value of every field in a GFF3 struct. Return the number of fields read. */
+static uint64 traverseGFF3(const Aurora::GFF3Struct &strct) {
+	uint64 count = 0;
+
+	const std::vector<Common::UString> &fields = strct.getFieldNames();
+	for (std::vector<Common::UString>::const_iterator f = fields.begin(); f != fields.end(); ++f) {
+		count++;
+
+		switch (strct.getFieldType(*f)) {
+			case Aurora::GFF3Struct::kFieldTypeStruct:
+				count += traverseGFF3(strct.getStruct(*f));
+				break;
+
+			case Aurora::GFF3Struct::kFieldTypeList: {
+					const Aurora::GFF3List &list = strct.getList(*f);
+					for (Aurora::GFF3List::const_iterator l = list.begin(); l != list.end(); ++l)
+						count += traverseGFF3(**l);
+				}
+				break;
+
+			case Aurora::GFF3Struct::kFieldTypeVoid: {
+					Common::SeekableReadStream *data = strct.getData(*f);
+					delete data;
+				}
+				break;
+
+			default:
+				strct.getString(*f);
+				break;
+		}
+	}
+
+	return count;
+}
+
+/** A thread traversing a set of GFF3 files, all at the same time as other threads. */
+class GFF3BenchThread : public Common::Thread {
+public:
+	GFF3BenchThread(const std::vector<Aurora::GFF3File *> &gffs) : _gffs(&gffs), _fields(0), _failed(false) {
+	}
+
+	~GFF3BenchThread() {
+		destroyThread();
+	}
+
+	/** Wait for the traversal to finish. */
+	void wait() {
+		_done.lock();
+	}
+
+	uint64 getFieldCount() const {
+		return _fields;
+	}
+
+	bool hasFailed() const {
+		return _failed;
+	}
+
+private:
+	const std::vector<Aurora::GFF3File *> *_gffs;
+
+	uint64 _fields;
+	bool   _failed;
+
+	Common::Semaphore _done;
+
+	void threadMethod() {
+		try {
+			for (std::vector<Aurora::GFF3File *>::const_iterator g = _gffs->begin(); g != _gffs->end(); ++g)
+				_fields += traverseGFF3((*g)->getTopLevel());
+		} catch (...) {
+			_failed = true;
+		}
+
+		_done.unlock();
+	}
+};
+
+void Console::cmdGFFBench(const CommandLine &cl) {
+	static const size_t kThreadCount = 4;
+
+	uint32 runs = 10;
+	if (!cl.args.empty()) {
+		try {
+			Common::parseString(cl.args, runs);
+		} catch (...) {
+			printCommandHelp(cl.cmd);
+			return;
+		}
+	}
+
+	if (runs == 0) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	std::vector<Aurora::FileType> types;
+	types.push_back(Aurora::kFileTypeGIT);
+	types.push_back(Aurora::kFileTypeARE);
+	types.push_back(Aurora::kFileTypeUTC);
+
+	std::list<Aurora::ResourceManager::ResourceID> resources;
+	ResMan.getAvailableResources(types, resources);
+
+	if (resources.empty()) {
+		printf("No GIT, ARE or UTC resources available");
+		return;
+	}
+
+	// Load all GFF3s
+
+	std::vector<Aurora::GFF3File *> gffs;
+	gffs.reserve(resources.size());
+
+	uint64 timeLoad = 0;
+	for (std::list<Aurora::ResourceManager::ResourceID>::const_iterator r = resources.begin();
+	     r != resources.end(); ++r) {
+
+		try {
+			const uint64 start = Common::getMicroTimestamp();
+
+			gffs.push_back(new Aurora::GFF3File(r->name, r->type));
+
+			timeLoad += Common::getMicroTimestamp() - start;
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to load \"%s\"",
+			                                   TypeMan.setFileType(r->name, r->type).c_str());
+		}
+	}
+
+	// Traverse them all, sequentially
+
+	uint64 fields = 0, timeTraverse = 0;
+
+	try {
+		const uint64 start = Common::getMicroTimestamp();
+
+		for (uint32 i = 0; i < runs; i++)
+			for (std::vector<Aurora::GFF3File *>::const_iterator g = gffs.begin(); g != gffs.end(); ++g)
+				fields += traverseGFF3((*g)->getTopLevel());
+
+		timeTraverse = Common::getMicroTimestamp() - start;
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to traverse GFF3s");
+	}
+
+	fields /= runs;
+
+	// Traverse them all, in several threads at the same time
+
+	uint64 timeThreaded = 0;
+	bool threadsOK = true;
+
+	{
+		std::vector<GFF3BenchThread *> threads;
+
+		const uint64 start = Common::getMicroTimestamp();
+
+		for (size_t i = 0; i < kThreadCount; i++) {
+			threads.push_back(new GFF3BenchThread(gffs));
+			if (!threads.back()->createThread()) {
+				delete threads.back();
+				threads.pop_back();
+			}
+		}
+
+		for (std::vector<GFF3BenchThread *>::iterator t = threads.begin(); t != threads.end(); ++t) {
+			(*t)->wait();
+
+			threadsOK = threadsOK && !(*t)->hasFailed() && ((*t)->getFieldCount() == fields);
+		}
+
+		timeThreaded = Common::getMicroTimestamp() - start;
+
+		threadsOK = threadsOK && (threads.size() == kThreadCount);
+
+		for (std::vector<GFF3BenchThread *>::iterator t = threads.begin(); t != threads.end(); ++t)
+			delete *t;
+	}
+
+	for (std::vector<Aurora::GFF3File *>::iterator g = gffs.begin(); g != gffs.end(); ++g)
+		delete *g;
+
+	printf("%u GFF3s with %s fields:", (uint) gffs.size(), Common::composeString(fields).c_str());
+	printf("Load:     %.3fms", timeLoad / 1000.0);
+	printf("Traverse: %.3fms per run, %.3fus per field",
+	       timeTraverse / (1000.0 * runs), (fields > 0) ? (timeTraverse / (double) (fields * runs)) : 0.0);
+	printf("Traverse in %u threads at once: %.3fms (%s)", (uint) kThreadCount,
+	       timeThreaded / 1000.0, threadsOK ? "results match" : "results DIFFER");
+}
+
+/** Count all fields in this GFF4 struct and all structs reachable from it. */
+static uint64 traverseGFF4(const Aurora::GFF4Struct *strct, std::set<uint64> &visited) {
+	if (!strct || !visited.insert(strct->getID()).second)
+		return 0;
+
+	uint64 count = 0;
+
+	const std::vector<uint32> &labels = strct->getFieldLabels();
+	for (std::vector<uint32>::const_iterator f = labels.begin(); f != labels.end(); ++f) {
+		count++;
+
+		bool isList = false;
+		const Aurora::GFF4Struct::FieldType type = strct->getFieldType(*f, isList);
+
+		if (type == Aurora::GFF4Struct::kFieldTypeGeneric) {
+			count += traverseGFF4(strct->getGeneric(*f), visited);
+		} else if (type == Aurora::GFF4Struct::kFieldTypeStruct) {
+			if (!isList) {
+				count += traverseGFF4(strct->getStruct(*f), visited);
+			} else {
+				const Aurora::GFF4List &list = strct->getList(*f);
+				for (Aurora::GFF4List::const_iterator l = list.begin(); l != list.end(); ++l)
+					count += traverseGFF4(*l, visited);
+			}
+		}
+	}
+
+	return count;
+}
+
+/** Load GFF4s in either eager or lazy mode and measure how much that costs. */
+static bool benchGFF4s(const std::list<Aurora::ResourceManager::ResourceID> &resources, bool lazy,
+                       uint64 &timeLoad, uint64 &timeTop, uint64 &timeTraverse,
+                       size_t &allocations, uint64 &fields) {
+
+	timeLoad = timeTop = timeTraverse = 0;
+	allocations = 0;
+	fields = 0;
+
+	for (std::list<Aurora::ResourceManager::ResourceID>::const_iterator r = resources.begin();
+	     r != resources.end(); ++r) {
+
+		Common::SeekableReadStream *stream = ResMan.getResource(r->name, r->type);
+		if (!stream)
+			continue;
+
+		try {
+			const size_t allocStart = Common::getAllocationCount();
+			const uint64 loadStart  = Common::getMicroTimestamp();
+
+			Aurora::GFF4File gff4(stream, 0xFFFFFFFF, lazy);
+
+			const uint64 topStart = Common::getMicroTimestamp();
+			timeLoad    += topStart - loadStart;
+			allocations += Common::getAllocationCount() - allocStart;
+
+			// Read the top level, like most users that only want a few fields do
+			const Aurora::GFF4Struct &top = gff4.getTopLevel();
+
+			const std::vector<uint32> &labels = top.getFieldLabels();
+			for (std::vector<uint32>::const_iterator f = labels.begin(); f != labels.end(); ++f)
+				top.getFieldType(*f);
+
+			const uint64 traverseStart = Common::getMicroTimestamp();
+			timeTop += traverseStart - topStart;
+
+			std::set<uint64> visited;
+			fields += traverseGFF4(&top, visited);
+
+			timeTraverse += Common::getMicroTimestamp() - traverseStart;
+
+		} catch (...) {
+			Common::exceptionDispatcherWarning("Failed to load \"%s\"",
+			                                   TypeMan.setFileType(r->name, r->type).c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Console::cmdGFF4Bench(const CommandLine &UNUSED(cl)) {
+	std::vector<Aurora::FileType> types;
+	types.push_back(Aurora::kFileTypeARL);
+	types.push_back(Aurora::kFileTypeRML);
+	types.push_back(Aurora::kFileTypeMMH);
+	types.push_back(Aurora::kFileTypeMSH);
+
+	std::list<Aurora::ResourceManager::ResourceID> resources;
+	ResMan.getAvailableResources(types, resources);
+
+	if (resources.empty()) {
+		printf("No ARL, RML, MMH or MSH resources available");
+		return;
+	}
+
+	uint64 eagerLoad, eagerTop, eagerTraverse, eagerFields;
+	uint64 lazyLoad , lazyTop , lazyTraverse , lazyFields;
+	size_t eagerAllocs, lazyAllocs;
+
+	if (!benchGFF4s(resources, false, eagerLoad, eagerTop, eagerTraverse, eagerAllocs, eagerFields) ||
+	    !benchGFF4s(resources, true , lazyLoad , lazyTop , lazyTraverse , lazyAllocs , lazyFields))
+		return;
+
+	printf("%u GFF4s with %s fields:", (uint) resources.size(), Common::composeString(eagerFields).c_str());
+	printf("Eager: load %.3fms (%s allocations), top level %.3fms, full traversal %.3fms",
+	       eagerLoad / 1000.0, Common::composeString(eagerAllocs).c_str(),
+	       eagerTop / 1000.0, eagerTraverse / 1000.0);
+	printf("Lazy:  load %.3fms (%s allocations), top level %.3fms, full traversal %.3fms",
+	       lazyLoad / 1000.0, Common::composeString(lazyAllocs).c_str(),
+	       lazyTop / 1000.0, lazyTraverse / 1000.0);
+
+	if (lazyFields != eagerFields)
+		printf("Field counts DIFFER: %s lazily", Common::composeString(lazyFields).c_str());
+
+	if (!Common::hasAllocationCount())
+		printf("Heap allocations are not counted in this build (configure with --enable-alloc-counting)");
+}
+
+/** A simple xorshift pseudo-random number generator, so that benchmarks are reproducible. */
+static uint64 nextRandom(uint64 &state) {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return state;
+}
+
+/** Read a bit stream in varying amounts of bits. Return the time that took and the number of bits read. */
+template<class BitStreamType>
+static uint64 readBitStream(Common::SeekableReadStream &stream, uint64 &bitCount, uint64 &checksum) {
+	BitStreamType bits(stream);
+
+	// Read 1, 2, ..., 32 bits at a time, for 528 bits per cycle
+	const size_t cycles = bits.size() / 528;
+
+	bitCount = cycles * 528;
+	checksum = 0;
+
+	const uint64 start = Common::getMicroTimestamp();
+
+	for (size_t i = 0; i < cycles; i++)
+		for (size_t n = 1; n <= 32; n++)
+			checksum = (checksum << 1) ^ (checksum >> 63) ^ bits.getBits(n);
+
+	return Common::getMicroTimestamp() - start;
+}
+
+/** Measure the throughput of a bit stream memory layout. */
+template<class BitStreamType>
+static Common::UString benchBitStream(const char *name, const std::vector<byte> &data) {
+	uint64 bitsMemory , checksumMemory;
+	uint64 bitsGeneric, checksumGeneric;
+
+	Common::MemoryReadStream memory(&data[0], data.size());
+
+	const uint64 timeMemory = readBitStream<BitStreamType>(memory, bitsMemory, checksumMemory);
+
+	// Hide the memory behind a sub stream, so that the generic stream reading code is used
+	Common::SeekableSubReadStream generic(&memory, 0, data.size());
+
+	const uint64 timeGeneric = readBitStream<BitStreamType>(generic, bitsGeneric, checksumGeneric);
+
+	return Common::UString::format("%-16s %8.1f Mbit/s from memory, %8.1f Mbit/s from a stream%s", name,
+	                               bitsMemory  / (double) MAX<uint64>(timeMemory , 1),
+	                               bitsGeneric / (double) MAX<uint64>(timeGeneric, 1),
+	                               (checksumMemory == checksumGeneric) ? "" : " (results DIFFER)");
+}
+
+void Console::cmdBitBench(const CommandLine &cl) {
+	uint32 megabytes = 4;
+	if (!cl.args.empty()) {
+		try {
+			Common::parseString(cl.args, megabytes);
+		} catch (...) {
+			printCommandHelp(cl.cmd);
+			return;
+		}
+	}
+
+	if (megabytes == 0) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	uint64 random = 0x2545F4914F6CDD1DULL;
+
+	std::vector<byte> data(megabytes * 1024 * 1024);
+	for (std::vector<byte>::iterator d = data.begin(); d != data.end(); ++d)
+		*d = (byte) nextRandom(random);
+
+	try {
+		printf("%s", benchBitStream<Common::BitStream8MSB   >("BitStream8MSB"   , data).c_str());
+		printf("%s", benchBitStream<Common::BitStream8LSB   >("BitStream8LSB"   , data).c_str());
+		printf("%s", benchBitStream<Common::BitStream16LEMSB>("BitStream16LEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream16LELSB>("BitStream16LELSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream16BEMSB>("BitStream16BEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream16BELSB>("BitStream16BELSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream32LEMSB>("BitStream32LEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream32LELSB>("BitStream32LELSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream32BEMSB>("BitStream32BEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream32BELSB>("BitStream32BELSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream64LEMSB>("BitStream64LEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream64LELSB>("BitStream64LELSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream64BEMSB>("BitStream64BEMSB", data).c_str());
+		printf("%s", benchBitStream<Common::BitStream64BELSB>("BitStream64BELSB", data).c_str());
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to read bit streams");
+	}
+}
+
+/** Write count random Huffman codes, each with the probability implied by its length.
+ *  The indices of the written codes are stored in indices. */
+static void writeHuffmanCodes(std::vector<byte> &data, std::vector<uint32> &indices, size_t count,
+                              const uint32 *codes, const uint8 *lengths, size_t codeCount,
+                              bool msbFirst, uint64 &random) {
+
+	std::vector<uint64> weights(codeCount);
+
+	uint64 total = 0;
+	for (size_t i = 0; i < codeCount; i++)
+		weights[i] = (total += ((uint64) 1) << (40 - lengths[i]));
+
+	data.clear();
+	indices.resize(count);
+
+	uint64 bits = 0;
+	for (size_t i = 0; i < count; i++) {
+		const uint64 r = nextRandom(random) % total;
+
+		indices[i] = std::upper_bound(weights.begin(), weights.end(), r) - weights.begin();
+
+		for (uint8 j = 0; j < lengths[indices[i]]; j++, bits++) {
+			const uint32 bit = msbFirst ? (codes[indices[i]] >> (lengths[indices[i]] - 1 - j)) & 1 :
+			                              (codes[indices[i]] >> j) & 1;
+
+			if ((bits % 8) == 0)
+				data.push_back(0);
+
+			data.back() |= bit << (msbFirst ? (7 - (bits % 8)) : (bits % 8));
+		}
+	}
+
+	// Pad to a whole number of 64-bit values, so that all bit stream layouts can read it
+	data.resize((data.size() + 7) & ~((size_t) 7), 0);
+}
+
+/** Decode symbols with this Huffman decoder and return the time that took. */
+static uint64 decodeHuffmanCodes(const Common::Huffman &huffman, Common::BitStream &bits,
+                                 const std::vector<uint32> &indices, bool &ok) {
+
+	const uint64 start = Common::getMicroTimestamp();
+
+	for (std::vector<uint32>::const_iterator i = indices.begin(); i != indices.end(); ++i)
+		ok = (huffman.getSymbol(bits) == *i) && ok;
+
+	return Common::getMicroTimestamp() - start;
+}
+
+void Console::cmdHuffBench(const CommandLine &cl) {
+	uint32 count = 1000000;
+	if (!cl.args.empty()) {
+		try {
+			Common::parseString(cl.args, count);
+		} catch (...) {
+			printCommandHelp(cl.cmd);
+			return;
+		}
+	}
+
+	if (count == 0) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	uint64 random = 0x2545F4914F6CDD1DULL;
+
+	std::vector<byte>   data;
+	std::vector<uint32> indices;
+
+	try {
+		// WMA coefficients, read MSB to LSB from 8-bit values
+
+		for (size_t i = 0; i < ARRAYSIZE(Sound::coefHuffmanParam); i++) {
+			const Sound::WMACoefHuffmanParam &param = Sound::coefHuffmanParam[i];
+
+			writeHuffmanCodes(data, indices, count, param.huffCodes, param.huffBits, param.n, true, random);
+
+			Common::Huffman huffman(0, param.n, param.huffCodes, param.huffBits);
+
+			Common::MemoryReadStream stream(&data[0], data.size());
+			Common::BitStream8MSB bits(stream);
+
+			bool ok = true;
+			const uint64 time = decodeHuffmanCodes(huffman, bits, indices, ok);
+
+			printf("WMA coefficients %u: %.3fms, %.3f Msymbols/s, %.3f Mbit/s (%s)", (uint) i, time / 1000.0,
+			       count / (double) MAX<uint64>(time, 1), bits.pos() / (double) MAX<uint64>(time, 1),
+			       ok ? "OK" : "symbols DIFFER");
+		}
+
+		// Bink, read LSB to MSB from 32-bit little-endian values
+
+		uint64 timeBink = 0, bitsBink = 0;
+		bool okBink = true;
+
+		for (size_t i = 0; i < ARRAYSIZE(binkHuffmanCodes); i++) {
+			writeHuffmanCodes(data, indices, count, binkHuffmanCodes[i], binkHuffmanLengths[i], 16, false, random);
+
+			Common::Huffman huffman(binkHuffmanLengths[i][15], 16, binkHuffmanCodes[i], binkHuffmanLengths[i]);
+
+			Common::MemoryReadStream stream(&data[0], data.size());
+			Common::BitStream32LELSB bits(stream);
+
+			timeBink += decodeHuffmanCodes(huffman, bits, indices, okBink);
+			bitsBink += bits.pos();
+		}
+
+		const uint64 symbolsBink = ((uint64) count) * ARRAYSIZE(binkHuffmanCodes);
+
+		printf("Bink, all %u tables: %.3fms, %.3f Msymbols/s, %.3f Mbit/s (%s)",
+		       (uint) ARRAYSIZE(binkHuffmanCodes), timeBink / 1000.0,
+		       symbolsBink / (double) MAX<uint64>(timeBink, 1), bitsBink / (double) MAX<uint64>(timeBink, 1),
+		       okBink ? "OK" : "symbols DIFFER");
+
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to decode Huffman codes");
+	}
+}
+
+void Console::cmdSoundBench(const CommandLine &cl) {
+	std::vector<Common::UString> args;
+	splitArguments(cl.args, args);
+
+	uint32 channels = 200, seconds = 5;
+	try {
+		if (args.size() > 0)
+			Common::parseString(args[0], channels);
+		if (args.size() > 1)
+			Common::parseString(args[1], seconds);
+	} catch (...) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	if ((channels == 0) || (seconds == 0) || (args.size() > 2)) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	// One second of a quiet 16-bit mono sawtooth, shared by all channels
+	static const int kRate = 22050;
+
+	std::vector<byte> data(kRate * 2);
+	for (size_t i = 0; i < kRate; i++)
+		WRITE_LE_UINT16(&data[i * 2], (uint16) (int16) (((i * 200) % 4096) - 2048));
+
+	std::vector<Sound::ChannelHandle> handles;
+	handles.reserve(channels);
+
+	try {
+		for (uint32 i = 0; i < channels; i++) {
+			Sound::RewindableAudioStream *pcm =
+				Sound::makePCMStream(new Common::MemoryReadStream(&data[0], data.size()), kRate,
+				                     Sound::FLAG_16BITS | Sound::FLAG_LITTLE_ENDIAN, 1);
+
+			handles.push_back(SoundMan.playAudioStream(Sound::makeLoopingAudioStream(pcm, 0), Sound::kSoundTypeSFX));
+
+			SoundMan.setChannelGain(handles.back(), 0.01f);
+			SoundMan.startChannel(handles.back());
+		}
+
+		SoundMan.resetUpdateStats();
+
+		EventMan.delay(seconds * 1000);
+
+		const Sound::SoundManager::UpdateStats stats = SoundMan.getUpdateStats();
+
+		printf("%u channels, %u seconds: %u updates, %u active channels", channels, seconds,
+		       (uint) stats.updates, (uint) stats.activeChannels);
+		printf("Update time: %.3fms average, %.3fms maximum, %.3fms total",
+		       stats.time / (1000.0 * MAX<uint64>(stats.updates, 1)), stats.maxTime / 1000.0, stats.time / 1000.0);
+
+		uint32 underrunChannels = 0, maxUnderruns = 0;
+		for (std::vector<Sound::ChannelHandle>::const_iterator h = handles.begin(); h != handles.end(); ++h) {
+			const uint32 underruns = SoundMan.getChannelUnderruns(*h);
+
+			underrunChannels += (underruns > 0) ? 1 : 0;
+			maxUnderruns      = MAX(maxUnderruns, underruns);
+		}
+
+		printf("Underruns: %u total, in %u channels, at most %u in one channel",
+		       (uint) stats.underruns, underrunChannels, maxUnderruns);
+
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to play the sounds");
+	}
+
+	for (std::vector<Sound::ChannelHandle>::iterator h = handles.begin(); h != handles.end(); ++h)
+		SoundMan.stopChannel(*h);
+}
+
+/** Wait for a full frame to be rendered, and add its world render statistics to the total. */
+static void addFrameRenderStats(Graphics::GraphicsManager::RenderStats &total) {
+	// The frame currently in progress might have started before the latest changes
+	GfxMan.lockFrame();
+	GfxMan.unlockFrame();
+	GfxMan.lockFrame();
+
+	const Graphics::GraphicsManager::RenderStats stats = GfxMan.getRenderStats();
+
+	GfxMan.unlockFrame();
+
+	total.tested += stats.tested;
+	total.culled += stats.culled;
+	total.drawn  += stats.drawn;
+	total.binds  += stats.binds;
+	total.draws  += stats.draws;
+	total.time   += stats.time;
+}
+
+/** Render <frames> frames along a fixed camera path and sum up the world render statistics. */
+static Graphics::GraphicsManager::RenderStats runCullBench(uint32 frames, const float *position,
+                                                           const float *orientation) {
+
+	static const float kRadius = 5.0f;
+
+	Graphics::GraphicsManager::RenderStats total;
+
+	for (uint32 i = 0; i < frames; i++) {
+		// Orbit around the start position while turning around the vertical axis
+		const float angle = (360.0f * i) / frames;
+
+		CameraMan.setPosition(position[0] + kRadius * cos(Common::deg2rad(angle)),
+		                      position[1] + kRadius * sin(Common::deg2rad(angle)), position[2]);
+		CameraMan.setOrientation(orientation[0], orientation[1], orientation[2] + angle);
+		CameraMan.update();
+
+		addFrameRenderStats(total);
+	}
+
+	return total;
+}
+
+void Console::cmdCullBench(const CommandLine &cl) {
+	std::vector<Common::UString> args;
+	splitArguments(cl.args, args);
+
+	uint32 frames = 360;
+	try {
+		if (args.size() > 0)
+			Common::parseString(args[0], frames);
+	} catch (...) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	if ((frames == 0) || (args.size() > 1)) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	float position[3], orientation[3];
+	memcpy(position   , CameraMan.getPosition   (), sizeof(position));
+	memcpy(orientation, CameraMan.getOrientation(), sizeof(orientation));
+
+	const bool culling = GfxMan.getFrustumCulling();
+
+	for (int pass = 0; pass < 2; pass++) {
+		const bool cull = pass == 0;
+
+		GfxMan.setFrustumCulling(cull);
+
+		const Graphics::GraphicsManager::RenderStats stats = runCullBench(frames, position, orientation);
+
+		printf("Culling %s: %.3fms average world render time, %.1f tested, %.1f culled, %.1f drawn",
+		       cull ? "on " : "off", stats.time / (1000.0 * frames),
+		       stats.tested / (double) frames, stats.culled / (double) frames, stats.drawn / (double) frames);
+	}
+
+	GfxMan.setFrustumCulling(culling);
+
+	CameraMan.setPosition   (position[0]   , position[1]   , position[2]);
+	CameraMan.setOrientation(orientation[0], orientation[1], orientation[2]);
+	CameraMan.update();
+}
+
+/** The model queue configurations renderbench compares. */
+static const struct {
+	const char *name;
+	bool queue;
+	Graphics::Aurora::ModelQueueManager::InstancingMode instancing;
+} kRenderBenchPasses[] = {
+	{ "Model queue off"    , false, Graphics::Aurora::ModelQueueManager::kInstancingNone     },
+	{ "No instancing"      , true , Graphics::Aurora::ModelQueueManager::kInstancingNone     },
+	{ "Batched instancing" , true , Graphics::Aurora::ModelQueueManager::kInstancingBatched  },
+	{ "Hardware instancing", true , Graphics::Aurora::ModelQueueManager::kInstancingHardware }
+};
+
+void Console::cmdRenderBench(const CommandLine &cl) {
+	std::vector<Common::UString> args;
+	splitArguments(cl.args, args);
+
+	uint32 count = 100, frames = 100;
+	try {
+		if (args.size() > 1)
+			Common::parseString(args[1], count);
+		if (args.size() > 2)
+			Common::parseString(args[2], frames);
+	} catch (...) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	if (args.empty() || (args.size() > 3) || (count == 0) || (frames == 0)) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	std::vector<Graphics::Aurora::Model *> models;
+	models.reserve(count);
+
+	for (uint32 i = 0; i < count; i++) {
+		Graphics::Aurora::Model *model = loadModelObject(args[0]);
+		if (!model)
+			break;
+
+		models.push_back(model);
+	}
+
+	if (models.size() == count) {
+		// Place the models in a square grid facing the camera
+
+		const float *position    = CameraMan.getPosition();
+		const float *orientation = CameraMan.getOrientation();
+
+		Common::TransformationMatrix camera;
+		camera.rotate(orientation[2], 0.0f, 0.0f, 1.0f);
+		camera.rotate(orientation[1], 0.0f, 1.0f, 0.0f);
+		camera.rotate(orientation[0], 1.0f, 0.0f, 0.0f);
+
+		const float *right = camera.get() + 0;
+		const float *up    = camera.get() + 4;
+		const float *back  = camera.get() + 8;
+
+		const float size    = MAX(MAX(models[0]->getWidth(), models[0]->getHeight()), models[0]->getDepth());
+		const float spacing = MAX(size, 1.0f) * 1.5f;
+
+		const uint32 columns  = (uint32) ceil(sqrt((double) count));
+		const float  distance = columns * spacing;
+
+		for (uint32 i = 0; i < count; i++) {
+			const float x = ((i % columns) - (columns - 1) / 2.0f) * spacing;
+			const float y = ((i / columns) - (columns - 1) / 2.0f) * spacing;
+
+			models[i]->setPosition(position[0] + right[0] * x + up[0] * y - back[0] * distance,
+			                       position[1] + right[1] * x + up[1] * y - back[1] * distance,
+			                       position[2] + right[2] * x + up[2] * y - back[2] * distance);
+		}
+
+		GfxMan.lockFrame();
+		for (std::vector<Graphics::Aurora::Model *>::iterator m = models.begin(); m != models.end(); ++m)
+			(*m)->show();
+		GfxMan.unlockFrame();
+
+		// Let the models upload their geometry first
+		Graphics::GraphicsManager::RenderStats upload;
+		addFrameRenderStats(upload);
+
+		printBufferStats();
+
+		const bool queue = ModelQueueMan.isEnabled();
+		const Graphics::Aurora::ModelQueueManager::InstancingMode instancing = ModelQueueMan.getInstancingMode();
+
+		for (size_t pass = 0; pass < ARRAYSIZE(kRenderBenchPasses); pass++) {
+			if ((kRenderBenchPasses[pass].instancing == Graphics::Aurora::ModelQueueManager::kInstancingHardware) &&
+			    !ModelQueueMan.hasHardwareInstancing())
+				continue;
+
+			ModelQueueMan.setEnabled(kRenderBenchPasses[pass].queue);
+			ModelQueueMan.setInstancingMode(kRenderBenchPasses[pass].instancing);
+
+			Graphics::GraphicsManager::RenderStats stats;
+			for (uint32 i = 0; i < frames; i++)
+				addFrameRenderStats(stats);
+
+			printf("%-19s: %.3fms average world render time, %.1f draw calls, %.1f texture binds, "
+			       "%.1f objects drawn", kRenderBenchPasses[pass].name, stats.time / (1000.0 * frames),
+			       stats.draws / (double) frames, stats.binds / (double) frames, stats.drawn / (double) frames);
+		}
+
+		ModelQueueMan.setEnabled(queue);
+		ModelQueueMan.setInstancingMode(instancing);
+
+	} else
+		printf("Failed to load model \"%s\"", args[0].c_str());
+
+	for (std::vector<Graphics::Aurora::Model *>::iterator m = models.begin(); m != models.end(); ++m)
+		freeModel(*m);
+}
+
+static bool compare2DAs(const Aurora::TwoDAFile &a, const Aurora::TwoDAFile &b) {
+	if ((a.getRowCount() != b.getRowCount()) || (a.getHeaders() != b.getHeaders()))
+		return false;
+
+	for (size_t c = 0; c < a.getColumnCount(); c++)
+		if (b.headerToColumn(a.getHeaders()[c]) != a.headerToColumn(a.getHeaders()[c]))
+			return false;
+
+	for (size_t r = 0; r < a.getRowCount(); r++) {
+		const Aurora::TwoDARow &rowA = a.getRow(r);
+		const Aurora::TwoDARow &rowB = b.getRow(r);
+
+		for (size_t c = 0; c < a.getColumnCount(); c++) {
+			if ((rowA.getString(c) != rowB.getString(c)) || (rowA.empty(c) != rowB.empty(c)) ||
+			    (rowA.getInt(c) != rowB.getInt(c)) || (rowA.getFloat(c) != rowB.getFloat(c)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void Console::cmd2DABench(const CommandLine &UNUSED(cl)) {
+	if (!Aurora::TwoDASnapshot::isSupported()) {
+		printf("2DA snapshots are not supported on this platform");
+		return;
+	}
+
+	std::list<Aurora::ResourceManager::ResourceID> resources;
+	ResMan.getAvailableResources(Aurora::kFileType2DA, resources);
+
+	if (resources.empty()) {
+		printf("No 2DA resources available");
+		return;
+	}
+
+	// Parse all 2DAs, and add them to a fresh snapshot
+
+	std::vector<Aurora::TwoDAFile *> twodas;
+	std::vector<uint64> hashes;
+	std::vector<Common::UString> names;
+
+	Aurora::TwoDASnapshot snapshot;
+
+	uint64 timeParse = 0, timeHash = 0;
+	for (std::list<Aurora::ResourceManager::ResourceID>::const_iterator r = resources.begin();
+	     r != resources.end(); ++r) {
+
+		Common::SeekableReadStream *stream = 0;
+		try {
+			if (!(stream = ResMan.getResource(r->name, r->type)))
+				continue;
+
+			const uint64 startHash = Common::getMicroTimestamp();
+
+			const uint64 hash = Aurora::TwoDASnapshot::hashSource(*stream);
+
+			const uint64 startParse = Common::getMicroTimestamp();
+
+			Aurora::TwoDAFile *twoda = new Aurora::TwoDAFile(*stream);
+
+			timeParse += Common::getMicroTimestamp() - startParse;
+			timeHash  += startParse - startHash;
+
+			twodas.push_back(twoda);
+			hashes.push_back(hash);
+			names.push_back(r->name);
+
+			snapshot.add(r->name, hash, *twoda);
+
+		} catch (...) {
+			delete stream;
+			stream = 0;
+
+			Common::exceptionDispatcherWarning("Failed to load \"%s\"",
+			                                   TypeMan.setFileType(r->name, r->type).c_str());
+		}
+
+		delete stream;
+	}
+
+	// Write the snapshot into a temporary file, and map it again
+
+	const Common::UString snapshotFile = Common::FilePath::getUserDataFile("2dabench.cache");
+
+	uint64 timeSave = 0, timeMap = 0;
+	try {
+		const uint64 startSave = Common::getMicroTimestamp();
+
+		snapshot.save(snapshotFile);
+
+		const uint64 startMap = Common::getMicroTimestamp();
+
+		if (!snapshot.load(snapshotFile))
+			throw Common::Exception("Failed to map the 2DA snapshot");
+
+		timeSave = startMap - startSave;
+		timeMap  = Common::getMicroTimestamp() - startMap;
+
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed to write \"%s\"", snapshotFile.c_str());
+
+		for (std::vector<Aurora::TwoDAFile *>::iterator t = twodas.begin(); t != twodas.end(); ++t)
+			delete *t;
+
+		std::remove(snapshotFile.c_str());
+		return;
+	}
+
+	const size_t snapshotSize = Common::FilePath::getFileSize(snapshotFile);
+
+	// Create all 2DAs out of the snapshot, and compare them to the parsed ones
+
+	uint64 timeSnapshot = 0;
+	size_t failed = 0, differ = 0;
+
+	for (size_t i = 0; i < twodas.size(); i++) {
+		const uint64 start = Common::getMicroTimestamp();
+
+		Aurora::TwoDAFile *twoda = snapshot.find(names[i], hashes[i]);
+
+		timeSnapshot += Common::getMicroTimestamp() - start;
+
+		if (!twoda) {
+			failed++;
+			continue;
+		}
+
+		if (!compare2DAs(*twodas[i], *twoda))
+			differ++;
+
+		delete twoda;
+	}
+
+	snapshot.clear();
+	std::remove(snapshotFile.c_str());
+
+	for (std::vector<Aurora::TwoDAFile *>::iterator t = twodas.begin(); t != twodas.end(); ++t)
+		delete *t;
+
+	printf("%u 2DAs, snapshot size %.1fKB:", (uint) twodas.size(), snapshotSize / 1024.0);
+	printf("Parse:         %.3fms", timeParse / 1000.0);
+	printf("Hash sources:  %.3fms", timeHash  / 1000.0);
+	printf("Save snapshot: %.3fms, map snapshot: %.3fms", timeSave / 1000.0, timeMap / 1000.0);
+	printf("From snapshot: %.3fms (%u failed, %u differ)", timeSnapshot / 1000.0, (uint) failed, (uint) differ);
+}
+
 void Console::printFullHelp() {
 	print("Available commands (help <command> for further help on each command):");
 
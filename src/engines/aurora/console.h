@@ -298,10 +298,27 @@ private:
 	void cmdGetLang    (const CommandLine &cl);
 	void cmdSetLang    (const CommandLine &cl);
 	void cmdGetString  (const CommandLine &cl);
+	void cmdIndexStats (const CommandLine &cl);
+	void cmdResCache   (const CommandLine &cl);
+	void cmdSoundCache (const CommandLine &cl);
+	void cmdModelBuffers(const CommandLine &cl);
+	void cmdResBench   (const CommandLine &cl);
+	void cmdArchiveBench(const CommandLine &cl);
+	void cmdScriptBench(const CommandLine &cl);
+	void cmdScriptProf (const CommandLine &cl);
+	void cmdGFFBench   (const CommandLine &cl);
+	void cmdGFF4Bench  (const CommandLine &cl);
+	void cmdBitBench   (const CommandLine &cl);
+	void cmdHuffBench  (const CommandLine &cl);
+	void cmdSoundBench (const CommandLine &cl);
+	void cmdCullBench  (const CommandLine &cl);
+	void cmdRenderBench(const CommandLine &cl);
+	void cmd2DABench   (const CommandLine &cl);
 
 	void updateHelpArguments();
 
 	void printFullHelp();
+	void printBufferStats();
 	bool printHints(const Common::UString &command);
 
 	void execute(const Common::UString &line);
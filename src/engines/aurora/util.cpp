@@ -80,11 +80,31 @@ Sound::ChannelHandle playSound(const Common::UString &sound, Sound::SoundType so
 	Sound::ChannelHandle channel;
 
 	try {
-		Common::SeekableReadStream *soundStream = ResMan.getResource(resType, sound);
-		if (!soundStream)
-			return channel;
-
-		channel = SoundMan.playSoundFile(soundStream, soundType, loop);
+		if (resType == Aurora::kResourceSound) {
+			/* Short sounds are kept decoded in the sound cache. The change ID
+			 * makes sure we don't play old data after the resources changed. */
+			const Common::UString cacheName = sound.toLower();
+			const uint64          changeID  = ResMan.getResourceChangeID(resType, sound);
+
+			if (changeID == 0)
+				return channel;
+
+			channel = SoundMan.playCachedSound(cacheName, changeID, soundType, loop);
+			if (!SoundMan.isValidChannel(channel)) {
+				Common::SeekableReadStream *soundStream = ResMan.getResource(resType, sound);
+				if (!soundStream)
+					return channel;
+
+				channel = SoundMan.playSoundFile(cacheName, changeID, soundStream, soundType, loop);
+			}
+
+		} else {
+			Common::SeekableReadStream *soundStream = ResMan.getResource(resType, sound);
+			if (!soundStream)
+				return channel;
+
+			channel = SoundMan.playSoundFile(soundStream, soundType, loop);
+		}
 
 		SoundMan.setChannelGain(channel, volume);
 
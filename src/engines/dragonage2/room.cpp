@@ -102,7 +102,7 @@ void Room::loadLayout(const Common::UString &roomFile) {
 	if (!ResMan.hasResource(roomFile, Aurora::kFileTypeRML) || EventMan.quitRequested())
 		return;
 
-	GFF4File rml(roomFile, Aurora::kFileTypeRML, kRMLID);
+	GFF4File rml(roomFile, Aurora::kFileTypeRML, kRMLID, true);
 	if (rml.getTypeVersion() != kVersion40)
 		throw Common::Exception("Unsupported RML version %s", Common::debugTag(rml.getTypeVersion()).c_str());
 
@@ -26,6 +26,7 @@
 
 #include "src/common/util.h"
 #include "src/common/error.h"
+#include "src/common/debug.h"
 #include "src/common/ustring.h"
 #include "src/common/readfile.h"
 #include "src/common/filelist.h"
@@ -252,6 +253,20 @@ void GameInstanceEngine::listLanguages() {
 void GameInstanceEngine::run() {
 	createEngine();
 
+	/* Use a snapshot of parsed 2DAs, separately for each game.
+	 *
+	 * NOTE: The snapshot is used by default, unless the 2dasnapshot config
+	 *       value is set to an empty string or no2dasnapshot is set to true.
+	 */
+	Common::UString snapshotFile =
+		Common::FilePath::getUserDataFile(Common::UString::format("2dasnapshot-%d.cache", (int) _probe->getGameID()));
+	if (ConfigMan.hasKey("2dasnapshot"))
+		snapshotFile = ConfigMan.getString("2dasnapshot");
+	if (ConfigMan.getBool("no2dasnapshot", false))
+		snapshotFile.clear();
+
+	TwoDAReg.setSnapshot(snapshotFile);
+
 	_engine->start(_probe->getGameID(), _target, _probe->getPlatform());
 
 	destroyEngine();
@@ -289,6 +304,22 @@ void EngineManager::run(GameInstance &game) const {
 
 void EngineManager::cleanup() const {
 	try {
+		const Aurora::ResourceManager::IndexStats &indexStats = ResMan.getIndexStats();
+		debugC(1, Common::kDebugResources,
+		       "Indexed %u archives from the index cache in %.3fs, %u archives directly in %.3fs",
+		       indexStats.archivesCached , indexStats.timeCached  / 1000000.0,
+		       indexStats.archivesIndexed, indexStats.timeIndexed / 1000000.0);
+
+		ResMan.saveIndexCache();
+
+		const Aurora::TwoDARegistry::LoadStats &twodaStats = TwoDAReg.getLoadStats();
+		debugC(1, Common::kDebugResources,
+		       "Loaded %u 2DAs from the snapshot in %.3fs, parsed %u 2DAs in %.3fs",
+		       twodaStats.twodasSnapshot, twodaStats.timeSnapshot / 1000000.0,
+		       twodaStats.twodasParsed  , twodaStats.timeParsed   / 1000000.0);
+
+		TwoDAReg.saveSnapshot();
+
 		DebugMan.clearEngineChannels();
 
 		unregisterModelLoader();
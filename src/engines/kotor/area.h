@@ -73,6 +73,26 @@ public:
 	void show();
 	void hide();
 
+	// Room visibility
+
+	/** How rooms are shown and hidden while the camera moves through the area. */
+	enum RoomVisibility {
+		kRoomVisibilityAll,       ///< Always show all rooms.
+		kRoomVisibilityVIS,       ///< Only show the rooms visible from the camera's room.
+		kRoomVisibilityHysteresis ///< Like kRoomVisibilityVIS, but delay room changes to avoid popping.
+	};
+
+	/** Return how rooms are shown and hidden. */
+	RoomVisibility getRoomVisibility() const;
+	/** Change how rooms are shown and hidden. */
+	void setRoomVisibility(RoomVisibility visibility);
+
+	/** Return the resref of the room the camera is in, or an empty string if it's in none. */
+	const Common::UString &getCameraRoom() const;
+
+	size_t getRoomCount() const;        ///< Return the number of rooms in the area.
+	size_t getVisibleRoomCount() const; ///< Return the number of currently visible rooms.
+
 	// Music/Sound
 
 	uint32 getMusicDayTrack   () const; ///< Return the music track ID playing by day.
@@ -109,6 +129,8 @@ protected:
 
 private:
 	typedef std::list<Room *> RoomList;
+	typedef std::map<Common::UString, Room *> RoomMap;
+	typedef std::map<Room *, uint32> RoomHideMap;
 
 	typedef std::list<KotOR::Object *> ObjectList;
 	typedef std::map<uint32, KotOR::Object *> ObjectMap;
@@ -144,7 +166,16 @@ private:
 	Aurora::LYTFile _lyt; ///< The area's layout description.
 	Aurora::VISFile _vis; ///< The area's inter-room visibility description.
 
-	RoomList _rooms; ///< All rooms in the area.
+	RoomList _rooms;   ///< All rooms in the area.
+	RoomMap  _roomMap; ///< All rooms in the area, indexed by their resref.
+
+	RoomVisibility _roomVisibility; ///< How rooms are shown and hidden.
+
+	Room  *_cameraRoom;        ///< The room the camera is in.
+	uint32 _roomCameraChanged; ///< The camera change timestamp the room visibility was last updated for.
+	size_t _visibleRoomCount;  ///< The number of currently visible rooms.
+
+	RoomHideMap _roomHideTimes; ///< Rooms that are about to be hidden, and when.
 
 	ObjectList _objects;   ///< List of all objects in the area.
 	ObjectMap  _objectMap; ///< Map of all non-static objects in the area.
@@ -172,6 +203,11 @@ private:
 
 	void loadRooms();
 
+	// Room visibility helpers
+
+	Room *findCameraRoom(float x, float y, float z) const;
+	void updateRoomVisibility(bool force = false);
+
 	void loadProperties(const Aurora::GFF3Struct &props);
 
 	void loadObject(KotOR::Object &object);
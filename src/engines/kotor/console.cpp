@@ -40,6 +40,7 @@
 #include "src/engines/kotor/kotor.h"
 #include "src/engines/kotor/game.h"
 #include "src/engines/kotor/module.h"
+#include "src/engines/kotor/area.h"
 
 namespace Engines {
 
@@ -62,6 +63,11 @@ Console::Console(KotOREngine &engine) :
 	registerCommand("playmusic"  , boost::bind(&Console::cmdPlayMusic  , this, _1),
 			"Usage: playmusic [<music>]\nPlay the specified music resource. "
 			"If none was specified, play the default area music.");
+	registerCommand("roomvis"    , boost::bind(&Console::cmdRoomVis    , this, _1),
+			"Usage: roomvis [all|vis|hysteresis]\nShow the camera's room and the number of visible rooms.\n"
+			"If given, change how rooms in the current area are shown:\n"
+			"all: all rooms, vis: only the rooms visible from the camera's room,\n"
+			"hysteresis: like vis, but delay room changes to avoid popping");
 }
 
 Console::~Console() {
@@ -141,6 +147,31 @@ void Console::cmdPlayMusic(const CommandLine &cl) {
 	_engine->getGame().playMusic(cl.args);
 }
 
+void Console::cmdRoomVis(const CommandLine &cl) {
+	Area *area = _engine->getGame().getModule().getCurrentArea();
+	if (!area) {
+		printf("No area loaded");
+		return;
+	}
+
+	if        (cl.args.equalsIgnoreCase("all")) {
+		area->setRoomVisibility(Area::kRoomVisibilityAll);
+	} else if (cl.args.equalsIgnoreCase("vis")) {
+		area->setRoomVisibility(Area::kRoomVisibilityVIS);
+	} else if (cl.args.equalsIgnoreCase("hysteresis")) {
+		area->setRoomVisibility(Area::kRoomVisibilityHysteresis);
+	} else if (!cl.args.empty()) {
+		printCommandHelp(cl.cmd);
+		return;
+	}
+
+	static const char * const kVisibilityNames[] = { "all", "vis", "hysteresis" };
+
+	printf("Room visibility \"%s\", camera in room \"%s\", %u of %u rooms visible",
+	       kVisibilityNames[area->getRoomVisibility()], area->getCameraRoom().c_str(),
+	       (uint) area->getVisibleRoomCount(), (uint) area->getRoomCount());
+}
+
 } // End of namespace KotOR
 
 } // End of namespace Engines
@@ -23,6 +23,7 @@
  */
 
 #include "src/engines/kotor/object.h"
+#include "src/engines/kotor/objectcontainer.h"
 
 #include "src/sound/sound.h"
 
@@ -32,7 +33,7 @@ namespace Engines {
 
 namespace KotOR {
 
-Object::Object(ObjectType type) : _type(type), _static(false), _usable(true) {
+Object::Object(ObjectType type) : _type(type), _static(false), _usable(true), _container(0) {
 	_position   [0] = 0.0f;
 	_position   [1] = 0.0f;
 	_position   [2] = 0.0f;
@@ -101,6 +102,9 @@ void Object::setPosition(float x, float y, float z) {
 	_position[0] = x;
 	_position[1] = y;
 	_position[2] = z;
+
+	if (_container)
+		_container->moveObject(*this);
 }
 
 void Object::setOrientation(float x, float y, float z, float angle) {
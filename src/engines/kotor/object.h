@@ -42,6 +42,8 @@ namespace Engines {
 
 namespace KotOR {
 
+class ObjectContainer;
+
 class Object : public Aurora::NWScript::Object, public KotOR::ScriptContainer {
 public:
 	Object(ObjectType type = kObjectTypeInvalid);
@@ -121,6 +123,10 @@ protected:
 	float _orientation[4]; ///< The object's orientation.
 
 	Sound::ChannelHandle _sound; ///< The currently playing object sound.
+
+	ObjectContainer *_container; ///< The container this object is in.
+
+	friend class ObjectContainer;
 };
 
 } // End of namespace KotOR
@@ -39,22 +39,6 @@ namespace Engines {
 
 namespace KotOR {
 
-ObjectDistanceSort::ObjectDistanceSort(const KotOR::Object &target) {
-	target.getPosition(xt, yt, zt);
-}
-
-bool ObjectDistanceSort::operator()(KotOR::Object *a, KotOR::Object *b) {
-	return getDistance(*a) < getDistance(*b);
-}
-
-float ObjectDistanceSort::getDistance(KotOR::Object &a) {
-	float x, y, z;
-	a.getPosition(x, y, z);
-
-	return ABS(x - xt) + ABS(y - yt) + ABS(z - zt);
-}
-
-
 class SearchType : public ::Aurora::NWScript::SearchRange< std::list<KotOR::Object *> > {
 public:
 	SearchType(const iterator &a, const iterator &b) : ::Aurora::NWScript::SearchRange<type>(std::make_pair(a, b)) { }
@@ -64,6 +48,21 @@ public:
 	::Aurora::NWScript::Object *getObject(const iterator &t) { return *t; }
 };
 
+/** Filter out one specific object, on top of another filter. */
+class ExcludeFilter : public ::Aurora::NWScript::SpatialIndex::Filter {
+public:
+	ExcludeFilter(const ::Aurora::NWScript::Object &exclude, const Filter *filter) :
+		_exclude(&exclude), _filter(filter) { }
+
+	bool operator()(::Aurora::NWScript::Object &object) const {
+		return (&object != _exclude) && (!_filter || (*_filter)(object));
+	}
+
+private:
+	const ::Aurora::NWScript::Object *_exclude;
+	const Filter *_filter;
+};
+
 
 ObjectContainer::ObjectContainer() {
 }
@@ -74,8 +73,14 @@ ObjectContainer::~ObjectContainer() {
 void ObjectContainer::clearObjects() {
 	lock();
 
+	for (ObjectMap::iterator l = _objects.begin(); l != _objects.end(); ++l)
+		for (ObjectList::iterator o = l->second.begin(); o != l->second.end(); ++o)
+			(*o)->_container = 0;
+
 	_objects.clear();
 
+	_spatialIndex.clear();
+
 	::Aurora::NWScript::ObjectContainer::clearObjects();
 
 	unlock();
@@ -88,6 +93,9 @@ void ObjectContainer::addObject(KotOR::Object &object) {
 
 	_objects[object.getType()].push_back(&object);
 
+	object._container = this;
+	indexObject(object);
+
 	unlock();
 }
 
@@ -96,11 +104,52 @@ void ObjectContainer::removeObject(KotOR::Object &object) {
 
 	_objects[object.getType()].remove(&object);
 
+	_spatialIndex.remove(object);
+	object._container = 0;
+
 	::Aurora::NWScript::ObjectContainer::removeObject(object);
 
 	unlock();
 }
 
+void ObjectContainer::moveObject(KotOR::Object &object) {
+	lock();
+
+	indexObject(object);
+
+	unlock();
+}
+
+void ObjectContainer::indexObject(KotOR::Object &object) {
+	// Only real objects can be found by their position
+	if (!(object.getType() & kObjectTypeAll))
+		return;
+
+	float x, y, z;
+	object.getPosition(x, y, z);
+
+	_spatialIndex.update(object, (uint32) object.getType(), x, y, z);
+}
+
+void ObjectContainer::findNearestObjects(const KotOR::Object &target, size_t count, uint32 typeMask,
+                                         std::vector< ::Aurora::NWScript::Object *> &objects,
+                                         const ::Aurora::NWScript::SpatialIndex::Filter *filter) const {
+
+	float x, y, z;
+	target.getPosition(x, y, z);
+
+	const ExcludeFilter excludeTarget(target, filter);
+
+	_spatialIndex.findNearest(x, y, z, count, typeMask, objects, &excludeTarget);
+}
+
+void ObjectContainer::findObjectsInRadius(float x, float y, float z, float radius, uint32 typeMask,
+                                          std::vector< ::Aurora::NWScript::Object *> &objects,
+                                          const ::Aurora::NWScript::SpatialIndex::Filter *filter) const {
+
+	_spatialIndex.findInRadius(x, y, z, radius, typeMask, objects, filter);
+}
+
 ::Aurora::NWScript::Object *ObjectContainer::getFirstObjectByType(ObjectType type) const {
 	ObjectMap::const_iterator l = _objects.find(type);
 	if (l == _objects.end())
@@ -27,10 +27,12 @@
 
 #include <list>
 #include <map>
+#include <vector>
 
 #include "src/common/types.h"
 
 #include "src/aurora/nwscript/objectcontainer.h"
+#include "src/aurora/nwscript/spatialindex.h"
 
 #include "src/engines/kotor/types.h"
 
@@ -47,19 +49,6 @@ class Placeable;
 class Door;
 class Creature;
 
-/** A class able to sort objects by distance to a target object. */
-class ObjectDistanceSort {
-public:
-	ObjectDistanceSort(const KotOR::Object &target);
-
-	bool operator()(KotOR::Object *a, KotOR::Object *b);
-
-private:
-	float xt, yt, zt;
-
-	float getDistance(KotOR::Object &a);
-};
-
 class ObjectContainer : public ::Aurora::NWScript::ObjectContainer {
 public:
 	ObjectContainer();
@@ -72,12 +61,33 @@ public:
 	/** Remove an object from this container. */
 	void removeObject(KotOR::Object &object);
 
+	/** Update the spatial index after an object moved. */
+	void moveObject(KotOR::Object &object);
+
 	/** Return the first object of this type. */
 	::Aurora::NWScript::Object *getFirstObjectByType(ObjectType type) const;
 
 	/** Return a search context to iterate over all objects of this type. */
 	::Aurora::NWScript::ObjectSearch *findObjectsByType(ObjectType type) const;
 
+	/** Find the count objects nearest to a target, ordered by distance.
+	 *
+	 *  Only objects whose type is within the typeMask and that pass the
+	 *  optional filter are considered. The target itself is never included.
+	 */
+	void findNearestObjects(const KotOR::Object &target, size_t count, uint32 typeMask,
+	                        std::vector< ::Aurora::NWScript::Object *> &objects,
+	                        const ::Aurora::NWScript::SpatialIndex::Filter *filter = 0) const;
+
+	/** Find all objects within a radius around a position, ordered by distance.
+	 *
+	 *  Only objects whose type is within the typeMask and that pass the
+	 *  optional filter are considered.
+	 */
+	void findObjectsInRadius(float x, float y, float z, float radius, uint32 typeMask,
+	                         std::vector< ::Aurora::NWScript::Object *> &objects,
+	                         const ::Aurora::NWScript::SpatialIndex::Filter *filter = 0) const;
+
 	static KotOR::Object *toObject(::Aurora::NWScript::Object *object);
 
 	static Module    *toModule   (Aurora::NWScript::Object *object);
@@ -94,6 +104,11 @@ private:
 	typedef std::map<ObjectType, ObjectList> ObjectMap;
 
 	ObjectMap _objects;
+
+	/** A spatial index over all objects. Only one area is loaded at a time. */
+	::Aurora::NWScript::SpatialIndex _spatialIndex;
+
+	void indexObject(KotOR::Object &object);
 };
 
 } // End of namespace KotOR
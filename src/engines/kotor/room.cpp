@@ -35,7 +35,9 @@ namespace Engines {
 
 namespace KotOR {
 
-Room::Room(const Common::UString &resRef, float x, float y, float z) : _model(0) {
+Room::Room(const Common::UString &resRef, float x, float y, float z) :
+	_resRef(resRef.toLower()), _model(0) {
+
 	load(resRef, x, y, z);
 }
 
@@ -54,6 +56,10 @@ void Room::load(const Common::UString &resRef, float x, float y, float z) {
 	_model->setPosition(x, y, z);
 }
 
+const Common::UString &Room::getResRef() const {
+	return _resRef;
+}
+
 void Room::show() {
 	if (_model)
 		_model->show();
@@ -64,6 +70,39 @@ void Room::hide() {
 		_model->hide();
 }
 
+bool Room::hasModel() const {
+	return _model != 0;
+}
+
+bool Room::isVisible() const {
+	return _model && _model->isVisible();
+}
+
+bool Room::isIn(float x, float y, float margin) const {
+	if (!_model)
+		return false;
+
+	if (_model->isIn(x, y))
+		return true;
+
+	if (margin <= 0.0f)
+		return false;
+
+	return _model->isIn(x - margin, y) || _model->isIn(x + margin, y) ||
+	       _model->isIn(x, y - margin) || _model->isIn(x, y + margin);
+}
+
+bool Room::isInBox(float x, float y, float z) const {
+	return _model && _model->isIn(x, y, z);
+}
+
+float Room::getFloorSize() const {
+	if (!_model)
+		return 0.0f;
+
+	return _model->getWidth() * _model->getHeight();
+}
+
 } // End of namespace KotOR
 
 } // End of namespace Engines
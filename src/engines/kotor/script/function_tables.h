@@ -345,9 +345,9 @@ const Functions::FunctionPointer Functions::kFunctionPointers[] = {
 	{ 224, "EffectBodyFuel"                      , 0                                                },
 	{ 225, "GetFacingFromLocation"               , 0                                                },
 	{ 226, "GetNearestCreatureToLocation"        , 0                                                },
-	{ 227, "GetNearestObject"                    , 0                                                },
+	{ 227, "GetNearestObject"                    , &Functions::getNearestObject                     },
 	{ 228, "GetNearestObjectToLocation"          , 0                                                },
-	{ 229, "GetNearestObjectByTag"               , 0                                                },
+	{ 229, "GetNearestObjectByTag"               , &Functions::getNearestObjectByTag                },
 	{ 230, "IntToFloat"                          , &Functions::intToFloat                           },
 	{ 231, "FloatToInt"                          , &Functions::floatToInt                           },
 	{ 232, "StringToInt"                         , &Functions::stringToInt                          },
@@ -176,6 +176,9 @@ private:
 	void getIsObjectValid(Aurora::NWScript::FunctionContext &ctx);
 
 	void getIsPC(Aurora::NWScript::FunctionContext &ctx);
+
+	void getNearestObject     (Aurora::NWScript::FunctionContext &ctx);
+	void getNearestObjectByTag(Aurora::NWScript::FunctionContext &ctx);
 	// '---
 
 	// .--- Situated objects, functions_situated.cpp
@@ -60,6 +60,60 @@ void Functions::getIsPC(Aurora::NWScript::FunctionContext &ctx) {
 	ctx.getReturn() = KotOR::ObjectContainer::toPC(getParamObject(ctx, 0)) != 0;
 }
 
+void Functions::getNearestObject(Aurora::NWScript::FunctionContext &ctx) {
+	ctx.getReturn() = (Aurora::NWScript::Object *) 0;
+
+	KotOR::Object *target = KotOR::ObjectContainer::toObject(getParamObject(ctx, 1));
+	if (!target)
+		return;
+
+	// Bitfield of type(s) to check for
+	uint32 type = ctx.getParams()[0].getInt() & kObjectTypeAll;
+	// We want the nth nearest object
+	size_t nth  = MAX<int32>(ctx.getParams()[2].getInt() - 1, 0);
+
+	std::vector<Aurora::NWScript::Object *> objects;
+	_game->getModule().findNearestObjects(*target, nth + 1, type, objects);
+
+	if (nth < objects.size())
+		ctx.getReturn() = objects[nth];
+}
+
+/** Only accept objects with a specific tag. */
+class TagFilter : public Aurora::NWScript::SpatialIndex::Filter {
+public:
+	TagFilter(const Common::UString &tag) : _tag(&tag) { }
+
+	bool operator()(Aurora::NWScript::Object &object) const {
+		return object.getTag() == *_tag;
+	}
+
+private:
+	const Common::UString *_tag;
+};
+
+void Functions::getNearestObjectByTag(Aurora::NWScript::FunctionContext &ctx) {
+	ctx.getReturn() = (Aurora::NWScript::Object *) 0;
+
+	const Common::UString &tag = ctx.getParams()[0].getString();
+	if (tag.empty())
+		return;
+
+	KotOR::Object *target = KotOR::ObjectContainer::toObject(getParamObject(ctx, 1));
+	if (!target)
+		return;
+
+	size_t nth = MAX<int32>(ctx.getParams()[2].getInt() - 1, 0);
+
+	const TagFilter filter(tag);
+
+	std::vector<Aurora::NWScript::Object *> objects;
+	_game->getModule().findNearestObjects(*target, nth + 1, kObjectTypeAll, objects, &filter);
+
+	if (nth < objects.size())
+		ctx.getReturn() = objects[nth];
+}
+
 } // End of namespace KotOR
 
 } // End of namespace Engines
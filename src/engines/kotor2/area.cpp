@@ -22,9 +22,12 @@
  *  The context holding a Star Wars: Knights of the Old Republic II - The Sith Lords area.
  */
 
+#include <set>
+
 #include "src/common/util.h"
 #include "src/common/error.h"
 #include "src/common/readstream.h"
+#include "src/common/debug.h"
 
 #include "src/aurora/resman.h"
 #include "src/aurora/gff3file.h"
@@ -33,11 +36,14 @@
 
 #include "src/graphics/graphics.h"
 #include "src/graphics/renderable.h"
+#include "src/graphics/camera.h"
 
 #include "src/graphics/aurora/cursorman.h"
 
 #include "src/sound/sound.h"
 
+#include "src/events/events.h"
+
 #include "src/engines/aurora/util.h"
 
 #include "src/engines/kotor2/area.h"
@@ -53,7 +59,9 @@ namespace Engines {
 namespace KotOR2 {
 
 Area::Area(Module &module, const Common::UString &resRef) : Object(kObjectTypeArea),
-	_module(&module), _resRef(resRef), _visible(false), _activeObject(0), _highlightAll(false) {
+	_module(&module), _resRef(resRef), _visible(false),
+	_roomVisibility(kRoomVisibilityHysteresis), _cameraRoom(0), _roomCameraChanged(0), _visibleRoomCount(0),
+	_activeObject(0), _highlightAll(false) {
 
 	try {
 		load();
@@ -101,6 +109,10 @@ void Area::clear() {
 
 	_objects.clear();
 	_rooms.clear();
+	_roomMap.clear();
+
+	_roomHideTimes.clear();
+	_cameraRoom = 0;
 }
 
 uint32 Area::getMusicDayTrack() const {
@@ -193,8 +205,7 @@ void Area::show() {
 	GfxMan.lockFrame();
 
 	// Show rooms
-	for (RoomList::iterator r = _rooms.begin(); r != _rooms.end(); ++r)
-		(*r)->show();
+	updateRoomVisibility(true);
 
 	// Show objects
 	for (ObjectList::iterator o = _objects.begin(); o != _objects.end(); ++o)
@@ -229,9 +240,166 @@ void Area::hide() {
 
 	GfxMan.unlockFrame();
 
+	_roomHideTimes.clear();
+	_cameraRoom       = 0;
+	_visibleRoomCount = 0;
+
 	_visible = false;
 }
 
+Area::RoomVisibility Area::getRoomVisibility() const {
+	return _roomVisibility;
+}
+
+void Area::setRoomVisibility(RoomVisibility visibility) {
+	_roomVisibility = visibility;
+
+	if (_visible)
+		updateRoomVisibility(true);
+}
+
+static const Common::UString kNoRoom;
+const Common::UString &Area::getCameraRoom() const {
+	return _cameraRoom ? _cameraRoom->getResRef() : kNoRoom;
+}
+
+size_t Area::getRoomCount() const {
+	return _rooms.size();
+}
+
+size_t Area::getVisibleRoomCount() const {
+	return _visibleRoomCount;
+}
+
+/** How far the camera may stray outside of its room before we look for a new one. */
+static const float kRoomMargin = 1.0f;
+/** How long rooms that went out of sight stay visible, in milliseconds. */
+static const uint32 kRoomHideDelay = 500;
+
+Room *Area::findCameraRoom(float x, float y, float z) const {
+	/* The rooms' bounding boxes overlap a lot. Of all the rooms the camera is in,
+	 * prefer the ones that also contain the camera's height, and then the smallest
+	 * one. A big room's box often reaches into smaller rooms next to it. */
+	Room *room     = 0;
+	bool  roomInZ  = false;
+	float roomSize = 0.0f;
+
+	for (RoomList::const_iterator r = _rooms.begin(); r != _rooms.end(); ++r) {
+		if (!(*r)->isIn(x, y))
+			continue;
+
+		const bool  inZ  = (*r)->isInBox(x, y, z);
+		const float size = (*r)->getFloorSize();
+
+		if (!room || (inZ && !roomInZ) || ((inZ == roomInZ) && (size < roomSize))) {
+			room     = *r;
+			roomInZ  = inZ;
+			roomSize = size;
+		}
+	}
+
+	// Stay in the current room until the camera clearly left it
+	if ((_roomVisibility == kRoomVisibilityHysteresis) && _cameraRoom && (room != _cameraRoom) &&
+	    !_cameraRoom->isIn(x, y) && _cameraRoom->isIn(x, y, kRoomMargin))
+		return _cameraRoom;
+
+	// If the camera is in none of the rooms, this is 0, and all rooms are shown
+	return room;
+}
+
+void Area::updateRoomVisibility(bool force) {
+	const uint32 cameraChanged = CameraMan.lastChanged();
+	if (!force && (cameraChanged == _roomCameraChanged) && _roomHideTimes.empty())
+		return;
+
+	_roomCameraChanged = cameraChanged;
+
+	const float *position = CameraMan.getPosition();
+	Room *cameraRoom = findCameraRoom(position[0], position[1], position[2]);
+
+	/* Collect the rooms visible from the camera's room. If we don't know where
+	 * the camera is, or the VIS has nothing on that room, we show all rooms. */
+	std::set<Room *> visibleRooms;
+	if (cameraRoom && (_roomVisibility != kRoomVisibilityAll)) {
+		const std::vector<Common::UString> &vis = _vis.getVisibilityArray(cameraRoom->getResRef());
+
+		for (std::vector<Common::UString>::const_iterator v = vis.begin(); v != vis.end(); ++v) {
+			RoomMap::const_iterator r = _roomMap.find(v->toLower());
+			if (r != _roomMap.end())
+				visibleRooms.insert(r->second);
+		}
+
+		if (!visibleRooms.empty())
+			visibleRooms.insert(cameraRoom);
+	}
+
+	const uint32 now = EventMan.getTimestamp();
+
+	/* First find the rooms that actually need to be shown or hidden. Only then,
+	 * and only if there are any, lock the frame to change them. */
+	std::vector<Room *> showRooms, hideRooms;
+
+	size_t visibleRoomCount = 0;
+
+	for (RoomList::iterator r = _rooms.begin(); r != _rooms.end(); ++r) {
+		// Rooms without a model can't be shown, so don't try to every time
+		if (!(*r)->hasModel())
+			continue;
+
+		bool visible = (*r)->isVisible();
+
+		if (visibleRooms.empty() || (visibleRooms.find(*r) != visibleRooms.end())) {
+			_roomHideTimes.erase(*r);
+
+			if (!visible) {
+				showRooms.push_back(*r);
+				visible = true;
+			}
+
+		} else if (visible) {
+
+			if (_roomVisibility == kRoomVisibilityHysteresis) {
+				// Keep rooms that went out of sight around for a bit, in case they come right back
+				RoomHideMap::iterator h = _roomHideTimes.find(*r);
+				if (h == _roomHideTimes.end()) {
+					_roomHideTimes.insert(std::make_pair(*r, now + kRoomHideDelay));
+				} else if (now >= h->second) {
+					_roomHideTimes.erase(h);
+
+					hideRooms.push_back(*r);
+					visible = false;
+				}
+
+			} else {
+				hideRooms.push_back(*r);
+				visible = false;
+			}
+		}
+
+		if (visible)
+			visibleRoomCount++;
+	}
+
+	if (!showRooms.empty() || !hideRooms.empty()) {
+		GfxMan.lockFrame();
+
+		for (std::vector<Room *>::iterator r = showRooms.begin(); r != showRooms.end(); ++r)
+			(*r)->show();
+		for (std::vector<Room *>::iterator r = hideRooms.begin(); r != hideRooms.end(); ++r)
+			(*r)->hide();
+
+		GfxMan.unlockFrame();
+	}
+
+	if ((cameraRoom != _cameraRoom) || (visibleRoomCount != _visibleRoomCount))
+		debugC(1, Common::kDebugGraphics, "Area \"%s\": Camera in room \"%s\", rendering %u of %u rooms",
+		       _resRef.c_str(), cameraRoom ? cameraRoom->getResRef().c_str() : "",
+		       (uint) visibleRoomCount, (uint) _rooms.size());
+
+	_cameraRoom       = cameraRoom;
+	_visibleRoomCount = visibleRoomCount;
+}
+
 void Area::loadLYT() {
 	Common::SeekableReadStream *lyt = 0;
 	try {
@@ -324,8 +492,11 @@ void Area::loadProperties(const Aurora::GFF3Struct &props) {
 
 void Area::loadRooms() {
 	const Aurora::LYTFile::RoomArray &rooms = _lyt.getRooms();
-	for (Aurora::LYTFile::RoomArray::const_iterator r = rooms.begin(); r != rooms.end(); ++r)
+	for (Aurora::LYTFile::RoomArray::const_iterator r = rooms.begin(); r != rooms.end(); ++r) {
 		_rooms.push_back(new Room(r->model, r->x, r->y, r->z));
+
+		_roomMap[_rooms.back()->getResRef()] = _rooms.back();
+	}
 }
 
 void Area::loadObject(KotOR2::Object &object) {
@@ -401,6 +572,9 @@ void Area::processEventQueue() {
 
 	if (hasMove)
 		checkActive();
+
+	if (_visible)
+		updateRoomVisibility();
 }
 
 KotOR2::Object *Area::getObjectAt(int x, int y) {
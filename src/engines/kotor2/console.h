@@ -63,6 +63,7 @@ private:
 	void cmdListMusic  (const CommandLine &cl);
 	void cmdStopMusic  (const CommandLine &cl);
 	void cmdPlayMusic  (const CommandLine &cl);
+	void cmdRoomVis    (const CommandLine &cl);
 };
 
 } // End of namespace KotOR2
@@ -25,11 +25,9 @@
 #ifndef ENGINES_KOTOR2_ROOM_H
 #define ENGINES_KOTOR2_ROOM_H
 
-#include "src/graphics/aurora/types.h"
+#include "src/common/ustring.h"
 
-namespace Common {
-	class UString;
-}
+#include "src/graphics/aurora/types.h"
 
 namespace Engines {
 
@@ -40,10 +38,28 @@ public:
 	Room(const Common::UString &resRef, float x, float y, float z);
 	~Room();
 
+	/** Return the room's resref (resource ID). */
+	const Common::UString &getResRef() const;
+
 	void show();
 	void hide();
 
+	/** Does the room have a model? Rooms without one are never shown. */
+	bool hasModel() const;
+	/** Is the room currently visible? */
+	bool isVisible() const;
+
+	/** Is that point within the room's bounding box, or at most margin units outside of it? */
+	bool isIn(float x, float y, float margin = 0.0f) const;
+	/** Is that point within the room's bounding box, taking the height into account too? */
+	bool isInBox(float x, float y, float z) const;
+
+	/** Return the size of the room's bounding box on the ground, in square units. */
+	float getFloorSize() const;
+
 private:
+	Common::UString _resRef; ///< The room's resref (resource ID).
+
 	Graphics::Aurora::Model *_model;
 
 	void load(const Common::UString &resRef, float x, float y, float z);
@@ -27,6 +27,7 @@
 #include "src/common/util.h"
 #include "src/common/error.h"
 
+#include "src/aurora/resman.h"
 #include "src/aurora/gff3file.h"
 #include "src/aurora/2dafile.h"
 #include "src/aurora/2dareg.h"
@@ -447,6 +448,21 @@ void Area::unloadTileset() {
 }
 
 void Area::loadTiles() {
+	// Read the tile models in the background, while we're busy creating the tiles
+	for (std::vector<Tile>::iterator t = _tiles.begin(); t != _tiles.end(); ++t)
+		ResMan.prefetchResource(_tileset->getTile(t->tileID).model, Aurora::kFileTypeMDL);
+
+	try {
+		createTiles();
+	} catch (...) {
+		ResMan.dropPrefetches();
+		throw;
+	}
+
+	ResMan.dropPrefetches();
+}
+
+void Area::createTiles() {
 	for (uint32 y = 0; y < _height; y++) {
 		for (uint32 x = 0; x < _width; x++) {
 			uint32 n = y * _width + x;
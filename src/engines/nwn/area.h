@@ -230,6 +230,7 @@ private:
 	void unloadTileset();
 
 	void loadTiles();
+	void createTiles();
 	void unloadTiles();
 
 	// Highlight / active helpers
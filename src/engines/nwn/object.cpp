@@ -43,6 +43,7 @@
 
 #include "src/engines/nwn/types.h"
 #include "src/engines/nwn/object.h"
+#include "src/engines/nwn/objectcontainer.h"
 
 namespace Engines {
 
@@ -50,7 +51,7 @@ namespace NWN {
 
 Object::Object(ObjectType type) : _type(type),
 	_soundSet(Aurora::kFieldIDInvalid), _ssf(0), _static(false), _usable(true),
-	_pcSpeaker(0), _area(0), _tooltip(0) {
+	_pcSpeaker(0), _area(0), _container(0), _tooltip(0) {
 
 	_id = Common::generateIDNumber();
 
@@ -138,6 +139,9 @@ Area *Object::getArea() const {
 
 void Object::setArea(Area *area) {
 	_area = area;
+
+	if (_container)
+		_container->moveObject(*this);
 }
 
 Location Object::getLocation() const {
@@ -170,6 +174,9 @@ void Object::setPosition(float x, float y, float z) {
 	_position[0] = x;
 	_position[1] = y;
 	_position[2] = z;
+
+	if (_container)
+		_container->moveObject(*this);
 }
 
 void Object::setOrientation(float x, float y, float z, float angle) {
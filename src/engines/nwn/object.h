@@ -54,6 +54,7 @@ namespace Engines {
 namespace NWN {
 
 class Area;
+class ObjectContainer;
 
 class Object : public Aurora::NWScript::Object, public NWN::ScriptContainer {
 public:
@@ -178,6 +179,8 @@ protected:
 
 	Area *_area; ///< The area the object is currently in.
 
+	ObjectContainer *_container; ///< The container this object is in.
+
 	float _position[3];    ///< The object's position.
 	float _orientation[4]; ///< The object's orientation.
 
@@ -208,6 +211,8 @@ protected:
 	bool showSpeechTooltip(const Common::UString &line);
 	/** Hide the tooltip again. */
 	void hideTooltip();
+
+	friend class ObjectContainer;
 };
 
 } // End of namespace NWN
@@ -40,22 +40,6 @@ namespace Engines {
 
 namespace NWN {
 
-ObjectDistanceSort::ObjectDistanceSort(const NWN::Object &target) {
-	target.getPosition(xt, yt, zt);
-}
-
-bool ObjectDistanceSort::operator()(NWN::Object *a, NWN::Object *b) {
-	return getDistance(*a) < getDistance(*b);
-}
-
-float ObjectDistanceSort::getDistance(NWN::Object &a) {
-	float x, y, z;
-	a.getPosition(x, y, z);
-
-	return ABS(x - xt) + ABS(y - yt) + ABS(z - zt);
-}
-
-
 class SearchType : public ::Aurora::NWScript::SearchRange< std::list<NWN::Object *> > {
 public:
 	SearchType(const iterator &a, const iterator &b) : ::Aurora::NWScript::SearchRange<type>(std::make_pair(a, b)) { }
@@ -65,6 +49,21 @@ public:
 	::Aurora::NWScript::Object *getObject(const iterator &t) { return *t; }
 };
 
+/** Filter out one specific object, on top of another filter. */
+class ExcludeFilter : public ::Aurora::NWScript::SpatialIndex::Filter {
+public:
+	ExcludeFilter(const ::Aurora::NWScript::Object &exclude, const Filter *filter) :
+		_exclude(&exclude), _filter(filter) { }
+
+	bool operator()(::Aurora::NWScript::Object &object) const {
+		return (&object != _exclude) && (!_filter || (*_filter)(object));
+	}
+
+private:
+	const ::Aurora::NWScript::Object *_exclude;
+	const Filter *_filter;
+};
+
 
 ObjectContainer::ObjectContainer() {
 }
@@ -75,8 +74,15 @@ ObjectContainer::~ObjectContainer() {
 void ObjectContainer::clearObjects() {
 	lock();
 
+	for (ObjectMap::iterator l = _objects.begin(); l != _objects.end(); ++l)
+		for (ObjectList::iterator o = l->second.begin(); o != l->second.end(); ++o)
+			(*o)->_container = 0;
+
 	_objects.clear();
 
+	_spatialIndex.clear();
+	_indexedAreas.clear();
+
 	::Aurora::NWScript::ObjectContainer::clearObjects();
 
 	unlock();
@@ -89,6 +95,9 @@ void ObjectContainer::addObject(NWN::Object &object) {
 
 	_objects[object.getType()].push_back(&object);
 
+	object._container = this;
+	indexObject(object);
+
 	unlock();
 }
 
@@ -97,11 +106,103 @@ void ObjectContainer::removeObject(NWN::Object &object) {
 
 	_objects[object.getType()].remove(&object);
 
+	deindexObject(object);
+	object._container = 0;
+
 	::Aurora::NWScript::ObjectContainer::removeObject(object);
 
 	unlock();
 }
 
+void ObjectContainer::moveObject(NWN::Object &object) {
+	lock();
+
+	indexObject(object);
+
+	unlock();
+}
+
+void ObjectContainer::indexObject(NWN::Object &object) {
+	// Only real objects within an area can be found by their position
+	const Area *area = object.getArea();
+	if (!(object.getType() & kObjectTypeAll))
+		area = 0;
+
+	IndexedAreaMap::iterator indexed = _indexedAreas.find(&object);
+	if ((indexed != _indexedAreas.end()) && (indexed->second != area)) {
+		deindexObject(object);
+
+		indexed = _indexedAreas.end();
+	}
+
+	if (!area)
+		return;
+
+	float x, y, z;
+	object.getPosition(x, y, z);
+
+	_spatialIndex[area].update(object, (uint32) object.getType(), x, y, z);
+
+	if (indexed == _indexedAreas.end())
+		_indexedAreas.insert(std::make_pair(&object, area));
+}
+
+void ObjectContainer::deindexObject(NWN::Object &object) {
+	IndexedAreaMap::iterator indexed = _indexedAreas.find(&object);
+	if (indexed != _indexedAreas.end()) {
+		SpatialIndexMap::iterator index = _spatialIndex.find(indexed->second);
+		if (index != _spatialIndex.end())
+			index->second.remove(object);
+
+		_indexedAreas.erase(indexed);
+	}
+
+	// When an area goes away, so does its spatial index
+	const Area *area = toArea(&object);
+	if (!area)
+		return;
+
+	_spatialIndex.erase(area);
+
+	for (IndexedAreaMap::iterator o = _indexedAreas.begin(); o != _indexedAreas.end(); ) {
+		if (o->second == area)
+			_indexedAreas.erase(o++);
+		else
+			++o;
+	}
+}
+
+void ObjectContainer::findNearestObjects(const NWN::Object &target, size_t count, uint32 typeMask,
+                                         std::vector< ::Aurora::NWScript::Object *> &objects,
+                                         const ::Aurora::NWScript::SpatialIndex::Filter *filter) const {
+
+	objects.clear();
+
+	SpatialIndexMap::const_iterator index = _spatialIndex.find(target.getArea());
+	if (index == _spatialIndex.end())
+		return;
+
+	float x, y, z;
+	target.getPosition(x, y, z);
+
+	const ExcludeFilter excludeTarget(target, filter);
+
+	index->second.findNearest(x, y, z, count, typeMask, objects, &excludeTarget);
+}
+
+void ObjectContainer::findObjectsInRadius(const Area &area, float x, float y, float z, float radius,
+                                          uint32 typeMask, std::vector< ::Aurora::NWScript::Object *> &objects,
+                                          const ::Aurora::NWScript::SpatialIndex::Filter *filter) const {
+
+	objects.clear();
+
+	SpatialIndexMap::const_iterator index = _spatialIndex.find(&area);
+	if (index == _spatialIndex.end())
+		return;
+
+	index->second.findInRadius(x, y, z, radius, typeMask, objects, filter);
+}
+
 ::Aurora::NWScript::Object *ObjectContainer::getFirstObjectByType(ObjectType type) const {
 	ObjectMap::const_iterator l = _objects.find(type);
 	if (l == _objects.end())
@@ -27,10 +27,12 @@
 
 #include <list>
 #include <map>
+#include <vector>
 
 #include "src/common/types.h"
 
 #include "src/aurora/nwscript/objectcontainer.h"
+#include "src/aurora/nwscript/spatialindex.h"
 
 #include "src/engines/nwn/types.h"
 
@@ -48,19 +50,6 @@ class Door;
 class Creature;
 class Location;
 
-/** A class able to sort objects by distance to a target object. */
-class ObjectDistanceSort {
-public:
-	ObjectDistanceSort(const NWN::Object &target);
-
-	bool operator()(NWN::Object *a, NWN::Object *b);
-
-private:
-	float xt, yt, zt;
-
-	float getDistance(NWN::Object &a);
-};
-
 class ObjectContainer : public ::Aurora::NWScript::ObjectContainer {
 public:
 	ObjectContainer();
@@ -73,12 +62,33 @@ public:
 	/** Remove an object from this container. */
 	void removeObject(NWN::Object &object);
 
+	/** Update the spatial index after an object moved or changed its area. */
+	void moveObject(NWN::Object &object);
+
 	/** Return the first object of this type. */
 	::Aurora::NWScript::Object *getFirstObjectByType(ObjectType type) const;
 
 	/** Return a search context to iterate over all objects of this type. */
 	::Aurora::NWScript::ObjectSearch *findObjectsByType(ObjectType type) const;
 
+	/** Find the count objects nearest to a target, in the target's area, ordered by distance.
+	 *
+	 *  Only objects whose type is within the typeMask and that pass the
+	 *  optional filter are considered. The target itself is never included.
+	 */
+	void findNearestObjects(const NWN::Object &target, size_t count, uint32 typeMask,
+	                        std::vector< ::Aurora::NWScript::Object *> &objects,
+	                        const ::Aurora::NWScript::SpatialIndex::Filter *filter = 0) const;
+
+	/** Find all objects within a radius around a position in an area, ordered by distance.
+	 *
+	 *  Only objects whose type is within the typeMask and that pass the
+	 *  optional filter are considered.
+	 */
+	void findObjectsInRadius(const Area &area, float x, float y, float z, float radius, uint32 typeMask,
+	                         std::vector< ::Aurora::NWScript::Object *> &objects,
+	                         const ::Aurora::NWScript::SpatialIndex::Filter *filter = 0) const;
+
 	static NWN::Object *toObject(::Aurora::NWScript::Object *object);
 
 	static Module    *toModule   (Aurora::NWScript::Object *object);
@@ -96,7 +106,16 @@ private:
 	typedef std::list<NWN::Object *> ObjectList;
 	typedef std::map<ObjectType, ObjectList> ObjectMap;
 
+	typedef std::map<const Area *, ::Aurora::NWScript::SpatialIndex> SpatialIndexMap;
+	typedef std::map<const NWN::Object *, const Area *> IndexedAreaMap;
+
 	ObjectMap _objects;
+
+	SpatialIndexMap _spatialIndex; ///< A spatial index for each area.
+	IndexedAreaMap  _indexedAreas; ///< The area each object is indexed in.
+
+	void indexObject(NWN::Object &object);
+	void deindexObject(NWN::Object &object);
 };
 
 } // End of namespace NWN
@@ -236,40 +236,29 @@ void Functions::getNearestObject(Aurora::NWScript::FunctionContext &ctx) {
 		return;
 
 	// Bitfield of type(s) to check for
-	uint32 type = ctx.getParams()[0].getInt();
+	uint32 type = ctx.getParams()[0].getInt() & kObjectTypeAll;
 	// We want the nth nearest object
 	size_t nth  = MAX<int32>(ctx.getParams()[2].getInt() - 1, 0);
 
-	Aurora::NWScript::ObjectSearch *search = _game->getModule().findObjects();
-	Aurora::NWScript::Object       *object = 0;
+	std::vector<Aurora::NWScript::Object *> objects;
+	_game->getModule().findNearestObjects(*target, nth + 1, type, objects);
 
-	std::list<Object *> objects;
-	while ((object = search->next())) {
-		// Needs to be a valid object, not the target, but in the target's area
-		NWN::Object *nwnObject = NWN::ObjectContainer::toObject(object);
-		if (!nwnObject || (nwnObject == target) || (nwnObject->getArea() != target->getArea()))
-			continue;
-
-		// Ignore invalid object types
-		const uint32 objectType = (uint32) nwnObject->getType();
-		if (objectType >= kObjectTypeMAX)
-			continue;
-
-		if (type & objectType)
-			objects.push_back(nwnObject);
-	}
+	if (nth < objects.size())
+		ctx.getReturn() = objects[nth];
+}
 
-	delete search;
+/** Only accept objects with a specific tag. */
+class TagFilter : public Aurora::NWScript::SpatialIndex::Filter {
+public:
+	TagFilter(const Common::UString &tag) : _tag(&tag) { }
 
-	objects.sort(ObjectDistanceSort(*target));
+	bool operator()(Aurora::NWScript::Object &object) const {
+		return object.getTag() == *_tag;
+	}
 
-	std::list<Object *>::iterator it = objects.begin();
-	for (size_t n = 0; (n < nth) && (it != objects.end()); ++n)
-		++it;
-
-	if (it != objects.end())
-		ctx.getReturn() = *it;
-}
+private:
+	const Common::UString *_tag;
+};
 
 void Functions::getNearestObjectByTag(Aurora::NWScript::FunctionContext &ctx) {
 	ctx.getReturn() = (Object *) 0;
@@ -284,29 +273,13 @@ void Functions::getNearestObjectByTag(Aurora::NWScript::FunctionContext &ctx) {
 
 	size_t nth = MAX<int32>(ctx.getParams()[2].getInt() - 1, 0);
 
-	Aurora::NWScript::ObjectSearch *search = _game->getModule().findObjectsByTag(tag);
-	Aurora::NWScript::Object       *object = 0;
-
-	std::list<Object *> objects;
-	while ((object = search->next())) {
-		// Needs to be a valid object, not the target, but in the target's area
-		NWN::Object *nwnObject = NWN::ObjectContainer::toObject(object);
-		if (!nwnObject || (nwnObject == target) || (nwnObject->getArea() != target->getArea()))
-			continue;
-
-		objects.push_back(nwnObject);
-	}
-
-	delete search;
-
-	objects.sort(ObjectDistanceSort(*target));
+	const TagFilter filter(tag);
 
-	std::list<Object *>::iterator it = objects.begin();
-	for (size_t n = 0; (n < nth) && (it != objects.end()); ++n)
-		++it;
+	std::vector<Aurora::NWScript::Object *> objects;
+	_game->getModule().findNearestObjects(*target, nth + 1, kObjectTypeAll, objects, &filter);
 
-	if (it != objects.end())
-		ctx.getReturn() = *it;
+	if (nth < objects.size())
+		ctx.getReturn() = objects[nth];
 }
 
 void Functions::getNearestCreature(Aurora::NWScript::FunctionContext &ctx) {
@@ -328,27 +301,11 @@ void Functions::getNearestCreature(Aurora::NWScript::FunctionContext &ctx) {
 	 * int crit3Value = ctx.getParams()[7].getInt();
 	 */
 
-	Aurora::NWScript::ObjectSearch *search = _game->getModule().findObjects();
-	Aurora::NWScript::Object       *object = 0;
-
-	std::list<Object *> creatures;
-	while ((object = search->next())) {
-		Creature *creature = NWN::ObjectContainer::toCreature(object);
-
-		if (creature && (creature != target) && (creature->getArea() == target->getArea()))
-			creatures.push_back(creature);
-	}
-
-	delete search;
-
-	creatures.sort(ObjectDistanceSort(*target));
-
-	std::list<Object *>::iterator it = creatures.begin();
-	for (size_t n = 0; (n < nth) && (it != creatures.end()); ++n)
-		++it;
+	std::vector<Aurora::NWScript::Object *> creatures;
+	_game->getModule().findNearestObjects(*target, nth + 1, kObjectTypeCreature, creatures);
 
-	if (it != creatures.end())
-		ctx.getReturn() = *it;
+	if (nth < creatures.size())
+		ctx.getReturn() = creatures[nth];
 }
 
 void Functions::playAnimation(Aurora::NWScript::FunctionContext &ctx) {
@@ -34,12 +34,12 @@ namespace Graphics {
 
 namespace Aurora {
 
-FPS::FPS(const FontHandle &font) : Text(font, "0 fps"), _fps(0) {
+FPS::FPS(const FontHandle &font) : Text(font, "0 fps"), _fps(0), _drawn(0) {
 	init();
 }
 
 FPS::FPS(const FontHandle &font, float r, float g, float b, float a) :
-	Text(font, "0 fps", r, g, b, a), _fps(0) {
+	Text(font, "0 fps", r, g, b, a), _fps(0), _drawn(0) {
 
 	init();
 }
@@ -59,11 +59,18 @@ void FPS::render(RenderPass pass) {
 		return;
 
 	uint32 fps = GfxMan.getFPS();
-
-	if (fps != _fps) {
-		_fps = fps;
-
-		set(Common::UString::format("%d fps", _fps));
+	GraphicsManager::RenderStats stats = GfxMan.getRenderStats();
+
+	// Only rebuild the text when the FPS value or the number of drawn objects changed
+	if ((fps != _fps) || (stats.drawn != _drawn)) {
+		_fps   = fps;
+		_drawn = stats.drawn;
+
+		if (stats.tested > 0)
+			set(Common::UString::format("%d fps, %u/%u drawn, %u culled, %u binds",
+			                            _fps, stats.drawn, stats.tested, stats.culled, stats.binds));
+		else
+			set(Common::UString::format("%d fps", _fps));
 	}
 
 	Text::render(pass);
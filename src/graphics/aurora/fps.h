@@ -45,6 +45,7 @@ public:
 
 private:
 	uint32 _fps;
+	uint32 _drawn; ///< Number of world objects drawn when the text was last updated.
 
 	void init();
 
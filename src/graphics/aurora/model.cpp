@@ -22,6 +22,8 @@
  *  A 3D model of an object.
  */
 
+#include "src/common/atomic.h"
+
 #include <cassert>
 #include <cstdlib>
 
@@ -29,13 +31,19 @@
 
 #include "src/common/readstream.h"
 #include "src/common/debug.h"
+#include "src/common/hash.h"
 
+#include "src/graphics/graphics.h"
 #include "src/graphics/camera.h"
+#include "src/graphics/frustum.h"
+#include "src/graphics/vertexbuffer.h"
+#include "src/graphics/indexbuffer.h"
 
 #include "src/graphics/aurora/model.h"
 #include "src/graphics/aurora/textureman.h"
 #include "src/graphics/aurora/animation.h"
 #include "src/graphics/aurora/modelnode.h"
+#include "src/graphics/aurora/modelqueueman.h"
 
 #include "src/graphics/shader/surfaceman.h"
 #include "src/graphics/shader/materialman.h"
@@ -50,7 +58,8 @@ namespace Aurora {
 Model::Model(ModelType type) : Renderable((RenderableType) type),
 	_type(type), _superModel(0), _currentState(0),
 	_currentAnimation(0), _nextAnimation(0), _drawBound(false),
-	_drawSkeleton(false), _drawSkeletonInvisible(false) {
+	_drawSkeleton(false), _drawSkeletonInvisible(false), _bufferObjects(0),
+	_geometryChanged(false) {
 
 	_scale   [0] = 1.0f; _scale   [1] = 1.0f; _scale   [2] = 1.0f;
 	_position[0] = 0.0f; _position[1] = 0.0f; _position[2] = 0.0f;
@@ -77,6 +86,8 @@ Model::Model(ModelType type) : Renderable((RenderableType) type),
 Model::~Model() {
 	hide();
 
+	destroy();
+
 	for (AnimationMap::iterator a = _animationMap.begin(); a != _animationMap.end(); ++a)
 		delete a->second;
 
@@ -500,12 +511,61 @@ void Model::manageAnimations(float dt) {
 }
 
 void Model::render(RenderPass pass) {
+	doRender(pass, 0);
+}
+
+bool Model::isInFrustum(const Frustum &frustum) const {
+	if (_absoluteBoundBox.empty())
+		return true;
+
+	float minX, minY, minZ, maxX, maxY, maxZ;
+	_absoluteBoundBox.getMin(minX, minY, minZ);
+	_absoluteBoundBox.getMax(maxX, maxY, maxZ);
+
+	/* The bounding box was created from the nodes as they were loaded.
+	 * Animations can move the nodes outside of it, so be generous. */
+	if (!isStatic()) {
+		const float margin = MAX(MAX(maxX - minX, maxY - minY), maxZ - minZ) / 2.0f;
+
+		minX -= margin; minY -= margin; minZ -= margin;
+		maxX += margin; maxY += margin; maxZ += margin;
+	}
+
+	return frustum.test(minX, minY, minZ, maxX, maxY, maxZ) != Frustum::kOutside;
+}
+
+void Model::renderCulled(RenderPass pass, const Frustum &frustum) {
+	// The nodes' bounding boxes are only reliable if they don't move
+	const bool cullNodes = isStatic();
+
+	const Frustum modelFrustum = cullNodes ? frustum.transform(_absolutePosition) : Frustum();
+
+	if (ModelQueueMan.isCollecting())
+		doQueueRender(pass, cullNodes ? &modelFrustum : 0);
+	else
+		doRender(pass, cullNodes ? &modelFrustum : 0);
+}
+
+bool Model::isStatic() const {
+	if (!_animationMap.empty())
+		return false;
+
+	return !_superModel || _superModel->isStatic();
+}
+
+void Model::doRender(RenderPass pass, const Frustum *frustum) {
 	if (!_currentState || (pass > kRenderPassAll))
 		return;
 
+	if (_geometryChanged) {
+		_geometryChanged = false;
+
+		rebuild();
+	}
+
 	if (pass == kRenderPassAll) {
-		Model::render(kRenderPassOpaque);
-		Model::render(kRenderPassTransparent);
+		doRender(kRenderPassOpaque, frustum);
+		doRender(kRenderPassTransparent, frustum);
 		return;
 	}
 
@@ -522,7 +582,7 @@ void Model::render(RenderPass pass) {
 	     n != _currentState->rootNodes.end(); ++n) {
 
 		glPushMatrix();
-		(*n)->render(pass);
+		(*n)->render(pass, frustum);
 		glPopMatrix();
 	}
 
@@ -533,6 +593,29 @@ void Model::render(RenderPass pass) {
 	doDrawSkeleton();
 }
 
+void Model::doQueueRender(RenderPass pass, const Frustum *frustum) {
+	if (!_currentState || ((pass != kRenderPassOpaque) && (pass != kRenderPassTransparent)))
+		return;
+
+	// Queue the nodes, with their full transformation from the camera on
+	const Common::TransformationMatrix transform = GfxMan.getModelviewMatrix() * _absolutePosition;
+
+	for (NodeList::iterator n = _currentState->rootNodes.begin();
+	     n != _currentState->rootNodes.end(); ++n)
+		(*n)->queueRender(pass, transform, frustum);
+
+	// The debug drawings are still drawn directly
+	if (!_drawBound && !_drawSkeleton)
+		return;
+
+	glTranslatef(_position[0], _position[1], _position[2]);
+	glRotatef(_orientation[3], _orientation[0], _orientation[1], _orientation[2]);
+	glScalef(_scale[0], _scale[1], _scale[2]);
+
+	doDrawBound();
+	doDrawSkeleton();
+}
+
 void Model::doDrawBound() {
 	if (!_drawBound)
 		return;
@@ -616,12 +699,228 @@ void Model::doDrawSkeleton() {
 	glPointSize(1.0f);
 }
 
+Model::GeometryBuffers::GeometryBuffers(VertexBuffer &vB, IndexBuffer &iB) :
+	vertexBuffer(&vB), indexBuffer(&iB) {
+
+}
+
+Model::BufferObjects::BufferObjects() : hash(0), vbo(0), ibo(0), size(0), references(0) {
+}
+
+Model::BufferStats::BufferStats() : models(0), buffers(0), size(0), sharedSize(0) {
+}
+
+Model::BufferObjectsMap Model::_sharedBufferObjects;
+
+// Running totals reported by getBufferStats()
+static boost::atomic<uint32> bufferModelCount(0);
+static boost::atomic<uint32> bufferObjectCount(0);
+static boost::atomic<uint64> bufferSize(0);
+static boost::atomic<uint64> bufferSharedSize(0);
+
+Model::BufferStats Model::getBufferStats() {
+	BufferStats stats;
+
+	stats.models     = bufferModelCount.load();
+	stats.buffers    = bufferObjectCount.load();
+	stats.size       = bufferSize.load();
+	stats.sharedSize = bufferSharedSize.load();
+
+	return stats;
+}
+
+void Model::collectGeometry(GeometryBufferList &geometry) {
+	for (StateList::iterator s = _stateList.begin(); s != _stateList.end(); ++s)
+		for (NodeList::iterator n = (*s)->nodeList.begin(); n != (*s)->nodeList.end(); ++n)
+			geometry.push_back(GeometryBuffers((*n)->_vertexBuffer, (*n)->_indexBuffer));
+}
+
+/** Align a buffer object offset, so that every attribute starts on a float boundary. */
+static uint32 alignBufferOffset(uint32 offset) {
+	return (offset + 15) & ~15;
+}
+
+static uint64 hashData(uint64 hash, const void *data, uint32 size) {
+	const byte *bytes = reinterpret_cast<const byte *>(data);
+
+	for (uint32 i = 0; i < size; i++)
+		hash = Common::hashFNV64(hash, bytes[i]);
+
+	return hash;
+}
+
+/** Hash the layout and contents of all geometry, to find out whether two models can share it. */
+static uint64 hashGeometry(const std::vector<const VertexBuffer *> &vertexBuffers,
+                           const std::vector<const IndexBuffer *> &indexBuffers) {
+
+	uint64 hash = 0xCBF29CE484222325LL;
+
+	for (size_t i = 0; i < vertexBuffers.size(); i++) {
+		const VertexBuffer &vB = *vertexBuffers[i];
+		const IndexBuffer  &iB = *indexBuffers[i];
+
+		hash = Common::hashFNV64(hash, vB.getCount());
+		hash = Common::hashFNV64(hash, vB.getSize());
+
+		const VertexDecl &decl = vB.getVertexDecl();
+		for (VertexDecl::const_iterator d = decl.begin(); d != decl.end(); ++d) {
+			hash = Common::hashFNV64(hash, d->index);
+			hash = Common::hashFNV64(hash, d->type);
+			hash = Common::hashFNV64(hash, d->size);
+			hash = Common::hashFNV64(hash, d->stride);
+			hash = Common::hashFNV64(hash, (uint32) (reinterpret_cast<const byte *>(d->pointer) -
+			                                         reinterpret_cast<const byte *>(vB.getData())));
+		}
+
+		hash = hashData(hash, vB.getData(), vB.getCount() * vB.getSize());
+
+		hash = Common::hashFNV64(hash, iB.getCount());
+		hash = Common::hashFNV64(hash, iB.getType());
+
+		hash = hashData(hash, iB.getData(), iB.getCount() * iB.getSize());
+	}
+
+	return hash;
+}
+
+Model::BufferObjects *Model::createBufferObjects(const GeometryBufferList &geometry, uint64 hash) {
+	BufferObjects *buffers = new BufferObjects;
+
+	buffers->hash = hash;
+
+	// Lay out all geometry, one after the other, in one vertex and one index buffer
+
+	uint32 vertexSize = 0, indexSize = 0;
+	for (GeometryBufferList::const_iterator g = geometry.begin(); g != geometry.end(); ++g) {
+		vertexSize = alignBufferOffset(vertexSize);
+		indexSize  = alignBufferOffset(indexSize);
+
+		buffers->vertexOffsets.push_back(vertexSize);
+		buffers->indexOffsets.push_back(indexSize);
+
+		vertexSize += g->vertexBuffer->getCount() * g->vertexBuffer->getSize();
+		indexSize  += g->indexBuffer->getCount()  * g->indexBuffer->getSize();
+	}
+
+	buffers->size = vertexSize + indexSize;
+
+	glGenBuffers(1, &buffers->vbo);
+	glGenBuffers(1, &buffers->ibo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers->vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexSize, 0, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, 0, GL_STATIC_DRAW);
+
+	for (size_t i = 0; i < geometry.size(); i++) {
+		const VertexBuffer &vB = *geometry[i].vertexBuffer;
+		const IndexBuffer  &iB = *geometry[i].indexBuffer;
+
+		glBufferSubData(GL_ARRAY_BUFFER        , buffers->vertexOffsets[i], vB.getCount() * vB.getSize(), vB.getData());
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, buffers->indexOffsets [i], iB.getCount() * iB.getSize(), iB.getData());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	bufferObjectCount++;
+	bufferSize += buffers->size;
+
+	return buffers;
+}
+
 void Model::doRebuild() {
-	// TODO: remove this and all references to it.
+	doDestroy();
+
+	if (!GfxMan.supportVertexBuffers())
+		return;
+
+	GeometryBufferList geometry;
+	collectGeometry(geometry);
+
+	std::vector<const VertexBuffer *> vertexBuffers;
+	std::vector<const IndexBuffer  *> indexBuffers;
+
+	for (GeometryBufferList::const_iterator g = geometry.begin(); g != geometry.end(); ++g) {
+		if ((g->vertexBuffer->getCount() == 0) || (g->indexBuffer->getCount() == 0))
+			continue;
+
+		_geometryBuffers.push_back(*g);
+
+		vertexBuffers.push_back(g->vertexBuffer);
+		indexBuffers.push_back(g->indexBuffer);
+	}
+
+	if (_geometryBuffers.empty())
+		return;
+
+	const uint64 hash = hashGeometry(vertexBuffers, indexBuffers);
+
+	/* Models with the same geometry, like the repeated tiles of an area or a forest
+	 * of trees, share one copy of it. This also lets the model queue draw them all
+	 * together, since their nodes then render out of the same buffer ranges. */
+
+	BufferObjectsMap::iterator shared = _sharedBufferObjects.find(_fileName);
+	if ((shared != _sharedBufferObjects.end()) && (shared->second->hash == hash)) {
+		_bufferObjects = shared->second;
+
+		bufferSharedSize += _bufferObjects->size;
+	} else {
+		_bufferObjects = createBufferObjects(_geometryBuffers, hash);
+
+		if (!_fileName.empty() && (shared == _sharedBufferObjects.end())) {
+			_bufferObjects->name = _fileName;
+
+			_sharedBufferObjects.insert(std::make_pair(_fileName, _bufferObjects));
+		}
+	}
+
+	_bufferObjects->references++;
+	bufferModelCount++;
+
+	for (size_t i = 0; i < _geometryBuffers.size(); i++) {
+		_geometryBuffers[i].vertexBuffer->setSharedVBO(_bufferObjects->vbo, _bufferObjects->vertexOffsets[i]);
+		_geometryBuffers[i].indexBuffer->setSharedIBO(_bufferObjects->ibo, _bufferObjects->indexOffsets [i]);
+	}
+
+	debugC(4, kDebugGraphics, "Model \"%s\": %u pieces of geometry in %u bytes of buffer objects%s",
+	       _name.c_str(), (uint)_geometryBuffers.size(), _bufferObjects->size,
+	       (_bufferObjects->references > 1) ? ", shared" : "");
 }
 
 void Model::doDestroy() {
-	// TODO: remove this and all references to it.
+	// The geometry goes back to rendering out of system memory
+	for (GeometryBufferList::iterator g = _geometryBuffers.begin(); g != _geometryBuffers.end(); ++g) {
+		g->vertexBuffer->setSharedVBO(0, 0);
+		g->indexBuffer->setSharedIBO(0, 0);
+	}
+
+	_geometryBuffers.clear();
+
+	if (!_bufferObjects)
+		return;
+
+	bufferModelCount--;
+
+	if (--_bufferObjects->references > 0) {
+		bufferSharedSize -= _bufferObjects->size;
+
+		_bufferObjects = 0;
+		return;
+	}
+
+	if (!_bufferObjects->name.empty())
+		_sharedBufferObjects.erase(_bufferObjects->name);
+
+	glDeleteBuffers(1, &_bufferObjects->vbo);
+	glDeleteBuffers(1, &_bufferObjects->ibo);
+
+	bufferObjectCount--;
+	bufferSize -= _bufferObjects->size;
+
+	delete _bufferObjects;
+	_bufferObjects = 0;
 }
 
 void Model::finalize() {
@@ -638,6 +937,11 @@ void Model::finalize() {
 			(*n)->orderChildren();
 
 	_currentAnimation = selectDefaultAnimation();
+
+	/* Upload our geometry into buffer objects the next time we're rendered, in the
+	 * main thread. The node tree is only ever changed while the model is hidden, see
+	 * ModelNode::addChild(), so the upload never sees a tree that's being changed. */
+	_geometryChanged = true;
 }
 
 void Model::createStateNamesList(std::list<Common::UString> *stateNames) {
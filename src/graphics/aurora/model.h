@@ -47,6 +47,9 @@ namespace Common {
 
 namespace Graphics {
 
+class VertexBuffer;
+class IndexBuffer;
+
 namespace Aurora {
 
 class ModelNode;
@@ -151,10 +154,26 @@ public:
 	void playDefaultAnimation();
 
 
+	/** Statistics about the GL buffer objects holding the geometry of all models. */
+	struct BufferStats {
+		uint32 models;     ///< Number of models rendering out of buffer objects.
+		uint32 buffers;    ///< Number of distinct vertex/index buffer object pairs.
+		uint64 size;       ///< Combined size of all buffer objects, in bytes.
+		uint64 sharedSize; ///< Size not uploaded again because models share their geometry, in bytes.
+
+		BufferStats();
+	};
+
+	/** Get statistics about the GL buffer objects holding the geometry of all models. */
+	static BufferStats getBufferStats();
+
+
 	// Renderable
 	void calculateDistance();
 	void render(RenderPass pass);
 	void advanceTime(float dt);
+	bool isInFrustum(const Frustum &frustum) const;
+	void renderCulled(RenderPass pass, const Frustum &frustum);
 
 
 protected:
@@ -228,9 +247,17 @@ protected:
 
 	// Rendering
 
+	/** Render the model, skipping nodes outside the frustum in model space, if given. */
+	void doRender(RenderPass pass, const Frustum *frustum);
+	/** Queue the model's nodes into the model queue, skipping those outside the frustum in model space. */
+	void doQueueRender(RenderPass pass, const Frustum *frustum);
+
 	void doDrawBound();
 	void doDrawSkeleton();
 
+	/** Can the model's nodes never move away from where they were loaded? */
+	bool isStatic() const;
+
 	// Animation
 
 	/** Get the animation from its name. */
@@ -241,6 +268,21 @@ protected:
 	void finalize();
 
 
+	// Buffer objects
+
+	/** Static geometry kept in the model's GL buffer objects. */
+	struct GeometryBuffers {
+		VertexBuffer *vertexBuffer;
+		IndexBuffer  *indexBuffer;
+
+		GeometryBuffers(VertexBuffer &vB, IndexBuffer &iB);
+	};
+
+	typedef std::vector<GeometryBuffers> GeometryBufferList;
+
+	/** Collect all geometry the model renders, to be uploaded into its buffer objects. */
+	virtual void collectGeometry(GeometryBufferList &geometry);
+
 	// GLContainer
 	void doRebuild();
 	void doDestroy();
@@ -255,6 +297,40 @@ private:
 
 	float _elapsedTime; ///< Track animation duration.
 
+	/** GL buffer objects holding static geometry, shared by all models with the same geometry. */
+	struct BufferObjects {
+		Common::UString name; ///< File name of the models sharing these buffer objects.
+		uint64 hash;          ///< Hash over the layout and contents of all the geometry.
+
+		GLuint vbo; ///< Vertex buffer object.
+		GLuint ibo; ///< Index buffer object.
+
+		std::vector<uint32> vertexOffsets; ///< Offsets of each piece of geometry into the vertex buffer.
+		std::vector<uint32> indexOffsets;  ///< Offsets of each piece of geometry into the index buffer.
+
+		uint32 size;       ///< Combined size of both buffer objects, in bytes.
+		uint32 references; ///< Number of models rendering out of these buffer objects.
+
+		BufferObjects();
+	};
+
+	typedef std::map<Common::UString, BufferObjects *> BufferObjectsMap;
+
+	/** All buffer objects other models with the same file name can share. */
+	static BufferObjectsMap _sharedBufferObjects;
+
+	/** The buffer objects our geometry is rendering out of. */
+	BufferObjects *_bufferObjects;
+
+	/** The geometry currently rendering out of our buffer objects. */
+	GeometryBufferList _geometryBuffers;
+
+	/** Does the geometry need to be uploaded into buffer objects again? */
+	bool _geometryChanged;
+
+	/** Lay out and upload the geometry into new buffer objects. */
+	static BufferObjects *createBufferObjects(const GeometryBufferList &geometry, uint64 hash);
+
 	/** Create the list of all state names. */
 	void createStateNamesList(std::list<Common::UString> *stateNames = 0);
 	/** Create the model's bounding box. */
@@ -148,7 +148,7 @@ void Model_DragonAge::ParserContext::open(const Common::UString &name) {
 
 	// Open the MMH
 
-	mmh = new GFF4File(mmhFile, kFileTypeMMH, kMMHID);
+	mmh = new GFF4File(mmhFile, kFileTypeMMH, kMMHID, true);
 	if (mmh->getTypeVersion() != kVersion01)
 		throw Common::Exception("Unsupported MMH version %s", Common::debugTag(mmh->getTypeVersion()).c_str());
 
@@ -163,7 +163,7 @@ void Model_DragonAge::ParserContext::open(const Common::UString &name) {
 	// Open the MSH
 	if (!mshFile.empty()) {
 
-		msh = new GFF4File(mshFile, kFileTypeMSH, kMSHID);
+		msh = new GFF4File(mshFile, kFileTypeMSH, kMSHID, true);
 		if ((msh->getTypeVersion() != kVersion01) && (msh->getTypeVersion() != kVersion10))
 			throw Common::Exception("Unsupported MSH version %s", Common::debugTag(msh->getTypeVersion()).c_str());
 
@@ -68,6 +68,7 @@
 #include "src/graphics/aurora/model_sonic.h"
 #include "src/graphics/aurora/textureman.h"
 #include "src/graphics/aurora/texture.h"
+#include "src/graphics/aurora/modelqueueman.h"
 
 static const uint32 kBMD0ID = MKTAG('B', 'M', 'D', '0');
 static const uint32 kMDL0ID = MKTAG('M', 'D', 'L', '0');
@@ -114,6 +115,17 @@ Model_Sonic::Model_Sonic(const Common::UString &name, ModelType type) : Model(ty
 }
 
 Model_Sonic::~Model_Sonic() {
+	// Our primitives are gone by the time ~Model() releases the buffer objects
+	destroy();
+}
+
+void Model_Sonic::collectGeometry(GeometryBufferList &geometry) {
+	Model::collectGeometry(geometry);
+
+	for (Geometries::iterator g = _geometries.begin(); g != _geometries.end(); ++g)
+		for (Primitives::iterator p = g->primitives.begin(); p != g->primitives.end(); ++p)
+			if (!p->invalid)
+				geometry.push_back(GeometryBuffers(p->vertexBuffer, p->indexBuffer));
 }
 
 // --- Loader ---
@@ -1329,6 +1341,13 @@ Common::TransformationMatrix Model_Sonic::createPivot(double a, double b, uint8
 	return Common::TransformationMatrix(pivot);
 }
 
+void Model_Sonic::renderCulled(RenderPass pass, const Frustum &UNUSED(frustum)) {
+	// Our geometry isn't split into nodes, so there's nothing to cull here, or to queue
+	ModelQueueMan.flush();
+
+	render(pass);
+}
+
 void Model_Sonic::render(RenderPass pass) {
 	/* We're overriding Model::render() here, because Model_Sonic keeps the geometry,
 	 * while in other Model classes, the geometry is inside the ModelNodes.
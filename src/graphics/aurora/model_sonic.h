@@ -118,6 +118,10 @@ public:
 	~Model_Sonic();
 
 	void render(RenderPass pass);
+	void renderCulled(RenderPass pass, const Frustum &frustum);
+
+protected:
+	void collectGeometry(GeometryBufferList &geometry);
 
 private:
 	// === Loading-time ===
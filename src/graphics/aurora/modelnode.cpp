@@ -30,11 +30,13 @@
 #include "src/common/error.h"
 
 #include "src/graphics/camera.h"
+#include "src/graphics/frustum.h"
 
 #include "src/graphics/images/txi.h"
 
 #include "src/graphics/aurora/modelnode.h"
 #include "src/graphics/aurora/textureman.h"
+#include "src/graphics/aurora/modelqueueman.h"
 #include "src/graphics/aurora/texture.h"
 #include "src/graphics/aurora/model.h"
 
@@ -555,7 +557,29 @@ void ModelNode::renderGeometryEnvMappedOver() {
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void ModelNode::render(RenderPass pass) {
+bool ModelNode::hasGeometry(RenderPass pass) const {
+	if (!_render || (_indexBuffer.getCount() == 0))
+		return false;
+
+	if (((pass == kRenderPassOpaque)      &&  _isTransparent) ||
+	    ((pass == kRenderPassTransparent) && !_isTransparent))
+		return false;
+
+	return true;
+}
+
+void ModelNode::render(RenderPass pass, const Frustum *frustum) {
+	// Skip the node and all its children if they're completely outside the view
+	if (frustum) {
+		const Frustum::Result visibility = frustum->test(_absoluteBoundBox);
+		if (visibility == Frustum::kOutside)
+			return;
+
+		// If they're completely inside, there's no need to test the children
+		if (visibility == Frustum::kInside)
+			frustum = 0;
+	}
+
 	// Apply the node's transformation
 
 	glTranslatef(_position[0], _position[1], _position[2]);
@@ -570,23 +594,61 @@ void ModelNode::render(RenderPass pass) {
 
 	// Render the node's geometry
 
-	bool shouldRender = _render && (_indexBuffer.getCount() > 0);
-	if (((pass == kRenderPassOpaque)      &&  _isTransparent) ||
-	    ((pass == kRenderPassTransparent) && !_isTransparent))
-		shouldRender = false;
-
-	if (shouldRender)
+	if (hasGeometry(pass))
 		renderGeometry();
 
 
 	// Render the node's children
 	for (std::list<ModelNode *>::iterator c = _children.begin(); c != _children.end(); ++c) {
 		glPushMatrix();
-		(*c)->render(pass);
+		(*c)->render(pass, frustum);
 		glPopMatrix();
 	}
 }
 
+void ModelNode::queueRender(RenderPass pass, const Common::TransformationMatrix &parent,
+                            const Frustum *frustum) {
+
+	// Skip the node and all its children if they're completely outside the view
+	if (frustum) {
+		const Frustum::Result visibility = frustum->test(_absoluteBoundBox);
+		if (visibility == Frustum::kOutside)
+			return;
+
+		// If they're completely inside, there's no need to test the children
+		if (visibility == Frustum::kInside)
+			frustum = 0;
+	}
+
+	// Apply the node's transformation, the same way render() does with the OpenGL matrix
+
+	Common::TransformationMatrix transform = parent;
+
+	transform.translate(_position[0], _position[1], _position[2]);
+	if (_orientation[3] != 0.0f)
+		transform.rotate(_orientation[3], _orientation[0], _orientation[1], _orientation[2]);
+
+	if (_rotation[0] != 0.0f)
+		transform.rotate(_rotation[0], 1.0f, 0.0f, 0.0f);
+	if (_rotation[1] != 0.0f)
+		transform.rotate(_rotation[1], 0.0f, 1.0f, 0.0f);
+	if (_rotation[2] != 0.0f)
+		transform.rotate(_rotation[2], 0.0f, 0.0f, 1.0f);
+
+	transform.scale(_scale[0], _scale[1], _scale[2]);
+
+
+	// Queue the node's geometry
+
+	if (hasGeometry(pass))
+		ModelQueueMan.queue(*this, transform);
+
+
+	// Queue the node's children
+	for (std::list<ModelNode *>::iterator c = _children.begin(); c != _children.end(); ++c)
+		(*c)->queueRender(pass, transform, frustum);
+}
+
 void ModelNode::drawSkeleton(const Common::TransformationMatrix &parent, bool showInvisible) {
 	Common::TransformationMatrix mine = parent;
 
@@ -41,6 +41,8 @@
 
 namespace Graphics {
 
+class Frustum;
+
 namespace Aurora {
 
 class Model;
@@ -193,7 +195,10 @@ protected:
 	void createAbsoluteBound();
 	void createAbsoluteBound(Common::BoundingBox parentPosition);
 
-	void render(RenderPass pass);
+	/** Render the node and its children, skipping those outside the frustum in model space, if given. */
+	void render(RenderPass pass, const Frustum *frustum = 0);
+	/** Queue the node and its children into the model queue, instead of rendering them directly. */
+	void queueRender(RenderPass pass, const Common::TransformationMatrix &parent, const Frustum *frustum = 0);
 	void drawSkeleton(const Common::TransformationMatrix &parent, bool showInvisible);
 
 	void lockFrame();
@@ -208,6 +213,9 @@ private:
 
 	void orderChildren();
 
+	/** Does the node have geometry to be rendered in this pass? */
+	bool hasGeometry(RenderPass pass) const;
+
 	void renderGeometry();
 	void renderGeometryNormal();
 	void renderGeometryEnvMappedUnder();
@@ -236,6 +244,7 @@ public:
 	void interpolateOrientation(float time, float &x, float &y, float &z, float &a) const;
 
 	friend class Model;
+	friend class ModelQueueManager;
 };
 
 } // End of namespace Aurora
@@ -0,0 +1,508 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  The Aurora model queue manager, batching world model geometry by texture state.
+ */
+
+#include "src/common/atomic.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+
+#include "src/common/util.h"
+
+#include "src/graphics/graphics.h"
+#include "src/graphics/vertexbuffer.h"
+#include "src/graphics/indexbuffer.h"
+
+#include "src/graphics/images/decoder.h"
+
+#include "src/graphics/aurora/modelqueueman.h"
+#include "src/graphics/aurora/modelnode.h"
+#include "src/graphics/aurora/textureman.h"
+#include "src/graphics/aurora/texture.h"
+
+DECLARE_SINGLETON(Graphics::Aurora::ModelQueueManager)
+
+namespace Graphics {
+
+namespace Aurora {
+
+/** Transform each instance with its own modelview matrix, otherwise like the fixed-function pipeline. */
+static const char *kInstancingVertexShader =
+	"#version 120\n"
+	"\n"
+	"attribute vec4 instanceMatrix0;\n"
+	"attribute vec4 instanceMatrix1;\n"
+	"attribute vec4 instanceMatrix2;\n"
+	"attribute vec4 instanceMatrix3;\n"
+	"\n"
+	"void main() {\n"
+	"\tmat4 modelview = mat4(instanceMatrix0, instanceMatrix1, instanceMatrix2, instanceMatrix3);\n"
+	"\n"
+	"\tgl_Position    = gl_ProjectionMatrix * (modelview * gl_Vertex);\n"
+	"\tgl_FrontColor  = gl_Color;\n"
+	"\tgl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+	"}\n";
+
+/** Modulate the color with the one texture, like GL_MODULATE. */
+static const char *kInstancingFragmentShader =
+	"#version 120\n"
+	"\n"
+	"uniform sampler2D texture0;\n"
+	"\n"
+	"void main() {\n"
+	"\tgl_FragColor = gl_Color * texture2D(texture0, gl_TexCoord[0].st);\n"
+	"}\n";
+
+/** The first of the four consecutive attributes holding the instance matrix columns.
+ *
+ *  Some drivers alias the conventional attributes onto the generic ones. These would
+ *  be gl_MultiTexCoord4 to gl_MultiTexCoord7, so nodes using those aren't instanced.
+ */
+static const GLuint kInstanceMatrixLocation = 12;
+
+static GLuint compileShader(GLenum type, const char *source) {
+	GLuint shader = glCreateShader(type);
+
+	glShaderSource(shader, 1, &source, 0);
+	glCompileShader(shader);
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status == GL_FALSE) {
+		char log[4096];
+		glGetShaderInfoLog(shader, sizeof(log), 0, log);
+
+		warning("Failed to compile the instancing shader: %s", log);
+
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+
+ModelQueueManager::Instancing::Instancing() : _tried(false), _program(0), _buffer(0) {
+}
+
+ModelQueueManager::Instancing::~Instancing() {
+	// The GL context is already gone by the time the model queue is destroyed
+}
+
+bool ModelQueueManager::Instancing::init() {
+	if (!_tried)
+		rebuild();
+
+	_tried = true;
+
+	return _program != 0;
+}
+
+void ModelQueueManager::Instancing::doRebuild() {
+	doDestroy();
+
+	if (!GfxMan.supportInstancing())
+		return;
+
+	GLuint vertexShader   = compileShader(GL_VERTEX_SHADER  , kInstancingVertexShader);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, kInstancingFragmentShader);
+
+	if ((vertexShader != 0) && (fragmentShader != 0)) {
+		_program = glCreateProgram();
+
+		glAttachShader(_program, vertexShader);
+		glAttachShader(_program, fragmentShader);
+
+		glBindAttribLocation(_program, kInstanceMatrixLocation + 0, "instanceMatrix0");
+		glBindAttribLocation(_program, kInstanceMatrixLocation + 1, "instanceMatrix1");
+		glBindAttribLocation(_program, kInstanceMatrixLocation + 2, "instanceMatrix2");
+		glBindAttribLocation(_program, kInstanceMatrixLocation + 3, "instanceMatrix3");
+
+		glLinkProgram(_program);
+
+		GLint status;
+		glGetProgramiv(_program, GL_LINK_STATUS, &status);
+		if (status == GL_FALSE) {
+			char log[4096];
+			glGetProgramInfoLog(_program, sizeof(log), 0, log);
+
+			warning("Failed to link the instancing shader: %s", log);
+
+			glDeleteProgram(_program);
+			_program = 0;
+		}
+	}
+
+	// The program keeps the shaders alive as long as it needs them
+	if (vertexShader != 0)
+		glDeleteShader(vertexShader);
+	if (fragmentShader != 0)
+		glDeleteShader(fragmentShader);
+
+	if (_program == 0) {
+		warning("Repeated models will be drawn one after the other");
+		return;
+	}
+
+	glUseProgram(_program);
+	glUniform1i(glGetUniformLocation(_program, "texture0"), 0);
+	glUseProgram(0);
+
+	glGenBuffers(1, &_buffer);
+}
+
+void ModelQueueManager::Instancing::doDestroy() {
+	if (_program != 0)
+		glDeleteProgram(_program);
+	if (_buffer != 0)
+		glDeleteBuffers(1, &_buffer);
+
+	_program = 0;
+	_buffer  = 0;
+}
+
+void ModelQueueManager::Instancing::draw(const ModelNode &node, const std::vector<float> &matrices, uint32 count) {
+	// Set up the geometry first, so that our matrix attributes win should they alias any of its arrays
+	node._vertexBuffer.enable();
+
+	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+	glBufferData(GL_ARRAY_BUFFER, count * 16 * sizeof(float), &matrices[0], GL_STREAM_DRAW);
+
+	for (GLuint i = 0; i < 4; i++) {
+		const GLuint location = kInstanceMatrixLocation + i;
+
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+		                      reinterpret_cast<const GLvoid *>(i * 4 * sizeof(float)));
+		glVertexAttribDivisorARB(location, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUseProgram(_program);
+
+	VertexBuffer::drawElementsInstanced(GL_TRIANGLES, node._indexBuffer, count);
+
+	glUseProgram(0);
+
+	for (GLuint i = 0; i < 4; i++) {
+		const GLuint location = kInstanceMatrixLocation + i;
+
+		glVertexAttribDivisorARB(location, 0);
+		glDisableVertexAttribArray(location);
+	}
+
+	node._vertexBuffer.disable();
+}
+
+
+ModelQueueManager::Item::Item(ModelNode &n, const Common::TransformationMatrix &t) : node(&n), transform(t) {
+}
+
+
+ModelQueueManager::ModelQueueManager() : _collecting(false), _pass(kRenderPassOpaque),
+	_boundTextures(TextureManager::getTextureUnitCount(), 0), _boundTextureCount(0), _wireframe(false) {
+
+	_enabled.store(true);
+	_instancingMode.store(kInstancingHardware);
+}
+
+ModelQueueManager::~ModelQueueManager() {
+}
+
+void ModelQueueManager::setEnabled(bool enabled) {
+	_enabled.store(enabled);
+}
+
+bool ModelQueueManager::isEnabled() const {
+	return _enabled.load();
+}
+
+void ModelQueueManager::setInstancingMode(InstancingMode mode) {
+	_instancingMode.store(mode);
+}
+
+ModelQueueManager::InstancingMode ModelQueueManager::getInstancingMode() const {
+	return (InstancingMode) _instancingMode.load();
+}
+
+bool ModelQueueManager::hasHardwareInstancing() const {
+	return GfxMan.supportInstancing();
+}
+
+void ModelQueueManager::begin(RenderPass pass) {
+	_items.clear();
+
+	_collecting = _enabled.load() && ((pass == kRenderPassOpaque) || (pass == kRenderPassTransparent));
+	_pass       = pass;
+}
+
+bool ModelQueueManager::isCollecting() const {
+	return _collecting;
+}
+
+void ModelQueueManager::queue(ModelNode &node, const Common::TransformationMatrix &transform) {
+	_items.push_back(Item(node, transform));
+}
+
+static const Texture *getTexture(const TextureHandle &handle) {
+	return handle.empty() ? 0 : &handle.getTexture();
+}
+
+bool ModelQueueManager::compareItems(const Item &a, const Item &b) {
+	const ModelNode &nodeA = *a.node;
+	const ModelNode &nodeB = *b.node;
+
+	// Environment mapped nodes manage their textures themselves, so put them last
+	const Texture *envMapA = getTexture(nodeA._envMap);
+	const Texture *envMapB = getTexture(nodeB._envMap);
+	if (envMapA != envMapB)
+		return std::less<const Texture *>()(envMapA, envMapB);
+
+	const size_t count = MIN(nodeA._textures.size(), nodeB._textures.size());
+	for (size_t t = 0; t < count; t++) {
+		const Texture *textureA = getTexture(nodeA._textures[t]);
+		const Texture *textureB = getTexture(nodeB._textures[t]);
+
+		if (textureA != textureB)
+			return std::less<const Texture *>()(textureA, textureB);
+	}
+
+	if (nodeA._textures.size() != nodeB._textures.size())
+		return nodeA._textures.size() < nodeB._textures.size();
+
+	// Then group nodes rendering out of the same buffer objects, ideally the same range
+	const VertexBuffer &vertexA = nodeA._vertexBuffer;
+	const VertexBuffer &vertexB = nodeB._vertexBuffer;
+	if (vertexA.getVBO() != vertexB.getVBO())
+		return vertexA.getVBO() < vertexB.getVBO();
+	if (vertexA.getVBOOffset() != vertexB.getVBOOffset())
+		return vertexA.getVBOOffset() < vertexB.getVBOOffset();
+
+	return nodeA._indexBuffer.getIBOOffset() < nodeB._indexBuffer.getIBOOffset();
+}
+
+bool ModelQueueManager::canInstance(const ModelNode &node) {
+	// Only geometry in shared buffer objects can be identified as the same
+	if (!node._envMap.empty() || (node._vertexBuffer.getVBO() == 0) || (node._indexBuffer.getIBO() == 0))
+		return false;
+
+	const VertexDecl &decl = node._vertexBuffer.getVertexDecl();
+	for (VertexDecl::const_iterator d = decl.begin(); d != decl.end(); ++d)
+		if (d->index >= VTCOORD + 4)
+			return false;
+
+	return true;
+}
+
+bool ModelQueueManager::isSameGeometry(const ModelNode &a, const ModelNode &b) {
+	if ((a._vertexBuffer.getVBO()       != b._vertexBuffer.getVBO()      ) ||
+	    (a._vertexBuffer.getVBOOffset() != b._vertexBuffer.getVBOOffset()) ||
+	    (a._indexBuffer.getIBO()        != b._indexBuffer.getIBO()       ) ||
+	    (a._indexBuffer.getIBOOffset()  != b._indexBuffer.getIBOOffset() ) ||
+	    (a._indexBuffer.getCount()      != b._indexBuffer.getCount()     ))
+		return false;
+
+	if (a._textures.size() != b._textures.size())
+		return false;
+
+	for (size_t t = 0; t < a._textures.size(); t++)
+		if (getTexture(a._textures[t]) != getTexture(b._textures[t]))
+			return false;
+
+	return true;
+}
+
+void ModelQueueManager::flush() {
+	if (!_collecting || (_pass != kRenderPassTransparent))
+		return;
+
+	drawItems();
+}
+
+void ModelQueueManager::end() {
+	if (!_collecting)
+		return;
+
+	_collecting = false;
+
+	drawItems();
+}
+
+void ModelQueueManager::drawItems() {
+	if (_items.empty())
+		return;
+
+	// Transparent nodes need to stay in their order, opaque nodes can be grouped by textures
+	if (_pass == kRenderPassOpaque)
+		std::stable_sort(_items.begin(), _items.end(), compareItems);
+
+	InstancingMode mode = getInstancingMode();
+	if ((mode == kInstancingHardware) && !_instancing.init())
+		mode = kInstancingBatched;
+
+	// Start from a known texture state
+	TextureMan.reset();
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+
+	std::vector<Item>::const_iterator i = _items.begin();
+	while (i != _items.end()) {
+		// Find the run of nodes drawing the same geometry with the same textures
+		std::vector<Item>::const_iterator last = i + 1;
+		if ((mode != kInstancingNone) && canInstance(*i->node))
+			while ((last != _items.end()) && isSameGeometry(*i->node, *last->node))
+				++last;
+
+		if ((last - i) > 1)
+			drawRun(i, last, mode);
+		else
+			draw(*i);
+
+		i = last;
+	}
+
+	glPopMatrix();
+
+	unbindTextures();
+	setWireframe(false);
+
+	TextureMan.reset();
+
+	_items.clear();
+}
+
+void ModelQueueManager::draw(const Item &item) {
+	ModelNode &node = *item.node;
+
+	glLoadMatrixf(item.transform.get());
+
+	if (!node._envMap.empty()) {
+		// Environment mapped nodes draw in several steps, changing the texture and blend state as they go
+		unbindTextures();
+		setWireframe(false);
+
+		TextureMan.activeTexture(0);
+		node.renderGeometry();
+
+		// They might leave the environment map bound, so start from scratch afterwards
+		TextureMan.reset();
+		return;
+	}
+
+	bindTextures(node);
+	setWireframe(node._textures.empty());
+
+	node._vertexBuffer.draw(GL_TRIANGLES, node._indexBuffer);
+}
+
+void ModelQueueManager::drawRun(std::vector<Item>::const_iterator first,
+                                std::vector<Item>::const_iterator last, InstancingMode mode) {
+
+	const ModelNode &node = *first->node;
+
+	bindTextures(node);
+	setWireframe(node._textures.empty());
+
+	// The instancing shader only knows about one 2D texture
+	const bool hardware = (mode == kInstancingHardware) && (node._textures.size() == 1) &&
+	                      !node._textures[0].getTexture().getImage().isCubeMap();
+
+	if (hardware) {
+		const uint32 count = last - first;
+
+		_instanceMatrices.resize(count * 16);
+		for (uint32 i = 0; i < count; i++)
+			memcpy(&_instanceMatrices[i * 16], first[i].transform.get(), 16 * sizeof(float));
+
+		_instancing.draw(node, _instanceMatrices, count);
+		return;
+	}
+
+	// All nodes draw the same buffer ranges, so only the matrix needs to change
+	node._vertexBuffer.enable();
+
+	for (std::vector<Item>::const_iterator i = first; i != last; ++i) {
+		glLoadMatrixf(i->transform.get());
+
+		VertexBuffer::drawElements(GL_TRIANGLES, i->node->_indexBuffer);
+	}
+
+	node._vertexBuffer.disable();
+}
+
+void ModelQueueManager::setWireframe(bool wireframe) {
+	if (wireframe != _wireframe)
+		glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+
+	_wireframe = wireframe;
+}
+
+void ModelQueueManager::bindTextures(const ModelNode &node) {
+	const size_t count = MIN(node._textures.size(), _boundTextures.size());
+
+	for (size_t t = 0; t < count; t++) {
+		const Texture *texture = getTexture(node._textures[t]);
+		if (texture == _boundTextures[t])
+			continue;
+
+		TextureMan.activeTexture(t);
+		TextureMan.set(node._textures[t]);
+
+		_boundTextures[t] = texture;
+	}
+
+	// Clear the texture units this node doesn't use
+	for (size_t t = count; t < _boundTextureCount; t++) {
+		if (!_boundTextures[t])
+			continue;
+
+		TextureMan.activeTexture(t);
+		TextureMan.set();
+
+		_boundTextures[t] = 0;
+	}
+
+	_boundTextureCount = count;
+}
+
+void ModelQueueManager::unbindTextures() {
+	for (size_t t = 0; t < _boundTextureCount; t++) {
+		if (!_boundTextures[t])
+			continue;
+
+		TextureMan.activeTexture(t);
+		TextureMan.set();
+
+		_boundTextures[t] = 0;
+	}
+
+	_boundTextureCount = 0;
+}
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
@@ -0,0 +1,185 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  The Aurora model queue manager, batching world model geometry by texture state.
+ */
+
+#ifndef GRAPHICS_AURORA_MODELQUEUEMAN_H
+#define GRAPHICS_AURORA_MODELQUEUEMAN_H
+
+#include "src/common/atomic.h"
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/singleton.h"
+#include "src/common/transmatrix.h"
+
+#include "src/graphics/types.h"
+#include "src/graphics/glcontainer.h"
+
+#include "src/graphics/aurora/types.h"
+
+namespace Graphics {
+
+namespace Aurora {
+
+class ModelNode;
+class Texture;
+
+/** The global Aurora model queue manager.
+ *
+ *  While the world is rendered, models don't draw their nodes directly.
+ *  Instead, they queue each node together with its full modelview matrix.
+ *  At the end of each render pass, the queued nodes are drawn in one go,
+ *  binding only those textures that actually change from node to node.
+ *
+ *  Opaque nodes are additionally sorted by their textures first, so that
+ *  nodes sharing the same textures are drawn right after each other.
+ *  Transparent nodes keep their back-to-front order, and are also drawn
+ *  whenever another renderable is about to draw itself directly.
+ *
+ *  Nodes of models sharing the same geometry, like the repeated tiles of
+ *  an area, render out of the same buffer object ranges. Runs of such
+ *  nodes are drawn together: either with one instanced draw call, reading
+ *  the modelview matrix of each copy in a small vertex shader, or, where
+ *  that's not available, by setting up the geometry once and only changing
+ *  the matrix between the draw calls.
+ */
+class ModelQueueManager : public Common::Singleton<ModelQueueManager> {
+public:
+	ModelQueueManager();
+	~ModelQueueManager();
+
+	/** Enable/Disable the queue. When disabled, models render their nodes directly. */
+	void setEnabled(bool enabled);
+	/** Is the queue enabled? */
+	bool isEnabled() const;
+
+	/** Start collecting nodes for this render pass, if the queue is enabled. */
+	void begin(RenderPass pass);
+	/** Are we currently collecting nodes? */
+	bool isCollecting() const;
+
+	/** Queue the geometry of this node, to be drawn with this modelview matrix. */
+	void queue(ModelNode &node, const Common::TransformationMatrix &transform);
+
+	/** Draw the transparent nodes collected so far, but keep on collecting.
+	 *
+	 *  Renderables that don't queue their geometry call this before they
+	 *  draw directly, so that the transparent pass stays in back-to-front
+	 *  order. The order of opaque nodes doesn't matter, so they're kept
+	 *  until end(), to be grouped by textures.
+	 */
+	void flush();
+
+	/** Draw all collected nodes and stop collecting. */
+	void end();
+
+	/** How runs of nodes with the same geometry are drawn. */
+	enum InstancingMode {
+		kInstancingNone     = 0, ///< Draw each node on its own.
+		kInstancingBatched  = 1, ///< Set up the geometry once, then draw each node with its own matrix.
+		kInstancingHardware = 2  ///< Draw all nodes with one instanced draw call, if supported.
+	};
+
+	/** Set how runs of nodes with the same geometry are drawn. */
+	void setInstancingMode(InstancingMode mode);
+	/** Return how runs of nodes with the same geometry are drawn. */
+	InstancingMode getInstancingMode() const;
+
+	/** Can hardware instancing actually be used? */
+	bool hasHardwareInstancing() const;
+
+private:
+	/** The shader program and buffer object used for hardware instancing. */
+	class Instancing : public GLContainer {
+	public:
+		Instancing();
+		~Instancing();
+
+		/** Create the program, if not yet tried. Return true if instancing can be used. */
+		bool init();
+
+		/** Draw these nodes, all sharing the same geometry, with one instanced draw call. */
+		void draw(const ModelNode &node, const std::vector<float> &matrices, uint32 count);
+
+	protected:
+		void doRebuild();
+		void doDestroy();
+
+	private:
+		bool _tried; ///< Did we already try to create the program?
+
+		GLuint _program; ///< The instancing shader program.
+		GLuint _buffer;  ///< The buffer object holding the matrices of all instances.
+	};
+
+	struct Item {
+		ModelNode *node;
+		Common::TransformationMatrix transform;
+
+		Item(ModelNode &n, const Common::TransformationMatrix &t);
+	};
+
+	boost::atomic<bool> _enabled;
+	boost::atomic<int>  _instancingMode;
+
+	bool _collecting;
+	RenderPass _pass;
+
+	std::vector<Item> _items; ///< The nodes queued in this pass.
+
+	std::vector<const Texture *> _boundTextures; ///< The textures currently bound to each texture unit.
+	size_t _boundTextureCount; ///< Number of texture units that might have a texture bound.
+
+	bool _wireframe; ///< Are polygons currently drawn as lines?
+
+	Instancing _instancing;
+
+	std::vector<float> _instanceMatrices; ///< The matrices of the nodes in the current run.
+
+	void drawItems();
+	void draw(const Item &item);
+	void drawRun(std::vector<Item>::const_iterator first, std::vector<Item>::const_iterator last,
+	             InstancingMode mode);
+
+	void setWireframe(bool wireframe);
+
+	void bindTextures(const ModelNode &node);
+	void unbindTextures();
+
+	static bool compareItems(const Item &a, const Item &b);
+
+	/** Can this node be drawn together with other nodes with the same geometry? */
+	static bool canInstance(const ModelNode &node);
+	/** Do these two nodes draw the same geometry with the same textures? */
+	static bool isSameGeometry(const ModelNode &a, const ModelNode &b);
+};
+
+} // End of namespace Aurora
+
+} // End of namespace Graphics
+
+/** Shortcut for accessing the model queue manager. */
+#define ModelQueueMan Graphics::Aurora::ModelQueueManager::instance()
+
+#endif // GRAPHICS_AURORA_MODELQUEUEMAN_H
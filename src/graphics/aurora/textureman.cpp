@@ -79,7 +79,7 @@ static GLenum kTextureUnit[] = {
 static const size_t kTextureUnitCount = ARRAYSIZE(kTextureUnit);
 
 
-TextureManager::TextureManager() : _recordNewTextures(false) {
+TextureManager::TextureManager() : _recordNewTextures(false), _bindCount(0) {
 }
 
 TextureManager::~TextureManager() {
@@ -263,10 +263,12 @@ void TextureManager::reset() {
 	activeTexture(0);
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, 0);
+	_bindCount++;
 }
 
 void TextureManager::set() {
 	glBindTexture(GL_TEXTURE_2D, 0);
+	_bindCount++;
 
 	glEnable(GL_TEXTURE_2D);
 	glDisable(GL_TEXTURE_CUBE_MAP);
@@ -298,6 +300,8 @@ void TextureManager::set(const TextureHandle &handle, TextureMode mode) {
 		glEnable(GL_TEXTURE_2D);
 	}
 
+	_bindCount++;
+
 	switch (mode) {
 		case kModeEnvironmentMapReflective:
 			if (handle._it->second->texture->getImage().isCubeMap()) {
@@ -335,6 +339,14 @@ void TextureManager::activeTexture(size_t n) {
 		glActiveTextureARB(kTextureUnit[n]);
 }
 
+size_t TextureManager::getTextureUnitCount() {
+	return kTextureUnitCount;
+}
+
+uint32 TextureManager::getBindCount() const {
+	return _bindCount;
+}
+
 } // End of namespace Aurora
 
 } // End of namespace Graphics
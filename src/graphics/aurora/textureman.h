@@ -90,6 +90,12 @@ public:
 
 	/** Set this texture unit as the current one. */
 	void activeTexture(size_t n);
+
+	/** Return the number of texture units set() and reset() can use. */
+	static size_t getTextureUnitCount();
+
+	/** Return the number of textures bound since the start, for statistics. */
+	uint32 getBindCount() const;
 	// '---
 
 private:
@@ -102,6 +108,8 @@ private:
 	bool _recordNewTextures;
 	std::list<Common::UString> _newTextureNames;
 
+	uint32 _bindCount; ///< Number of textures bound since the start.
+
 	void assign(TextureHandle &texture, const TextureHandle &from);
 	void release(TextureHandle &texture);
 
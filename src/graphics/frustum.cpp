@@ -0,0 +1,101 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A view frustum, for culling objects outside the view.
+ */
+
+#include "src/common/boundingbox.h"
+
+#include "src/graphics/frustum.h"
+
+namespace Graphics {
+
+Frustum::Frustum() : _infinite(true) {
+	for (int i = 0; i < 6; i++)
+		_planes[i][0] = _planes[i][1] = _planes[i][2] = _planes[i][3] = 0.0f;
+}
+
+Frustum::Frustum(const Common::TransformationMatrix &clip) : _clip(clip), _infinite(false) {
+	extractPlanes();
+}
+
+void Frustum::extractPlanes() {
+	/* Each plane is the sum or difference of the fourth row of the clip
+	 * matrix and one of the other rows (Gribb & Hartmann). The matrix is
+	 * stored column-major, so row r consists of elements r, r + 4, r + 8
+	 * and r + 12. */
+
+	const float *m = _clip.get();
+
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			_planes[i * 2 + 0][j] = m[j * 4 + 3] + m[j * 4 + i];
+			_planes[i * 2 + 1][j] = m[j * 4 + 3] - m[j * 4 + i];
+		}
+	}
+}
+
+Frustum Frustum::transform(const Common::TransformationMatrix &m) const {
+	if (_infinite)
+		return *this;
+
+	return Frustum(_clip * m);
+}
+
+Frustum::Result Frustum::test(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const {
+	if (_infinite)
+		return kInside;
+
+	Result result = kInside;
+
+	for (int i = 0; i < 6; i++) {
+		const float *p = _planes[i];
+
+		// The corner furthest along the plane's normal. If it's outside, the whole box is
+		const float outer = p[0] * ((p[0] >= 0.0f) ? maxX : minX) +
+		                    p[1] * ((p[1] >= 0.0f) ? maxY : minY) +
+		                    p[2] * ((p[2] >= 0.0f) ? maxZ : minZ) + p[3];
+		if (outer < 0.0f)
+			return kOutside;
+
+		// The opposite corner. If it's outside, the box straddles the plane
+		const float inner = p[0] * ((p[0] >= 0.0f) ? minX : maxX) +
+		                    p[1] * ((p[1] >= 0.0f) ? minY : maxY) +
+		                    p[2] * ((p[2] >= 0.0f) ? minZ : maxZ) + p[3];
+		if (inner < 0.0f)
+			result = kIntersecting;
+	}
+
+	return result;
+}
+
+Frustum::Result Frustum::test(const Common::BoundingBox &box) const {
+	if (_infinite || box.empty())
+		return kInside;
+
+	float minX, minY, minZ, maxX, maxY, maxZ;
+	box.getMin(minX, minY, minZ);
+	box.getMax(maxX, maxY, maxZ);
+
+	return test(minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+} // End of namespace Graphics
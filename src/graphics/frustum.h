@@ -0,0 +1,79 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A view frustum, for culling objects outside the view.
+ */
+
+#ifndef GRAPHICS_FRUSTUM_H
+#define GRAPHICS_FRUSTUM_H
+
+#include "src/common/transmatrix.h"
+
+namespace Common {
+	class BoundingBox;
+}
+
+namespace Graphics {
+
+/** The six planes of a view frustum.
+ *
+ *  The planes are extracted from a combined projection and modelview
+ *  matrix, so the frustum lives in the same coordinate system as the
+ *  vertices that matrix transforms. A frustum for the coordinate system of
+ *  a specific object can be created by additionally applying the object's
+ *  transformation.
+ */
+class Frustum {
+public:
+	/** The result of testing a box against the frustum. */
+	enum Result {
+		kOutside,      ///< Completely outside the frustum.
+		kIntersecting, ///< Partially inside the frustum.
+		kInside        ///< Completely inside the frustum.
+	};
+
+	/** Create a frustum that contains everything. */
+	Frustum();
+	/** Create the frustum of this combined projection and modelview matrix. */
+	Frustum(const Common::TransformationMatrix &clip);
+
+	/** Return the frustum in the coordinate system this matrix transforms into ours. */
+	Frustum transform(const Common::TransformationMatrix &m) const;
+
+	/** Test an axis-aligned box against the frustum. */
+	Result test(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const;
+	/** Test a bounding box against the frustum. An empty box is always inside. */
+	Result test(const Common::BoundingBox &box) const;
+
+private:
+	Common::TransformationMatrix _clip;
+
+	bool _infinite; ///< Does the frustum contain everything?
+
+	/** The planes, as (a, b, c, d), with a * x + b * y + c * z + d >= 0 on the inside. */
+	float _planes[6][4];
+
+	void extractPlanes();
+};
+
+} // End of namespace Graphics
+
+#endif // GRAPHICS_FRUSTUM_H
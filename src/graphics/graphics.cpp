@@ -34,6 +34,7 @@
 #include "src/common/configman.h"
 #include "src/common/threads.h"
 #include "src/common/transmatrix.h"
+#include "src/common/timestamp.h"
 #include "src/common/vector3.h"
 
 #include "src/events/requests.h"
@@ -49,10 +50,15 @@
 #include "src/graphics/glcontainer.h"
 #include "src/graphics/renderable.h"
 #include "src/graphics/camera.h"
+#include "src/graphics/frustum.h"
+#include "src/graphics/vertexbuffer.h"
 
 #include "src/graphics/images/decoder.h"
 #include "src/graphics/images/screenshot.h"
 
+#include "src/graphics/aurora/textureman.h"
+#include "src/graphics/aurora/modelqueueman.h"
+
 #include "src/graphics/shader/shader.h"
 #include "src/graphics/shader/materialman.h"
 #include "src/graphics/shader/surfaceman.h"
@@ -69,6 +75,8 @@ GraphicsManager::GraphicsManager() {
 
 	_needManualDeS3TC        = false;
 	_supportMultipleTextures = false;
+	_supportVertexBuffers    = false;
+	_supportInstancing       = false;
 
 	_fullScreen = false;
 
@@ -86,6 +94,8 @@ GraphicsManager::GraphicsManager() {
 
 	_projectType = kProjectTypePerspective;
 
+	_frustumCulling.store(true);
+
 	_viewAngle = 60.0f;
 	_clipNear  = 1.0f;
 	_clipFar   = 1000.0f;
@@ -172,6 +182,8 @@ void GraphicsManager::deinit() {
 
 	_needManualDeS3TC        = false;
 	_supportMultipleTextures = false;
+	_supportVertexBuffers    = false;
+	_supportInstancing       = false;
 }
 
 bool GraphicsManager::ready() const {
@@ -186,6 +198,14 @@ bool GraphicsManager::supportMultipleTextures() const {
 	return _supportMultipleTextures;
 }
 
+bool GraphicsManager::supportVertexBuffers() const {
+	return _supportVertexBuffers;
+}
+
+bool GraphicsManager::supportInstancing() const {
+	return _supportInstancing;
+}
+
 int GraphicsManager::getMaxFSAA() const {
 	return _fsaaMax;
 }
@@ -194,6 +214,23 @@ int GraphicsManager::getCurrentFSAA() const {
 	return _fsaa;
 }
 
+GraphicsManager::RenderStats::RenderStats() : tested(0), culled(0), drawn(0), binds(0), draws(0), time(0) {
+}
+
+void GraphicsManager::setFrustumCulling(bool enabled) {
+	_frustumCulling.store(enabled);
+}
+
+bool GraphicsManager::getFrustumCulling() const {
+	return _frustumCulling.load();
+}
+
+GraphicsManager::RenderStats GraphicsManager::getRenderStats() const {
+	Common::StackLock lock(_renderStatsMutex);
+
+	return _renderStats;
+}
+
 uint32 GraphicsManager::getFPS() const {
 	return _fpsCounter->getFPS();
 }
@@ -411,6 +448,23 @@ void GraphicsManager::checkGLExtensions() {
 		_supportMultipleTextures = false;
 	} else
 		_supportMultipleTextures = true;
+
+	if (!GLEW_VERSION_1_5) {
+		warning("Your graphics card does not support vertex buffer objects");
+		warning("Model geometry will be sent from system memory every frame");
+
+		_supportVertexBuffers = false;
+	} else
+		_supportVertexBuffers = ConfigMan.getBool("vertexbuffers", true);
+
+	// Instancing reads the per-instance matrices out of a buffer object in a vertex shader
+	if (!GLEW_VERSION_2_0 || !GLEW_ARB_draw_instanced || !GLEW_ARB_instanced_arrays) {
+		warning("Your graphics card does not support hardware instancing");
+		warning("Repeated models will be drawn one after the other");
+
+		_supportInstancing = false;
+	} else
+		_supportInstancing = _supportVertexBuffers && ConfigMan.getBool("instancing", true);
 }
 
 void GraphicsManager::setWindowTitle(const Common::UString &title) {
@@ -979,8 +1033,12 @@ bool GraphicsManager::playVideo() {
 }
 
 bool GraphicsManager::renderWorld() {
-	if (QueueMan.isQueueEmpty(kQueueVisibleWorldObject))
+	if (QueueMan.isQueueEmpty(kQueueVisibleWorldObject)) {
+		Common::StackLock lock(_renderStatsMutex);
+		_renderStats = RenderStats();
+
 		return false;
+	}
 
 	float cPos[3];
 	float cOrient[3];
@@ -1010,6 +1068,11 @@ bool GraphicsManager::renderWorld() {
 	_modelview.rotate(-cOrient[2], 0.0f, 0.0f, 1.0f);
 	_modelview.translate(-cPos[0], -cPos[1], -cPos[2]);
 
+	const uint64 startTime = Common::getMicroTimestamp();
+
+	// Without culling, an infinite frustum lets everything through
+	const Frustum frustum = _frustumCulling.load() ? Frustum(_projection * _modelview) : Frustum();
+
 	QueueMan.lockQueue(kQueueVisibleWorldObject);
 	const std::list<Queueable *> &objects = QueueMan.getQueue(kQueueVisibleWorldObject);
 
@@ -1024,33 +1087,59 @@ bool GraphicsManager::renderWorld() {
 	float elapsedTime = (now - _lastSampled) / 1000.0f;
 	_lastSampled = now;
 
-	// If game paused, skip the advanceTime loop below
+	RenderStats stats;
 
-	// Advance time for animation queues
+	// Advance time for animation queues and collect the objects within the view frustum
+	_visibleWorld.clear();
 	for (std::list<Queueable *>::const_reverse_iterator o = objects.rbegin();
 	     o != objects.rend(); ++o) {
-		static_cast<Renderable *>(*o)->advanceTime(elapsedTime);
+
+		Renderable *object = static_cast<Renderable *>(*o);
+
+		object->advanceTime(elapsedTime);
+
+		stats.tested++;
+		if (!object->isInFrustum(frustum)) {
+			stats.culled++;
+			continue;
+		}
+
+		_visibleWorld.push_back(object);
 	}
 
-	// Draw opaque objects
-	for (std::list<Queueable *>::const_reverse_iterator o = objects.rbegin();
-	     o != objects.rend(); ++o) {
+	stats.drawn = _visibleWorld.size();
+
+	const uint32 binds = TextureMan.getBindCount();
+	const uint32 draws = VertexBuffer::getDrawCount();
 
+	// Draw opaque objects
+	ModelQueueMan.begin(kRenderPassOpaque);
+	for (std::vector<Renderable *>::iterator o = _visibleWorld.begin(); o != _visibleWorld.end(); ++o) {
 		glPushMatrix();
-		static_cast<Renderable *>(*o)->render(kRenderPassOpaque);
+		(*o)->renderCulled(kRenderPassOpaque, frustum);
 		glPopMatrix();
 	}
+	ModelQueueMan.end();
 
 	// Draw transparent objects
-	for (std::list<Queueable *>::const_reverse_iterator o = objects.rbegin();
-	     o != objects.rend(); ++o) {
-
+	ModelQueueMan.begin(kRenderPassTransparent);
+	for (std::vector<Renderable *>::iterator o = _visibleWorld.begin(); o != _visibleWorld.end(); ++o) {
 		glPushMatrix();
-		static_cast<Renderable *>(*o)->render(kRenderPassTransparent);
+		(*o)->renderCulled(kRenderPassTransparent, frustum);
 		glPopMatrix();
 	}
+	ModelQueueMan.end();
+
+	stats.binds = TextureMan.getBindCount() - binds;
+	stats.draws = VertexBuffer::getDrawCount() - draws;
 
 	QueueMan.unlockQueue(kQueueVisibleWorldObject);
+
+	stats.time = Common::getMicroTimestamp() - startTime;
+
+	Common::StackLock lock(_renderStatsMutex);
+	_renderStats = stats;
+
 	return true;
 }
 
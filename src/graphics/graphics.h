@@ -48,6 +48,18 @@ class Renderable;
 /** The graphics manager. */
 class GraphicsManager : public Common::Singleton<GraphicsManager> {
 public:
+	/** Statistics about the last rendered world frame. */
+	struct RenderStats {
+		uint32 tested; ///< Number of world objects tested against the view frustum.
+		uint32 culled; ///< Number of world objects rejected by the view frustum.
+		uint32 drawn;  ///< Number of world objects drawn.
+		uint32 binds;  ///< Number of textures bound while rendering the world.
+		uint32 draws;  ///< Number of draw calls issued while rendering the world.
+		uint64 time;   ///< Time spent rendering the world, in microseconds.
+
+		RenderStats();
+	};
+
 	GraphicsManager();
 	~GraphicsManager();
 
@@ -63,6 +75,10 @@ public:
 	bool needManualDeS3TC() const;
 	/** Do we have support for multiple textures? */
 	bool supportMultipleTextures() const;
+	/** Should static geometry be kept in GL buffer objects? */
+	bool supportVertexBuffers() const;
+	/** Can repeated geometry be drawn with hardware instancing? */
+	bool supportInstancing() const;
 
 	/** Set the screen size. */
 	void setScreenSize(int width, int height);
@@ -113,6 +129,14 @@ public:
 	/** Enable/Disable face culling. */
 	void setCullFace(bool enabled, GLenum mode = GL_BACK);
 
+	/** Enable/Disable culling world objects against the view frustum. */
+	void setFrustumCulling(bool enabled);
+	/** Are world objects culled against the view frustum? */
+	bool getFrustumCulling() const;
+
+	/** Return statistics about the last rendered world frame. */
+	RenderStats getRenderStats() const;
+
 	/** Change the perspective projection matrix. */
 	void setPerspective(float viewAngle, float clipNear, float clipFar);
 	/** Change the projection matrix to be orthogonal. */
@@ -189,6 +213,8 @@ private:
 	// Extensions
 	bool _needManualDeS3TC;        ///< Do we need to do manual S3TC DXTn decompression?
 	bool _supportMultipleTextures; ///< Do we have support for multiple textures?
+	bool _supportVertexBuffers;    ///< Should static geometry be kept in GL buffer objects?
+	bool _supportInstancing;       ///< Can repeated geometry be drawn with hardware instancing?
 
 	bool _fullScreen; ///< Are we currently in fullscreen mode?
 
@@ -208,6 +234,13 @@ private:
 
 	ProjectType _projectType;
 
+	boost::atomic<bool> _frustumCulling; ///< Cull world objects against the view frustum?
+
+	std::vector<Renderable *> _visibleWorld; ///< World objects that passed the frustum test.
+
+	RenderStats _renderStats;              ///< Statistics about the last rendered world frame.
+	mutable Common::Mutex _renderStatsMutex; ///< A mutex protecting the render statistics.
+
 	float _viewAngle;
 	float _clipNear;
 	float _clipFar;
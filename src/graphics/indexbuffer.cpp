@@ -29,10 +29,12 @@
 
 namespace Graphics {
 
-IndexBuffer::IndexBuffer() : _count(0), _size(0), _type(GL_UNSIGNED_INT), _data(0), _ibo(0), _hint(GL_STATIC_DRAW) {
+IndexBuffer::IndexBuffer() : _count(0), _size(0), _type(GL_UNSIGNED_INT), _data(0), _ibo(0), _hint(GL_STATIC_DRAW),
+	_iboOffset(0), _iboShared(false) {
 }
 
-IndexBuffer::IndexBuffer(const IndexBuffer &other) : _data(0), _ibo(0), _hint(GL_STATIC_DRAW) {
+IndexBuffer::IndexBuffer(const IndexBuffer &other) : _data(0), _ibo(0), _hint(GL_STATIC_DRAW),
+	_iboOffset(0), _iboShared(false) {
 	*this = other;
 }
 
@@ -91,12 +93,19 @@ GLenum IndexBuffer::getType() const {
 	return _type;
 }
 
+uint32 IndexBuffer::getSize() const {
+	return _size;
+}
+
 void IndexBuffer::initGL(GLuint hint) {
 	if (_ibo != 0) {
 		return; // Already initialised.
 	}
 
-	_hint = hint;
+	_hint      = hint;
+	_iboOffset = 0;
+	_iboShared = false;
+
 	if (_count) {
 		glGenBuffers(1, &_ibo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
@@ -106,7 +115,11 @@ void IndexBuffer::initGL(GLuint hint) {
 }
 
 void IndexBuffer::updateGL() {
-	if (_count) {
+	if (_count && _iboShared) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, _iboOffset, _count * _size, _data);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	} else if (_count) {
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count * _size, _data, _hint);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // Return to default buffer. Maybe this isn't required.
@@ -114,14 +127,28 @@ void IndexBuffer::updateGL() {
 }
 
 void IndexBuffer::destroyGL() {
-	if (_ibo != 0) {
+	if ((_ibo != 0) && !_iboShared)
 		glDeleteBuffers(1, &_ibo);
-		_ibo = 0;
-	}
+
+	_ibo       = 0;
+	_iboOffset = 0;
+	_iboShared = false;
+}
+
+void IndexBuffer::setSharedIBO(GLuint ibo, uint32 offset) {
+	destroyGL();
+
+	_ibo       = ibo;
+	_iboOffset = offset;
+	_iboShared = ibo != 0;
 }
 
 GLuint IndexBuffer::getIBO() const {
 	return _ibo;
 }
 
+uint32 IndexBuffer::getIBOOffset() const {
+	return _iboOffset;
+}
+
 } // End of namespace Graphics
@@ -55,6 +55,9 @@ public:
 	/** Get element type. */
 	GLenum getType() const;
 
+	/** Get element size in bytes. */
+	uint32 getSize() const;
+
 	/** Initialise internal buffer object for GL handling. */
 	void initGL(GLuint hint = GL_STATIC_DRAW);
 
@@ -64,7 +67,15 @@ public:
 	/** Clear (destroy) GL resources associated with the buffer. */
 	void destroyGL();
 
+	/** Render from a GL buffer object owned by someone else, holding our data at this byte offset.
+	 *
+	 *  The buffer object is not deleted by destroyGL(), only forgotten.
+	 */
+	void setSharedIBO(GLuint ibo, uint32 offset);
+
 	GLuint getIBO() const;
+	/** Get the offset of our data within the "Index" Buffer Object. */
+	uint32 getIBOOffset() const;
 
 private:
 	uint32 _count; ///< Number of elements in buffer.
@@ -74,6 +85,9 @@ private:
 
 	GLuint _ibo;   ///< "Index" Buffer Object.
 	GLuint _hint;  ///< GL hint for static or dynamic data.
+
+	uint32 _iboOffset; ///< Offset of our data within the "Index" Buffer Object.
+	bool   _iboShared; ///< Is the "Index" Buffer Object owned by someone else?
 };
 
 } // End of namespace Graphics
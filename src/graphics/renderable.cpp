@@ -28,6 +28,8 @@
 #include "src/graphics/renderable.h"
 #include "src/graphics/graphics.h"
 
+#include "src/graphics/aurora/modelqueueman.h"
+
 namespace Graphics {
 
 Renderable::Renderable(RenderableType type) : _clickable(false), _distance(0.0f) {
@@ -74,6 +76,17 @@ bool Renderable::operator<(const Queueable &q) const {
 void Renderable::advanceTime(float UNUSED(dt)) {
 }
 
+bool Renderable::isInFrustum(const Frustum &UNUSED(frustum)) const {
+	return true;
+}
+
+void Renderable::renderCulled(RenderPass pass, const Frustum &UNUSED(frustum)) {
+	// We draw directly, so the queued model nodes behind us need to be drawn first
+	ModelQueueMan.flush();
+
+	render(pass);
+}
+
 double Renderable::getDistance() const {
 	return _distance;
 }
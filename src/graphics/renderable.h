@@ -32,6 +32,8 @@
 
 namespace Graphics {
 
+class Frustum;
+
 /** An object that can be displayed by the graphics manager. */
 class Renderable : public Queueable {
 public:
@@ -49,6 +51,18 @@ public:
 	/** Render the object. */
 	virtual void render(RenderPass pass) = 0;
 
+	/** Is the object at least partially within the view frustum?
+	 *
+	 *  Objects that don't know their extent are always considered visible.
+	 */
+	virtual bool isInFrustum(const Frustum &frustum) const;
+
+	/** Render the object, skipping parts of it outside the view frustum.
+	 *
+	 *  By default, this just renders the whole object.
+	 */
+	virtual void renderCulled(RenderPass pass, const Frustum &frustum);
+
 	/** Get the distance of the object from the viewer. */
 	double getDistance() const;
 
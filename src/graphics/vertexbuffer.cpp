@@ -40,28 +40,32 @@ const GLvoid *VertexAttrib::getData() const {
 }
 
 void VertexAttrib::enable() const {
+	enable(pointer);
+}
+
+void VertexAttrib::enable(const GLvoid *data) const {
 	switch (index) {
 		case VPOSITION:
 			glEnableClientState(GL_VERTEX_ARRAY);
-			glVertexPointer(size, type, stride, pointer);
+			glVertexPointer(size, type, stride, data);
 			break;
 
 		case VNORMAL:
 			assert(size == 3);
 			glEnableClientState(GL_NORMAL_ARRAY);
-			glNormalPointer(type, stride, pointer);
+			glNormalPointer(type, stride, data);
 			break;
 
 		case VCOLOR:
 			glEnableClientState(GL_COLOR_ARRAY);
-			glColorPointer(size, type, stride, pointer);
+			glColorPointer(size, type, stride, data);
 			break;
 
 		default:
 			assert(index >= VTCOORD);
 			glClientActiveTextureARB(GL_TEXTURE0 + index - VTCOORD);
 			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-			glTexCoordPointer(size, type, stride, pointer);
+			glTexCoordPointer(size, type, stride, data);
 			break;
 	}
 }
@@ -89,10 +93,14 @@ void VertexAttrib::disable() const {
 }
 
 
-VertexBuffer::VertexBuffer() : _count(0), _size(0), _data(0), _vbo(0), _hint(GL_STATIC_DRAW) {
+uint32 VertexBuffer::_drawCount = 0;
+
+VertexBuffer::VertexBuffer() : _count(0), _size(0), _data(0), _vbo(0), _hint(GL_STATIC_DRAW),
+	_vboOffset(0), _vboShared(false) {
 }
 
-VertexBuffer::VertexBuffer(const VertexBuffer &other) : _data(0), _vbo(0), _hint(GL_STATIC_DRAW) {
+VertexBuffer::VertexBuffer(const VertexBuffer &other) : _data(0), _vbo(0), _hint(GL_STATIC_DRAW),
+	_vboOffset(0), _vboShared(false) {
 	*this = other;
 }
 
@@ -251,7 +259,10 @@ void VertexBuffer::initGL(GLuint hint) {
 		return; // Already initialised.
 	}
 
-	_hint = hint;
+	_hint      = hint;
+	_vboOffset = 0;
+	_vboShared = false;
+
 	if (_count) {
 		glGenBuffers(1, &_vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
@@ -261,7 +272,11 @@ void VertexBuffer::initGL(GLuint hint) {
 }
 
 void VertexBuffer::updateGL() {
-	if (_count) {
+	if (_count && _vboShared) {
+		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, _vboOffset, _count * _size, _data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	} else if (_count) {
 		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
 		glBufferData(GL_ARRAY_BUFFER, _count * _size, _data, _hint);
 		glBindBuffer(GL_ARRAY_BUFFER, 0); // Return to default buffer. Maybe this isn't required.
@@ -269,27 +284,99 @@ void VertexBuffer::updateGL() {
 }
 
 void VertexBuffer::destroyGL() {
-	if (_vbo != 0) {
+	if ((_vbo != 0) && !_vboShared)
 		glDeleteBuffers(1, &_vbo);
-		_vbo = 0;
-	}
+
+	_vbo       = 0;
+	_vboOffset = 0;
+	_vboShared = false;
+}
+
+void VertexBuffer::setSharedVBO(GLuint vbo, uint32 offset) {
+	destroyGL();
+
+	_vbo       = vbo;
+	_vboOffset = offset;
+	_vboShared = vbo != 0;
 }
 
 GLuint VertexBuffer::getVBO() const {
 	return _vbo;
 }
 
+uint32 VertexBuffer::getVBOOffset() const {
+	return _vboOffset;
+}
+
 void VertexBuffer::draw(GLenum mode, const IndexBuffer &indexBuffer) const {
 	if ((getCount() == 0) || (indexBuffer.getCount() == 0))
 		return;
 
-	for (VertexDecl::const_iterator d = _decl.begin(); d != _decl.end(); ++d)
-		d->enable();
+	enable();
+	drawElements(mode, indexBuffer);
+	disable();
+}
+
+void VertexBuffer::enable() const {
+	if (_vbo != 0) {
+		// Attribute pointers become offsets into the buffer object
+		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+		for (VertexDecl::const_iterator d = _decl.begin(); d != _decl.end(); ++d) {
+			const intptr_t offset = _vboOffset + (reinterpret_cast<const byte *>(d->pointer) - _data);
+
+			d->enable(reinterpret_cast<const GLvoid *>(offset));
+		}
 
-	glDrawElements(mode, indexBuffer.getCount(), indexBuffer.getType(), indexBuffer.getData());
+	} else {
+		for (VertexDecl::const_iterator d = _decl.begin(); d != _decl.end(); ++d)
+			d->enable();
+	}
+}
 
+void VertexBuffer::disable() const {
 	for (VertexDecl::const_iterator d = _decl.begin(); d != _decl.end(); ++d)
 		d->disable();
+
+	// Client-side arrays only work without a bound buffer object
+	if (_vbo != 0)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexBuffer::drawElements(GLenum mode, const IndexBuffer &indexBuffer) {
+	const GLuint ibo = indexBuffer.getIBO();
+	if (ibo != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+		glDrawElements(mode, indexBuffer.getCount(), indexBuffer.getType(),
+		               reinterpret_cast<const GLvoid *>((intptr_t) indexBuffer.getIBOOffset()));
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	} else
+		glDrawElements(mode, indexBuffer.getCount(), indexBuffer.getType(), indexBuffer.getData());
+
+	_drawCount++;
+}
+
+void VertexBuffer::drawElementsInstanced(GLenum mode, const IndexBuffer &indexBuffer, uint32 instanceCount) {
+	const GLuint ibo = indexBuffer.getIBO();
+	if (ibo != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+		glDrawElementsInstancedARB(mode, indexBuffer.getCount(), indexBuffer.getType(),
+		                           reinterpret_cast<const GLvoid *>((intptr_t) indexBuffer.getIBOOffset()),
+		                           instanceCount);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	} else
+		glDrawElementsInstancedARB(mode, indexBuffer.getCount(), indexBuffer.getType(), indexBuffer.getData(),
+		                           instanceCount);
+
+	_drawCount++;
+}
+
+uint32 VertexBuffer::getDrawCount() {
+	return _drawCount;
 }
 
 } // End of namespace Graphics
@@ -56,6 +56,8 @@ struct VertexAttrib {
 
 	// Render methods
 	void enable() const;
+	/** Enable the attribute, reading from this address or buffer object offset instead. */
+	void enable(const GLvoid *data) const;
 	void disable() const;
 };
 
@@ -124,13 +126,34 @@ public:
 	/** Clear (destroy) GL resources associated with the buffer. */
 	void destroyGL();
 
+	/** Render from a GL buffer object owned by someone else, holding our data at this byte offset.
+	 *
+	 *  The buffer object is not deleted by destroyGL(), only forgotten.
+	 */
+	void setSharedVBO(GLuint vbo, uint32 offset);
+
 	GLuint getVBO() const;
+	/** Get the offset of our data within the Vertex Buffer Object. */
+	uint32 getVBOOffset() const;
 
 	// Render method
 
 	/** Draw this IndexBuffer/VertexBuffer combination. */
 	void draw(GLenum mode, const IndexBuffer &indexBuffer) const;
 
+	/** Enable our vertex arrays, to draw several index buffers out of them. */
+	void enable() const;
+	/** Disable our vertex arrays again. */
+	void disable() const;
+
+	/** Draw this IndexBuffer out of the currently enabled vertex arrays. */
+	static void drawElements(GLenum mode, const IndexBuffer &indexBuffer);
+	/** Draw this IndexBuffer instanceCount times, out of the currently enabled vertex arrays. */
+	static void drawElementsInstanced(GLenum mode, const IndexBuffer &indexBuffer, uint32 instanceCount);
+
+	/** Return the number of draw calls issued so far. */
+	static uint32 getDrawCount();
+
 private:
 	VertexDecl _decl; ///< Vertex declaration.
 	uint32 _count;    ///< Number of elements in buffer.
@@ -140,6 +163,11 @@ private:
 	GLuint _vbo;      ///< Vertex Buffer Object.
 	GLuint _hint;     ///< GL hint for static or dynamic data.
 
+	uint32 _vboOffset; ///< Offset of our data within the Vertex Buffer Object.
+	bool   _vboShared; ///< Is the Vertex Buffer Object owned by someone else?
+
+	static uint32 _drawCount; ///< Number of draw calls issued so far.
+
 	static uint32 getTypeSize(GLenum type);
 };
 
@@ -0,0 +1,119 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A lock-free ring of preallocated PCM blocks.
+ */
+
+#include "src/common/atomic.h"
+
+#include <cassert>
+
+#include "src/sound/ringbuffer.h"
+
+namespace Sound {
+
+RingBuffer::RingBuffer(size_t blockCount, size_t blockSamples) :
+	_blockCount(blockCount), _blockSamples(blockSamples), _data(0), _samples(blockCount, 0),
+	_readCount(0), _writeCount(0), _finished(false) {
+
+	assert((_blockCount > 0) && (_blockSamples > 0));
+
+	_data = new int16[_blockCount * _blockSamples];
+}
+
+RingBuffer::~RingBuffer() {
+	delete[] _data;
+}
+
+size_t RingBuffer::getBlockCount() const {
+	return _blockCount;
+}
+
+size_t RingBuffer::getBlockSamples() const {
+	return _blockSamples;
+}
+
+size_t RingBuffer::getFilledCount() const {
+	const size_t readCount  = _readCount.load(boost::memory_order_acquire);
+	const size_t writeCount = _writeCount.load(boost::memory_order_acquire);
+
+	return writeCount - readCount;
+}
+
+bool RingBuffer::isEmpty() const {
+	return getFilledCount() == 0;
+}
+
+bool RingBuffer::isFull() const {
+	return getFilledCount() >= _blockCount;
+}
+
+bool RingBuffer::isFinished() const {
+	return _finished.load(boost::memory_order_acquire);
+}
+
+void RingBuffer::clear() {
+	_readCount.store(_writeCount.load(boost::memory_order_acquire), boost::memory_order_release);
+}
+
+int16 *RingBuffer::getWriteBlock() {
+	const size_t writeCount = _writeCount.load(boost::memory_order_relaxed);
+
+	// Acquire, so that the consumer is really done with the block we're about to overwrite
+	if ((writeCount - _readCount.load(boost::memory_order_acquire)) >= _blockCount)
+		return 0;
+
+	return _data + (writeCount % _blockCount) * _blockSamples;
+}
+
+void RingBuffer::commitWrite(size_t samples) {
+	assert(samples <= _blockSamples);
+
+	const size_t writeCount = _writeCount.load(boost::memory_order_relaxed);
+
+	_samples[writeCount % _blockCount] = samples;
+
+	// Release, so that the consumer sees the block contents once it sees the new count
+	_writeCount.store(writeCount + 1, boost::memory_order_release);
+}
+
+void RingBuffer::setFinished(bool finished) {
+	_finished.store(finished, boost::memory_order_release);
+}
+
+const int16 *RingBuffer::getReadBlock(size_t &samples) const {
+	const size_t readCount = _readCount.load(boost::memory_order_relaxed);
+
+	if (readCount == _writeCount.load(boost::memory_order_acquire))
+		return 0;
+
+	samples = _samples[readCount % _blockCount];
+
+	return _data + (readCount % _blockCount) * _blockSamples;
+}
+
+void RingBuffer::commitRead() {
+	const size_t readCount = _readCount.load(boost::memory_order_relaxed);
+
+	_readCount.store(readCount + 1, boost::memory_order_release);
+}
+
+} // End of namespace Sound
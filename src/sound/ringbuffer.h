@@ -0,0 +1,115 @@
+/* xoreos - A reimplementation of BioWare's Aurora engine
+ *
+ * xoreos is the legal property of its developers, whose names
+ * can be found in the AUTHORS file distributed with this source
+ * distribution.
+ *
+ * xoreos is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * xoreos is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with xoreos. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ *  A lock-free ring of preallocated PCM blocks.
+ */
+
+#ifndef SOUND_RINGBUFFER_H
+#define SOUND_RINGBUFFER_H
+
+#include "src/common/atomic.h"
+
+#include <vector>
+
+#include "src/common/types.h"
+#include "src/common/noncopyable.h"
+
+namespace Sound {
+
+/** A lock-free ring of preallocated blocks of 16-bit PCM samples.
+ *
+ *  The ring buffer sits between exactly one producer, which decodes audio
+ *  into the blocks, and exactly one consumer, which hands the decoded blocks
+ *  on to the sound output. Both sides can run in different threads without
+ *  any further locking. All memory is allocated up front, so neither side
+ *  allocates anything while streaming.
+ *
+ *  The producer calls getWriteBlock() to get an empty block, fills it and
+ *  then publishes it with commitWrite(). The consumer calls getReadBlock()
+ *  to get the oldest filled block, and gives it back with commitRead().
+ *  Once there is no more data to come, the producer marks the ring as
+ *  finished.
+ */
+class RingBuffer : Common::NonCopyable {
+public:
+	/** Create a ring buffer of blockCount blocks of blockSamples samples each. */
+	RingBuffer(size_t blockCount, size_t blockSamples);
+	~RingBuffer();
+
+	/** Return the number of blocks in the ring. */
+	size_t getBlockCount() const;
+	/** Return the number of samples each block can hold. */
+	size_t getBlockSamples() const;
+
+	/** Return the number of blocks currently filled with data. */
+	size_t getFilledCount() const;
+
+	/** Are there no filled blocks in the ring? */
+	bool isEmpty() const;
+	/** Are all blocks in the ring filled? */
+	bool isFull() const;
+
+	/** Has the producer finished writing all blocks it will ever write? */
+	bool isFinished() const;
+
+	/** Throw away all filled blocks.
+	 *
+	 *  Must not be called while either the producer or consumer is active.
+	 */
+	void clear();
+
+	// .--- Producer
+	/** Return the next empty block, or 0 if the ring is full. */
+	int16 *getWriteBlock();
+	/** Publish the block returned by getWriteBlock(), now filled with this many samples. */
+	void commitWrite(size_t samples);
+	/** Mark whether there is no more data to come. */
+	void setFinished(bool finished);
+	// '---
+
+	// .--- Consumer
+	/** Return the oldest filled block and its number of samples, or 0 if the ring is empty. */
+	const int16 *getReadBlock(size_t &samples) const;
+	/** Give back the block returned by getReadBlock(). */
+	void commitRead();
+	// '---
+
+private:
+	size_t _blockCount;
+	size_t _blockSamples;
+
+	/** The samples of all blocks. */
+	int16 *_data;
+	/** The number of samples in each block. */
+	std::vector<size_t> _samples;
+
+	/** Number of blocks ever read. Only modified by the consumer. */
+	boost::atomic<size_t> _readCount;
+	/** Number of blocks ever written. Only modified by the producer. */
+	boost::atomic<size_t> _writeCount;
+
+	/** No more blocks will be written. Only modified by the producer. */
+	boost::atomic<bool> _finished;
+};
+
+} // End of namespace Sound
+
+#endif // SOUND_RINGBUFFER_H
@@ -22,32 +22,33 @@
  *  The global sound manager, handling all sound output.
  */
 
+#include "src/common/atomic.h"
+
 #include <cassert>
 #include <cstring>
 
 #include "src/sound/sound.h"
 #include "src/sound/audiostream.h"
+#include "src/sound/ringbuffer.h"
 #include "src/sound/decoders/asf.h"
 #include "src/sound/decoders/mp3.h"
 #include "src/sound/decoders/vorbis.h"
 #include "src/sound/decoders/wave.h"
+#include "src/sound/decoders/pcm.h"
 
 #include "src/common/readstream.h"
+#include "src/common/sharedmemreadstream.h"
+#include "src/common/endianness.h"
 #include "src/common/util.h"
 #include "src/common/strutil.h"
 #include "src/common/error.h"
 #include "src/common/configman.h"
+#include "src/common/timestamp.h"
 
 #include "src/events/events.h"
 
 DECLARE_SINGLETON(Sound::SoundManager)
 
-/** Control how many buffers per sound OpenAL will create.
- *
- *  @note clone2727 says: 5 is just a safe number. Mine only reached a max of 2.
- */
-static const size_t kOpenALBufferCount = 5;
-
 /** Number of bytes per OpenAL buffer.
  *
  *  @note Needs to be high enough to prevent stuttering, but low enough to
@@ -55,15 +56,82 @@ static const size_t kOpenALBufferCount = 5;
  */
 static const size_t kOpenALBufferSize = 32768;
 
+/** Minimum number of blocks of kOpenALBufferSize bytes each channel can decode ahead. */
+static const size_t kMinRingBlockCount = 2;
+/** Number of blocks decoded right away when a new sound is played. */
+static const size_t kInitialDecodeBlocks = 2;
+
+/** Default milliseconds of sound to decode ahead of the playback position. */
+static const int kDefaultLookahead = 1000;
+/** Default number of decode worker threads. */
+static const int kDefaultDecodeWorkers = 2;
+
+/** Time in milliseconds an idle decode worker waits for a channel before checking if it should quit. */
+static const uint32 kDecodeIdleTimeout = 100;
+
+/** Default size of the sound cache, in MB. */
+static const int kDefaultSoundCacheSize = 16;
+/** Maximum size of the decoded data of a sound to be put into the sound cache, in bytes. */
+static const size_t kMaxCachedSoundSize = 1024 * 1024;
+/** Number of samples decoded in one go when decoding a sound for the cache. */
+static const size_t kCacheDecodeSamples = 4096;
+
 namespace Sound {
 
-SoundManager::SoundManager() : _ready(false), _hasSound(false), _hasMultiChannel(false), _format51(0) {
+SoundManager::UpdateStats::UpdateStats() : updates(0), time(0), maxTime(0), underruns(0),
+	activeChannels(0) {
+}
+
+SoundManager::CacheStats::CacheStats() : hits(0), misses(0), evictions(0), invalidations(0),
+	entries(0), size(0), budget(0) {
+}
+
+
+class SoundManager::DecodeWorker : public Common::Thread {
+public:
+	DecodeWorker(SoundManager &sound) : _sound(&sound) {
+	}
+
+	~DecodeWorker() {
+		destroyThread();
+	}
+
+private:
+	SoundManager *_sound;
+
+	void threadMethod() {
+		while (!_killThread) {
+			Channel *channel = _sound->takeDecode(kDecodeIdleTimeout);
+			if (channel)
+				_sound->runDecode(*channel);
+		}
+	}
+};
+
+
+SoundManager::SoundManager() : _ready(false), _hasSound(false), _hasMultiChannel(false), _format51(0),
+	_lookahead(0), _decodeQueueHead(0), _decodeRequest(_decodeMutex), _decodeDone(_decodeMutex) {
 }
 
 void SoundManager::init() {
 	for (size_t i = 0; i < kChannelCount; i++)
 		_channels[i] = 0;
 
+	// Hand out the lowest channels first
+	_freeChannels.resize(kChannelCount);
+	for (size_t i = 0; i < kChannelCount; i++)
+		_freeChannels[i] = kChannelCount - 1 - i;
+
+	_activeChannels.clear();
+	_updateStats = UpdateStats();
+
+	_decodeQueue.clear();
+	_decodeQueueHead = 0;
+
+	_lookahead = MAX(ConfigMan.getInt("soundlookahead", kDefaultLookahead), 0);
+
+	setSoundCacheSize((size_t) MAX(ConfigMan.getInt("soundcache", kDefaultSoundCacheSize), 0) * 1024 * 1024);
+
 	for (size_t i = 0; i < kSoundTypeMAX; i++)
 		_types[i].gain = 1.0f;
 
@@ -77,9 +145,11 @@ void SoundManager::init() {
 	_format51        = 0;
 
 	try {
-		_dev = alcOpenDevice(0);
+		const Common::UString device = ConfigMan.getString("sounddevice");
+
+		_dev = alcOpenDevice(device.empty() ? 0 : device.c_str());
 		if (!_dev)
-			throw Common::Exception("Could not open OpenAL device");
+			throw Common::Exception("Could not open OpenAL device \"%s\"", device.c_str());
 
 		_ctx = alcCreateContext(_dev, 0);
 		if (!_ctx)
@@ -94,6 +164,8 @@ void SoundManager::init() {
 		_hasMultiChannel = alIsExtensionPresent("AL_EXT_MCFORMATS") != 0;
 		_format51        = alGetEnumValue("AL_FORMAT_51CHN16");
 
+		startDecodeWorkers(MAX(ConfigMan.getInt("sounddecoders", kDefaultDecodeWorkers), 0));
+
 		if (!createThread())
 			throw Common::Exception("Failed to create sound thread: %s", SDL_GetError());
 
@@ -123,8 +195,12 @@ void SoundManager::deinit() {
 	if (!destroyThread())
 		warning("SoundManager::deinit(): Sound thread had to be killed");
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		freeChannel(i);
+	stopDecodeWorkers();
+
+	while (!_activeChannels.empty())
+		freeChannel(_activeChannels.front()->index);
+
+	clearSoundCache();
 
 	if (_hasSound) {
 		alcMakeContextCurrent(0);
@@ -167,7 +243,7 @@ bool SoundManager::isPlaying(const ChannelHandle &handle) {
 	return isPlaying(handle.channel);
 }
 
-bool SoundManager::isPlaying(size_t channel) const {
+bool SoundManager::isPlaying(size_t channel) {
 	if ((channel >= kChannelCount) || !_channels[channel])
 		return false;
 
@@ -186,7 +262,7 @@ bool SoundManager::isPlaying(size_t channel) const {
 		throw Common::Exception("OpenAL error while getting source state: %X", error);
 
 	if (val != AL_PLAYING) {
-		if (!_channels[channel]->stream || _channels[channel]->stream->endOfStream()) {
+		if (_channels[channel]->ring->isFinished() && _channels[channel]->ring->isEmpty()) {
 			ALint buffersQueued;
 			alGetSourcei(_channels[channel]->source, AL_BUFFERS_QUEUED, &buffersQueued);
 			if ((error = alGetError()) != AL_NO_ERROR)
@@ -204,6 +280,12 @@ bool SoundManager::isPlaying(size_t channel) const {
 		if (_channels[channel]->state != AL_PLAYING)
 			return true;
 
+		// The source stopped by itself, even though there's more sound to come
+		if (val == AL_STOPPED) {
+			_channels[channel]->underruns++;
+			_updateStats.underruns++;
+		}
+
 		alSourcePlay(_channels[channel]->source);
 	}
 
@@ -304,22 +386,48 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 	Channel &channel = *_channels[handle.channel];
 
 	channel.id              = handle.id;
+	channel.index           = handle.channel;
 	channel.state           = AL_PAUSED;
 	channel.stream          = audStream;
+	channel.format          = AL_NONE;
+	channel.rate            = 0;
 	channel.source          = 0;
+	channel.freeBufferCount = 0;
+	channel.ring            = 0;
+	channel.decodeQueued    = false;
+	channel.decoding        = false;
+	channel.underruns       = 0;
 	channel.disposeAfterUse = disposeAfterUse;
 	channel.type            = type;
 	channel.typeIt          = _types[channel.type].list.end();
 	channel.gain            = 1.0f;
 
+	std::memset(channel.buffers, 0, sizeof(channel.buffers));
+
+	// Add the channel to the list of active channels
+	_activeChannels.push_back(&channel);
+	channel.activeIt = --_activeChannels.end();
+
 	try {
 
 		if (!channel.stream)
 			throw Common::Exception("Could not detect stream type");
 
+		// Make the ring buffer large enough to hold the lookahead
+		const size_t blockSamples = kOpenALBufferSize / 2;
+		const uint64 lookahead    = ((uint64) _lookahead * channel.stream->getRate() *
+		                             channel.stream->getChannels()) / 1000;
+
+		const size_t blockCount = MAX<size_t>((lookahead + blockSamples - 1) / blockSamples, kMinRingBlockCount);
+
+		channel.ring = new RingBuffer(blockCount, blockSamples);
+
 		ALenum error = AL_NO_ERROR;
 
 		if (_hasSound) {
+			channel.format = getFormat(*channel.stream);
+			channel.rate   = channel.stream->getRate();
+
 			// Create the source
 			alGenSources(1, &channel.source);
 			if ((error = alGetError()) != AL_NO_ERROR)
@@ -327,26 +435,17 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 
 			// Create all needed buffers
 			for (size_t i = 0; i < kOpenALBufferCount; i++) {
-				ALuint buffer;
-
-				alGenBuffers(1, &buffer);
+				alGenBuffers(1, &channel.buffers[i]);
 				if ((error = alGetError()) != AL_NO_ERROR)
 					throw Common::Exception("OpenAL error while generating buffers: %X", error);
 
-				if (fillBuffer(buffer, channel.stream)) {
-					// If we could fill the buffer with data, queue it
-
-					alSourceQueueBuffers(channel.source, 1, &buffer);
-					if ((error = alGetError()) != AL_NO_ERROR)
-						throw Common::Exception("OpenAL error while queueing buffers: %X", error);
-
-				} else
-					// If not, put it into our free list
-					channel.freeBuffers.push_back(buffer);
-
-				channel.buffers.push_back(buffer);
+				channel.freeBuffers[channel.freeBufferCount++] = channel.buffers[i];
 			}
 
+			// Decode the start of the sound and queue it. The rest is decoded in the background
+			decodeData(channel, kInitialDecodeBlocks);
+			bufferData(channel);
+
 			// Set the gain to the current sound type gain
 			alSourcef(channel.source, AL_GAIN, _types[channel.type].gain);
 		}
@@ -366,11 +465,83 @@ ChannelHandle SoundManager::playAudioStream(AudioStream *audStream, SoundType ty
 ChannelHandle SoundManager::playSoundFile(Common::SeekableReadStream *wavStream, SoundType type, bool loop) {
 	checkReady();
 
+	if (!wavStream)
+		throw Common::Exception("No stream");
+
+	return playSoundStream(makeAudioStream(wavStream), type, loop);
+}
+
+ChannelHandle SoundManager::playSoundFile(const Common::UString &name, uint64 changeID,
+                                          Common::SeekableReadStream *wavStream, SoundType type, bool loop) {
+	checkReady();
+
 	if (!wavStream)
 		throw Common::Exception("No stream");
 
 	AudioStream *audioStream = makeAudioStream(wavStream);
 
+	RewindableAudioStream *reAudStream = dynamic_cast<RewindableAudioStream *>(audioStream);
+	if (!reAudStream || (getCacheStats().budget == 0))
+		return playSoundStream(audioStream, type, loop);
+
+	// Try to decode the whole sound
+	CachedSound sound;
+	try {
+		if (!decodeSound(*reAudStream, sound))
+			return playSoundStream(audioStream, type, loop);
+	} catch (...) {
+		delete audioStream;
+		throw;
+	}
+
+	delete audioStream;
+
+	sound.name     = name;
+	sound.changeID = changeID;
+	cacheSound(sound);
+
+	return playAudioStream(makeCachedStream(sound, loop), type);
+}
+
+ChannelHandle SoundManager::playCachedSound(const Common::UString &name, uint64 changeID,
+                                            SoundType type, bool loop) {
+	checkReady();
+
+	CachedSound sound;
+
+	{
+		Common::StackLock lock(_mutex);
+
+		if (_cacheStats.budget == 0)
+			return ChannelHandle();
+
+		SoundCacheMap::iterator c = _soundCacheMap.find(name);
+		if (c == _soundCacheMap.end()) {
+			_cacheStats.misses++;
+			return ChannelHandle();
+		}
+
+		// The data the sound was decoded from has changed since
+		if (c->second->changeID != changeID) {
+			uncacheSound(c);
+
+			_cacheStats.invalidations++;
+			_cacheStats.misses++;
+			return ChannelHandle();
+		}
+
+		// Move it to the front, as the most recently played
+		_soundCache.splice(_soundCache.begin(), _soundCache, c->second);
+
+		_cacheStats.hits++;
+
+		sound = *c->second;
+	}
+
+	return playAudioStream(makeCachedStream(sound, loop), type);
+}
+
+ChannelHandle SoundManager::playSoundStream(AudioStream *audioStream, SoundType type, bool loop) {
 	if (loop) {
 		RewindableAudioStream *reAudStream = dynamic_cast<RewindableAudioStream *>(audioStream);
 		if (!reAudStream)
@@ -382,6 +553,137 @@ ChannelHandle SoundManager::playSoundFile(Common::SeekableReadStream *wavStream,
 	return playAudioStream(audioStream, type);
 }
 
+bool SoundManager::decodeSound(RewindableAudioStream &stream, CachedSound &sound) {
+	// Only even try if the sound claims to be short
+	const uint64 length = stream.getLength();
+	if ((length == RewindableAudioStream::kInvalidLength) ||
+	    ((length * stream.getChannels() * 2) > kMaxCachedSoundSize))
+		return false;
+
+	const size_t maxSamples = kMaxCachedSoundSize / 2;
+
+	std::vector<int16> samples;
+	samples.reserve((size_t) length * stream.getChannels());
+
+	size_t count = 0;
+	while (!stream.endOfData()) {
+		// The length was just an estimate, and the sound is longer after all
+		if (count >= maxSamples) {
+			if (!stream.rewind())
+				throw Common::Exception("Failed to rewind sound stream");
+
+			return false;
+		}
+
+		samples.resize(count + kCacheDecodeSamples);
+
+		const size_t read = stream.readBuffer(&samples[count], kCacheDecodeSamples);
+		if (read == AudioStream::kSizeInvalid)
+			throw Common::Exception("Failed reading from sound stream");
+
+		if (read == 0)
+			break;
+
+		count += read;
+	}
+
+	byte *data = new byte[MAX<size_t>(count, 1) * 2];
+	for (size_t i = 0; i < count; i++)
+		WRITE_LE_UINT16(data + i * 2, (uint16) samples[i]);
+
+	sound.data     = boost::shared_array<const byte>(data);
+	sound.size     = count * 2;
+	sound.rate     = stream.getRate();
+	sound.channels = stream.getChannels();
+
+	return true;
+}
+
+AudioStream *SoundManager::makeCachedStream(const CachedSound &sound, bool loop) {
+	RewindableAudioStream *pcm =
+		makePCMStream(new Common::SharedMemoryReadStream(sound.data, sound.size), sound.rate,
+		              FLAG_16BITS | FLAG_LITTLE_ENDIAN, sound.channels);
+
+	if (loop)
+		return makeLoopingAudioStream(pcm, 0);
+
+	return pcm;
+}
+
+void SoundManager::setSoundCacheSize(size_t size) {
+	Common::StackLock lock(_mutex);
+
+	_cacheStats.budget = size;
+
+	trimSoundCache();
+}
+
+SoundManager::CacheStats SoundManager::getCacheStats() {
+	Common::StackLock lock(_mutex);
+
+	return _cacheStats;
+}
+
+void SoundManager::cacheSound(const CachedSound &sound) {
+	Common::StackLock lock(_mutex);
+
+	// Don't bother caching sounds that would push everything else out
+	if (sound.size > _cacheStats.budget)
+		return;
+
+	SoundCacheMap::iterator c = _soundCacheMap.find(sound.name);
+	if (c != _soundCacheMap.end()) {
+		if (c->second->changeID == sound.changeID)
+			return;
+
+		// Replace the out-of-date sound
+		uncacheSound(c);
+
+		_cacheStats.invalidations++;
+	}
+
+	_soundCache.push_front(sound);
+	_soundCacheMap[sound.name] = _soundCache.begin();
+
+	_cacheStats.entries++;
+	_cacheStats.size += sound.size;
+
+	trimSoundCache();
+}
+
+void SoundManager::uncacheSound(SoundCacheMap::iterator sound) {
+	_cacheStats.entries--;
+	_cacheStats.size -= sound->second->size;
+
+	_soundCache.erase(sound->second);
+	_soundCacheMap.erase(sound);
+}
+
+void SoundManager::clearSoundCache() {
+	Common::StackLock lock(_mutex);
+
+	_soundCache.clear();
+	_soundCacheMap.clear();
+
+	// Reset the statistics, but keep the budget
+	const size_t budget = _cacheStats.budget;
+
+	_cacheStats = CacheStats();
+	_cacheStats.budget = budget;
+}
+
+void SoundManager::trimSoundCache() {
+	// Drop the least recently played sounds until we're within budget again
+	while (!_soundCache.empty() && (_cacheStats.size > _cacheStats.budget)) {
+		_cacheStats.entries--;
+		_cacheStats.size -= _soundCache.back().size;
+		_cacheStats.evictions++;
+
+		_soundCacheMap.erase(_soundCache.back().name);
+		_soundCache.pop_back();
+	}
+}
+
 SoundManager::Channel *SoundManager::getChannel(const ChannelHandle &handle) {
 	if ((handle.channel >= kChannelCount) || (handle.id == 0))
 		return 0;
@@ -426,15 +728,15 @@ void SoundManager::stopChannel(ChannelHandle &handle) {
 void SoundManager::pauseAll(bool pause) {
 	Common::StackLock lock(_mutex);
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		pauseChannel(_channels[i], pause);
+	for (ChannelList::iterator c = _activeChannels.begin(); c != _activeChannels.end(); ++c)
+		pauseChannel(*c, pause);
 }
 
 void SoundManager::stopAll() {
 	Common::StackLock lock(_mutex);
 
-	for (size_t i = 0; i < kChannelCount; i++)
-		freeChannel(i);
+	while (!_activeChannels.empty())
+		freeChannel(_activeChannels.front()->index);
 }
 
 void SoundManager::setListenerGain(float gain) {
@@ -498,6 +800,16 @@ void SoundManager::setChannelPitch(const ChannelHandle &handle, float pitch) {
 		alSourcef(channel->source, AL_PITCH, pitch);
 }
 
+uint32 SoundManager::getChannelUnderruns(const ChannelHandle &handle) {
+	Common::StackLock lock(_mutex);
+
+	Channel *channel = getChannel(handle);
+	if (!channel || !channel->stream)
+		throw Common::Exception("Invalid channel");
+
+	return channel->underruns;
+}
+
 void SoundManager::setTypeGain(SoundType type, float gain) {
 	assert((type >= 0) && (type < kSoundTypeMAX));
 
@@ -507,7 +819,7 @@ void SoundManager::setTypeGain(SoundType type, float gain) {
 	_types[type].gain = gain;
 
 	// Update all currently playing channels of that type
-	for (TypeList::iterator t = _types[type].list.begin(); t != _types[type].list.end(); ++t) {
+	for (ChannelList::iterator t = _types[type].list.begin(); t != _types[type].list.end(); ++t) {
 		assert(*t);
 
 		if (_hasSound)
@@ -515,75 +827,76 @@ void SoundManager::setTypeGain(SoundType type, float gain) {
 	}
 }
 
-bool SoundManager::fillBuffer(ALuint alBuffer, AudioStream *stream) const {
-	if (!stream)
-		throw Common::Exception("No stream");
+SoundManager::UpdateStats SoundManager::getUpdateStats() {
+	Common::StackLock lock(_mutex);
 
-	if (!_hasSound)
-		return true;
+	UpdateStats stats = _updateStats;
+	stats.activeChannels = _activeChannels.size();
 
-	if (stream->endOfData())
-		return false;
+	return stats;
+}
 
-	ALenum format;
+void SoundManager::resetUpdateStats() {
+	Common::StackLock lock(_mutex);
 
-	const int channelCount = stream->getChannels();
-	if        (channelCount == 1) {
-		format = AL_FORMAT_MONO16;
-	} else if (channelCount == 2) {
-		format = AL_FORMAT_STEREO16;
-	} else if (channelCount == 6) {
+	_updateStats = UpdateStats();
+}
+
+ALenum SoundManager::getFormat(const AudioStream &stream) const {
+	const int channelCount = stream.getChannels();
+	if (channelCount == 1)
+		return AL_FORMAT_MONO16;
+
+	if (channelCount == 2)
+		return AL_FORMAT_STEREO16;
+
+	if (channelCount == 6) {
 		if (!_hasMultiChannel) {
-			warning("SoundManager::fillBuffer(): TODO: !_hasMultiChannel");
-			return false;
+			warning("SoundManager::getFormat(): TODO: !_hasMultiChannel");
+			return AL_NONE;
 		}
 
-		format = _format51;
-
-	} else {
-		warning("SoundManager::fillBuffer(): Unsupported channel count %d", channelCount);
-		return false;
+		return _format51;
 	}
 
-	// Read in the required amount of samples
-	size_t numSamples = kOpenALBufferSize / 2;
-
-	byte *buffer = new byte[kOpenALBufferSize];
-	memset(buffer, 0, kOpenALBufferSize);
+	warning("SoundManager::getFormat(): Unsupported channel count %d", channelCount);
+	return AL_NONE;
+}
 
-	numSamples = stream->readBuffer(reinterpret_cast<int16 *>(buffer), numSamples);
-	if (numSamples == AudioStream::kSizeInvalid) {
-		delete[] buffer;
+void SoundManager::decodeData(Channel &channel, size_t maxBlocks) {
+	if (!channel.stream || !_hasSound)
+		return;
 
-		warning("Failed reading from stream while filling buffer");
-		return false;
+	// We can't play this sound, so there's nothing to wait for
+	if (channel.format == AL_NONE) {
+		channel.ring->setFinished(true);
+		return;
 	}
 
-	const ALsizei bufferSize = (ALsizei) (numSamples * 2);
-	alBufferData(alBuffer, format, buffer, bufferSize, stream->getRate());
+	// Decode as long as we still have data and empty blocks
+	int16 *block;
+	for (size_t i = 0; i < maxBlocks; i++) {
+		if (channel.stream->endOfData() || !(block = channel.ring->getWriteBlock()))
+			break;
 
-	delete[] buffer;
+		const size_t samples = channel.stream->readBuffer(block, channel.ring->getBlockSamples());
+		if (samples == AudioStream::kSizeInvalid) {
+			warning("Failed reading from stream while filling buffer");
 
-	ALenum error = alGetError();
-	if (error != AL_NO_ERROR) {
-		warning("OpenAL error while filling buffer: 0x%X", error);
-		return false;
-	}
+			channel.ring->setFinished(true);
+			return;
+		}
 
-	return true;
-}
+		if (samples == 0)
+			break;
 
-void SoundManager::bufferData(size_t channel) {
-	if ((channel >= kChannelCount) || !_channels[channel])
-		return;
+		channel.ring->commitWrite(samples);
+	}
 
-	bufferData(*_channels[channel]);
+	channel.ring->setFinished(channel.stream->endOfStream());
 }
 
 void SoundManager::bufferData(Channel &channel) {
-	if (!channel.stream || channel.stream->endOfData())
-		return;
-
 	if (!_hasSound)
 		return;
 
@@ -597,33 +910,153 @@ void SoundManager::bufferData(Channel &channel) {
 
 	assert(buffersProcessed >= 0);
 
-	if ((size_t)buffersProcessed > kOpenALBufferCount)
+	if (((size_t)buffersProcessed + channel.freeBufferCount) > kOpenALBufferCount)
 		throw Common::Exception("Got more processed buffers than total source buffers?!?");
 
-	// Unqueue the processed buffers
-	ALuint freeBuffers[kOpenALBufferCount];
-	alSourceUnqueueBuffers(channel.source, buffersProcessed, freeBuffers);
-	if ((error = alGetError()) != AL_NO_ERROR)
-		throw Common::Exception("OpenAL error while unqueueing buffers: %X", error);
+	// Unqueue the processed buffers and put them into the free buffers list
+	if (buffersProcessed > 0) {
+		alSourceUnqueueBuffers(channel.source, buffersProcessed, channel.freeBuffers + channel.freeBufferCount);
+		if ((error = alGetError()) != AL_NO_ERROR)
+			throw Common::Exception("OpenAL error while unqueueing buffers: %X", error);
 
-	// Put them into the free buffers list
-	for (size_t i = 0; i < (size_t)buffersProcessed; i++)
-		channel.freeBuffers.push_back(freeBuffers[i]);
+		channel.freeBufferCount += buffersProcessed;
+	}
 
-	// Buffer as long as we still have data and free buffers
-	std::list<ALuint>::iterator buffer = channel.freeBuffers.begin();
-	while (buffer != channel.freeBuffers.end()) {
-		if (!fillBuffer(*buffer, channel.stream))
+	// Buffer as long as we still have decoded data and free buffers
+	const int16 *block;
+	size_t samples;
+	while ((channel.freeBufferCount > 0) && ((block = channel.ring->getReadBlock(samples)) != 0)) {
+		ALuint buffer = channel.freeBuffers[channel.freeBufferCount - 1];
+
+		alBufferData(buffer, channel.format, block, (ALsizei) (samples * 2), channel.rate);
+		if ((error = alGetError()) != AL_NO_ERROR) {
+			warning("OpenAL error while filling buffer: 0x%X", error);
 			break;
+		}
+
+		channel.ring->commitRead();
 
-		alSourceQueueBuffers(channel.source, 1, &*buffer);
+		alSourceQueueBuffers(channel.source, 1, &buffer);
 		if ((error = alGetError()) != AL_NO_ERROR)
 			throw Common::Exception("OpenAL error while queueing buffers: %X", error);
 
-		buffer = channel.freeBuffers.erase(buffer);
+		channel.freeBufferCount--;
 	}
 }
 
+void SoundManager::startDecodeWorkers(size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		_decodeWorkers.push_back(new DecodeWorker(*this));
+
+		if (!_decodeWorkers.back()->createThread())
+			throw Common::Exception("Failed to create sound decode thread: %s", SDL_GetError());
+	}
+}
+
+void SoundManager::stopDecodeWorkers() {
+	// This waits for channels currently being decoded to finish
+	for (std::vector<DecodeWorker *>::iterator w = _decodeWorkers.begin(); w != _decodeWorkers.end(); ++w)
+		delete *w;
+
+	_decodeWorkers.clear();
+
+	Common::StackLock lock(_decodeMutex);
+
+	for (size_t i = _decodeQueueHead; i < _decodeQueue.size(); i++)
+		if (_decodeQueue[i])
+			_decodeQueue[i]->decodeQueued = false;
+
+	_decodeQueue.clear();
+	_decodeQueueHead = 0;
+}
+
+void SoundManager::queueDecode(Channel &channel) {
+	if (!_hasSound || (channel.format == AL_NONE))
+		return;
+
+	if (channel.ring->isFull() || channel.ring->isFinished())
+		return;
+
+	Common::StackLock lock(_decodeMutex);
+
+	if (channel.decodeQueued || channel.decoding)
+		return;
+
+	channel.decodeQueued = true;
+
+	_decodeQueue.push_back(&channel);
+	_decodeRequest.signal();
+}
+
+void SoundManager::cancelDecode(Channel &channel) {
+	Common::StackLock lock(_decodeMutex);
+
+	if (channel.decodeQueued) {
+		for (size_t i = _decodeQueueHead; i < _decodeQueue.size(); i++)
+			if (_decodeQueue[i] == &channel)
+				_decodeQueue[i] = 0;
+
+		channel.decodeQueued = false;
+	}
+
+	while (channel.decoding)
+		_decodeDone.wait();
+}
+
+SoundManager::Channel *SoundManager::takeDecode(uint32 timeout) {
+	Common::StackLock lock(_decodeMutex);
+
+	if (_decodeQueueHead == _decodeQueue.size())
+		_decodeRequest.wait(timeout);
+
+	while (_decodeQueueHead < _decodeQueue.size()) {
+		Channel *channel = _decodeQueue[_decodeQueueHead++];
+
+		// Drop the taken entries, without giving up the queue's memory
+		if (_decodeQueueHead == _decodeQueue.size()) {
+			_decodeQueue.clear();
+			_decodeQueueHead = 0;
+		} else if ((_decodeQueueHead * 2) >= _decodeQueue.size()) {
+			_decodeQueue.erase(_decodeQueue.begin(), _decodeQueue.begin() + _decodeQueueHead);
+			_decodeQueueHead = 0;
+		}
+
+		// Channels freed while waiting in the queue
+		if (!channel)
+			continue;
+
+		channel->decodeQueued = false;
+		channel->decoding     = true;
+
+		return channel;
+	}
+
+	return 0;
+}
+
+void SoundManager::runDecode(Channel &channel) {
+	const bool wasEmpty = channel.ring->isEmpty();
+
+	try {
+		decodeData(channel);
+	} catch (...) {
+		Common::exceptionDispatcherWarning("Failed decoding sound");
+
+		channel.ring->setFinished(true);
+	}
+
+	{
+		Common::StackLock lock(_decodeMutex);
+
+		channel.decoding = false;
+		_decodeDone.signal();
+	}
+
+	// If the channel might be starving, let the sound thread hand over the new data right away
+	if (wasEmpty)
+		_needUpdate.signal();
+}
+
 void SoundManager::checkReady() {
 	if (!_ready)
 		throw Common::Exception("SoundManager not ready");
@@ -632,36 +1065,46 @@ void SoundManager::checkReady() {
 void SoundManager::update() {
 	Common::StackLock lock(_mutex);
 
-	for (size_t i = 0; i < kChannelCount; i++) {
-		if (!_channels[i])
-			continue;
+	const uint64 startTime = Common::getMicroTimestamp();
+
+	for (ChannelList::iterator c = _activeChannels.begin(); c != _activeChannels.end(); ) {
+		// Advance first, since freeing the channel removes it from the list
+		Channel &channel = **c++;
 
 		// Free the channel if it is no longer playing
-		if (!isPlaying(i)) {
-			freeChannel(i);
+		if (!isPlaying(channel.index)) {
+			freeChannel(channel.index);
 			continue;
 		}
 
-		// Try to buffer some more data
-		bufferData(i);
+		// Try to decode and buffer some more data
+		if (_decodeWorkers.empty()) {
+			decodeData(channel);
+			bufferData(channel);
+		} else {
+			bufferData(channel);
+			queueDecode(channel);
+		}
 	}
-}
 
-ChannelHandle SoundManager::newChannel() {
-	size_t foundChannel = kChannelInvalid;
+	const uint64 time = Common::getMicroTimestamp() - startTime;
 
-	for (size_t i = 0; (i < kChannelCount) && (foundChannel == kChannelInvalid); i++)
-		if (!_channels[i])
-			foundChannel = i;
+	_updateStats.updates++;
+	_updateStats.time   += time;
+	_updateStats.maxTime = MAX(_updateStats.maxTime, time);
+}
 
-	if (foundChannel == kChannelInvalid)
+ChannelHandle SoundManager::newChannel() {
+	if (_freeChannels.empty())
 		throw Common::Exception("All sound channels occupied");
 
 	ChannelHandle handle;
 
-	handle.channel = foundChannel;
+	handle.channel = _freeChannels.back();
 	handle.id      = _curID++;
 
+	_freeChannels.pop_back();
+
 	// ID 0 is reserved for "invalid ID"
 	if (_curID == 0)
 		_curID++;
@@ -708,6 +1151,9 @@ void SoundManager::freeChannel(size_t channel) {
 		// Nothing to do
 		return;
 
+	// Make sure no decode worker touches the channel anymore
+	cancelDecode(*c);
+
 	// Discard the stream, if requested
 	if (c->disposeAfterUse)
 		delete c->stream;
@@ -718,17 +1164,25 @@ void SoundManager::freeChannel(size_t channel) {
 			alDeleteSources(1, &c->source);
 
 		// Delete the OpenAL buffers
-		for (std::list<ALuint>::iterator buffer = c->buffers.begin(); buffer != c->buffers.end(); ++buffer)
-			alDeleteBuffers(1, &*buffer);
+		for (size_t i = 0; i < kOpenALBufferCount; i++)
+			if (c->buffers[i])
+				alDeleteBuffers(1, &c->buffers[i]);
 	}
 
+	delete c->ring;
+
 	// Remove the channel from the type list
 	if (c->typeIt != _types[c->type].list.end())
 		_types[c->type].list.erase(c->typeIt);
 
+	// Remove the channel from the active list
+	_activeChannels.erase(c->activeIt);
+
 	// And finally delete the channel itself
 	delete c;
 	_channels[channel] = 0;
+
+	_freeChannels.push_back(channel);
 }
 
 void SoundManager::threadMethod() {
@@ -36,11 +36,16 @@
 #endif
 
 #include <list>
+#include <vector>
+#include <map>
+
+#include <boost/shared_array.hpp>
 
 #include "src/common/types.h"
 #include "src/common/singleton.h"
 #include "src/common/thread.h"
 #include "src/common/mutex.h"
+#include "src/common/ustring.h"
 
 #include "src/sound/types.h"
 
@@ -51,8 +56,20 @@ namespace Common {
 namespace Sound {
 
 class AudioStream;
+class RewindableAudioStream;
+class RingBuffer;
 
-/** The sound manager. */
+/** The sound manager.
+ *
+ *  All sound output goes through OpenAL, with one OpenAL source per channel.
+ *  A pool of decode workers decodes the channels' audio streams ahead of the
+ *  playback position into preallocated ring buffers. The sound thread feeds
+ *  the decoded blocks into a fixed number of OpenAL buffers per source. Only
+ *  the currently active channels are visited, and no memory is allocated
+ *  while streaming.
+ *
+ *  Without any decode workers, the sound thread decodes the streams itself.
+ */
 class SoundManager : public Common::Singleton<SoundManager>, public Common::Thread {
 public:
 	SoundManager();
@@ -105,6 +122,47 @@ public:
 	ChannelHandle playAudioStream(AudioStream *audStream,
 	                              SoundType type, bool disposeAfterUse = true);
 
+	/** Play a sound file, keeping it in the sound cache if it's short.
+	 *
+	 *  Like playSoundFile(), but if the sound is short enough, it is decoded
+	 *  completely right away and put into the sound cache under this name.
+	 *
+	 *  This decoding happens in the calling thread, before the sound starts
+	 *  playing. That is intended: only sounds of at most 1MB of PCM data are
+	 *  decoded this way, which usually takes only a few milliseconds. Every
+	 *  later playCachedSound() of the same sound needs no decoding at all.
+	 *
+	 *  The change ID identifies the data the sound was read from, for
+	 *  example the resource's ResourceManager::getResourceChangeID().
+	 *
+	 *  @param  name The name to cache the sound under.
+	 *  @param  changeID The change ID of the sound's data.
+	 *  @param  wavStream The stream to play. Will be taken over.
+	 *  @param  type The type of the sound.
+	 *  @param  loop Should the sound loop?
+	 *  @return The channel the sound has been assigned to.
+	 */
+	ChannelHandle playSoundFile(const Common::UString &name, uint64 changeID,
+	                            Common::SeekableReadStream *wavStream, SoundType type, bool loop = false);
+
+	/** Play a sound out of the sound cache.
+	 *
+	 *  This only allocate a channel for the sound, to actually start playing it,
+	 *  call startChannel().
+	 *
+	 *  A cached sound with a different change ID is out of date, because
+	 *  the data it was read from changed. It is dropped from the cache.
+	 *
+	 *  @param  name The name the sound was cached under.
+	 *  @param  changeID The current change ID of the sound's data.
+	 *  @param  type The type of the sound.
+	 *  @param  loop Should the sound loop?
+	 *  @return The channel the sound has been assigned to, or an invalid
+	 *          channel if no current sound of that name is in the cache.
+	 */
+	ChannelHandle playCachedSound(const Common::UString &name, uint64 changeID,
+	                              SoundType type, bool loop = false);
+
 
 	// Starting/Pausing/Stopping channels
 
@@ -147,40 +205,134 @@ public:
 	/** Set the pitch of the channel. */
 	void setChannelPitch(const ChannelHandle &handle, float pitch);
 
+	/** Return how often the channel ran out of decoded data while playing. */
+	uint32 getChannelUnderruns(const ChannelHandle &handle);
+
 
 	// Type properties
 
 	/** Set the gain/volume of all channels of a specific type. */
 	void setTypeGain(SoundType type, float gain);
 
+
+	// Statistics
+
+	/** Statistics about the sound thread's updates. */
+	struct UpdateStats {
+		uint64 updates;   ///< Number of updates.
+		uint64 time;      ///< Total time spent in updates, in microseconds.
+		uint64 maxTime;   ///< Time spent in the longest update, in microseconds.
+		uint64 underruns; ///< Number of times any channel ran out of decoded data.
+
+		size_t activeChannels; ///< Number of currently active channels.
+
+		UpdateStats();
+	};
+
+	/** Return statistics about the sound thread's updates. */
+	UpdateStats getUpdateStats();
+	/** Reset the update statistics. */
+	void resetUpdateStats();
+
+
+	// Sound cache
+
+	/** Statistics about the cache of decoded sounds. */
+	struct CacheStats {
+		uint64 hits;      ///< Number of sounds played out of the cache.
+		uint64 misses;    ///< Number of sounds not found in the cache.
+		uint64 evictions; ///< Number of sounds dropped from the cache to make room.
+
+		uint64 invalidations; ///< Number of sounds dropped because their data changed.
+
+		size_t entries; ///< Number of sounds currently in the cache.
+		size_t size;    ///< Memory currently used by the cache, in bytes.
+		size_t budget;  ///< Maximum memory the cache may use, in bytes.
+
+		CacheStats();
+	};
+
+	/** Set the maximum memory used for caching decoded sounds.
+	 *
+	 *  Short sounds played through the named playSoundFile() are decoded
+	 *  once and kept in memory as shared PCM data. Playing them again with
+	 *  playCachedSound() then doesn't need any decoding at all. When the
+	 *  cache exceeds its budget, the least recently played sounds are dropped.
+	 *
+	 *  @param size The maximum size of the cache, in bytes. 0 disables the cache.
+	 */
+	void setSoundCacheSize(size_t size);
+
+	/** Return statistics about the cache of decoded sounds. */
+	CacheStats getCacheStats();
+
 private:
 	static const size_t kChannelCount = 65535; ///< Maximal number of channels.
 
+	/** Control how many buffers per sound OpenAL will create.
+	 *
+	 *  @note clone2727 says: 5 is just a safe number. Mine only reached a max of 2.
+	 */
+	static const size_t kOpenALBufferCount = 5;
+
+	class DecodeWorker;
+
 	struct Channel;
-	typedef std::list<Channel *> TypeList;
+	typedef std::list<Channel *> ChannelList;
 
 	/** A sound type. */
 	struct Type {
-		float    gain; ///< The sound type's current gain.
-		TypeList list; ///< The list of channels for that type.
+		float       gain; ///< The sound type's current gain.
+		ChannelList list; ///< The list of channels for that type.
+	};
+
+	/** A completely decoded sound in the sound cache. */
+	struct CachedSound {
+		Common::UString name;     ///< The name the sound is cached under.
+		uint64          changeID; ///< The change ID of the data the sound was decoded from.
+
+		boost::shared_array<const byte> data; ///< The little-endian 16-bit PCM samples.
+		size_t size; ///< The size of the PCM data, in bytes.
+
+		int rate;     ///< The sample rate of the sound.
+		int channels; ///< The number of channels of the sound.
 	};
 
+	/** All cached sounds, the most recently played first. */
+	typedef std::list<CachedSound> SoundCacheList;
+	/** Cached sounds, by their name. */
+	typedef std::map<Common::UString, SoundCacheList::iterator> SoundCacheMap;
+
 	/** A sound channel. */
 	struct Channel {
-		uint32 id; ///< The channel's ID.
+		uint32 id;    ///< The channel's ID.
+		size_t index; ///< The channel's index in the channel array.
 
 		ALint state; ///< The sound's state.
 
 		AudioStream *stream;  ///< The actual audio stream.
 		bool disposeAfterUse; ///< Delete the audio stream when done playing?
 
+		ALenum format; ///< The OpenAL format of the sound, or AL_NONE if unsupported.
+		int    rate;   ///< The sample rate of the sound.
+
 		ALuint source; ///< OpenAL source for this channel.
 
-		std::list<ALuint> buffers;     ///< List of buffers for that channel.
-		std::list<ALuint> freeBuffers; ///< List of free buffers not filled with data.
+		ALuint buffers[kOpenALBufferCount];     ///< All OpenAL buffers of this channel.
+		ALuint freeBuffers[kOpenALBufferCount]; ///< The buffers not currently queued.
+		size_t freeBufferCount;                 ///< Number of buffers not currently queued.
+
+		/** Decoded sound data, waiting to be handed to OpenAL. */
+		RingBuffer *ring;
 
-		SoundType type;            ///< The channel's sound type.
-		TypeList::iterator typeIt; ///< Iterator into the type list.
+		bool decodeQueued; ///< Is the channel waiting for a decode worker?
+		bool decoding;     ///< Is a decode worker currently decoding the channel?
+
+		uint32 underruns; ///< Number of times the channel ran out of decoded data.
+
+		SoundType type;                 ///< The channel's sound type.
+		ChannelList::iterator typeIt;   ///< Iterator into the type list.
+		ChannelList::iterator activeIt; ///< Iterator into the active channel list.
 
 		float gain; ///< The channel's gain.
 	};
@@ -195,6 +347,25 @@ private:
 	Channel *_channels[kChannelCount]; ///< The sound channels.
 	Type     _types   [kSoundTypeMAX]; ///< The sound types.
 
+	ChannelList         _activeChannels; ///< All channels currently in use.
+	std::vector<size_t> _freeChannels;   ///< Indices of all unused channels.
+
+	UpdateStats _updateStats; ///< Statistics about the sound thread's updates.
+
+	SoundCacheList _soundCache;    ///< Cached decoded sounds.
+	SoundCacheMap  _soundCacheMap; ///< Cached decoded sounds, by name.
+	CacheStats     _cacheStats;    ///< Statistics about the sound cache.
+
+	/** Milliseconds of sound to decode ahead of the playback position. */
+	uint32 _lookahead;
+
+	std::vector<DecodeWorker *> _decodeWorkers; ///< The decode worker threads.
+
+	/** Channels waiting for a decode worker, oldest first. Freed channels are 0. */
+	std::vector<Channel *> _decodeQueue;
+	/** Position of the oldest channel in the decode queue. */
+	size_t _decodeQueueHead;
+
 	uint32 _curID; ///< The ID the next sound will get.
 
 	Common::Mutex _mutex;
@@ -202,6 +373,13 @@ private:
 	/** Condition to signal that an update is needed. */
 	Common::Condition _needUpdate;
 
+	/** Protects the decode queue and the channels' decode flags. */
+	Common::Mutex _decodeMutex;
+	/** Condition to signal that a channel has been queued for decoding. */
+	Common::Condition _decodeRequest;
+	/** Condition to signal that a decode worker has finished a channel. */
+	Common::Condition _decodeDone;
+
 	ALCdevice *_dev;
 	ALCcontext *_ctx;
 
@@ -214,13 +392,28 @@ private:
 	/** Look for a free place in the channel vector. */
 	ChannelHandle newChannel();
 
-	/** Buffer more sound from the channel to the OpenAL buffers. */
+	/** Decode up to this many blocks from the channel's audio stream into its ring buffer. */
+	void decodeData(Channel &channel, size_t maxBlocks = SIZE_MAX);
+	/** Buffer more sound from the channel's ring buffer to the OpenAL buffers. */
 	void bufferData(Channel &channel);
-	/** Buffer more sound from the channel to the OpenAL buffers. */
-	void bufferData(size_t channel);
+
+	/** Start the decode worker threads. */
+	void startDecodeWorkers(size_t count);
+	/** Stop the decode worker threads. */
+	void stopDecodeWorkers();
+
+	/** Queue the channel for decoding by a decode worker, if it needs more data. */
+	void queueDecode(Channel &channel);
+	/** Make sure no decode worker is and will be touching the channel. */
+	void cancelDecode(Channel &channel);
+
+	/** Wait for a channel to decode and take it out of the queue. Returns 0 on timeout. */
+	Channel *takeDecode(uint32 timeout);
+	/** Decode the channel taken by takeDecode(), in a decode worker. */
+	void runDecode(Channel &channel);
 
 	/** Is that channel currently playing a sound? */
-	bool isPlaying(size_t channel) const;
+	bool isPlaying(size_t channel);
 
 	/** Pause/Unpause a channel. */
 	void pauseChannel(Channel *channel, bool pause);
@@ -237,8 +430,25 @@ private:
 
 	static AudioStream *makeAudioStream(Common::SeekableReadStream *stream);
 
-	/** Fill the buffer with data from the audio stream. */
-	bool fillBuffer(ALuint alBuffer, AudioStream *stream) const;
+	/** Play an audio stream made from a sound file, looping it if requested. */
+	ChannelHandle playSoundStream(AudioStream *audioStream, SoundType type, bool loop);
+
+	/** Completely decode a short sound. Returns false if the sound is too long. */
+	static bool decodeSound(RewindableAudioStream &stream, CachedSound &sound);
+	/** Create an audio stream playing a cached sound. */
+	static AudioStream *makeCachedStream(const CachedSound &sound, bool loop);
+
+	/** Put a decoded sound into the cache. */
+	void cacheSound(const CachedSound &sound);
+	/** Remove this sound from the cache. Needs the lock held. */
+	void uncacheSound(SoundCacheMap::iterator sound);
+	/** Drop all sounds from the cache. */
+	void clearSoundCache();
+	/** Drop the least recently played sounds until the cache is within budget again. */
+	void trimSoundCache();
+
+	/** Return the OpenAL format for the audio stream, or AL_NONE if it's not supported. */
+	ALenum getFormat(const AudioStream &stream) const;
 };
 
 } // End of namespace Sound
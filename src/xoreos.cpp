@@ -47,6 +47,8 @@
 #include "src/aurora/talkman.h"
 #include "src/aurora/util.h"
 
+#include "src/aurora/nwscript/scriptcache.h"
+
 #include "src/graphics/queueman.h"
 #include "src/graphics/graphics.h"
 
@@ -62,6 +64,7 @@
 #include "src/graphics/aurora/textureman.h"
 #include "src/graphics/aurora/cursorman.h"
 #include "src/graphics/aurora/fontman.h"
+#include "src/graphics/aurora/modelqueueman.h"
 
 static void initPlatform();
 static void initConfig();
@@ -133,6 +136,30 @@ int main(int argc, char **argv) {
 		if (!DebugMan.openLogFile(logFile))
 			warning("Failed to open log file \"%s\" for writing", logFile.c_str());
 
+	/* Use the resource index cache.
+	 *
+	 * NOTE: The cache is used by default, unless the indexcache config value
+	 *       is set to an empty string or noindexcache is set to true.
+	 */
+	Common::UString indexCacheFile = Common::FilePath::getUserDataFile("resindex.cache");
+	if (ConfigMan.hasKey("indexcache"))
+		indexCacheFile = ConfigMan.getString("indexcache");
+	if (ConfigMan.getBool("noindexcache", false))
+		indexCacheFile.clear();
+
+	ResMan.setIndexCache(indexCacheFile);
+
+	// Map archives into memory. By default, only on 64-bit systems, to not run out of address space
+	if (ConfigMan.hasKey("maparchives"))
+		ResMan.setMapArchives(ConfigMan.getBool("maparchives"));
+
+	// Size of the decompressed resource cache, in MB
+	if (ConfigMan.hasKey("rescache"))
+		ResMan.setResourceCacheSize((size_t) MAX<int>(ConfigMan.getInt("rescache"), 0) * 1024 * 1024);
+
+	// Decode all strings of talk tables in several threads when loading them, instead of on demand
+	TalkMan.setPredecode(ConfigMan.getBool("tlkpredecode", false));
+
 	DebugMan.logCommandLine(args);
 
 	status("Target \"%s\"", target.c_str());
@@ -304,6 +331,7 @@ static void deinit() {
 	Common::deinitXML();
 
 	// Destroy global singletons
+	Graphics::Aurora::ModelQueueManager::destroy();
 	Graphics::Aurora::FontManager::destroy();
 	Graphics::Aurora::CursorManager::destroy();
 	Graphics::Aurora::TextureManager::destroy();
@@ -311,6 +339,7 @@ static void deinit() {
 	Aurora::LanguageManager::destroy();
 	Aurora::TalkManager::destroy();
 	Aurora::TwoDARegistry::destroy();
+	Aurora::NWScript::ScriptCache::destroy();
 	Aurora::ResourceManager::destroy();
 	Aurora::FileTypeManager::destroy();
 